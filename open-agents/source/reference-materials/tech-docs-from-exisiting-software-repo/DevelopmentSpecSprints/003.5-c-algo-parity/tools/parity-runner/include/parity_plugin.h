@@ -0,0 +1,65 @@
+#ifndef PARITY_PLUGIN_H
+#define PARITY_PLUGIN_H
+
+#include "types.h"
+
+/*
+ * In-process engine plugin ABI.
+ *
+ * A plugin is a shared library exporting PARITY_PLUGIN_ENTRY_SYMBOL, a function
+ * returning a static ParityEnginePlugin descriptor. parity-runner loads it with
+ * dlopen (--c-engine-so / --alt-engine-so) and calls generate() directly with the
+ * parsed InputCase, so colors never pass through JSON.
+ *
+ * InputCase and EngineColor are shared by layout, which is why the descriptor
+ * records the sizes the plugin was compiled against. Bump
+ * PARITY_PLUGIN_ABI_VERSION whenever either struct, or this descriptor, changes.
+ *
+ * generate() is called concurrently from several workers under --jobs, so it
+ * must be reentrant.
+ */
+
+#define PARITY_PLUGIN_ABI_VERSION 1u
+#define PARITY_PLUGIN_ENTRY_SYMBOL "parity_engine_plugin"
+
+typedef struct {
+    uint32_t abi_version;        /* PARITY_PLUGIN_ABI_VERSION */
+    uint32_t input_case_size;    /* sizeof(InputCase) */
+    uint32_t engine_color_size;  /* sizeof(EngineColor) */
+    const char *engine;          /* reported as EngineOutput.engine */
+    const char *commit;          /* optional */
+    const char *build_flags;     /* optional */
+    const char *platform;        /* optional */
+
+    /*
+     * Writes up to `capacity` colors for `input_case` into the caller-provided
+     * `colors` buffer (capacity == input_case->config.count) and stores the number
+     * written in `out_count`. Returns 0 on success; on failure returns non-zero and
+     * may describe the problem in `error_message`.
+     */
+    int (*generate)(const InputCase *input_case,
+                    EngineColor *colors,
+                    size_t capacity,
+                    size_t *out_count,
+                    char *error_message,
+                    size_t error_capacity);
+} ParityEnginePlugin;
+
+typedef const ParityEnginePlugin *(*ParityEnginePluginEntry)(void);
+
+/* Declaration plugins implement; the export must use C linkage. */
+const ParityEnginePlugin *parity_engine_plugin(void);
+
+#define PARITY_PLUGIN_DESCRIPTOR_INIT(engine_name, generate_fn) \
+    {                                                              \
+        PARITY_PLUGIN_ABI_VERSION,                                 \
+        (uint32_t)sizeof(InputCase),                               \
+        (uint32_t)sizeof(EngineColor),                             \
+        (engine_name),                                             \
+        NULL,                                                      \
+        NULL,                                                      \
+        NULL,                                                      \
+        (generate_fn)                                              \
+    }
+
+#endif // PARITY_PLUGIN_H
@@ -4,12 +4,15 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
 
 #define MAX_ID_LENGTH 128
 #define MAX_VERSION_LENGTH 32
 #define MAX_ERROR_MESSAGE 512
 #define MAX_ENGINE_NAME 32
 #define MAX_PATH_LENGTH 512
+#define FINGERPRINT_LENGTH 16
 
 struct Contributor;
 
@@ -44,6 +47,17 @@ typedef struct {
     uint32_t count;
 } EngineConfig;
 
+/* Bump allocator (arena.c); a zeroed Arena is empty. */
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *blocks;     /* current block first */
+    size_t next_block_size;
+    size_t allocations;     /* objects handed out */
+    size_t block_count;     /* heap allocations behind them */
+    size_t bytes;
+} Arena;
+
 typedef struct {
     char id[MAX_ID_LENGTH];
     Anchor *anchors;
@@ -61,6 +75,7 @@ typedef struct {
     char *description;
     InputCase *cases;
     size_t case_count;
+    Arena arena; /* owns the description, the cases and everything they point to */
 } Corpus;
 
 typedef struct {
@@ -85,6 +100,7 @@ typedef struct {
     char *policy_notes;
     char *provenance_source;
     char *provenance_updated;
+    Arena arena; /* owns the strings above */
 } ToleranceConfig;
 
 typedef struct {
@@ -104,11 +120,13 @@ typedef struct {
     EngineColor *colors;
     size_t color_count;
     double duration_ms;
+    double wall_ms; /* runner-observed time from request to complete output */
     char *commit;
     char *build_flags;
     char *platform;
 } EngineOutput;
 
+/* One compared sample; executed cases derive it on demand with comparison_sample(). */
 typedef struct {
     size_t index;
     EngineColor canonical;
@@ -117,9 +135,54 @@ typedef struct {
     SrgbColor rgb_delta;
 } SampleDelta;
 
+/* Wall-clock (CLOCK_MONOTONIC) time spent in each phase of one case. */
+typedef struct {
+    double spawn_ms;   /* starting runner processes / sending server requests */
+    double wait_ms;    /* waiting for engine output (includes in-process plugin calls) */
+    double parse_ms;   /* reaping runners and decoding their output or a cached one */
+    double compare_ms;
+    double write_ms;   /* per-case artifact files */
+    double total_ms;   /* whole case, 0 when the case was not executed */
+} CaseTiming;
+
+/* Runner-reported durationMs over the timed trials of one engine (--repeat). */
+typedef struct {
+    size_t trials;   /* timed trials; 0 when the case ran once */
+    size_t rejected; /* trials further than the outlier MAD multiple from the median */
+    double median_ms;
+    double mad_ms;
+    double min_ms;
+} TrialStats;
+
+#define NONDETERMINISTIC_CANONICAL 0x1u
+#define NONDETERMINISTIC_ALTERNATE 0x2u
+
+/* The seven summarized delta metrics, in the order of the max_* fields and RunStats. */
+typedef enum {
+    RUN_METRIC_DELTA_E,
+    RUN_METRIC_L,
+    RUN_METRIC_A,
+    RUN_METRIC_B,
+    RUN_METRIC_RGB_R,
+    RUN_METRIC_RGB_G,
+    RUN_METRIC_RGB_B,
+    RUN_METRIC_COUNT
+} RunMetric;
+
+/* Welford moments with exact extremes. */
+typedef struct {
+    size_t count;
+    double mean;
+    double m2; /* sum of squared deviations from the mean */
+    double min;
+    double max;
+} RunningMoments;
+
 typedef struct {
     char input_case_id[MAX_ID_LENGTH];
-    SampleDelta *samples;
+    EngineColor *canonical_colors; /* sample i compares canonical_colors[i] with alternate_colors[i] */
+    EngineColor *alternate_colors;
+    SampleDelta *samples;          /* instead of the palettes for results read back from a report */
     size_t sample_count;
     int passed;
     double max_delta_e;
@@ -129,10 +192,34 @@ typedef struct {
     double max_rgb_r;
     double max_rgb_g;
     double max_rgb_b;
+    double max_signed[RUN_METRIC_COUNT]; /* canonical - alternate where each max_* was first reached; ΔE as is */
+    RunningMoments *moments;             /* per-metric |delta| moments from the compare pass; --stats streaming only */
+    bool accumulated;                    /* counted into a RunAccumulator by the compare pass */
     struct Contributor *contributors;
     size_t contributor_count;
+    char fingerprint[FINGERPRINT_LENGTH + 1]; /* case + engine fingerprint; empty when unknown */
+    bool carried_over;                        /* reused from the --since report */
+    CaseTiming timing;
+    double canonical_duration_ms;             /* runner-reported durationMs; 0 when unknown */
+    double alternate_duration_ms;
+    TrialStats canonical_trials;
+    TrialStats alternate_trials;
+    unsigned nondeterministic;                /* NONDETERMINISTIC_* engines whose trials disagreed; fails the case */
 } ComparisonResult;
 
+#define MAX_PERCENTILES 16
+
+typedef struct {
+    double percent; /* e.g. 99.9 */
+    double value;
+} Percentile;
+
+/* --percentiles: extra ranks reported next to p50/p95/p99, in the order given. */
+typedef struct {
+    size_t count;
+    double percents[MAX_PERCENTILES];
+} PercentileList;
+
 typedef struct {
     double mean;
     double stddev;
@@ -141,15 +228,65 @@ typedef struct {
     double p99;
     double min;
     double max;
+    size_t percentile_count;
+    Percentile percentiles[MAX_PERCENTILES];
 } MetricStats;
 
+#define LOG_HISTOGRAM_MIN_EXPONENT (-50) /* values below 2^-50, zero included, count as underflow */
+#define LOG_HISTOGRAM_MAX_EXPONENT 12    /* values from 2^12 up, infinities included, count as overflow */
+#define LOG_HISTOGRAM_SUB_BUCKETS 128    /* linear buckets per power of two: at most 1/128 relative width */
+#define LOG_HISTOGRAM_BUCKETS ((LOG_HISTOGRAM_MAX_EXPONENT - LOG_HISTOGRAM_MIN_EXPONENT) * LOG_HISTOGRAM_SUB_BUCKETS)
+
+/* HDR-style log-linear histogram with a fixed layout, so any two merge bucket by bucket. */
+typedef struct {
+    size_t total;
+    size_t underflow;
+    size_t overflow;
+    size_t nan_count;
+    size_t *counts; /* LOG_HISTOGRAM_BUCKETS */
+} LogHistogram;
+
+#define QUANTILE_SKETCH_ALPHA 0.01 /* relative error bound of every sketch quantile */
+#define QUANTILE_SKETCH_BINS 2048  /* log-spaced buckets; covers about 17 decades at ALPHA */
+
+/*
+ * DDSketch over non-negative values: bucket i holds values in
+ * (gamma^(i-1), gamma^i] with gamma = (1 + ALPHA) / (1 - ALPHA). When the
+ * values span more buckets than fit, the lowest ones are collapsed together.
+ */
+typedef struct {
+    double log_gamma;
+    int offset;      /* bucket index of bins[0] */
+    int min_index;   /* occupied bucket range; meaningful while binned > 0 */
+    int max_index;
+    size_t binned;
+    size_t zero_count;     /* zeros and negative values */
+    size_t infinite_count;
+    size_t bins[QUANTILE_SKETCH_BINS];
+} QuantileSketch;
+
+/* O(1)-memory replacement for compute_metric_stats: Welford moments, exact min/max, sketched quantiles. */
 typedef struct {
-    double min_value;
-    double max_value;
-    double bucket_size;
-    size_t bucket_count;
-    size_t *counts;
-} Histogram;
+    RunningMoments moments;
+    QuantileSketch sketch;
+} StreamingStats;
+
+typedef enum {
+    STATS_MODE_EXACT = 0,
+    STATS_MODE_STREAMING
+} StatsMode;
+
+/*
+ * Run-wide state the fused compare pass updates, one per worker. It holds
+ * only counts and extremes, so per-worker copies merge exactly in any order;
+ * per-case moments live on the results and are folded in corpus order.
+ */
+typedef struct {
+    StatsMode mode;
+    size_t samples;
+    LogHistogram hist[RUN_METRIC_COUNT];
+    QuantileSketch sketch[RUN_METRIC_COUNT]; /* --stats streaming only */
+} RunAccumulator;
 
 typedef struct {
     MetricStats delta_e;
@@ -159,20 +296,63 @@ typedef struct {
     MetricStats rgb_r;
     MetricStats rgb_g;
     MetricStats rgb_b;
-    Histogram delta_e_hist;
+    LogHistogram delta_e_hist;
+    LogHistogram l_hist;
+    LogHistogram a_hist;
+    LogHistogram b_hist;
+    LogHistogram rgb_r_hist;
+    LogHistogram rgb_g_hist;
+    LogHistogram rgb_b_hist;
 } RunStats;
 
 typedef struct {
     char *message;
 } ValidationError;
 
+typedef struct {
+    double total_ms;
+    MetricStats stats;
+} PhaseTiming;
+
+typedef struct {
+    size_t measured_cases;
+    PhaseTiming spawn;
+    PhaseTiming wait;
+    PhaseTiming parse;
+    PhaseTiming compare;
+    PhaseTiming write;
+    PhaseTiming total;
+} RunTiming;
+
+#define MAX_SLOWEST_CASES 5
+
+/* Runner-reported engine durations over the cases where both engines reported one. */
+typedef struct {
+    size_t measured_cases;
+    double canonical_total_ms;
+    double alternate_total_ms;
+    double slowdown;              /* alternate_total_ms / canonical_total_ms; 0 when unmeasured */
+    MetricStats canonical_duration;
+    MetricStats alternate_duration;
+    MetricStats speed_ratio;      /* per case alternate / canonical */
+    size_t slowest[MAX_SLOWEST_CASES]; /* result indices, highest speed ratio first */
+    size_t slowest_count;
+} EnginePerformance;
+
 typedef struct {
     size_t total_cases;
     size_t passed;
     size_t failed;
     double duration_ms;
     double pass_rate;
+    size_t nondeterministic_cases;
+    size_t sample_count;
+    size_t peak_rss_bytes; /* process peak RSS once every case is summarized; 0 when unmeasured */
+    StatsMode stats_mode;  /* --stats; read by summarize_run_results */
+    PercentileList percentiles; /* --percentiles; read by summarize_run_results */
     RunStats stats;
+    RunTiming timing;
+    EnginePerformance performance;
 } RunSummary;
 
 typedef struct {
@@ -186,12 +366,27 @@ typedef struct {
     char *alt_build_flags;
     double max_duration_ms;
     double pass_gate;
+    double max_slowdown; /* 0 disables the slowdown gate */
     const char *artifact_policy;
+    const char *engine_format; /* "json" or "bin"; NULL when unknown */
+    bool cache_enabled;
+    size_t cache_hits;
+    size_t cache_misses;
+    const char *since_report;
+    size_t carried_over;
+    size_t repeat;       /* timed trials per case */
+    size_t warmup;       /* untimed trials per case */
+    double outlier_mad;
+    size_t shard_index;
+    size_t shard_count;  /* --shard i/n; 0 when the run is not sharded */
+    size_t merged_shards; /* set by parity-merge */
 } RunProvenance;
 
 typedef struct {
     ComparisonResult *results;
     size_t result_count;
+    RunAccumulator *accumulators; /* per-worker compare-pass state, owned by the caller; NULL when none */
+    size_t accumulator_count;
     RunSummary summary;
 } RunResults;
 
@@ -202,6 +397,9 @@ typedef struct {
     const char *parameter;
 } StageHint;
 
+typedef struct WorkerPool WorkerPool;
+typedef int (*WorkerTaskFn)(size_t index, size_t worker, void *context, ValidationError *error);
+
 typedef struct Contributor {
     char metric[32];
     double magnitude;
@@ -217,39 +415,367 @@ int validate_corpus_version(const char *version);
 int parse_corpus_file(const char *path, Corpus *out, ValidationError *error);
 int parse_tolerances_file(const char *path, ToleranceConfig *out, ValidationError *error);
 void free_corpus(Corpus *corpus);
+/* Only for a case parsed on its own; the cases of a Corpus are freed with it. */
+void free_input_case(InputCase *input_case);
+int parse_input_case_json(const char *json, InputCase *out, ValidationError *error);
+/*
+ * Same, for a case that is not NUL-terminated (e.g. a byte range of a mapped
+ * corpus). With an arena, the case's arrays and strings are allocated from it
+ * instead of the heap and are released with the arena.
+ */
+int parse_input_case_json_length(const char *json, size_t length, Arena *arena, InputCase *out, ValidationError *error);
+char *serialize_input_case(const InputCase *input_case);
 void free_tolerances(ToleranceConfig *config);
 
+// Process launching
+typedef struct {
+    double timeout_ms;      /* per case; 0 waits indefinitely */
+    size_t memory_limit_mb; /* RLIMIT_AS for engine processes; 0 inherits */
+    size_t cpu_limit_s;     /* RLIMIT_CPU for engine processes; 0 inherits */
+} LaunchLimits;
+
+typedef struct {
+    pid_t pid;
+    int stdin_fd;           /* write end of the child's stdin, -1 when inherited */
+    int stdout_fd;
+    char *output;           /* NUL-terminated bytes read so far; owned by the caller */
+    size_t output_length;
+    size_t output_capacity;
+    size_t scanned;
+    int eof;
+    int complete;
+    int binary_frames;      /* responses are engine frames rather than lines (engine servers only) */
+    double started_ms;
+    double finished_ms;
+} LaunchedProcess;
+
+double launcher_now_ms(void);
+int launch_process(char *const argv[],
+                   int pipe_stdin,
+                   const LaunchLimits *limits,
+                   size_t output_hint,
+                   LaunchedProcess *process,
+                   ValidationError *error);
+/* Reads until every process is complete (EOF, or a full response when until_response); deadline_ms of 0 never expires. */
+int drain_processes(LaunchedProcess *processes,
+                    size_t count,
+                    int until_response,
+                    double deadline_ms,
+                    size_t *failed,
+                    ValidationError *error);
+/* Removes the first response (a line, or a frame with binary_frames) from the output; *length excludes the newline. */
+char *take_process_response(LaunchedProcess *process, size_t *length, ValidationError *error);
+int reap_process(LaunchedProcess *process, int terminate, ValidationError *error);
+
 // Engine execution and parsing
+/* Wire format runners are asked to answer in (`--format bin` for ENGINE_FORMAT_BIN). */
+typedef enum {
+    ENGINE_FORMAT_JSON = 0,
+    ENGINE_FORMAT_BIN
+} EngineFormat;
+
 int run_c_engine(const char *binary_path,
                  const char *corpus_path,
-                 const char *case_id,
+                 const InputCase *input_case,
+                 const LaunchLimits *limits,
+                 EngineFormat format,
                  EngineOutput *out,
+                 CaseTiming *timing,
                  ValidationError *error);
 
 int run_alt_engine(const char *binary_path,
                    const char *corpus_path,
-                   const char *case_id,
+                   const InputCase *input_case,
+                   const LaunchLimits *limits,
+                   EngineFormat format,
                    EngineOutput *out,
+                   CaseTiming *timing,
                    ValidationError *error);
 
+typedef struct EngineServer EngineServer;
+/* Runs both engines for one case at the same time; *failed_engine is 0 (canonical) or 1 (alternate) on error. */
+int run_engine_pair(const char *c_binary_path,
+                    const char *alt_binary_path,
+                    const char *corpus_path,
+                    const InputCase *input_case,
+                    const LaunchLimits *limits,
+                    EngineFormat format,
+                    EngineOutput *canonical,
+                    EngineOutput *alternate,
+                    size_t *failed_engine,
+                    CaseTiming *timing,
+                    ValidationError *error);
+EngineServer *start_engine_server(const char *binary_path,
+                                  const LaunchLimits *limits,
+                                  EngineFormat format,
+                                  ValidationError *error);
+int engine_server_run_case(EngineServer *server,
+                           const InputCase *input_case,
+                           EngineOutput *out,
+                           CaseTiming *timing,
+                           ValidationError *error);
+int engine_server_run_pair(EngineServer *c_server,
+                           EngineServer *alt_server,
+                           const InputCase *input_case,
+                           EngineOutput *canonical,
+                           EngineOutput *alternate,
+                           size_t *failed_engine,
+                           CaseTiming *timing,
+                           ValidationError *error);
+int engine_server_failed(const EngineServer *server);
+int stop_engine_server(EngineServer *server);
+
+typedef struct EnginePlugin EnginePlugin;
+EnginePlugin *load_engine_plugin(const char *path, ValidationError *error);
+int run_engine_plugin(const EnginePlugin *plugin,
+                      const InputCase *input_case,
+                      EngineOutput *out,
+                      ValidationError *error);
+void unload_engine_plugin(EnginePlugin *plugin);
+
 int parse_engine_output(const char *buffer, EngineOutput *out, ValidationError *error);
+/* Binary EngineOutput frames (see engine_frame.c). engine_frame_size is 0 until a whole header is buffered. */
+size_t engine_frame_size(const char *data, size_t length);
+char *encode_engine_frame(const EngineOutput *output, size_t *length);
+int decode_engine_frame(const char *data, size_t length, EngineOutput *out, ValidationError *error);
 void free_engine_output(EngineOutput *output);
+int engine_outputs_identical(const EngineOutput *a, const EngineOutput *b);
+
+// Arena allocation (arena.c)
+void arena_init(Arena *arena, size_t first_block_size);
+/* Zeroed, 16-byte aligned memory that stays valid until arena_release(). */
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_calloc(Arena *arena, size_t count, size_t size);
+char *arena_strdup(Arena *arena, const char *text);
+void arena_release(Arena *arena);
+/* Routes cJSON allocations through the JSON arena hooks; call before starting any threads. */
+void install_json_arena_hooks(void);
+/*
+ * Until json_arena_end(), cJSON allocates from `arena` on the calling thread and
+ * cJSON_Delete()/cJSON_free() do nothing; rendered strings must be released with
+ * cJSON_free(), never free(). Scopes do not nest. Without the hooks both are no-ops.
+ */
+void json_arena_begin(Arena *arena);
+void json_arena_end(void);
+
+// Lazy corpus index (corpus_index.c)
+typedef struct {
+    char id[MAX_ID_LENGTH];
+    size_t offset;      /* byte range of the case object in the corpus file */
+    size_t length;
+    size_t tags_offset; /* the case's tags: tag_count NUL-terminated strings in the index's tag pool */
+    size_t tag_count;
+} CorpusIndexEntry;
+
+typedef struct {
+    char corpus_version[MAX_VERSION_LENGTH];
+    char *description;
+    CorpusIndexEntry *entries; /* in corpus order */
+    size_t entry_count;
+    char *tag_pool;
+    size_t tag_pool_length;
+    const char *data;          /* the memory-mapped corpus file */
+    size_t data_length;
+} CorpusIndex;
+
+int open_corpus_index(const char *path, CorpusIndex *out, ValidationError *error);
+int corpus_entry_has_tag(const CorpusIndex *index, const CorpusIndexEntry *entry, const char *tag);
+/* Parses the given entries, in order, into a Corpus holding just those cases. */
+int load_indexed_cases(const CorpusIndex *index, const size_t *entries, size_t count, Corpus *out, ValidationError *error);
+/* Loads a single case by id from a JSON or packed corpus, e.g. for a runner started with --corpus/--case-id. */
+int load_corpus_case(const char *path, const char *id, InputCase *out, ValidationError *error);
+void close_corpus_index(CorpusIndex *index);
+
+// Packed corpora (pcorpus.c)
+typedef struct {
+    const unsigned char *data; /* the memory-mapped .pcorpus file */
+    size_t length;
+    char corpus_version[MAX_VERSION_LENGTH];
+    const char *description;   /* points into the mapping */
+    size_t case_count;
+    size_t anchor_count;
+    size_t tag_ref_count;
+    size_t slot_count;
+    size_t strings_length;
+    size_t cases_offset;
+    size_t anchors_offset;
+    size_t tags_offset;
+    size_t slots_offset;
+    size_t strings_offset;
+} PackedCorpus;
+
+int is_packed_corpus_file(const char *path);
+int write_packed_corpus(const Corpus *corpus, const char *path, ValidationError *error);
+int open_packed_corpus(const char *path, PackedCorpus *out, ValidationError *error);
+const char *packed_case_id(const PackedCorpus *packed, size_t index);
+/* Looks up a case by id through the hash index; -1 if there is none. */
+int packed_corpus_find(const PackedCorpus *packed, const char *id, size_t *index);
+int packed_case_has_tag(const PackedCorpus *packed, size_t index, const char *tag);
+int load_packed_cases(const PackedCorpus *packed, const size_t *cases, size_t count, Corpus *out, ValidationError *error);
+/* Decodes one case on its own, to be freed with free_input_case(). */
+int load_packed_case(const PackedCorpus *packed, size_t index, InputCase *out, ValidationError *error);
+int parse_packed_corpus_file(const char *path, Corpus *out, ValidationError *error);
+void close_packed_corpus(PackedCorpus *packed);
+
+// Case selection (selection.c)
+typedef struct SelectExpr SelectExpr; /* a parsed --select expression */
+
+typedef struct {
+    const Corpus *corpus;     /* borrowed, with the tag and id strings */
+    const char **tag_names;   /* interned tags: bit i of a case's bitset is tag_names[i] */
+    size_t tag_count;
+    size_t *tag_slots;        /* open addressing over tag_names: position + 1, 0 = empty */
+    size_t tag_slot_count;
+    uint64_t *tag_bits;       /* case_count bitsets of tag_words words each */
+    size_t tag_words;
+    size_t *id_slots;         /* open addressing over case ids: case index + 1, 0 = empty */
+    size_t id_slot_count;
+    bool duplicate_ids;
+} CaseCatalog;
+
+SelectExpr *parse_select_expression(const char *text, ValidationError *error);
+void free_select_expression(SelectExpr *expr);
+int build_case_catalog(const Corpus *corpus, CaseCatalog *out, ValidationError *error);
+const InputCase *catalog_find_case(const CaseCatalog *catalog, const char *id);
+/*
+ * Fills `selected` (room for every case) with the indices of the cases matching
+ * `expr` (NULL = all), the --cases ids and any of the --tags, in corpus order.
+ */
+int select_cases(const CaseCatalog *catalog, const SelectExpr *expr, char **ids, size_t id_count, char **tags,
+                 size_t tag_count, size_t *selected, size_t *selected_count, ValidationError *error);
+void free_case_catalog(CaseCatalog *catalog);
+
+// Streaming JSON scanning (json_scan.c)
+typedef struct {
+    const char *p;
+    const char *end;
+    size_t depth;
+    const char *failure; /* first field error noted by a decoder; the scan continues past it */
+} JsonScanner;
+/* Member callbacks receive the key ("" when too long to be one a decoder wants) and must consume the value. */
+typedef int (*JsonMemberFn)(JsonScanner *scanner, const char *key, void *context);
+typedef int (*JsonElementFn)(JsonScanner *scanner, void *context);
+/* The scan, skip and walk functions return 0 on success and -1 on a syntax error (-2: allocation failure). */
+void json_scan_init(JsonScanner *scanner, const char *data, size_t length);
+void json_skip_whitespace(JsonScanner *scanner);
+int json_consume(JsonScanner *scanner, char c);
+int json_peek_is_number(const JsonScanner *scanner);
+/* Stores up to cap - 1 decoded bytes, NUL-terminated, when dst is given. */
+int json_scan_string(JsonScanner *scanner, char *dst, size_t cap);
+int json_scan_string_dup(JsonScanner *scanner, char **out);
+int json_scan_number(JsonScanner *scanner, double *value);
+int json_skip_value(JsonScanner *scanner);
+int json_walk_object(JsonScanner *scanner, JsonMemberFn member, void *context);
+int json_walk_array(JsonScanner *scanner, JsonElementFn element, void *context);
+
+// Streaming JSON writing (json_writer.c)
+#define JSON_WRITER_MAX_DEPTH 32
+
+/* Writes to `file` in cJSON's layout: compact when indent is '\0', else cJSON_Print's with indent for each tab. */
+typedef struct {
+    FILE *file;
+    char indent;
+    size_t depth; /* open containers */
+    bool is_array[JSON_WRITER_MAX_DEPTH];
+    bool empty[JSON_WRITER_MAX_DEPTH]; /* no value written into the container yet */
+    bool failed;
+} JsonWriter;
+/* key names the member inside an object; pass NULL for array elements and the top-level value. */
+void json_writer_init(JsonWriter *writer, FILE *file, char indent);
+void json_begin_object(JsonWriter *writer, const char *key);
+void json_end_object(JsonWriter *writer);
+void json_begin_array(JsonWriter *writer, const char *key);
+void json_end_array(JsonWriter *writer);
+void json_write_number(JsonWriter *writer, const char *key, double value);
+void json_write_string(JsonWriter *writer, const char *key, const char *value);
+void json_write_bool(JsonWriter *writer, const char *key, bool value);
+/* Flushes the stream; -1 when a write failed or a container is still open. */
+int json_writer_finish(JsonWriter *writer);
+
+// Fingerprinting
+#define FNV1A64_OFFSET_BASIS 0xcbf29ce484222325ULL
+uint64_t fnv1a64(uint64_t hash, const void *data, size_t length);
+uint64_t fnv1a64_string(uint64_t hash, const char *value);
+int fnv1a64_file(const char *path, uint64_t *out);
+size_t shard_of_case(const char *case_id, size_t shard_count);
+/* Writes a hex fingerprint of the serialized case combined with engine_hash (both engine binaries). */
+int fingerprint_input_case(const InputCase *input_case, uint64_t engine_hash, char *out, size_t out_size);
+
+// Canonical output cache
+typedef struct OutputCache OutputCache;
+OutputCache *open_output_cache(const char *cache_dir,
+                               const char *engine_path,
+                               EngineFormat format,
+                               ValidationError *error);
+/* Returns 1 and fills `out` on a hit, 0 on a miss; both are counted. */
+int output_cache_load(OutputCache *cache, const InputCase *input_case, EngineOutput *out);
+int output_cache_store(OutputCache *cache, const InputCase *input_case, const EngineOutput *output, ValidationError *error);
+void output_cache_counts(OutputCache *cache, size_t *hits, size_t *misses);
+void close_output_cache(OutputCache *cache);
 
 // Comparison helpers
 int comparison_within_tolerance(const ComparisonDelta *delta, const ToleranceConfig *tolerance);
 double delta_e_oklab(const OklabColor *a, const OklabColor *b);
+/* Recomputes passed and the per-channel maxima from the result's palettes or stored samples. */
+void summarize_comparison(ComparisonResult *result, const ToleranceConfig *tolerance);
+void comparison_sample(const ComparisonResult *result, size_t index, SampleDelta *out);
+/*
+ * The result's palettes point into the outputs' colors until
+ * retain_compared_colors() moves the arrays into the result, which must happen
+ * before the outputs are freed.
+ */
 int compare_engine_outputs(const EngineOutput *canonical,
                            const EngineOutput *alternate,
                            const ToleranceConfig *tolerance,
                            const InputCase *input_case,
-                           ComparisonResult *result);
+                           ComparisonResult *result,
+                           RunAccumulator *accumulator);
+void retain_compared_colors(ComparisonResult *result, EngineOutput *canonical, EngineOutput *alternate);
 void free_comparison_result(ComparisonResult *result);
 
+// Comparison kernels (compare_kernel.c)
+/*
+ * Sets result->passed, the per-channel maxima and max_signed in one pass over
+ * the palettes, bit-identical to checking every comparison_sample() with
+ * comparison_within_tolerance(). A non-NULL accumulator also receives every
+ * sample in that pass and marks the result accumulated.
+ */
+void compare_palettes(const EngineColor *canonical,
+                      const EngineColor *alternate,
+                      size_t count,
+                      const ToleranceConfig *tolerance,
+                      ComparisonResult *result,
+                      RunAccumulator *accumulator);
+/* "avx512", "avx2", "sse2" or "scalar"; picked from the CPU on first use. */
+const char *compare_kernel_name(void);
+/* Forces a kernel by name, or "auto"; -1 when the CPU cannot run it. Call before comparing. */
+int select_compare_kernel(const char *name);
+
 // Statistics helpers
-int init_histogram(Histogram *hist, double min_value, double max_value, size_t bucket_count);
-void record_histogram(Histogram *hist, double value);
-void free_histogram(Histogram *hist);
+int init_log_histogram(LogHistogram *hist);
+void record_log_histogram(LogHistogram *hist, double value);
+void merge_log_histogram(LogHistogram *into, const LogHistogram *from);
+double log_histogram_bucket_floor(size_t index);
+void free_log_histogram(LogHistogram *hist);
+void select_quantiles(double *values, size_t count, const double *quantiles, size_t quantile_count, double *out);
+void compute_metric_stats_in_place(double *values, size_t count, const PercentileList *percentiles, MetricStats *out);
 void compute_metric_stats(const double *values, size_t count, MetricStats *out);
+void summarize_trials(const double *values, size_t count, double outlier_mad, TrialStats *out);
+void init_quantile_sketch(QuantileSketch *sketch);
+void add_quantile_sketch(QuantileSketch *sketch, double value);
+void merge_quantile_sketch(QuantileSketch *into, const QuantileSketch *from);
+double quantile_sketch_value(const QuantileSketch *sketch, double q);
+void add_running_moments(RunningMoments *moments, double value);
+void merge_running_moments(RunningMoments *into, const RunningMoments *from);
+void finish_sketched_stats(const RunningMoments *moments,
+                           const QuantileSketch *sketch,
+                           const PercentileList *percentiles,
+                           MetricStats *out);
+void init_streaming_stats(StreamingStats *stats);
+void add_streaming_stats(StreamingStats *stats, double value);
+void merge_streaming_stats(StreamingStats *into, const StreamingStats *from);
+double streaming_stats_quantile(const StreamingStats *stats, double q);
+void finish_streaming_stats(const StreamingStats *stats, const PercentileList *percentiles, MetricStats *out);
 
 // Analysis helpers
 const StageHint *lookup_stage_hint(const char *metric);
@@ -259,6 +785,34 @@ int compute_contributors(const ComparisonResult *result,
                          Contributor **out,
                          size_t *out_count,
                          ValidationError *error);
+int compute_engine_performance(const ComparisonResult *results,
+                               size_t count,
+                               EnginePerformance *out,
+                               ValidationError *error);
+double case_speed_ratio(const ComparisonResult *result);
+
+// Run summaries
+/* Fills every RunSummary field except duration_ms from results->results. */
+int summarize_run_results(RunResults *results, ValidationError *error);
+int init_run_accumulator(RunAccumulator *acc, StatsMode mode);
+void accumulate_sample(RunAccumulator *acc, RunningMoments *moments, const double *magnitudes);
+void merge_run_accumulator(RunAccumulator *into, const RunAccumulator *from);
+void free_run_accumulator(RunAccumulator *acc);
+void free_run_stats(RunStats *stats);
+int parse_percentile_list(const char *text, PercentileList *out, ValidationError *error);
+/* getrusage() peak resident set size of this process in bytes, 0 when unavailable. */
+size_t process_peak_rss_bytes(void);
+int compute_run_contributors(RunResults *results, size_t top_n, ValidationError *error);
+
+// Worker pool
+WorkerPool *worker_pool_start(size_t jobs,
+                              size_t task_count,
+                              WorkerTaskFn task,
+                              void *context,
+                              ValidationError *error);
+int worker_pool_wait(WorkerPool *pool, size_t index, char **message);
+void worker_pool_cancel(WorkerPool *pool);
+void worker_pool_finish(WorkerPool *pool);
 
 // Reporting helpers
 int write_case_artifacts(const char *artifacts_root,
@@ -280,4 +834,27 @@ int write_run_report(const char *artifacts_root,
                      ValidationError *error);
 int ensure_directory(const char *path, ValidationError *error);
 
+// Incremental runs (--since)
+typedef struct {
+    ComparisonResult *results; /* sorted by input_case_id */
+    size_t result_count;
+    char *c_build_flags;       /* provenance of the engines that produced the results */
+    char *alt_build_flags;
+} PreviousRun;
+
+struct cJSON;
+/*
+ * Reads report.json "cases" into results sorted by id; null deltas read as NaN. When a fingerprint is
+ * required, cases without one or with null samples are skipped so they get re-run.
+ */
+int parse_report_cases(const struct cJSON *cases, int require_fingerprint, PreviousRun *out, ValidationError *error);
+int load_previous_run(const char *report_path, PreviousRun *out, ValidationError *error);
+/* Returns the previous result for the case when its fingerprint is unchanged, otherwise NULL. */
+const ComparisonResult *find_reusable_result(const PreviousRun *run, const char *case_id, const char *fingerprint);
+int carry_over_result(const ComparisonResult *previous,
+                      const ToleranceConfig *tolerance,
+                      ComparisonResult *out,
+                      ValidationError *error);
+void free_previous_run(PreviousRun *run);
+
 #endif // PARITY_TYPES_H
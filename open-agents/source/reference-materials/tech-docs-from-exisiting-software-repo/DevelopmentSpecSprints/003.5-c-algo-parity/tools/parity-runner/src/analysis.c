@@ -53,7 +53,7 @@ int compute_contributors(const ComparisonResult *result,
         return 0;
     }
 
-    const size_t metric_total = 7; /* deltaE, L, a, b, R, G, B */
+    const size_t metric_total = RUN_METRIC_COUNT;
     typedef struct {
         const char *metric;
         double magnitude;
@@ -61,69 +61,22 @@ int compute_contributors(const ComparisonResult *result,
         double z_score;
     } RawContributor;
 
-    RawContributor metrics[7] = {
-        {.metric = "deltaE", .magnitude = 0.0, .signed_value = 0.0, .z_score = 0.0},
-        {.metric = "oklab.l", .magnitude = 0.0, .signed_value = 0.0, .z_score = 0.0},
-        {.metric = "oklab.a", .magnitude = 0.0, .signed_value = 0.0, .z_score = 0.0},
-        {.metric = "oklab.b", .magnitude = 0.0, .signed_value = 0.0, .z_score = 0.0},
-        {.metric = "srgb.r", .magnitude = 0.0, .signed_value = 0.0, .z_score = 0.0},
-        {.metric = "srgb.g", .magnitude = 0.0, .signed_value = 0.0, .z_score = 0.0},
-        {.metric = "srgb.b", .magnitude = 0.0, .signed_value = 0.0, .z_score = 0.0},
+    /*
+     * The compare pass already found each metric's largest |delta| and the
+     * signed delta behind it; only the z-scores need the run statistics.
+     * signed_value is alternate - canonical, the opposite of max_signed.
+     */
+    const double *max_signed = result->max_signed;
+    RawContributor metrics[RUN_METRIC_COUNT] = {
+        {.metric = "deltaE", .magnitude = result->max_delta_e, .signed_value = result->max_delta_e},
+        {.metric = "oklab.l", .magnitude = result->max_l, .signed_value = 0.0 - max_signed[RUN_METRIC_L]},
+        {.metric = "oklab.a", .magnitude = result->max_a, .signed_value = 0.0 - max_signed[RUN_METRIC_A]},
+        {.metric = "oklab.b", .magnitude = result->max_b, .signed_value = 0.0 - max_signed[RUN_METRIC_B]},
+        {.metric = "srgb.r", .magnitude = result->max_rgb_r, .signed_value = 0.0 - max_signed[RUN_METRIC_RGB_R]},
+        {.metric = "srgb.g", .magnitude = result->max_rgb_g, .signed_value = 0.0 - max_signed[RUN_METRIC_RGB_G]},
+        {.metric = "srgb.b", .magnitude = result->max_rgb_b, .signed_value = 0.0 - max_signed[RUN_METRIC_RGB_B]},
     };
 
-    for (size_t i = 0; i < result->sample_count; ++i) {
-        const SampleDelta *sample = &result->samples[i];
-
-        const double diff_l = sample->alternate.oklab.l - sample->canonical.oklab.l;
-        const double diff_a = sample->alternate.oklab.a - sample->canonical.oklab.a;
-        const double diff_b = sample->alternate.oklab.b - sample->canonical.oklab.b;
-        const double diff_r = sample->alternate.srgb.r - sample->canonical.srgb.r;
-        const double diff_g = sample->alternate.srgb.g - sample->canonical.srgb.g;
-        const double diff_b_rgb = sample->alternate.srgb.b - sample->canonical.srgb.b;
-
-        const double mag_de = sample->delta.deltaE;
-        if (mag_de > metrics[0].magnitude) {
-            metrics[0].magnitude = mag_de;
-            metrics[0].signed_value = mag_de; /* deltaE is magnitude only */
-        }
-
-        const double mag_l = fabs(diff_l);
-        if (mag_l > metrics[1].magnitude) {
-            metrics[1].magnitude = mag_l;
-            metrics[1].signed_value = diff_l;
-        }
-
-        const double mag_a = fabs(diff_a);
-        if (mag_a > metrics[2].magnitude) {
-            metrics[2].magnitude = mag_a;
-            metrics[2].signed_value = diff_a;
-        }
-
-        const double mag_b = fabs(diff_b);
-        if (mag_b > metrics[3].magnitude) {
-            metrics[3].magnitude = mag_b;
-            metrics[3].signed_value = diff_b;
-        }
-
-        const double mag_r = fabs(diff_r);
-        if (mag_r > metrics[4].magnitude) {
-            metrics[4].magnitude = mag_r;
-            metrics[4].signed_value = diff_r;
-        }
-
-        const double mag_g = fabs(diff_g);
-        if (mag_g > metrics[5].magnitude) {
-            metrics[5].magnitude = mag_g;
-            metrics[5].signed_value = diff_g;
-        }
-
-        const double mag_b_rgb = fabs(diff_b_rgb);
-        if (mag_b_rgb > metrics[6].magnitude) {
-            metrics[6].magnitude = mag_b_rgb;
-            metrics[6].signed_value = diff_b_rgb;
-        }
-    }
-
     for (size_t i = 0; i < metric_total; ++i) {
         metrics[i].z_score = compute_z_score(metrics[i].magnitude, stats_for_metric(metrics[i].metric, summary));
     }
@@ -180,3 +133,67 @@ int compute_contributors(const ComparisonResult *result,
     *out_count = placed;
     return 0;
 }
+
+double case_speed_ratio(const ComparisonResult *result) {
+    if (!result || result->canonical_duration_ms <= 0.0 || result->alternate_duration_ms <= 0.0) {
+        return 0.0;
+    }
+    return result->alternate_duration_ms / result->canonical_duration_ms;
+}
+
+int compute_engine_performance(const ComparisonResult *results,
+                               size_t count,
+                               EnginePerformance *out,
+                               ValidationError *error) {
+    if (!out || (!results && count > 0)) {
+        set_error(error, "invalid performance arguments");
+        return -1;
+    }
+    memset(out, 0, sizeof(EnginePerformance));
+
+    double *values = (double *)malloc((count > 0 ? count : 1) * 3 * sizeof(double));
+    if (!values) {
+        set_error(error, "failed to allocate performance buffers");
+        return -1;
+    }
+    double *canonical = values;
+    double *alternate = values + (count > 0 ? count : 1);
+    double *ratios = alternate + (count > 0 ? count : 1);
+
+    for (size_t i = 0; i < count; ++i) {
+        const double ratio = case_speed_ratio(&results[i]);
+        if (ratio <= 0.0) {
+            continue;
+        }
+        canonical[out->measured_cases] = results[i].canonical_duration_ms;
+        alternate[out->measured_cases] = results[i].alternate_duration_ms;
+        ratios[out->measured_cases] = ratio;
+        out->measured_cases++;
+        out->canonical_total_ms += results[i].canonical_duration_ms;
+        out->alternate_total_ms += results[i].alternate_duration_ms;
+
+        /* Keep the slowest cases ordered by ratio; earlier cases win ties. */
+        size_t slot = out->slowest_count;
+        while (slot > 0 && case_speed_ratio(&results[out->slowest[slot - 1]]) < ratio) {
+            if (slot < MAX_SLOWEST_CASES) {
+                out->slowest[slot] = out->slowest[slot - 1];
+            }
+            slot--;
+        }
+        if (slot < MAX_SLOWEST_CASES) {
+            out->slowest[slot] = i;
+            if (out->slowest_count < MAX_SLOWEST_CASES) {
+                out->slowest_count++;
+            }
+        }
+    }
+
+    compute_metric_stats(canonical, out->measured_cases, &out->canonical_duration);
+    compute_metric_stats(alternate, out->measured_cases, &out->alternate_duration);
+    compute_metric_stats(ratios, out->measured_cases, &out->speed_ratio);
+    if (out->canonical_total_ms > 0.0) {
+        out->slowdown = out->alternate_total_ms / out->canonical_total_ms;
+    }
+    free(values);
+    return 0;
+}
@@ -0,0 +1,178 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "types.h"
+
+/*
+ * Bump allocator for data that lives and dies together, such as a parsed corpus:
+ * objects are carved out of large blocks and are only ever released all at once
+ * by arena_release(). A zeroed Arena is empty and ready to use.
+ *
+ * Blocks double in size from ARENA_MIN_BLOCK (or the size given to arena_init)
+ * up to ARENA_MAX_BLOCK; a request larger than the next block gets a block of
+ * its own, so the partly used current block is kept for later requests.
+ *
+ * The same arenas back cJSON: once install_json_arena_hooks() has run, cJSON
+ * allocates from the calling thread's JSON arena while a json_arena_begin() scope
+ * is open, and its frees are no-ops there, so a whole tree and its rendering go
+ * away with one arena_release(). Outside a scope cJSON uses malloc and free.
+ */
+
+#define ARENA_MIN_BLOCK ((size_t)4096)
+#define ARENA_MAX_BLOCK ((size_t)4 << 20)
+#define ARENA_ALIGNMENT ((size_t)16)
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t used;
+    size_t capacity;
+    unsigned char data[];
+};
+
+void arena_init(Arena *arena, size_t first_block_size) {
+    memset(arena, 0, sizeof(Arena));
+    arena->next_block_size = first_block_size;
+}
+
+static void *take_from_block(ArenaBlock *block, size_t size) {
+    const uintptr_t start = (uintptr_t)(block->data + block->used);
+    const size_t padding = (size_t)((ARENA_ALIGNMENT - start % ARENA_ALIGNMENT) % ARENA_ALIGNMENT);
+    if (padding > block->capacity - block->used || size > block->capacity - block->used - padding) {
+        return NULL;
+    }
+    unsigned char *object = block->data + block->used + padding;
+    block->used += padding + size;
+    return object;
+}
+
+static ArenaBlock *add_block(Arena *arena, size_t size) {
+    size_t capacity = arena->next_block_size < ARENA_MIN_BLOCK ? ARENA_MIN_BLOCK : arena->next_block_size;
+    const int dedicated = size + ARENA_ALIGNMENT > capacity;
+    if (dedicated) {
+        if (size > SIZE_MAX - sizeof(ArenaBlock) - ARENA_ALIGNMENT) {
+            return NULL;
+        }
+        capacity = size + ARENA_ALIGNMENT;
+    }
+    ArenaBlock *block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + capacity);
+    if (!block) {
+        return NULL;
+    }
+    block->used = 0;
+    block->capacity = capacity;
+    if (dedicated && arena->blocks) {
+        block->next = arena->blocks->next;
+        arena->blocks->next = block;
+    } else {
+        block->next = arena->blocks;
+        arena->blocks = block;
+        arena->next_block_size = capacity >= ARENA_MAX_BLOCK / 2 ? ARENA_MAX_BLOCK : capacity * 2;
+    }
+    arena->block_count++;
+    return block;
+}
+
+static void *arena_take(Arena *arena, size_t size) {
+    if (size == 0) {
+        size = 1;
+    }
+    void *object = arena->blocks ? take_from_block(arena->blocks, size) : NULL;
+    if (!object) {
+        ArenaBlock *block = add_block(arena, size);
+        object = block ? take_from_block(block, size) : NULL;
+    }
+    if (object) {
+        arena->allocations++;
+        arena->bytes += size;
+    }
+    return object;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    if (!arena) {
+        return NULL;
+    }
+    void *object = arena_take(arena, size);
+    if (object) {
+        memset(object, 0, size);
+    }
+    return object;
+}
+
+void *arena_calloc(Arena *arena, size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    return arena_alloc(arena, count * size);
+}
+
+char *arena_strdup(Arena *arena, const char *text) {
+    if (!text) {
+        return NULL;
+    }
+    const size_t length = strlen(text) + 1;
+    char *copy = (char *)arena_alloc(arena, length);
+    if (copy) {
+        memcpy(copy, text, length);
+    }
+    return copy;
+}
+
+void arena_release(Arena *arena) {
+    if (!arena) {
+        return;
+    }
+    ArenaBlock *block = arena->blocks;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    memset(arena, 0, sizeof(Arena));
+}
+
+static pthread_key_t json_arena_key;
+static pthread_once_t json_arena_once = PTHREAD_ONCE_INIT;
+static int json_arena_ready;
+
+/* cJSON clears what needs clearing itself. */
+static void *json_arena_malloc(size_t size) {
+    Arena *arena = (Arena *)pthread_getspecific(json_arena_key);
+    return arena ? arena_take(arena, size) : malloc(size);
+}
+
+static void json_arena_free(void *pointer) {
+    if (!pthread_getspecific(json_arena_key)) {
+        free(pointer);
+    }
+}
+
+static void create_json_arena_key(void) {
+    if (pthread_key_create(&json_arena_key, NULL) != 0) {
+        return;
+    }
+    cJSON_Hooks hooks = {json_arena_malloc, json_arena_free};
+    cJSON_InitHooks(&hooks);
+    json_arena_ready = 1;
+}
+
+void install_json_arena_hooks(void) {
+    pthread_once(&json_arena_once, create_json_arena_key);
+}
+
+void json_arena_begin(Arena *arena) {
+    if (json_arena_ready) {
+        pthread_setspecific(json_arena_key, arena);
+    }
+}
+
+void json_arena_end(void) {
+    if (json_arena_ready) {
+        pthread_setspecific(json_arena_key, NULL);
+    }
+}
@@ -0,0 +1,403 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cJSON.h"
+#include "types.h"
+
+/*
+ * Content-addressed cache of canonical engine outputs.
+ *
+ * Layout under --cache-dir:
+ *   <binary-hash>/identity.json   buildFlags/commit reported by that engine binary
+ *   <binary-hash>/<key>.bin       one EngineOutput blob per case
+ *
+ * <binary-hash> is FNV-1a over the engine file's bytes. <key> hashes the binary
+ * hash, the reported buildFlags and commit, the wire format the engine answered
+ * in (JSON colors are decimal-rounded, bin colors are not) and
+ * serialize_input_case() of the case. Blobs also carry the serialized case so a hash collision reads as a
+ * miss rather than as someone else's output. Colors are stored as raw doubles,
+ * so a hit is bit-identical to the run that produced it.
+ *
+ * The identity is only known after the engine has run once; until then every
+ * lookup misses, and the first successful store records it.
+ */
+
+#define CACHE_MAGIC "PCOC"
+#define CACHE_FORMAT_VERSION 1u
+
+struct OutputCache {
+    char root[MAX_PATH_LENGTH];
+    char binary_hash[17];
+    EngineFormat format;
+    char *build_flags;
+    char *commit;
+    int identity_known;
+    size_t hits;
+    size_t misses;
+    pthread_mutex_t lock;
+};
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t case_length;
+    uint64_t color_count;
+    double duration_ms;
+    uint32_t string_lengths[4]; /* engine, commit, buildFlags, platform; 0 = absent, else strlen + 1 */
+} BlobHeader;
+
+static void set_error(ValidationError *error, const char *message) {
+    if (!error || !message) {
+        return;
+    }
+    free(error->message);
+    size_t len = strlen(message);
+    error->message = (char *)malloc(len + 1);
+    if (error->message) {
+        memcpy(error->message, message, len + 1);
+    }
+}
+
+static char *dup_optional(const char *value) {
+    return value ? strdup(value) : NULL;
+}
+
+static int same_optional(const char *a, const char *b) {
+    return (!a && !b) || (a && b && strcmp(a, b) == 0);
+}
+
+static char *read_text_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    size_t capacity = 1024;
+    size_t length = 0;
+    char *buffer = (char *)malloc(capacity);
+    size_t read_bytes;
+    while (buffer && (read_bytes = fread(buffer + length, 1, capacity - length - 1, file)) > 0) {
+        length += read_bytes;
+        if (capacity - length <= 1) {
+            char *tmp = (char *)realloc(buffer, capacity * 2);
+            if (!tmp) {
+                free(buffer);
+                buffer = NULL;
+                break;
+            }
+            buffer = tmp;
+            capacity *= 2;
+        }
+    }
+    fclose(file);
+    if (buffer) {
+        buffer[length] = '\0';
+    }
+    return buffer;
+}
+
+/* snprintf into a fixed path buffer; -1 instead of a truncated path. */
+static int format_path(char *path, size_t path_size, const char *root, const char *name) {
+    const int length = snprintf(path, path_size, "%s/%s", root, name);
+    return length < 0 || (size_t)length >= path_size ? -1 : 0;
+}
+
+static void load_identity(OutputCache *cache) {
+    char path[MAX_PATH_LENGTH];
+    if (format_path(path, sizeof(path), cache->root, "identity.json") != 0) {
+        return;
+    }
+    char *text = read_text_file(path);
+    if (!text) {
+        return;
+    }
+    cJSON *root = cJSON_Parse(text);
+    free(text);
+    if (!root) {
+        return;
+    }
+    const cJSON *build_flags = cJSON_GetObjectItemCaseSensitive(root, "buildFlags");
+    const cJSON *commit = cJSON_GetObjectItemCaseSensitive(root, "commit");
+    cache->build_flags = cJSON_IsString(build_flags) ? dup_optional(build_flags->valuestring) : NULL;
+    cache->commit = cJSON_IsString(commit) ? dup_optional(commit->valuestring) : NULL;
+    cache->identity_known = 1;
+    cJSON_Delete(root);
+}
+
+/* Writes the parts to `path` through a temporary file and rename, so readers never see a partial file. */
+static int write_atomically(const char *path, const void *const *parts, const size_t *lengths, size_t part_count) {
+    char tmp_path[MAX_PATH_LENGTH];
+    const int length = snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path);
+    if (length < 0 || (size_t)length >= sizeof(tmp_path)) {
+        return -1;
+    }
+    const int fd = mkstemp(tmp_path);
+    if (fd < 0) {
+        return -1;
+    }
+    FILE *file = fdopen(fd, "wb");
+    if (!file) {
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    int failed = 0;
+    for (size_t i = 0; i < part_count && !failed; ++i) {
+        if (lengths[i] > 0 && fwrite(parts[i], 1, lengths[i], file) != lengths[i]) {
+            failed = 1;
+        }
+    }
+    if (fclose(file) != 0) {
+        failed = 1;
+    }
+    if (failed || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+static int store_identity(OutputCache *cache, const EngineOutput *output) {
+    cJSON *root = cJSON_CreateObject();
+    if (output->build_flags) {
+        cJSON_AddStringToObject(root, "buildFlags", output->build_flags);
+    }
+    if (output->commit) {
+        cJSON_AddStringToObject(root, "commit", output->commit);
+    }
+    char *rendered = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!rendered) {
+        return -1;
+    }
+
+    char path[MAX_PATH_LENGTH];
+    const void *parts[1] = {rendered};
+    const size_t lengths[1] = {strlen(rendered)};
+    const int status = format_path(path, sizeof(path), cache->root, "identity.json") == 0
+                           ? write_atomically(path, parts, lengths, 1)
+                           : -1;
+    free(rendered);
+    return status;
+}
+
+static int blob_path(const OutputCache *cache, const char *serialized_case, char *path, size_t path_size) {
+    uint64_t key = fnv1a64_string(FNV1A64_OFFSET_BASIS, cache->binary_hash);
+    key = fnv1a64_string(key, cache->build_flags);
+    key = fnv1a64_string(key, cache->commit);
+    key = fnv1a64_string(key, cache->format == ENGINE_FORMAT_BIN ? "bin" : "json");
+    key = fnv1a64_string(key, serialized_case);
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return format_path(path, path_size, cache->root, name);
+}
+
+OutputCache *open_output_cache(const char *cache_dir,
+                               const char *engine_path,
+                               EngineFormat format,
+                               ValidationError *error) {
+    if (!cache_dir || !engine_path) {
+        set_error(error, "invalid cache arguments");
+        return NULL;
+    }
+
+    uint64_t binary_hash = 0;
+    if (fnv1a64_file(engine_path, &binary_hash) != 0) {
+        char message[MAX_ERROR_MESSAGE];
+        snprintf(message, sizeof(message), "failed to hash canonical engine %s", engine_path);
+        set_error(error, message);
+        return NULL;
+    }
+
+    OutputCache *cache = (OutputCache *)calloc(1, sizeof(OutputCache));
+    if (!cache) {
+        set_error(error, "failed to allocate output cache");
+        return NULL;
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->format = format;
+    snprintf(cache->binary_hash, sizeof(cache->binary_hash), "%016llx", (unsigned long long)binary_hash);
+    if (format_path(cache->root, sizeof(cache->root), cache_dir, cache->binary_hash) != 0) {
+        set_error(error, "cache directory path is too long");
+        close_output_cache(cache);
+        return NULL;
+    }
+    if (ensure_directory(cache->root, error) != 0) {
+        close_output_cache(cache);
+        return NULL;
+    }
+    load_identity(cache);
+    return cache;
+}
+
+static int read_blob(const char *path, const char *serialized_case, EngineOutput *out) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return 0;
+    }
+
+    BlobHeader header;
+    const size_t case_length = strlen(serialized_case);
+    int hit = fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+              header.version == CACHE_FORMAT_VERSION &&
+              header.case_length == case_length &&
+              header.color_count > 0;
+
+    char *stored_case = hit ? (char *)malloc(case_length + 1) : NULL;
+    hit = hit && stored_case && fread(stored_case, 1, case_length, file) == case_length &&
+          memcmp(stored_case, serialized_case, case_length) == 0;
+    free(stored_case);
+
+    char *strings[4] = {NULL, NULL, NULL, NULL};
+    for (size_t i = 0; hit && i < 4; ++i) {
+        const uint32_t length = header.string_lengths[i];
+        if (length == 0) {
+            continue;
+        }
+        strings[i] = (char *)malloc(length);
+        hit = strings[i] && fread(strings[i], 1, length, file) == length && strings[i][length - 1] == '\0';
+    }
+
+    EngineColor *colors = hit ? (EngineColor *)calloc((size_t)header.color_count, sizeof(EngineColor)) : NULL;
+    hit = hit && colors && fread(colors, sizeof(EngineColor), (size_t)header.color_count, file) == header.color_count;
+    fclose(file);
+
+    if (!hit || !strings[0]) {
+        for (size_t i = 0; i < 4; ++i) {
+            free(strings[i]);
+        }
+        free(colors);
+        return 0;
+    }
+
+    memset(out, 0, sizeof(EngineOutput));
+    strncpy(out->engine, strings[0], sizeof(out->engine) - 1);
+    free(strings[0]);
+    out->commit = strings[1];
+    out->build_flags = strings[2];
+    out->platform = strings[3];
+    out->duration_ms = header.duration_ms;
+    out->colors = colors;
+    out->color_count = (size_t)header.color_count;
+    return 1;
+}
+
+int output_cache_load(OutputCache *cache, const InputCase *input_case, EngineOutput *out) {
+    if (!cache || !input_case || !out) {
+        return 0;
+    }
+
+    int hit = 0;
+    pthread_mutex_lock(&cache->lock);
+    const int identity_known = cache->identity_known;
+    pthread_mutex_unlock(&cache->lock);
+
+    char *serialized_case = identity_known ? serialize_input_case(input_case) : NULL;
+    if (serialized_case) {
+        char path[MAX_PATH_LENGTH];
+        hit = blob_path(cache, serialized_case, path, sizeof(path)) == 0 && read_blob(path, serialized_case, out);
+        free(serialized_case);
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    if (hit) {
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return hit;
+}
+
+int output_cache_store(OutputCache *cache, const InputCase *input_case, const EngineOutput *output, ValidationError *error) {
+    if (!cache || !input_case || !output || output->color_count == 0) {
+        set_error(error, "invalid cache store arguments");
+        return -1;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    if (!cache->identity_known) {
+        cache->build_flags = dup_optional(output->build_flags);
+        cache->commit = dup_optional(output->commit);
+        cache->identity_known = 1;
+        if (store_identity(cache, output) != 0) {
+            pthread_mutex_unlock(&cache->lock);
+            set_error(error, "failed to write cache identity");
+            return -1;
+        }
+    }
+    const int matches_identity = same_optional(cache->build_flags, output->build_flags) &&
+                                 same_optional(cache->commit, output->commit);
+    pthread_mutex_unlock(&cache->lock);
+    if (!matches_identity) {
+        set_error(error, "canonical engine reported a different buildFlags/commit than the cached identity");
+        return -1;
+    }
+
+    char *serialized_case = serialize_input_case(input_case);
+    if (!serialized_case) {
+        set_error(error, "failed to serialize input case");
+        return -1;
+    }
+
+    BlobHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_FORMAT_VERSION;
+    header.case_length = strlen(serialized_case);
+    header.color_count = output->color_count;
+    header.duration_ms = output->duration_ms;
+    const char *strings[4] = {output->engine, output->commit, output->build_flags, output->platform};
+    for (size_t i = 0; i < 4; ++i) {
+        header.string_lengths[i] = strings[i] ? (uint32_t)strlen(strings[i]) + 1u : 0u;
+    }
+
+    const void *parts[7] = {&header, serialized_case, strings[0], strings[1], strings[2], strings[3], output->colors};
+    const size_t lengths[7] = {
+        sizeof(header),
+        (size_t)header.case_length,
+        header.string_lengths[0],
+        header.string_lengths[1],
+        header.string_lengths[2],
+        header.string_lengths[3],
+        output->color_count * sizeof(EngineColor)
+    };
+
+    char path[MAX_PATH_LENGTH];
+    const int status = blob_path(cache, serialized_case, path, sizeof(path)) == 0
+                           ? write_atomically(path, parts, lengths, 7)
+                           : -1;
+    free(serialized_case);
+    if (status != 0) {
+        set_error(error, "failed to write cache entry");
+        return -1;
+    }
+    return 0;
+}
+
+void output_cache_counts(OutputCache *cache, size_t *hits, size_t *misses) {
+    if (!cache) {
+        *hits = 0;
+        *misses = 0;
+        return;
+    }
+    pthread_mutex_lock(&cache->lock);
+    *hits = cache->hits;
+    *misses = cache->misses;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void close_output_cache(OutputCache *cache) {
+    if (!cache) {
+        return;
+    }
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->build_flags);
+    free(cache->commit);
+    free(cache);
+}
@@ -51,37 +51,33 @@ double delta_e_oklab(const OklabColor *a, const OklabColor *b) {
     return sqrt((dl * dl) + (da * da) + (db * db));
 }
 
-int compare_engine_outputs(const EngineOutput *canonical,
-                           const EngineOutput *alternate,
-                           const ToleranceConfig *tolerance,
-                           const InputCase *input_case,
-                           ComparisonResult *result) {
-    if (!canonical || !alternate || !tolerance || !input_case || !result) {
-        return -1;
-    }
-
-    memset(result, 0, sizeof(ComparisonResult));
-    strncpy(result->input_case_id, input_case->id, sizeof(result->input_case_id) - 1);
-
-    const size_t expected = input_case->config.count;
-    const size_t sample_count = (canonical->color_count < alternate->color_count)
-                                    ? canonical->color_count
-                                    : alternate->color_count;
-
-    if (sample_count == 0 || expected == 0) {
-        result->passed = 0;
-        return -1;
-    }
-
-    if (sample_count != expected || canonical->color_count != alternate->color_count) {
-        result->passed = 0;
+void comparison_sample(const ComparisonResult *result, size_t index, SampleDelta *out) {
+    if (result->samples) {
+        *out = result->samples[index];
+        return;
     }
+    const EngineColor *canonical = &result->canonical_colors[index];
+    const EngineColor *alternate = &result->alternate_colors[index];
+    out->index = index;
+    out->canonical = *canonical;
+    out->alternate = *alternate;
+    out->delta.l = canonical->oklab.l - alternate->oklab.l;
+    out->delta.a = canonical->oklab.a - alternate->oklab.a;
+    out->delta.b = canonical->oklab.b - alternate->oklab.b;
+    out->delta.deltaE = delta_e_oklab(&canonical->oklab, &alternate->oklab);
+    out->rgb_delta.r = canonical->srgb.r - alternate->srgb.r;
+    out->rgb_delta.g = canonical->srgb.g - alternate->srgb.g;
+    out->rgb_delta.b = canonical->srgb.b - alternate->srgb.b;
+}
 
-    result->samples = (SampleDelta *)calloc(sample_count, sizeof(SampleDelta));
-    if (!result->samples) {
-        return -1;
+static void raise_max(double *max, double *max_signed, double delta) {
+    if (fabs(delta) > *max) {
+        *max = fabs(delta);
+        *max_signed = delta;
     }
+}
 
+static void summarize_stored_samples(ComparisonResult *result, const ToleranceConfig *tolerance) {
     int passed = 1;
     double max_delta = 0.0;
     double max_l = 0.0;
@@ -90,45 +86,27 @@ int compare_engine_outputs(const EngineOutput *canonical,
     double max_rgb_r = 0.0;
     double max_rgb_g = 0.0;
     double max_rgb_b = 0.0;
+    double *const max_signed = result->max_signed;
+    memset(result->max_signed, 0, sizeof(result->max_signed));
 
-    for (size_t i = 0; i < sample_count; ++i) {
-        SampleDelta *sample = &result->samples[i];
-        sample->index = i;
-        sample->canonical = canonical->colors[i];
-        sample->alternate = alternate->colors[i];
-
-        sample->delta.l = sample->canonical.oklab.l - sample->alternate.oklab.l;
-        sample->delta.a = sample->canonical.oklab.a - sample->alternate.oklab.a;
-        sample->delta.b = sample->canonical.oklab.b - sample->alternate.oklab.b;
-        sample->delta.deltaE = delta_e_oklab(&sample->canonical.oklab, &sample->alternate.oklab);
-
-        sample->rgb_delta.r = sample->canonical.srgb.r - sample->alternate.srgb.r;
-        sample->rgb_delta.g = sample->canonical.srgb.g - sample->alternate.srgb.g;
-        sample->rgb_delta.b = sample->canonical.srgb.b - sample->alternate.srgb.b;
-
+    for (size_t i = 0; i < result->sample_count; ++i) {
+        const SampleDelta *sample = &result->samples[i];
         if (!comparison_within_tolerance(&sample->delta, tolerance)) {
             passed = 0;
         }
         if (sample->delta.deltaE > max_delta) {
             max_delta = sample->delta.deltaE;
+            max_signed[RUN_METRIC_DELTA_E] = sample->delta.deltaE;
         }
-        const double abs_l = fabs(sample->delta.l);
-        const double abs_a = fabs(sample->delta.a);
-        const double abs_b = fabs(sample->delta.b);
-        const double abs_r = fabs(sample->rgb_delta.r);
-        const double abs_g = fabs(sample->rgb_delta.g);
-        const double abs_b_rgb = fabs(sample->rgb_delta.b);
-
-        if (abs_l > max_l) max_l = abs_l;
-        if (abs_a > max_a) max_a = abs_a;
-        if (abs_b > max_b) max_b = abs_b;
-        if (abs_r > max_rgb_r) max_rgb_r = abs_r;
-        if (abs_g > max_rgb_g) max_rgb_g = abs_g;
-        if (abs_b_rgb > max_rgb_b) max_rgb_b = abs_b_rgb;
+        raise_max(&max_l, &max_signed[RUN_METRIC_L], sample->delta.l);
+        raise_max(&max_a, &max_signed[RUN_METRIC_A], sample->delta.a);
+        raise_max(&max_b, &max_signed[RUN_METRIC_B], sample->delta.b);
+        raise_max(&max_rgb_r, &max_signed[RUN_METRIC_RGB_R], sample->rgb_delta.r);
+        raise_max(&max_rgb_g, &max_signed[RUN_METRIC_RGB_G], sample->rgb_delta.g);
+        raise_max(&max_rgb_b, &max_signed[RUN_METRIC_RGB_B], sample->rgb_delta.b);
     }
 
-    result->sample_count = sample_count;
-    result->passed = passed;
+    result->passed = passed && !result->nondeterministic;
     result->max_delta_e = max_delta;
     result->max_l = max_l;
     result->max_a = max_a;
@@ -136,14 +114,82 @@ int compare_engine_outputs(const EngineOutput *canonical,
     result->max_rgb_r = max_rgb_r;
     result->max_rgb_g = max_rgb_g;
     result->max_rgb_b = max_rgb_b;
+}
+
+void summarize_comparison(ComparisonResult *result, const ToleranceConfig *tolerance) {
+    if (!result || !tolerance) {
+        return;
+    }
+    if (result->samples) {
+        summarize_stored_samples(result, tolerance);
+    } else {
+        compare_palettes(result->canonical_colors, result->alternate_colors, result->sample_count, tolerance, result, NULL);
+    }
+}
+
+int compare_engine_outputs(const EngineOutput *canonical,
+                           const EngineOutput *alternate,
+                           const ToleranceConfig *tolerance,
+                           const InputCase *input_case,
+                           ComparisonResult *result,
+                           RunAccumulator *accumulator) {
+    if (!canonical || !alternate || !tolerance || !input_case || !result) {
+        return -1;
+    }
+
+    memset(result, 0, sizeof(ComparisonResult));
+    strncpy(result->input_case_id, input_case->id, sizeof(result->input_case_id) - 1);
+
+    const size_t expected = input_case->config.count;
+    const size_t sample_count = (canonical->color_count < alternate->color_count)
+                                    ? canonical->color_count
+                                    : alternate->color_count;
+
+    if (sample_count == 0 || expected == 0) {
+        result->passed = 0;
+        return -1;
+    }
+
+    if (sample_count != expected || canonical->color_count != alternate->color_count) {
+        result->passed = 0;
+    }
+
+    result->canonical_colors = canonical->colors;
+    result->alternate_colors = alternate->colors;
+    result->sample_count = sample_count;
+    compare_palettes(canonical->colors, alternate->colors, sample_count, tolerance, result, accumulator);
     return 0;
 }
 
+static EngineColor *take_colors(EngineOutput *output, size_t count) {
+    EngineColor *colors = output->colors;
+    output->colors = NULL;
+    output->color_count = 0;
+    /* Drop growth slack; the retained palettes outlive the case. */
+    EngineColor *trimmed = (EngineColor *)realloc(colors, count * sizeof(EngineColor));
+    return trimmed ? trimmed : colors;
+}
+
+void retain_compared_colors(ComparisonResult *result, EngineOutput *canonical, EngineOutput *alternate) {
+    if (!result || !canonical || !alternate || result->sample_count == 0) {
+        return;
+    }
+    if (result->canonical_colors == canonical->colors) {
+        result->canonical_colors = take_colors(canonical, result->sample_count);
+    }
+    if (result->alternate_colors == alternate->colors) {
+        result->alternate_colors = take_colors(alternate, result->sample_count);
+    }
+}
+
 void free_comparison_result(ComparisonResult *result) {
     if (!result) {
         return;
     }
+    free(result->canonical_colors);
+    free(result->alternate_colors);
     free(result->samples);
+    free(result->moments);
     free(result->contributors);
     memset(result, 0, sizeof(ComparisonResult));
 }
@@ -0,0 +1,409 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define COMPARE_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * Palette comparison kernels. Each kernel makes one pass over the canonical and
+ * alternate colours and computes the tolerance verdict, the per-channel maxima
+ * and the signed delta where each maximum was first reached (the contributor
+ * candidates). Per-sample deltas are not kept but derived on demand by
+ * comparison_sample(); when the run accumulates statistics, compare_palettes()
+ * feeds the kernel tiles of samples and hands each tile's magnitudes, still in
+ * L1, to accumulate_sample(), so every sample is read from memory once.
+ *
+ * An EngineColor is six contiguous doubles (Oklab then sRGB). The SIMD kernels
+ * (SSE2, AVX2, AVX-512F, picked from the CPU at first use) therefore vectorise
+ * across the channels of one sample: a colour is one or a few loads, and its
+ * deltas, magnitudes, limit checks and running maxima are a few vector
+ * operations. Palettes are short, so this beats transposing samples into
+ * per-channel lanes, which costs more than it saves for the common sizes.
+ *
+ * Every kernel does the same IEEE operations in the same order as the scalar
+ * one: subtraction, sqrt((dl * dl + da * da) + db * db) without fused
+ * multiply-adds, sign-bit clearing for fabs, ordered compares, and running
+ * maxima that only move on `x > max`, which skips NaN lanes and keeps the
+ * first sample of a tie. Their results are bit-identical.
+ */
+
+enum { D_L, D_A, D_B, D_E, D_R, D_G, D_BLUE, DELTA_LANES = 8 };
+
+/* Limits for the l/a/b/deltaE lanes; a disabled limit is +inf, which nothing exceeds. */
+typedef struct {
+    double abs[4];
+    double rel[4];
+} ToleranceLimits;
+
+typedef struct {
+    double max[DELTA_LANES];        /* D_* order; ΔE as is, every other channel by magnitude */
+    double signed_max[DELTA_LANES]; /* the delta behind each max */
+    int failed;
+} PaletteTotals;
+
+/* tile, when not NULL, receives count rows of DELTA_LANES magnitudes in D_* order. */
+typedef void (*PaletteKernel)(const EngineColor *canonical,
+                              const EngineColor *alternate,
+                              size_t count,
+                              const ToleranceLimits *limits,
+                              PaletteTotals *totals,
+                              double *tile);
+
+enum { FUSED_TILE_SAMPLES = 256 }; /* 16 KiB of magnitudes */
+
+static double abs_limit(double limit) {
+    return limit > 0 ? limit : INFINITY;
+}
+
+static double rel_limit(double rel, double abs) {
+    return rel > 0 ? rel * fabs(abs + 1.0) : INFINITY;
+}
+
+static void tolerance_limits(const ToleranceConfig *tolerance, ToleranceLimits *limits) {
+    limits->abs[D_L] = abs_limit(tolerance->abs.l);
+    limits->abs[D_A] = abs_limit(tolerance->abs.a);
+    limits->abs[D_B] = abs_limit(tolerance->abs.b);
+    limits->abs[D_E] = abs_limit(tolerance->abs.deltaE);
+    limits->rel[D_L] = rel_limit(tolerance->rel.l, tolerance->abs.l);
+    limits->rel[D_A] = rel_limit(tolerance->rel.a, tolerance->abs.a);
+    limits->rel[D_B] = rel_limit(tolerance->rel.b, tolerance->abs.b);
+    limits->rel[D_E] = INFINITY;
+}
+
+static void compare_palette_scalar(const EngineColor *canonical,
+                                   const EngineColor *alternate,
+                                   size_t count,
+                                   const ToleranceLimits *limits,
+                                   PaletteTotals *totals,
+                                   double *tile) {
+    for (size_t i = 0; i < count; ++i) {
+        const EngineColor *c = &canonical[i];
+        const EngineColor *a = &alternate[i];
+        const double dl = c->oklab.l - a->oklab.l;
+        const double da = c->oklab.a - a->oklab.a;
+        const double db = c->oklab.b - a->oklab.b;
+        const double de = sqrt((dl * dl) + (da * da) + (db * db));
+        const double delta[D_BLUE + 1] = {dl, da, db, de, c->srgb.r - a->srgb.r, c->srgb.g - a->srgb.g,
+                                          c->srgb.b - a->srgb.b};
+
+        for (size_t lane = 0; lane <= D_BLUE; ++lane) {
+            const double magnitude = fabs(delta[lane]);
+            if (lane <= D_E && (magnitude > limits->abs[lane] || magnitude > limits->rel[lane])) {
+                totals->failed = 1;
+            }
+            if (magnitude > totals->max[lane]) {
+                totals->max[lane] = magnitude;
+                totals->signed_max[lane] = delta[lane];
+            }
+            if (tile) {
+                tile[i * DELTA_LANES + lane] = magnitude;
+            }
+        }
+    }
+}
+
+#ifdef COMPARE_KERNEL_X86
+/* mask ? a : b, lane by lane */
+#define SSE2_SELECT(mask, a, b) _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b))
+
+__attribute__((target("sse2")))
+static void compare_palette_sse2(const EngineColor *canonical,
+                                 const EngineColor *alternate,
+                                 size_t count,
+                                 const ToleranceLimits *limits,
+                                 PaletteTotals *totals,
+                                 double *tile) {
+    const __m128d sign = _mm_set1_pd(-0.0);
+    const __m128d abs_la = _mm_loadu_pd(&limits->abs[D_L]), abs_be = _mm_loadu_pd(&limits->abs[D_B]);
+    const __m128d rel_la = _mm_loadu_pd(&limits->rel[D_L]), rel_be = _mm_loadu_pd(&limits->rel[D_B]);
+    __m128d max_la = _mm_loadu_pd(&totals->max[D_L]), max_be = _mm_loadu_pd(&totals->max[D_B]);
+    __m128d max_rg = _mm_loadu_pd(&totals->max[D_R]), max_bl = _mm_load_sd(&totals->max[D_BLUE]);
+    __m128d sgn_la = _mm_loadu_pd(&totals->signed_max[D_L]), sgn_be = _mm_loadu_pd(&totals->signed_max[D_B]);
+    __m128d sgn_rg = _mm_loadu_pd(&totals->signed_max[D_R]), sgn_bl = _mm_load_sd(&totals->signed_max[D_BLUE]);
+    __m128d fail = _mm_setzero_pd();
+    for (size_t i = 0; i < count; ++i) {
+        const double *c = &canonical[i].oklab.l;
+        const double *a = &alternate[i].oklab.l;
+        const __m128d c0 = _mm_loadu_pd(c), c1 = _mm_loadu_pd(c + 2), c2 = _mm_loadu_pd(c + 4);
+        const __m128d a0 = _mm_loadu_pd(a), a1 = _mm_loadu_pd(a + 2), a2 = _mm_loadu_pd(a + 4);
+        const __m128d d_la = _mm_sub_pd(c0, a0); /* l, a */
+        const __m128d d_br = _mm_sub_pd(c1, a1); /* b, r */
+        const __m128d d_gb = _mm_sub_pd(c2, a2); /* g, blue */
+        const __m128d sq_la = _mm_mul_pd(d_la, d_la);
+        const __m128d sum = _mm_add_sd(_mm_add_sd(sq_la, _mm_unpackhi_pd(sq_la, sq_la)), _mm_mul_sd(d_br, d_br));
+        const __m128d d_be = _mm_unpacklo_pd(d_br, _mm_sqrt_sd(sum, sum));
+        const __m128d d_rg = _mm_shuffle_pd(d_br, d_gb, 1);
+        const __m128d d_bl = _mm_unpackhi_pd(d_gb, d_gb);
+
+        const __m128d m_la = _mm_andnot_pd(sign, d_la);
+        const __m128d m_be = _mm_andnot_pd(sign, d_be);
+        const __m128d m_rg = _mm_andnot_pd(sign, d_rg);
+        const __m128d m_bl = _mm_andnot_pd(sign, d_bl);
+        fail = _mm_or_pd(fail, _mm_or_pd(_mm_or_pd(_mm_cmpgt_pd(m_la, abs_la), _mm_cmpgt_pd(m_be, abs_be)),
+                                         _mm_or_pd(_mm_cmpgt_pd(m_la, rel_la), _mm_cmpgt_pd(m_be, rel_be))));
+        const __m128d gt_la = _mm_cmpgt_pd(m_la, max_la), gt_be = _mm_cmpgt_pd(m_be, max_be);
+        const __m128d gt_rg = _mm_cmpgt_pd(m_rg, max_rg), gt_bl = _mm_cmpgt_pd(m_bl, max_bl);
+        max_la = SSE2_SELECT(gt_la, m_la, max_la);
+        max_be = SSE2_SELECT(gt_be, m_be, max_be);
+        max_rg = SSE2_SELECT(gt_rg, m_rg, max_rg);
+        max_bl = SSE2_SELECT(gt_bl, m_bl, max_bl);
+        sgn_la = SSE2_SELECT(gt_la, d_la, sgn_la);
+        sgn_be = SSE2_SELECT(gt_be, d_be, sgn_be);
+        sgn_rg = SSE2_SELECT(gt_rg, d_rg, sgn_rg);
+        sgn_bl = SSE2_SELECT(gt_bl, d_bl, sgn_bl);
+        if (tile) {
+            double *row = tile + i * DELTA_LANES;
+            _mm_storeu_pd(row + D_L, m_la);
+            _mm_storeu_pd(row + D_B, m_be);
+            _mm_storeu_pd(row + D_R, m_rg);
+            _mm_store_sd(row + D_BLUE, m_bl);
+        }
+    }
+    _mm_storeu_pd(&totals->max[D_L], max_la);
+    _mm_storeu_pd(&totals->max[D_B], max_be);
+    _mm_storeu_pd(&totals->max[D_R], max_rg);
+    _mm_store_sd(&totals->max[D_BLUE], max_bl);
+    _mm_storeu_pd(&totals->signed_max[D_L], sgn_la);
+    _mm_storeu_pd(&totals->signed_max[D_B], sgn_be);
+    _mm_storeu_pd(&totals->signed_max[D_R], sgn_rg);
+    _mm_store_sd(&totals->signed_max[D_BLUE], sgn_bl);
+    if (_mm_movemask_pd(fail)) {
+        totals->failed = 1;
+    }
+}
+
+__attribute__((target("avx2")))
+static void compare_palette_avx2(const EngineColor *canonical,
+                                 const EngineColor *alternate,
+                                 size_t count,
+                                 const ToleranceLimits *limits,
+                                 PaletteTotals *totals,
+                                 double *tile) {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d abs_limits = _mm256_loadu_pd(limits->abs);
+    const __m256d rel_limits = _mm256_loadu_pd(limits->rel);
+    __m256d max_lab = _mm256_loadu_pd(&totals->max[D_L]);
+    __m256d max_rgb = _mm256_loadu_pd(&totals->max[D_R]);
+    __m256d sgn_lab = _mm256_loadu_pd(&totals->signed_max[D_L]);
+    __m256d sgn_rgb = _mm256_loadu_pd(&totals->signed_max[D_R]);
+    __m256d fail = _mm256_setzero_pd();
+    for (size_t i = 0; i < count; ++i) {
+        const double *c = &canonical[i].oklab.l;
+        const double *a = &alternate[i].oklab.l;
+        const __m256d c0 = _mm256_loadu_pd(c), a0 = _mm256_loadu_pd(a);
+        const __m128d c1 = _mm_loadu_pd(c + 4), a1 = _mm_loadu_pd(a + 4);
+        const __m256d d0 = _mm256_sub_pd(c0, a0); /* l, a, b, r */
+        const __m128d d1 = _mm_sub_pd(c1, a1);    /* g, blue */
+        const __m256d sq = _mm256_mul_pd(d0, d0);
+        const __m128d sq_la = _mm256_castpd256_pd128(sq);
+        const __m128d sum = _mm_add_sd(_mm_add_sd(sq_la, _mm_unpackhi_pd(sq_la, sq_la)), _mm256_extractf128_pd(sq, 1));
+        const __m128d de = _mm_sqrt_sd(sum, sum);
+        const __m256d d_lab = _mm256_blend_pd(d0, _mm256_broadcastsd_pd(de), 8);
+        const __m128d d_br = _mm256_extractf128_pd(d0, 1);
+        const __m256d d_rgb = _mm256_insertf128_pd(_mm256_castpd128_pd256(_mm_shuffle_pd(d_br, d1, 1)),
+                                                   _mm_unpackhi_pd(d1, d1), 1); /* r, g, blue, blue */
+
+        const __m256d m_lab = _mm256_andnot_pd(sign, d_lab);
+        const __m256d m_rgb = _mm256_andnot_pd(sign, d_rgb);
+        fail = _mm256_or_pd(fail, _mm256_or_pd(_mm256_cmp_pd(m_lab, abs_limits, _CMP_GT_OQ),
+                                               _mm256_cmp_pd(m_lab, rel_limits, _CMP_GT_OQ)));
+        const __m256d gt_lab = _mm256_cmp_pd(m_lab, max_lab, _CMP_GT_OQ);
+        const __m256d gt_rgb = _mm256_cmp_pd(m_rgb, max_rgb, _CMP_GT_OQ);
+        max_lab = _mm256_blendv_pd(max_lab, m_lab, gt_lab);
+        max_rgb = _mm256_blendv_pd(max_rgb, m_rgb, gt_rgb);
+        sgn_lab = _mm256_blendv_pd(sgn_lab, d_lab, gt_lab);
+        sgn_rgb = _mm256_blendv_pd(sgn_rgb, d_rgb, gt_rgb);
+        if (tile) {
+            _mm256_storeu_pd(tile + i * DELTA_LANES + D_L, m_lab);
+            _mm256_storeu_pd(tile + i * DELTA_LANES + D_R, m_rgb);
+        }
+    }
+    _mm256_storeu_pd(&totals->max[D_L], max_lab);
+    _mm256_storeu_pd(&totals->max[D_R], max_rgb);
+    _mm256_storeu_pd(&totals->signed_max[D_L], sgn_lab);
+    _mm256_storeu_pd(&totals->signed_max[D_R], sgn_rgb);
+    if (_mm256_movemask_pd(fail)) {
+        totals->failed = 1;
+    }
+}
+
+__attribute__((target("avx512f")))
+static void compare_palette_avx512(const EngineColor *canonical,
+                                   const EngineColor *alternate,
+                                   size_t count,
+                                   const ToleranceLimits *limits,
+                                   PaletteTotals *totals,
+                                   double *tile) {
+    const __mmask8 color_lanes = 0x3f;
+    /* l, a, b, (deltaE), r, g, blue from the l, a, b, r, g, blue difference. */
+    const __m512i delta_order = _mm512_set_epi64(0, 5, 4, 3, 0, 2, 1, 0);
+    const __m512d no_limit = _mm512_set1_pd(INFINITY);
+    const __m512d abs_limits = _mm512_insertf64x4(no_limit, _mm256_loadu_pd(limits->abs), 0);
+    const __m512d rel_limits = _mm512_insertf64x4(no_limit, _mm256_loadu_pd(limits->rel), 0);
+    __m512d max = _mm512_loadu_pd(totals->max);
+    __m512d sgn = _mm512_loadu_pd(totals->signed_max);
+    __mmask8 fail = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const double *c = &canonical[i].oklab.l;
+        const double *a = &alternate[i].oklab.l;
+        const __m512d cv = _mm512_maskz_loadu_pd(color_lanes, c);
+        const __m512d av = _mm512_maskz_loadu_pd(color_lanes, a);
+        const __m512d d = _mm512_sub_pd(cv, av);
+        const __m512d sq = _mm512_mul_pd(d, d);
+        const __m128d sq_la = _mm512_castpd512_pd128(sq);
+        const __m128d sq_br = _mm256_extractf128_pd(_mm512_castpd512_pd256(sq), 1);
+        const __m128d sum = _mm_add_sd(_mm_add_sd(sq_la, _mm_unpackhi_pd(sq_la, sq_la)), sq_br);
+        const __m512d out = _mm512_mask_broadcastsd_pd(_mm512_permutexvar_pd(delta_order, d), 1 << D_E,
+                                                       _mm_sqrt_sd(sum, sum));
+
+        const __m512d magnitude = _mm512_abs_pd(out);
+        fail |= _mm512_cmp_pd_mask(magnitude, abs_limits, _CMP_GT_OQ) |
+                _mm512_cmp_pd_mask(magnitude, rel_limits, _CMP_GT_OQ);
+        const __mmask8 gt = _mm512_cmp_pd_mask(magnitude, max, _CMP_GT_OQ);
+        max = _mm512_mask_mov_pd(max, gt, magnitude);
+        sgn = _mm512_mask_mov_pd(sgn, gt, out);
+        if (tile) {
+            _mm512_storeu_pd(tile + i * DELTA_LANES, magnitude);
+        }
+    }
+    _mm512_storeu_pd(totals->max, max);
+    _mm512_storeu_pd(totals->signed_max, sgn);
+    if (fail) {
+        totals->failed = 1;
+    }
+}
+#endif
+
+typedef struct {
+    const char *name;
+    PaletteKernel run;
+} CompareKernel;
+
+static const CompareKernel scalar_kernel = {"scalar", compare_palette_scalar};
+#ifdef COMPARE_KERNEL_X86
+static const CompareKernel sse2_kernel = {"sse2", compare_palette_sse2};
+static const CompareKernel avx2_kernel = {"avx2", compare_palette_avx2};
+static const CompareKernel avx512_kernel = {"avx512", compare_palette_avx512};
+#endif
+
+static const CompareKernel *active_kernel = &scalar_kernel;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+static const CompareKernel *find_kernel(const char *name) {
+    if (strcmp(name, "scalar") == 0) {
+        return &scalar_kernel;
+    }
+#ifdef COMPARE_KERNEL_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        return &sse2_kernel;
+    }
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        return &avx2_kernel;
+    }
+    if (strcmp(name, "avx512") == 0 && __builtin_cpu_supports("avx512f")) {
+        return &avx512_kernel;
+    }
+#endif
+    return NULL;
+}
+
+static void pick_kernel(void) {
+    static const char *const preference[] = {"avx512", "avx2", "sse2"};
+    for (size_t i = 0; i < sizeof(preference) / sizeof(preference[0]); ++i) {
+        const CompareKernel *kernel = find_kernel(preference[i]);
+        if (kernel) {
+            active_kernel = kernel;
+            return;
+        }
+    }
+}
+
+const char *compare_kernel_name(void) {
+    pthread_once(&kernel_once, pick_kernel);
+    return active_kernel->name;
+}
+
+int select_compare_kernel(const char *name) {
+    pthread_once(&kernel_once, pick_kernel);
+    if (!name) {
+        return -1;
+    }
+    if (strcmp(name, "auto") == 0) {
+        active_kernel = &scalar_kernel;
+        pick_kernel();
+        return 0;
+    }
+    const CompareKernel *kernel = find_kernel(name);
+    if (!kernel) {
+        return -1;
+    }
+    active_kernel = kernel;
+    return 0;
+}
+
+/*
+ * With an accumulator the palettes go through the kernel FUSED_TILE_SAMPLES at
+ * a time, and each tile's magnitudes feed accumulate_sample() while they are
+ * still in cache; --stats streaming also gives the result its own moments.
+ */
+void compare_palettes(const EngineColor *canonical,
+                      const EngineColor *alternate,
+                      size_t count,
+                      const ToleranceConfig *tolerance,
+                      ComparisonResult *result,
+                      RunAccumulator *accumulator) {
+    pthread_once(&kernel_once, pick_kernel);
+    ToleranceLimits limits;
+    tolerance_limits(tolerance, &limits);
+    PaletteTotals totals;
+    memset(&totals, 0, sizeof(totals));
+    RunningMoments *moments = NULL;
+    if (accumulator && accumulator->mode == STATS_MODE_STREAMING) {
+        moments = result->moments ? result->moments : (RunningMoments *)malloc(RUN_METRIC_COUNT * sizeof(RunningMoments));
+        if (moments) {
+            memset(moments, 0, RUN_METRIC_COUNT * sizeof(RunningMoments));
+            result->moments = moments;
+        } else {
+            accumulator = NULL; /* summarize_run_results() accumulates the case instead */
+        }
+    }
+
+    if (!accumulator) {
+        active_kernel->run(canonical, alternate, count, &limits, &totals, NULL);
+    } else {
+        double tile[FUSED_TILE_SAMPLES * DELTA_LANES];
+        for (size_t start = 0; start < count; start += FUSED_TILE_SAMPLES) {
+            const size_t n = count - start < FUSED_TILE_SAMPLES ? count - start : FUSED_TILE_SAMPLES;
+            active_kernel->run(canonical + start, alternate + start, n, &limits, &totals, tile);
+            for (size_t i = 0; i < n; ++i) {
+                const double *row = tile + i * DELTA_LANES;
+                const double magnitudes[RUN_METRIC_COUNT] = {row[D_E], row[D_L], row[D_A], row[D_B],
+                                                             row[D_R], row[D_G], row[D_BLUE]};
+                accumulate_sample(accumulator, moments, magnitudes);
+            }
+        }
+        result->accumulated = true;
+    }
+
+    static const int lanes[RUN_METRIC_COUNT] = {D_E, D_L, D_A, D_B, D_R, D_G, D_BLUE};
+    for (size_t metric = 0; metric < RUN_METRIC_COUNT; ++metric) {
+        result->max_signed[metric] = totals.signed_max[lanes[metric]];
+    }
+    result->passed = !totals.failed && !result->nondeterministic;
+    result->max_delta_e = totals.max[D_E];
+    result->max_l = totals.max[D_L];
+    result->max_a = totals.max[D_A];
+    result->max_b = totals.max[D_B];
+    result->max_rgb_r = totals.max[D_R];
+    result->max_rgb_g = totals.max[D_G];
+    result->max_rgb_b = totals.max[D_BLUE];
+}
@@ -0,0 +1,359 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "types.h"
+
+/*
+ * Lazy corpus loading. The corpus file is memory-mapped and scanned once to
+ * record each case's id, tags and byte range; only the cases a run selects are
+ * then parsed into InputCase. The whole document is still syntax-checked, and
+ * every case's id and tags are validated, but the remaining case fields are only
+ * validated for the cases that are loaded.
+ */
+
+#define INDEX_INITIAL_ENTRIES 64
+#define INDEX_INITIAL_TAG_POOL 1024
+
+static void set_error(ValidationError *error, const char *message) {
+    if (!error || !message) {
+        return;
+    }
+    free(error->message);
+    size_t len = strlen(message);
+    error->message = (char *)malloc(len + 1);
+    if (error->message) {
+        memcpy(error->message, message, len + 1);
+    }
+}
+
+static void fail_field(JsonScanner *d, const char *message) {
+    if (!d->failure) {
+        d->failure = message;
+    }
+}
+
+typedef struct {
+    CorpusIndex *index;
+    size_t entry_capacity;
+    size_t tag_pool_capacity;
+    char *corpus_version;
+    unsigned int seen;  /* bit 0: corpusVersion, bit 1: description, bit 2: cases */
+    int cases_is_array;
+    int out_of_memory;
+} IndexBuilder;
+
+typedef struct {
+    IndexBuilder *builder;
+    CorpusIndexEntry *entry;
+    unsigned int seen; /* bit 0: id, bit 1: tags */
+    int id_is_string;
+    const char *id_failure;
+    const char *tags_failure;
+} CaseMembers;
+
+static int append_tag(IndexBuilder *builder, const char *tag, size_t length) {
+    CorpusIndex *index = builder->index;
+    while (index->tag_pool_length + length + 1 > builder->tag_pool_capacity) {
+        const size_t capacity = builder->tag_pool_capacity ? builder->tag_pool_capacity * 2 : INDEX_INITIAL_TAG_POOL;
+        char *grown = (char *)realloc(index->tag_pool, capacity);
+        if (!grown) {
+            builder->out_of_memory = 1;
+            return -1;
+        }
+        index->tag_pool = grown;
+        builder->tag_pool_capacity = capacity;
+    }
+    memcpy(index->tag_pool + index->tag_pool_length, tag, length + 1);
+    index->tag_pool_length += length + 1;
+    return 0;
+}
+
+static int tag_element(JsonScanner *d, void *context) {
+    CaseMembers *members = (CaseMembers *)context;
+    if (d->p >= d->end || *d->p != '"') {
+        if (!members->tags_failure) {
+            members->tags_failure = "tags must contain strings";
+        }
+        return json_skip_value(d);
+    }
+    char *tag = NULL;
+    const int status = json_scan_string_dup(d, &tag);
+    if (status != 0) {
+        members->builder->out_of_memory |= status == -2;
+        return -1;
+    }
+    /* Tags are kept as C strings, as strdup() would in parse_input_case. */
+    const int appended = append_tag(members->builder, tag, strlen(tag));
+    free(tag);
+    if (appended != 0) {
+        return -1;
+    }
+    members->entry->tag_count++;
+    return 0;
+}
+
+static int case_member(JsonScanner *d, const char *key, void *context) {
+    CaseMembers *members = (CaseMembers *)context;
+    const unsigned int bit = strcmp(key, "id") == 0 ? 1u : (strcmp(key, "tags") == 0 ? 2u : 0u);
+    if (bit == 0 || (members->seen & bit)) {
+        return json_skip_value(d);
+    }
+    members->seen |= bit;
+    const char first = d->p < d->end ? *d->p : '\0';
+    if (bit == 1u) {
+        if (first != '"') {
+            return json_skip_value(d);
+        }
+        char id[MAX_ID_LENGTH + 1];
+        if (json_scan_string(d, id, sizeof(id)) != 0) {
+            return -1;
+        }
+        members->id_is_string = 1;
+        if (strlen(id) >= MAX_ID_LENGTH) {
+            members->id_failure = "inputCase.id exceeds maximum length";
+        }
+        strncpy(members->entry->id, id, MAX_ID_LENGTH - 1);
+        return 0;
+    }
+    if (first != '[') {
+        members->tags_failure = "tags must be an array";
+        return json_skip_value(d);
+    }
+    return json_walk_array(d, tag_element, members);
+}
+
+static int case_element(JsonScanner *d, void *context) {
+    IndexBuilder *builder = (IndexBuilder *)context;
+    CorpusIndex *index = builder->index;
+    if (index->entry_count == builder->entry_capacity) {
+        const size_t capacity = builder->entry_capacity ? builder->entry_capacity * 2 : INDEX_INITIAL_ENTRIES;
+        CorpusIndexEntry *grown = (CorpusIndexEntry *)realloc(index->entries, capacity * sizeof(CorpusIndexEntry));
+        if (!grown) {
+            builder->out_of_memory = 1;
+            return -1;
+        }
+        index->entries = grown;
+        builder->entry_capacity = capacity;
+    }
+    CorpusIndexEntry *entry = &index->entries[index->entry_count];
+    memset(entry, 0, sizeof(CorpusIndexEntry));
+    entry->offset = (size_t)(d->p - index->data);
+    entry->tags_offset = index->tag_pool_length;
+
+    CaseMembers members = {.builder = builder, .entry = entry};
+    if (d->p < d->end && *d->p == '{') {
+        if (json_walk_object(d, case_member, &members) != 0) {
+            return -1;
+        }
+    } else if (json_skip_value(d) != 0) {
+        return -1;
+    }
+    /* The id is checked before the tags, as in parse_input_case. */
+    if (!members.id_is_string) {
+        members.id_failure = "inputCase.id must be a string";
+    }
+    if (members.id_failure || members.tags_failure) {
+        fail_field(d, members.id_failure ? members.id_failure : members.tags_failure);
+    }
+    entry->length = (size_t)(d->p - index->data) - entry->offset;
+    index->entry_count++;
+    return 0;
+}
+
+static int root_member(JsonScanner *d, const char *key, void *context) {
+    IndexBuilder *builder = (IndexBuilder *)context;
+    const unsigned int bit = strcmp(key, "corpusVersion") == 0 ? 1u
+                             : strcmp(key, "description") == 0 ? 2u
+                             : strcmp(key, "cases") == 0       ? 4u
+                                                               : 0u;
+    if (bit == 0 || (builder->seen & bit)) {
+        return json_skip_value(d);
+    }
+    builder->seen |= bit;
+    const char first = d->p < d->end ? *d->p : '\0';
+    if (bit == 4u) {
+        if (first != '[') {
+            return json_skip_value(d);
+        }
+        builder->cases_is_array = 1;
+        return json_walk_array(d, case_element, builder);
+    }
+    if (first != '"') {
+        return json_skip_value(d);
+    }
+    const int status = json_scan_string_dup(d, bit == 1u ? &builder->corpus_version : &builder->index->description);
+    builder->out_of_memory |= status == -2;
+    return status == 0 ? 0 : -1;
+}
+
+static int map_corpus_file(const char *path, CorpusIndex *index) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        return -1;
+    }
+    index->data_length = (size_t)info.st_size;
+    if (index->data_length == 0) {
+        /* Nothing to map; the scan reports an empty file as a parse failure. */
+        index->data = "";
+        close(fd);
+        return 0;
+    }
+    void *mapped = mmap(NULL, index->data_length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return -1;
+    }
+    index->data = (const char *)mapped;
+    return 0;
+}
+
+int open_corpus_index(const char *path, CorpusIndex *out, ValidationError *error) {
+    if (!path || !out) {
+        set_error(error, "invalid corpus arguments");
+        return -1;
+    }
+    memset(out, 0, sizeof(CorpusIndex));
+    if (map_corpus_file(path, out) != 0) {
+        memset(out, 0, sizeof(CorpusIndex));
+        set_error(error, "failed to read corpus file");
+        return -1;
+    }
+
+    /* The corpus is read as a C string, so a NUL byte ends the document (as it does for cJSON_Parse). */
+    const char *nul = (const char *)memchr(out->data, '\0', out->data_length);
+    JsonScanner d;
+    json_scan_init(&d, out->data, nul ? (size_t)(nul - out->data) : out->data_length);
+    IndexBuilder builder = {.index = out};
+    const int is_object = d.p < d.end && *d.p == '{';
+    const int parsed = is_object ? json_walk_object(&d, root_member, &builder) : json_skip_value(&d);
+
+    /* Same precedence as parse_corpus_file: syntax, then version, then cases. */
+    const char *failure = NULL;
+    if (parsed != 0) {
+        failure = builder.out_of_memory ? "failed to allocate cases" : "failed to parse corpus JSON";
+    } else if (!validate_corpus_version(builder.corpus_version)) {
+        failure = "corpusVersion must match vYYYYMMDD.n";
+    } else if (!builder.cases_is_array || out->entry_count == 0) {
+        failure = "cases must be a non-empty array";
+    } else {
+        failure = d.failure;
+    }
+    if (!failure) {
+        strncpy(out->corpus_version, builder.corpus_version, MAX_VERSION_LENGTH - 1);
+    }
+    free(builder.corpus_version);
+    if (failure) {
+        close_corpus_index(out);
+        set_error(error, failure);
+        return -1;
+    }
+    return 0;
+}
+
+int corpus_entry_has_tag(const CorpusIndex *index, const CorpusIndexEntry *entry, const char *tag) {
+    if (!index || !entry || !tag) {
+        return 0;
+    }
+    const char *cursor = index->tag_pool + entry->tags_offset;
+    for (size_t i = 0; i < entry->tag_count; ++i) {
+        if (strcmp(cursor, tag) == 0) {
+            return 1;
+        }
+        cursor += strlen(cursor) + 1;
+    }
+    return 0;
+}
+
+int load_indexed_cases(const CorpusIndex *index, const size_t *entries, size_t count, Corpus *out, ValidationError *error) {
+    if (!index || !out || (count > 0 && !entries)) {
+        set_error(error, "invalid corpus arguments");
+        return -1;
+    }
+    memset(out, 0, sizeof(Corpus));
+    memcpy(out->corpus_version, index->corpus_version, sizeof(out->corpus_version));
+    if (index->description) {
+        out->description = arena_strdup(&out->arena, index->description);
+    }
+    if (count == 0) {
+        return 0;
+    }
+    out->cases = (InputCase *)arena_calloc(&out->arena, count, sizeof(InputCase));
+    if (!out->cases) {
+        free_corpus(out);
+        set_error(error, "failed to allocate cases");
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const CorpusIndexEntry *entry = &index->entries[entries[i]];
+        out->case_count = i + 1;
+        if (parse_input_case_json_length(index->data + entry->offset, entry->length, &out->arena, &out->cases[i],
+                                         error) != 0) {
+            free_corpus(out);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int load_corpus_case(const char *path, const char *id, InputCase *out, ValidationError *error) {
+    if (!id || !out) {
+        set_error(error, "invalid corpus arguments");
+        return -1;
+    }
+    if (is_packed_corpus_file(path)) {
+        PackedCorpus packed;
+        if (open_packed_corpus(path, &packed, error) != 0) {
+            return -1;
+        }
+        size_t found = 0;
+        int status = -1;
+        if (packed_corpus_find(&packed, id, &found) != 0) {
+            set_error(error, "input case not found in corpus");
+        } else {
+            status = load_packed_case(&packed, found, out, error);
+        }
+        close_packed_corpus(&packed);
+        return status;
+    }
+    CorpusIndex index;
+    if (open_corpus_index(path, &index, error) != 0) {
+        return -1;
+    }
+    int status = -1;
+    size_t i = 0;
+    while (i < index.entry_count && strcmp(index.entries[i].id, id) != 0) {
+        i++;
+    }
+    if (i == index.entry_count) {
+        set_error(error, "input case not found in corpus");
+    } else {
+        const CorpusIndexEntry *entry = &index.entries[i];
+        status = parse_input_case_json_length(index.data + entry->offset, entry->length, NULL, out, error);
+    }
+    close_corpus_index(&index);
+    return status;
+}
+
+void close_corpus_index(CorpusIndex *index) {
+    if (!index) {
+        return;
+    }
+    if (index->data && index->data_length > 0) {
+        munmap((void *)index->data, index->data_length);
+    }
+    free(index->description);
+    free(index->entries);
+    free(index->tag_pool);
+    memset(index, 0, sizeof(CorpusIndex));
+}
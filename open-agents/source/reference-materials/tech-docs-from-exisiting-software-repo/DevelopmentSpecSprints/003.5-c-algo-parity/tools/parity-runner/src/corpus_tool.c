@@ -0,0 +1,77 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "types.h"
+
+/*
+ * parity-corpus: offline corpus tooling. `compile` validates a JSON corpus once
+ * and writes it as a packed corpus (.pcorpus), which parity-runner and the
+ * engine runners load with --corpus without parsing JSON. `stats` loads a corpus
+ * of either kind and reports how long that took and what it allocated.
+ */
+
+static void print_usage(void) {
+    printf("Usage: parity-corpus compile <corpus.json> <output.pcorpus>\n");
+    printf("       parity-corpus stats <corpus>\n");
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+/* Every case array and string counts as one allocation; blocks are the heap allocations behind them. */
+static int print_corpus_stats(const char *path) {
+    ValidationError error = {.message = NULL};
+    Corpus corpus;
+    const double start_ms = now_ms();
+    if (parse_corpus_file(path, &corpus, &error) != 0) {
+        fprintf(stderr, "Corpus validation failed: %s\n", error.message ? error.message : "unknown error");
+        free(error.message);
+        return 1;
+    }
+    const double load_ms = now_ms() - start_ms;
+    printf("Loaded %zu cases (corpus %s) in %.1fms\n", corpus.case_count, corpus.corpus_version, load_ms);
+    printf("Allocations: %zu objects (%.1f KiB) from %zu heap blocks\n", corpus.arena.allocations,
+           (double)corpus.arena.bytes / 1024.0, corpus.arena.block_count);
+    const double free_start_ms = now_ms();
+    free_corpus(&corpus);
+    printf("Freed in %.3fms\n", now_ms() - free_start_ms);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    install_json_arena_hooks();
+    if (argc == 2 && strcmp(argv[1], "--help") == 0) {
+        print_usage();
+        return 0;
+    }
+    if (argc == 3 && strcmp(argv[1], "stats") == 0) {
+        return print_corpus_stats(argv[2]);
+    }
+    if (argc != 4 || strcmp(argv[1], "compile") != 0) {
+        print_usage();
+        return 1;
+    }
+    ValidationError error = {.message = NULL};
+    Corpus corpus;
+    if (parse_corpus_file(argv[2], &corpus, &error) != 0) {
+        fprintf(stderr, "Corpus validation failed: %s\n", error.message ? error.message : "unknown error");
+        free(error.message);
+        return 1;
+    }
+    if (write_packed_corpus(&corpus, argv[3], &error) != 0) {
+        fprintf(stderr, "Failed to compile corpus: %s\n", error.message ? error.message : "unknown error");
+        free_corpus(&corpus);
+        free(error.message);
+        return 1;
+    }
+    printf("Compiled %zu cases (corpus %s) to %s\n", corpus.case_count, corpus.corpus_version, argv[3]);
+    free_corpus(&corpus);
+    return 0;
+}
@@ -0,0 +1,242 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+
+/*
+ * Binary EngineOutput frames, emitted by runners started with `--format bin`.
+ * All integers and doubles are little-endian:
+ *
+ *   0   magic "PEOF"
+ *   4   u32 version
+ *   8   u64 frame length, header included
+ *   16  u64 color count
+ *   24  f64 durationMs
+ *   32  u32 string lengths: engine, commit, buildFlags, platform (0 = absent, else strlen + 1)
+ *   48  the strings, NUL-terminated, then count x 6 f64 (oklab l, a, b, rgb r, g, b)
+ *
+ * Colors travel as their IEEE-754 bits, so the harness compares exactly what
+ * the engines computed. This file has no other dependencies so runners can link it.
+ */
+
+#define FRAME_MAGIC "PEOF"
+#define FRAME_VERSION 1u
+#define FRAME_HEADER_SIZE 48u
+#define FRAME_COLOR_SIZE (6u * sizeof(double))
+
+static void set_error(ValidationError *error, const char *message) {
+    if (!error || !message) {
+        return;
+    }
+    free(error->message);
+    size_t len = strlen(message);
+    error->message = (char *)malloc(len + 1);
+    if (error->message) {
+        memcpy(error->message, message, len + 1);
+    }
+}
+
+static int host_is_little_endian(void) {
+    const uint16_t probe = 1;
+    return *(const unsigned char *)&probe == 1;
+}
+
+static uint64_t read_u64(const unsigned char *p, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = bytes; i > 0; --i) {
+        value = (value << 8) | p[i - 1];
+    }
+    return value;
+}
+
+static void write_u64(unsigned char *p, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static double read_f64(const unsigned char *p) {
+    const uint64_t bits = read_u64(p, 8);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void write_f64(unsigned char *p, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    write_u64(p, bits, 8);
+}
+
+/* EngineColor is six packed doubles on every supported ABI, so on little-endian hosts the wire layout is its memory layout. */
+static int colors_match_wire_layout(void) {
+    return host_is_little_endian() && sizeof(EngineColor) == FRAME_COLOR_SIZE && sizeof(double) == 8;
+}
+
+size_t engine_frame_size(const char *data, size_t length) {
+    if (length < FRAME_HEADER_SIZE) {
+        return 0;
+    }
+    const unsigned char *header = (const unsigned char *)data;
+    const uint64_t frame_length = read_u64(header + 8, 8);
+    if (memcmp(header, FRAME_MAGIC, 4) != 0 || frame_length < FRAME_HEADER_SIZE || frame_length > SIZE_MAX) {
+        /* Not a frame we can size; hand over the header so decoding reports why. */
+        return FRAME_HEADER_SIZE;
+    }
+    return (size_t)frame_length;
+}
+
+char *encode_engine_frame(const EngineOutput *output, size_t *length) {
+    if (!output || !length || (output->color_count > 0 && !output->colors)) {
+        return NULL;
+    }
+    const char *strings[4] = {output->engine, output->commit, output->build_flags, output->platform};
+    size_t string_lengths[4];
+    size_t total = FRAME_HEADER_SIZE;
+    for (size_t i = 0; i < 4; ++i) {
+        string_lengths[i] = strings[i] ? strlen(strings[i]) + 1 : 0;
+        total += string_lengths[i];
+    }
+    if (output->color_count > (SIZE_MAX - total) / FRAME_COLOR_SIZE) {
+        return NULL;
+    }
+    total += output->color_count * FRAME_COLOR_SIZE;
+
+    unsigned char *frame = (unsigned char *)malloc(total);
+    if (!frame) {
+        return NULL;
+    }
+    memcpy(frame, FRAME_MAGIC, 4);
+    write_u64(frame + 4, FRAME_VERSION, 4);
+    write_u64(frame + 8, (uint64_t)total, 8);
+    write_u64(frame + 16, (uint64_t)output->color_count, 8);
+    write_f64(frame + 24, output->duration_ms);
+    unsigned char *cursor = frame + FRAME_HEADER_SIZE;
+    for (size_t i = 0; i < 4; ++i) {
+        write_u64(frame + 32 + 4 * i, (uint64_t)string_lengths[i], 4);
+        if (string_lengths[i] > 0) {
+            memcpy(cursor, strings[i], string_lengths[i]);
+            cursor += string_lengths[i];
+        }
+    }
+    if (colors_match_wire_layout()) {
+        memcpy(cursor, output->colors, output->color_count * FRAME_COLOR_SIZE);
+    } else {
+        for (size_t i = 0; i < output->color_count; ++i, cursor += FRAME_COLOR_SIZE) {
+            const EngineColor *color = &output->colors[i];
+            const double values[6] = {color->oklab.l, color->oklab.a, color->oklab.b,
+                                      color->srgb.r, color->srgb.g, color->srgb.b};
+            for (size_t v = 0; v < 6; ++v) {
+                write_f64(cursor + 8 * v, values[v]);
+            }
+        }
+    }
+    *length = total;
+    return (char *)frame;
+}
+
+static char *dup_frame_string(const unsigned char *data, size_t length) {
+    char *copy = (char *)malloc(length);
+    if (copy) {
+        memcpy(copy, data, length);
+    }
+    return copy;
+}
+
+int decode_engine_frame(const char *data, size_t length, EngineOutput *out, ValidationError *error) {
+    if (!data || !out) {
+        set_error(error, "invalid engine output buffer");
+        return -1;
+    }
+    const unsigned char *frame = (const unsigned char *)data;
+    if (length < FRAME_HEADER_SIZE) {
+        set_error(error, "engine output frame is truncated");
+        return -1;
+    }
+    if (memcmp(frame, FRAME_MAGIC, 4) != 0) {
+        set_error(error, "engine output is not a binary frame");
+        return -1;
+    }
+    if (read_u64(frame + 4, 4) != FRAME_VERSION) {
+        set_error(error, "unsupported engine output frame version");
+        return -1;
+    }
+    if (read_u64(frame + 8, 8) != (uint64_t)length) {
+        set_error(error, "engine output frame length does not match its contents");
+        return -1;
+    }
+
+    /* Every section is checked against the bytes actually present before it is read. */
+    size_t offset = FRAME_HEADER_SIZE;
+    size_t string_lengths[4];
+    for (size_t i = 0; i < 4; ++i) {
+        const uint64_t string_length = read_u64(frame + 32 + 4 * i, 4);
+        if (string_length > length - offset ||
+            (string_length > 0 && frame[offset + string_length - 1] != '\0')) {
+            set_error(error, "engine output frame length does not match its contents");
+            return -1;
+        }
+        string_lengths[i] = (size_t)string_length;
+        offset += string_lengths[i];
+    }
+    const uint64_t color_count = read_u64(frame + 16, 8);
+    if (color_count != (length - offset) / FRAME_COLOR_SIZE || (length - offset) % FRAME_COLOR_SIZE != 0) {
+        set_error(error, "engine output frame length does not match its contents");
+        return -1;
+    }
+    if (string_lengths[0] == 0) {
+        set_error(error, "engine output missing required fields");
+        return -1;
+    }
+    if (color_count == 0) {
+        set_error(error, "engine output contains no colors");
+        return -1;
+    }
+
+    memset(out, 0, sizeof(EngineOutput));
+    out->colors = (EngineColor *)malloc((size_t)color_count * sizeof(EngineColor));
+    if (!out->colors) {
+        set_error(error, "failed to allocate engine colors");
+        return -1;
+    }
+    out->color_count = (size_t)color_count;
+    out->duration_ms = read_f64(frame + 24);
+
+    const unsigned char *cursor = frame + FRAME_HEADER_SIZE;
+    strncpy(out->engine, (const char *)cursor, sizeof(out->engine) - 1);
+    cursor += string_lengths[0];
+    char **targets[3] = {&out->commit, &out->build_flags, &out->platform};
+    int allocated = 1;
+    for (size_t i = 0; i < 3; ++i) {
+        if (string_lengths[i + 1] > 0) {
+            *targets[i] = dup_frame_string(cursor, string_lengths[i + 1]);
+            allocated = allocated && *targets[i] != NULL;
+            cursor += string_lengths[i + 1];
+        }
+    }
+    if (!allocated) {
+        free(out->colors);
+        free(out->commit);
+        free(out->build_flags);
+        free(out->platform);
+        memset(out, 0, sizeof(EngineOutput));
+        set_error(error, "failed to allocate engine output");
+        return -1;
+    }
+
+    if (colors_match_wire_layout()) {
+        memcpy(out->colors, cursor, out->color_count * FRAME_COLOR_SIZE);
+    } else {
+        for (size_t i = 0; i < out->color_count; ++i, cursor += FRAME_COLOR_SIZE) {
+            EngineColor *color = &out->colors[i];
+            color->oklab.l = read_f64(cursor);
+            color->oklab.a = read_f64(cursor + 8);
+            color->oklab.b = read_f64(cursor + 16);
+            color->srgb.r = read_f64(cursor + 24);
+            color->srgb.g = read_f64(cursor + 32);
+            color->srgb.b = read_f64(cursor + 40);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,268 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+
+/*
+ * Single-pass decoder for EngineOutput documents. Values are stored into the
+ * EngineOutput as they are read, without building a cJSON tree, and the
+ * colors array is presized from "count" when it precedes "colors". Unknown
+ * members are syntax-checked and skipped by the json_scan.c scanner, so the
+ * documents accepted (and the
+ * error reported for a rejected one) are the same as with cJSON_Parse plus
+ * lookups: a malformed document is always reported as a parse failure, even
+ * when a field error occurs earlier in the text.
+ */
+
+#define DECODER_INITIAL_COLORS 16
+/* Smallest plausible encoding of one color, bounding the capacity taken from "count". */
+#define DECODER_MIN_COLOR_BYTES 32
+
+static void set_error(ValidationError *error, const char *message) {
+    if (!error || !message) {
+        return;
+    }
+    free(error->message);
+    size_t len = strlen(message);
+    error->message = (char *)malloc(len + 1);
+    if (error->message) {
+        memcpy(error->message, message, len + 1);
+    }
+}
+
+static void fail_field(JsonScanner *d, const char *message) {
+    if (!d->failure) {
+        d->failure = message;
+    }
+}
+
+/* Tracks the first occurrence of each wanted key, like cJSON_GetObjectItemCaseSensitive. */
+typedef struct {
+    const char *const *names;
+    size_t name_count;
+    double values[3];
+    unsigned int seen;
+    unsigned int numeric;
+} ComponentMembers;
+
+static int component_member(JsonScanner *d, const char *key, void *context) {
+    ComponentMembers *members = (ComponentMembers *)context;
+    for (size_t i = 0; i < members->name_count; ++i) {
+        const unsigned int bit = 1u << i;
+        if (strcmp(key, members->names[i]) != 0 || (members->seen & bit)) {
+            continue;
+        }
+        members->seen |= bit;
+        if (!json_peek_is_number(d)) {
+            return json_skip_value(d);
+        }
+        members->numeric |= bit;
+        return json_scan_number(d, &members->values[i]);
+    }
+    return json_skip_value(d);
+}
+
+typedef struct {
+    ComponentMembers oklab;
+    ComponentMembers rgb;
+    unsigned int seen;    /* bit 0: oklab, bit 1: rgb */
+    unsigned int objects; /* same bits, set when the first occurrence is an object */
+} ColorMembers;
+
+static const char *const OKLAB_NAMES[3] = {"l", "a", "b"};
+static const char *const RGB_NAMES[3] = {"r", "g", "b"};
+
+static int color_member(JsonScanner *d, const char *key, void *context) {
+    ColorMembers *color = (ColorMembers *)context;
+    const unsigned int bit = strcmp(key, "oklab") == 0 ? 1u : (strcmp(key, "rgb") == 0 ? 2u : 0u);
+    if (bit == 0 || (color->seen & bit)) {
+        return json_skip_value(d);
+    }
+    color->seen |= bit;
+    if (d->p >= d->end || *d->p != '{') {
+        return json_skip_value(d);
+    }
+    color->objects |= bit;
+    return json_walk_object(d, component_member, bit == 1u ? (void *)&color->oklab : (void *)&color->rgb);
+}
+
+static int decode_color(JsonScanner *d, EngineColor *out) {
+    ColorMembers color = {
+        .oklab = {.names = OKLAB_NAMES, .name_count = 3},
+        .rgb = {.names = RGB_NAMES, .name_count = 3},
+    };
+    json_skip_whitespace(d);
+    if (d->p >= d->end || *d->p != '{') {
+        fail_field(d, "engine color missing oklab or rgb");
+        return json_skip_value(d);
+    }
+    if (json_walk_object(d, color_member, &color) != 0) {
+        return -1;
+    }
+    if (color.objects != 3u) {
+        fail_field(d, "engine color missing oklab or rgb");
+    } else if (color.oklab.numeric != 7u || color.rgb.numeric != 7u) {
+        fail_field(d, "engine color components must be numeric");
+    } else {
+        out->oklab.l = color.oklab.values[0];
+        out->oklab.a = color.oklab.values[1];
+        out->oklab.b = color.oklab.values[2];
+        out->srgb.r = color.rgb.values[0];
+        out->srgb.g = color.rgb.values[1];
+        out->srgb.b = color.rgb.values[2];
+    }
+    return 0;
+}
+
+enum {
+    FIELD_ENGINE = 1u << 0,
+    FIELD_DURATION = 1u << 1,
+    FIELD_COUNT = 1u << 2,
+    FIELD_COLORS = 1u << 3,
+    FIELD_COMMIT = 1u << 4,
+    FIELD_BUILD_FLAGS = 1u << 5,
+    FIELD_PLATFORM = 1u << 6,
+    FIELDS_REQUIRED = FIELD_ENGINE | FIELD_DURATION | FIELD_COUNT | FIELD_COLORS
+};
+
+typedef struct {
+    EngineOutput *out;
+    size_t capacity;
+    double declared_count;
+    unsigned int seen;
+    unsigned int valid; /* required fields whose first occurrence has the right type */
+    int out_of_memory;
+} OutputMembers;
+
+static int color_element(JsonScanner *d, void *context) {
+    OutputMembers *members = (OutputMembers *)context;
+    EngineOutput *out = members->out;
+    if (out->color_count == members->capacity) {
+        EngineColor *grown = (EngineColor *)realloc(out->colors, members->capacity * 2 * sizeof(EngineColor));
+        if (!grown) {
+            members->out_of_memory = 1;
+            return -1;
+        }
+        out->colors = grown;
+        members->capacity *= 2;
+    }
+    EngineColor *color = &out->colors[out->color_count];
+    memset(color, 0, sizeof(EngineColor));
+    if (decode_color(d, color) != 0) {
+        return -1;
+    }
+    out->color_count++;
+    return 0;
+}
+
+static int decode_colors(JsonScanner *d, OutputMembers *members) {
+    EngineOutput *out = members->out;
+    if ((members->valid & FIELD_COUNT) && members->declared_count >= 1.0) {
+        const size_t bound = (size_t)(d->end - d->p) / DECODER_MIN_COLOR_BYTES + 1;
+        members->capacity = members->declared_count < (double)bound ? (size_t)members->declared_count : bound;
+    } else {
+        members->capacity = DECODER_INITIAL_COLORS;
+    }
+    out->colors = (EngineColor *)calloc(members->capacity, sizeof(EngineColor));
+    if (!out->colors) {
+        members->out_of_memory = 1;
+        return -1;
+    }
+
+    return json_walk_array(d, color_element, members);
+}
+
+static int output_member(JsonScanner *d, const char *key, void *context) {
+    OutputMembers *members = (OutputMembers *)context;
+    EngineOutput *out = members->out;
+    static const struct {
+        const char *name;
+        unsigned int field;
+    } fields[] = {
+        {"engine", FIELD_ENGINE}, {"durationMs", FIELD_DURATION}, {"count", FIELD_COUNT},
+        {"colors", FIELD_COLORS}, {"commit", FIELD_COMMIT}, {"buildFlags", FIELD_BUILD_FLAGS},
+        {"platform", FIELD_PLATFORM},
+    };
+    unsigned int field = 0;
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+        if (strcmp(key, fields[i].name) == 0) {
+            field = fields[i].field;
+            break;
+        }
+    }
+    if (field == 0 || (members->seen & field)) {
+        return json_skip_value(d);
+    }
+    members->seen |= field;
+
+    const char first = d->p < d->end ? *d->p : '\0';
+    switch (field) {
+        case FIELD_ENGINE:
+            if (first != '"') {
+                return json_skip_value(d);
+            }
+            members->valid |= field;
+            if (json_scan_string(d, out->engine, sizeof(out->engine)) != 0) {
+                return -1;
+            }
+            memset(out->engine + strlen(out->engine), 0, sizeof(out->engine) - strlen(out->engine));
+            return 0;
+        case FIELD_DURATION:
+        case FIELD_COUNT:
+            if (!json_peek_is_number(d)) {
+                return json_skip_value(d);
+            }
+            members->valid |= field;
+            return json_scan_number(d, field == FIELD_DURATION ? &out->duration_ms : &members->declared_count);
+        case FIELD_COLORS:
+            if (first != '[') {
+                return json_skip_value(d);
+            }
+            members->valid |= field;
+            return decode_colors(d, members);
+        default: {
+            if (first != '"') {
+                return json_skip_value(d);
+            }
+            char **target = field == FIELD_COMMIT ? &out->commit : (field == FIELD_BUILD_FLAGS ? &out->build_flags : &out->platform);
+            const int status = json_scan_string_dup(d, target);
+            members->out_of_memory |= status == -2;
+            return status == 0 ? 0 : -1;
+        }
+    }
+}
+
+int parse_engine_output(const char *buffer, EngineOutput *out, ValidationError *error) {
+    if (!buffer || !out) {
+        set_error(error, "invalid engine output buffer");
+        return -1;
+    }
+
+    JsonScanner d;
+    json_scan_init(&d, buffer, strlen(buffer));
+    memset(out, 0, sizeof(EngineOutput));
+    OutputMembers members = {.out = out};
+
+    const int is_object = d.p < d.end && *d.p == '{';
+    const int parsed = is_object ? json_walk_object(&d, output_member, &members) : json_skip_value(&d);
+    if (parsed != 0) {
+        free_engine_output(out);
+        set_error(error, members.out_of_memory ? "failed to allocate engine colors" : "failed to parse engine JSON output");
+        return -1;
+    }
+
+    const char *failure = d.failure;
+    if ((members.valid & FIELDS_REQUIRED) != FIELDS_REQUIRED) {
+        failure = "engine output missing required fields";
+    } else if (out->color_count == 0) {
+        failure = "engine output contains no colors";
+    }
+    if (failure) {
+        free_engine_output(out);
+        set_error(error, failure);
+        return -1;
+    }
+    return 0;
+}
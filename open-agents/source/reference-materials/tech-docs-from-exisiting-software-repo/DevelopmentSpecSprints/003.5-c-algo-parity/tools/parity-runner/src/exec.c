@@ -1,9 +1,11 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-#include "cJSON.h"
 #include "types.h"
 
 static void set_error(ValidationError *error, const char *message) {
@@ -18,189 +20,405 @@ static void set_error(ValidationError *error, const char *message) {
     }
 }
 
-static int capture_command(const char *command, char **out_buffer, ValidationError *error) {
-    FILE *pipe = popen(command, "r");
-    if (!pipe) {
-        set_error(error, "failed to spawn runner process");
+/* Generous per-color size of an EngineOutput document, used to presize the read buffer. */
+#define OUTPUT_BYTES_PER_COLOR 256
+#define OUTPUT_BYTES_BASE 1024
+
+static size_t expected_output_size(const InputCase *input_case, EngineFormat format) {
+    const size_t per_color = format == ENGINE_FORMAT_BIN ? sizeof(EngineColor) : OUTPUT_BYTES_PER_COLOR;
+    return OUTPUT_BYTES_BASE + (size_t)input_case->config.count * per_color;
+}
+
+static int decode_output(const LaunchedProcess *process,
+                         const char *response,
+                         size_t length,
+                         EngineOutput *out,
+                         ValidationError *error) {
+    return process->binary_frames ? decode_engine_frame(response, length, out, error)
+                                  : parse_engine_output(response, out, error);
+}
+
+/* Adds the time since *mark to *phase and restarts the mark. */
+static void lap(double *phase, double *mark) {
+    const double now = launcher_now_ms();
+    *phase += now - *mark;
+    *mark = now;
+}
+
+static double case_deadline(const LaunchLimits *limits) {
+    return limits && limits->timeout_ms > 0.0 ? launcher_now_ms() + limits->timeout_ms : 0.0;
+}
+
+static int start_runner(const char *binary_path,
+                        const char *corpus_path,
+                        const InputCase *input_case,
+                        const LaunchLimits *limits,
+                        EngineFormat format,
+                        LaunchedProcess *process,
+                        ValidationError *error) {
+    /* JSON runners get no --format flag: the NULL ends argv before it. */
+    char *argv[] = {(char *)binary_path, "--corpus", (char *)corpus_path, "--case-id", (char *)input_case->id,
+                    format == ENGINE_FORMAT_BIN ? "--format" : NULL, "bin", NULL};
+    if (launch_process(argv, 0, limits, expected_output_size(input_case, format), process, error) != 0) {
         return -1;
     }
+    process->binary_frames = format == ENGINE_FORMAT_BIN;
+    return 0;
+}
 
-    size_t capacity = 4096;
-    size_t length = 0;
-    char *buffer = (char *)malloc(capacity);
-    if (!buffer) {
-        set_error(error, "failed to allocate output buffer");
-        pclose(pipe);
-        return -1;
-    }
-
-    int ch;
-    while ((ch = fgetc(pipe)) != EOF) {
-        if (length + 1 >= capacity) {
-            capacity *= 2;
-            char *tmp = (char *)realloc(buffer, capacity);
-            if (!tmp) {
-                free(buffer);
-                pclose(pipe);
-                set_error(error, "failed to grow output buffer");
-                return -1;
-            }
-            buffer = tmp;
-        }
-        buffer[length++] = (char)ch;
+/* Reaps a drained runner and parses its output; always releases the process. */
+static int finish_runner(LaunchedProcess *process, EngineOutput *out, ValidationError *error) {
+    int status = reap_process(process, 0, error);
+    if (status == 0) {
+        status = decode_output(process, process->output, process->output_length, out, error);
+        out->wall_ms = process->finished_ms - process->started_ms;
     }
-    buffer[length] = '\0';
+    free(process->output);
+    process->output = NULL;
+    return status;
+}
 
-    int status = pclose(pipe);
-    if (status != 0) {
-        free(buffer);
-        set_error(error, "runner process exited with failure");
+static void abandon_runner(LaunchedProcess *process) {
+    reap_process(process, 1, NULL);
+    free(process->output);
+    process->output = NULL;
+}
+
+static int run_engine_process(const char *binary_path,
+                              const char *corpus_path,
+                              const InputCase *input_case,
+                              const LaunchLimits *limits,
+                              EngineFormat format,
+                              EngineOutput *out,
+                              CaseTiming *timing,
+                              ValidationError *error) {
+    if (!binary_path || !corpus_path || !input_case || !out) {
+        set_error(error, "invalid engine arguments");
         return -1;
     }
+    CaseTiming unused = {0};
+    if (!timing) {
+        timing = &unused;
+    }
+    double mark = launcher_now_ms();
 
-    *out_buffer = buffer;
-    return 0;
+    LaunchedProcess process;
+    const int started = start_runner(binary_path, corpus_path, input_case, limits, format, &process, error);
+    lap(&timing->spawn_ms, &mark);
+    if (started != 0) {
+        return -1;
+    }
+    size_t failed = 0;
+    const int drained = drain_processes(&process, 1, 0, case_deadline(limits), &failed, error);
+    lap(&timing->wait_ms, &mark);
+    if (drained != 0) {
+        abandon_runner(&process);
+        return -1;
+    }
+    const int status = finish_runner(&process, out, error);
+    lap(&timing->parse_ms, &mark);
+    return status;
 }
 
-int parse_engine_output(const char *buffer, EngineOutput *out, ValidationError *error) {
-    if (!buffer || !out) {
-        set_error(error, "invalid engine output buffer");
-        return -1;
+void free_engine_output(EngineOutput *output) {
+    if (!output) {
+        return;
     }
+    free(output->colors);
+    free(output->commit);
+    free(output->build_flags);
+    free(output->platform);
+    memset(output, 0, sizeof(EngineOutput));
+}
 
-    cJSON *root = cJSON_Parse(buffer);
-    if (!root) {
-        set_error(error, "failed to parse engine JSON output");
-        return -1;
+/* Bitwise comparison of the generated colors; timing and provenance fields are ignored. */
+int engine_outputs_identical(const EngineOutput *a, const EngineOutput *b) {
+    if (!a || !b || a->color_count != b->color_count) {
+        return 0;
     }
+    return a->color_count == 0 || memcmp(a->colors, b->colors, a->color_count * sizeof(EngineColor)) == 0;
+}
+
+int run_c_engine(const char *binary_path,
+                 const char *corpus_path,
+                 const InputCase *input_case,
+                 const LaunchLimits *limits,
+                 EngineFormat format,
+                 EngineOutput *out,
+                 CaseTiming *timing,
+                 ValidationError *error) {
+    return run_engine_process(binary_path, corpus_path, input_case, limits, format, out, timing, error);
+}
 
-    memset(out, 0, sizeof(EngineOutput));
+int run_alt_engine(const char *binary_path,
+                   const char *corpus_path,
+                   const InputCase *input_case,
+                   const LaunchLimits *limits,
+                   EngineFormat format,
+                   EngineOutput *out,
+                   CaseTiming *timing,
+                   ValidationError *error) {
+    return run_engine_process(binary_path, corpus_path, input_case, limits, format, out, timing, error);
+}
 
-    const cJSON *engine = cJSON_GetObjectItemCaseSensitive(root, "engine");
-    const cJSON *duration = cJSON_GetObjectItemCaseSensitive(root, "durationMs");
-    const cJSON *count = cJSON_GetObjectItemCaseSensitive(root, "count");
-    const cJSON *colors = cJSON_GetObjectItemCaseSensitive(root, "colors");
-    const cJSON *commit = cJSON_GetObjectItemCaseSensitive(root, "commit");
-    const cJSON *build_flags = cJSON_GetObjectItemCaseSensitive(root, "buildFlags");
-    const cJSON *platform = cJSON_GetObjectItemCaseSensitive(root, "platform");
 
-    if (!cJSON_IsString(engine) || !cJSON_IsNumber(duration) || !cJSON_IsNumber(count) || !cJSON_IsArray(colors)) {
-        cJSON_Delete(root);
-        set_error(error, "engine output missing required fields");
+int run_engine_pair(const char *c_binary_path,
+                    const char *alt_binary_path,
+                    const char *corpus_path,
+                    const InputCase *input_case,
+                    const LaunchLimits *limits,
+                    EngineFormat format,
+                    EngineOutput *canonical,
+                    EngineOutput *alternate,
+                    size_t *failed_engine,
+                    CaseTiming *timing,
+                    ValidationError *error) {
+    *failed_engine = 0;
+    if (!c_binary_path || !alt_binary_path || !corpus_path || !input_case || !canonical || !alternate) {
+        set_error(error, "invalid engine arguments");
         return -1;
     }
-
-    strncpy(out->engine, engine->valuestring, sizeof(out->engine) - 1);
-    out->duration_ms = duration->valuedouble;
-    const size_t declared_count = (size_t)count->valuedouble;
-
-    if (cJSON_IsString(commit) && commit->valuestring) {
-        out->commit = strdup(commit->valuestring);
+    CaseTiming unused = {0};
+    if (!timing) {
+        timing = &unused;
     }
-    if (cJSON_IsString(build_flags) && build_flags->valuestring) {
-        out->build_flags = strdup(build_flags->valuestring);
+    double mark = launcher_now_ms();
+
+    LaunchedProcess processes[2];
+    if (start_runner(c_binary_path, corpus_path, input_case, limits, format, &processes[0], error) != 0) {
+        lap(&timing->spawn_ms, &mark);
+        return -1;
     }
-    if (cJSON_IsString(platform) && platform->valuestring) {
-        out->platform = strdup(platform->valuestring);
+    if (start_runner(alt_binary_path, corpus_path, input_case, limits, format, &processes[1], error) != 0) {
+        lap(&timing->spawn_ms, &mark);
+        *failed_engine = 1;
+        abandon_runner(&processes[0]);
+        return -1;
     }
+    lap(&timing->spawn_ms, &mark);
 
-    const int array_size = cJSON_GetArraySize(colors);
-    if (array_size <= 0) {
-        cJSON_Delete(root);
-        set_error(error, "engine output contains no colors");
+    const int drained = drain_processes(processes, 2, 0, case_deadline(limits), failed_engine, error);
+    lap(&timing->wait_ms, &mark);
+    if (drained != 0) {
+        abandon_runner(&processes[0]);
+        abandon_runner(&processes[1]);
         return -1;
     }
 
-    out->color_count = (size_t)array_size;
-    if (declared_count > 0 && declared_count != out->color_count) {
-        /* Prefer actual array size but keep declared count mismatch noted */
+    /* Both children are reaped before anything is compared. */
+    int status = 0;
+    if (finish_runner(&processes[0], canonical, error) != 0) {
+        abandon_runner(&processes[1]);
+        status = -1;
+    } else if (finish_runner(&processes[1], alternate, error) != 0) {
+        *failed_engine = 1;
+        status = -1;
     }
+    lap(&timing->parse_ms, &mark);
+    return status;
+}
 
-    out->colors = (EngineColor *)calloc(out->color_count, sizeof(EngineColor));
-    if (!out->colors) {
-        cJSON_Delete(root);
-        set_error(error, "failed to allocate engine colors");
-        return -1;
+/*
+ * Persistent engine sessions. A runner started with --server reads one InputCase
+ * per line on stdin (see serialize_input_case) and answers each with one
+ * EngineOutput JSON document on a single stdout line, or with one binary frame
+ * when it was also given --format bin. Requests are strictly
+ * lockstep, so neither pipe can fill up while the other side is blocked.
+ */
+struct EngineServer {
+    LaunchedProcess process;
+    LaunchLimits limits;
+    int failed; /* a request failed or timed out; the session is out of step and gets killed on stop */
+};
+
+EngineServer *start_engine_server(const char *binary_path,
+                                  const LaunchLimits *limits,
+                                  EngineFormat format,
+                                  ValidationError *error) {
+    if (!binary_path) {
+        set_error(error, "invalid engine server arguments");
+        return NULL;
     }
 
-    for (int i = 0; i < array_size; ++i) {
-        const cJSON *item = cJSON_GetArrayItem(colors, i);
-        const cJSON *oklab = cJSON_GetObjectItemCaseSensitive(item, "oklab");
-        const cJSON *rgb = cJSON_GetObjectItemCaseSensitive(item, "rgb");
-        if (!cJSON_IsObject(oklab) || !cJSON_IsObject(rgb)) {
-            free_engine_output(out);
-            cJSON_Delete(root);
-            set_error(error, "engine color missing oklab or rgb");
-            return -1;
-        }
-        const cJSON *l = cJSON_GetObjectItemCaseSensitive(oklab, "l");
-        const cJSON *a = cJSON_GetObjectItemCaseSensitive(oklab, "a");
-        const cJSON *b = cJSON_GetObjectItemCaseSensitive(oklab, "b");
-        const cJSON *r = cJSON_GetObjectItemCaseSensitive(rgb, "r");
-        const cJSON *g = cJSON_GetObjectItemCaseSensitive(rgb, "g");
-        const cJSON *bl = cJSON_GetObjectItemCaseSensitive(rgb, "b");
-        if (!cJSON_IsNumber(l) || !cJSON_IsNumber(a) || !cJSON_IsNumber(b) ||
-            !cJSON_IsNumber(r) || !cJSON_IsNumber(g) || !cJSON_IsNumber(bl)) {
-            free_engine_output(out);
-            cJSON_Delete(root);
-            set_error(error, "engine color components must be numeric");
+    EngineServer *server = (EngineServer *)calloc(1, sizeof(EngineServer));
+    if (!server) {
+        set_error(error, "failed to allocate engine server");
+        return NULL;
+    }
+    if (limits) {
+        server->limits = *limits;
+    }
+
+    /* As in start_runner, JSON sessions get no --format flag. */
+    char *argv[] = {(char *)binary_path, "--server", format == ENGINE_FORMAT_BIN ? "--format" : NULL, "bin", NULL};
+    if (launch_process(argv, 1, limits, 0, &server->process, error) != 0) {
+        free(server);
+        return NULL;
+    }
+    server->process.binary_frames = format == ENGINE_FORMAT_BIN;
+    return server;
+}
+
+static int write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        const ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
             return -1;
         }
-        out->colors[i].oklab.l = l->valuedouble;
-        out->colors[i].oklab.a = a->valuedouble;
-        out->colors[i].oklab.b = b->valuedouble;
-        out->colors[i].srgb.r = r->valuedouble;
-        out->colors[i].srgb.g = g->valuedouble;
-        out->colors[i].srgb.b = bl->valuedouble;
+        data += written;
+        length -= (size_t)written;
     }
-
-    cJSON_Delete(root);
     return 0;
 }
 
-void free_engine_output(EngineOutput *output) {
-    if (!output) {
-        return;
+static int send_case(EngineServer *server, const char *request, ValidationError *error) {
+    if (write_all(server->process.stdin_fd, request, strlen(request)) != 0 ||
+        write_all(server->process.stdin_fd, "\n", 1) != 0) {
+        server->failed = 1;
+        set_error(error, "failed to send case to engine server");
+        return -1;
     }
-    free(output->colors);
-    free(output->commit);
-    free(output->build_flags);
-    free(output->platform);
-    memset(output, 0, sizeof(EngineOutput));
+    server->process.started_ms = launcher_now_ms();
+    return 0;
 }
 
-int run_c_engine(const char *binary_path,
-                 const char *corpus_path,
-                 const char *case_id,
-                 EngineOutput *out,
-                 ValidationError *error) {
-    char command[MAX_PATH_LENGTH];
-    snprintf(command, sizeof(command), "%s --corpus \"%s\" --case-id \"%s\"", binary_path, corpus_path, case_id);
+int engine_server_failed(const EngineServer *server) {
+    return server && server->failed;
+}
+
+static int receive_output(EngineServer *server, EngineOutput *out, ValidationError *error) {
+    size_t length = 0;
+    char *response = take_process_response(&server->process, &length, error);
+    if (!response) {
+        server->failed = 1;
+        return -1;
+    }
+    const int status = decode_output(&server->process, response, length, out, error);
+    free(response);
+    out->wall_ms = server->process.finished_ms - server->process.started_ms;
+    return status;
+}
 
-    char *buffer = NULL;
-    if (capture_command(command, &buffer, error) != 0) {
+int engine_server_run_case(EngineServer *server,
+                           const InputCase *input_case,
+                           EngineOutput *out,
+                           CaseTiming *timing,
+                           ValidationError *error) {
+    if (!server || !input_case || !out) {
+        set_error(error, "invalid engine server request");
         return -1;
     }
+    if (server->failed) {
+        /* A response may still be in flight and would be taken for this case's. */
+        set_error(error, "engine server session is out of step after an earlier failure");
+        return -1;
+    }
+    CaseTiming unused = {0};
+    if (!timing) {
+        timing = &unused;
+    }
+    double mark = launcher_now_ms();
 
-    int status = parse_engine_output(buffer, out, error);
-    free(buffer);
+    char *request = serialize_input_case(input_case);
+    if (!request) {
+        set_error(error, "failed to serialize input case");
+        return -1;
+    }
+    const int sent = send_case(server, request, error);
+    free(request);
+    lap(&timing->spawn_ms, &mark);
+    if (sent != 0) {
+        return -1;
+    }
+    size_t failed = 0;
+    const int drained = drain_processes(&server->process, 1, 1, case_deadline(&server->limits), &failed, error);
+    lap(&timing->wait_ms, &mark);
+    if (drained != 0) {
+        server->failed = 1;
+        return -1;
+    }
+    const int status = receive_output(server, out, error);
+    lap(&timing->parse_ms, &mark);
     return status;
 }
 
-int run_alt_engine(const char *binary_path,
-                   const char *corpus_path,
-                   const char *case_id,
-                   EngineOutput *out,
-                   ValidationError *error) {
-    char command[MAX_PATH_LENGTH];
-    snprintf(command, sizeof(command), "%s --corpus \"%s\" --case-id \"%s\"", binary_path, corpus_path, case_id);
+int engine_server_run_pair(EngineServer *c_server,
+                           EngineServer *alt_server,
+                           const InputCase *input_case,
+                           EngineOutput *canonical,
+                           EngineOutput *alternate,
+                           size_t *failed_engine,
+                           CaseTiming *timing,
+                           ValidationError *error) {
+    *failed_engine = 0;
+    if (!c_server || !alt_server || !input_case || !canonical || !alternate) {
+        set_error(error, "invalid engine server request");
+        return -1;
+    }
+    if (c_server->failed || alt_server->failed) {
+        *failed_engine = c_server->failed ? 0 : 1;
+        set_error(error, "engine server session is out of step after an earlier failure");
+        return -1;
+    }
+    CaseTiming unused = {0};
+    if (!timing) {
+        timing = &unused;
+    }
+    double mark = launcher_now_ms();
 
-    char *buffer = NULL;
-    if (capture_command(command, &buffer, error) != 0) {
+    char *request = serialize_input_case(input_case);
+    if (!request) {
+        set_error(error, "failed to serialize input case");
+        return -1;
+    }
+    int status = send_case(c_server, request, error);
+    if (status == 0) {
+        status = send_case(alt_server, request, error);
+        *failed_engine = status == 0 ? 0 : 1;
+        /* The canonical request is already out and its response would go unread. */
+        c_server->failed |= status != 0;
+    }
+    free(request);
+    lap(&timing->spawn_ms, &mark);
+    if (status != 0) {
         return -1;
     }
 
-    int status = parse_engine_output(buffer, out, error);
-    free(buffer);
+    /* Both sessions compute while their responses are drained together. */
+    LaunchedProcess processes[2] = {c_server->process, alt_server->process};
+    status = drain_processes(processes, 2, 1, case_deadline(&c_server->limits), failed_engine, error);
+    c_server->process = processes[0];
+    alt_server->process = processes[1];
+    lap(&timing->wait_ms, &mark);
+    if (status != 0) {
+        c_server->failed = 1;
+        alt_server->failed = 1;
+        return -1;
+    }
+
+    if (receive_output(c_server, canonical, error) != 0) {
+        *failed_engine = 0;
+        alt_server->failed = 1; /* its drained response is left unread */
+        status = -1;
+    } else if (receive_output(alt_server, alternate, error) != 0) {
+        *failed_engine = 1;
+        status = -1;
+    }
+    lap(&timing->parse_ms, &mark);
     return status;
 }
+
+int stop_engine_server(EngineServer *server) {
+    if (!server) {
+        return 0;
+    }
+    /* Closing stdin is the shutdown signal; the runner exits once it drains its input. */
+    const int failed = server->failed;
+    const int result = reap_process(&server->process, failed, NULL);
+    free(server->process.output);
+    free(server);
+    return failed ? -1 : result;
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+
+/*
+ * FNV-1a (64-bit) helpers shared by the output cache and incremental runs.
+ * These identify content, not adversarial input, so a fast non-cryptographic
+ * hash is enough.
+ */
+
+#define FNV1A64_PRIME 0x100000001b3ULL
+
+uint64_t fnv1a64(uint64_t hash, const void *data, size_t length) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV1A64_PRIME;
+    }
+    return hash;
+}
+
+uint64_t fnv1a64_string(uint64_t hash, const char *value) {
+    /* The terminator is hashed too so adjacent fields cannot run together. */
+    return value ? fnv1a64(hash, value, strlen(value) + 1) : fnv1a64(hash, "", 1);
+}
+
+int fnv1a64_file(const char *path, uint64_t *out) {
+    if (!path || !out) {
+        return -1;
+    }
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return -1;
+    }
+    unsigned char buffer[65536];
+    uint64_t hash = FNV1A64_OFFSET_BASIS;
+    size_t read_bytes;
+    while ((read_bytes = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        hash = fnv1a64(hash, buffer, read_bytes);
+    }
+    const int failed = ferror(file);
+    fclose(file);
+    *out = hash;
+    return failed ? -1 : 0;
+}
+
+int fingerprint_input_case(const InputCase *input_case, uint64_t engine_hash, char *out, size_t out_size) {
+    if (!input_case || !out || out_size < FINGERPRINT_LENGTH + 1) {
+        return -1;
+    }
+    char *serialized = serialize_input_case(input_case);
+    if (!serialized) {
+        return -1;
+    }
+    uint64_t hash = fnv1a64(FNV1A64_OFFSET_BASIS, &engine_hash, sizeof(engine_hash));
+    hash = fnv1a64_string(hash, serialized);
+    free(serialized);
+    snprintf(out, out_size, "%016llx", (unsigned long long)hash);
+    return 0;
+}
+
+/* Stable shard assignment for --shard: depends only on the case id, never on corpus order or content. */
+size_t shard_of_case(const char *case_id, size_t shard_count) {
+    if (!case_id || shard_count == 0) {
+        return 0;
+    }
+    /* FNV-1a's low bits follow the last bytes too closely for a modulus; finish with the murmur3 fmix64 avalanche. */
+    uint64_t hash = fnv1a64_string(FNV1A64_OFFSET_BASIS, case_id);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return (size_t)(hash % (uint64_t)shard_count);
+}
@@ -0,0 +1,353 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "types.h"
+
+/*
+ * Incremental runs. A previous report.json is read back into ComparisonResults
+ * so cases whose fingerprint (serialized InputCase plus both engine binaries)
+ * is unchanged can be carried over instead of re-executed.
+ *
+ * report.json keeps per-sample OKLab values and deltas but not absolute sRGB,
+ * so carried samples get canonical sRGB 0 and alternate sRGB -rgbDelta: the
+ * sRGB deltas, which are all the statistics use, come back exactly.
+ *
+ * NaN and infinite values are printed as null. Such a case is not carried
+ * over (there is no telling which it was, and Inf fails tolerances where NaN
+ * does not), so --since re-runs it; merged shards read the nulls as NaN.
+ *
+ * These results keep the samples as read (ComparisonResult.samples) instead of
+ * palettes: cJSON prints numbers that only round-trip approximately, so deltas
+ * recomputed from the printed colours could drift from the stored ones.
+ */
+
+static void set_error(ValidationError *error, const char *message) {
+    if (!error || !message) {
+        return;
+    }
+    free(error->message);
+    size_t len = strlen(message);
+    error->message = (char *)malloc(len + 1);
+    if (error->message) {
+        memcpy(error->message, message, len + 1);
+    }
+}
+
+static char *read_text_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    if (fseek(file, 0, SEEK_END) != 0) {
+        fclose(file);
+        return NULL;
+    }
+    const long size = ftell(file);
+    rewind(file);
+    if (size < 0) {
+        fclose(file);
+        return NULL;
+    }
+    char *buffer = (char *)malloc((size_t)size + 1);
+    if (buffer && fread(buffer, 1, (size_t)size, file) != (size_t)size) {
+        free(buffer);
+        buffer = NULL;
+    }
+    fclose(file);
+    if (buffer) {
+        buffer[size] = '\0';
+    }
+    return buffer;
+}
+
+static double number_field(const cJSON *object, const char *name, int *ok) {
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(object, name);
+    if (!cJSON_IsNumber(item)) {
+        *ok = 0;
+        return 0.0;
+    }
+    return item->valuedouble;
+}
+
+/* Like number_field, but null (how NaN and Inf are printed) reads as NaN and is counted. */
+static double sample_field(const cJSON *object, const char *name, int *ok, size_t *nulls) {
+    if (cJSON_IsNull(cJSON_GetObjectItemCaseSensitive(object, name))) {
+        ++*nulls;
+        return NAN;
+    }
+    return number_field(object, name, ok);
+}
+
+static int parse_sample(const cJSON *node, SampleDelta *sample, size_t *nulls) {
+    int ok = 1;
+    const cJSON *delta = cJSON_GetObjectItemCaseSensitive(node, "delta");
+    const cJSON *rgb_delta = cJSON_GetObjectItemCaseSensitive(node, "rgbDelta");
+    const cJSON *canonical = cJSON_GetObjectItemCaseSensitive(node, "canonical");
+    const cJSON *alternate = cJSON_GetObjectItemCaseSensitive(node, "alternate");
+    if (!cJSON_IsObject(delta) || !cJSON_IsObject(rgb_delta) || !cJSON_IsObject(canonical) || !cJSON_IsObject(alternate)) {
+        return -1;
+    }
+
+    sample->index = (size_t)number_field(node, "index", &ok);
+    sample->delta.l = sample_field(delta, "l", &ok, nulls);
+    sample->delta.a = sample_field(delta, "a", &ok, nulls);
+    sample->delta.b = sample_field(delta, "b", &ok, nulls);
+    sample->delta.deltaE = sample_field(node, "deltaE", &ok, nulls);
+    sample->rgb_delta.r = sample_field(rgb_delta, "r", &ok, nulls);
+    sample->rgb_delta.g = sample_field(rgb_delta, "g", &ok, nulls);
+    sample->rgb_delta.b = sample_field(rgb_delta, "b", &ok, nulls);
+    sample->canonical.oklab.l = sample_field(canonical, "l", &ok, nulls);
+    sample->canonical.oklab.a = sample_field(canonical, "a", &ok, nulls);
+    sample->canonical.oklab.b = sample_field(canonical, "b", &ok, nulls);
+    sample->alternate.oklab.l = sample_field(alternate, "l", &ok, nulls);
+    sample->alternate.oklab.a = sample_field(alternate, "a", &ok, nulls);
+    sample->alternate.oklab.b = sample_field(alternate, "b", &ok, nulls);
+    sample->alternate.srgb.r = -sample->rgb_delta.r;
+    sample->alternate.srgb.g = -sample->rgb_delta.g;
+    sample->alternate.srgb.b = -sample->rgb_delta.b;
+    return ok ? 0 : -1;
+}
+
+static void parse_trial_stats(const cJSON *node, TrialStats *trials) {
+    int ok = 1;
+    if (!cJSON_IsObject(node)) {
+        return;
+    }
+    trials->trials = (size_t)number_field(node, "trials", &ok);
+    trials->rejected = (size_t)number_field(node, "rejected", &ok);
+    trials->median_ms = number_field(node, "medianMs", &ok);
+    trials->mad_ms = number_field(node, "madMs", &ok);
+    trials->min_ms = number_field(node, "minMs", &ok);
+    if (!ok) {
+        memset(trials, 0, sizeof(TrialStats));
+    }
+}
+
+static void parse_case_timing(const cJSON *node, CaseTiming *timing) {
+    int ok = 1;
+    if (!cJSON_IsObject(node)) {
+        return;
+    }
+    timing->spawn_ms = number_field(node, "spawnMs", &ok);
+    timing->wait_ms = number_field(node, "waitMs", &ok);
+    timing->parse_ms = number_field(node, "parseMs", &ok);
+    timing->compare_ms = number_field(node, "compareMs", &ok);
+    timing->write_ms = number_field(node, "writeMs", &ok);
+    timing->total_ms = number_field(node, "totalMs", &ok);
+    if (!ok) {
+        memset(timing, 0, sizeof(CaseTiming));
+    }
+}
+
+/*
+ * Returns 1 when the case was read, 0 when a fingerprint is required and the
+ * case has none or has null samples (the case cannot be reused), -1 on
+ * malformed input.
+ */
+static int parse_previous_case(const cJSON *node, int require_fingerprint, ComparisonResult *result) {
+    const cJSON *id = cJSON_GetObjectItemCaseSensitive(node, "inputCaseId");
+    const cJSON *fingerprint = cJSON_GetObjectItemCaseSensitive(node, "fingerprint");
+    const cJSON *samples = cJSON_GetObjectItemCaseSensitive(node, "samples");
+    if (!cJSON_IsString(id) || !cJSON_IsArray(samples)) {
+        return -1;
+    }
+    const int has_fingerprint = cJSON_IsString(fingerprint) && strlen(fingerprint->valuestring) == FINGERPRINT_LENGTH;
+    if (!has_fingerprint && require_fingerprint) {
+        return 0;
+    }
+
+    memset(result, 0, sizeof(ComparisonResult));
+    strncpy(result->input_case_id, id->valuestring, sizeof(result->input_case_id) - 1);
+    if (has_fingerprint) {
+        memcpy(result->fingerprint, fingerprint->valuestring, FINGERPRINT_LENGTH + 1);
+    }
+    result->carried_over = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(node, "carriedOver"));
+    parse_case_timing(cJSON_GetObjectItemCaseSensitive(node, "timing"), &result->timing);
+    const cJSON *duration_trials = cJSON_GetObjectItemCaseSensitive(node, "durationTrials");
+    parse_trial_stats(cJSON_GetObjectItemCaseSensitive(duration_trials, "canonical"), &result->canonical_trials);
+    parse_trial_stats(cJSON_GetObjectItemCaseSensitive(duration_trials, "alternate"), &result->alternate_trials);
+    const cJSON *canonical_duration = cJSON_GetObjectItemCaseSensitive(node, "canonicalDurationMs");
+    const cJSON *alternate_duration = cJSON_GetObjectItemCaseSensitive(node, "alternateDurationMs");
+    if (cJSON_IsNumber(canonical_duration) && cJSON_IsNumber(alternate_duration)) {
+        result->canonical_duration_ms = canonical_duration->valuedouble;
+        result->alternate_duration_ms = alternate_duration->valuedouble;
+    }
+    const cJSON *engine = NULL;
+    cJSON_ArrayForEach(engine, cJSON_GetObjectItemCaseSensitive(node, "nondeterministic")) {
+        if (cJSON_IsString(engine) && strcmp(engine->valuestring, "canonical") == 0) {
+            result->nondeterministic |= NONDETERMINISTIC_CANONICAL;
+        } else if (cJSON_IsString(engine) && strcmp(engine->valuestring, "alternate") == 0) {
+            result->nondeterministic |= NONDETERMINISTIC_ALTERNATE;
+        }
+    }
+
+    const int sample_count = cJSON_GetArraySize(samples);
+    if (sample_count <= 0) {
+        return -1;
+    }
+    result->samples = (SampleDelta *)calloc((size_t)sample_count, sizeof(SampleDelta));
+    if (!result->samples) {
+        return -1;
+    }
+    result->sample_count = (size_t)sample_count;
+    size_t index = 0;
+    size_t nulls = 0;
+    const cJSON *sample = NULL;
+    cJSON_ArrayForEach(sample, samples) {
+        if (parse_sample(sample, &result->samples[index++], &nulls) != 0) {
+            free_comparison_result(result);
+            return -1;
+        }
+    }
+    if (nulls > 0 && require_fingerprint) {
+        free_comparison_result(result);
+        return 0;
+    }
+    return 1;
+}
+
+static int compare_result_ids(const void *lhs, const void *rhs) {
+    const ComparisonResult *a = (const ComparisonResult *)lhs;
+    const ComparisonResult *b = (const ComparisonResult *)rhs;
+    return strcmp(a->input_case_id, b->input_case_id);
+}
+
+/* Reads the cases and build flags out of a parsed report; the caller owns `root`. */
+static int read_previous_run(const cJSON *root, PreviousRun *out, ValidationError *error) {
+    if (parse_report_cases(cJSON_GetObjectItemCaseSensitive(root, "cases"), 1, out, error) != 0) {
+        return -1;
+    }
+
+    const cJSON *provenance = cJSON_GetObjectItemCaseSensitive(root, "provenance");
+    const cJSON *c_build_flags = cJSON_GetObjectItemCaseSensitive(provenance, "cBuildFlags");
+    const cJSON *alt_build_flags = cJSON_GetObjectItemCaseSensitive(provenance, "altBuildFlags");
+    if (cJSON_IsString(c_build_flags)) {
+        out->c_build_flags = strdup(c_build_flags->valuestring);
+    }
+    if (cJSON_IsString(alt_build_flags)) {
+        out->alt_build_flags = strdup(alt_build_flags->valuestring);
+    }
+    return 0;
+}
+
+int load_previous_run(const char *report_path, PreviousRun *out, ValidationError *error) {
+    if (!report_path || !out) {
+        set_error(error, "invalid previous report arguments");
+        return -1;
+    }
+    memset(out, 0, sizeof(PreviousRun));
+
+    char *text = read_text_file(report_path);
+    if (!text) {
+        set_error(error, "failed to read previous report");
+        return -1;
+    }
+    /* The report tree is dropped as soon as the results are copied out. */
+    Arena json_arena;
+    arena_init(&json_arena, strlen(text));
+    json_arena_begin(&json_arena);
+    cJSON *root = cJSON_Parse(text);
+    free(text);
+    int status = -1;
+    if (!root) {
+        set_error(error, "failed to parse previous report JSON");
+    } else {
+        status = read_previous_run(root, out, error);
+        cJSON_Delete(root);
+    }
+    json_arena_end();
+    arena_release(&json_arena);
+    return status;
+}
+
+int parse_report_cases(const cJSON *cases, int require_fingerprint, PreviousRun *out, ValidationError *error) {
+    if (!out) {
+        set_error(error, "invalid report case arguments");
+        return -1;
+    }
+    memset(out, 0, sizeof(PreviousRun));
+    if (!cJSON_IsArray(cases)) {
+        set_error(error, "report is missing cases");
+        return -1;
+    }
+
+    const int case_count = cJSON_GetArraySize(cases);
+    out->results = (ComparisonResult *)calloc(case_count > 0 ? (size_t)case_count : 1, sizeof(ComparisonResult));
+    if (!out->results) {
+        set_error(error, "failed to allocate report results");
+        return -1;
+    }
+
+    /* cJSON arrays are linked lists; walk them instead of indexing. */
+    const cJSON *node = NULL;
+    cJSON_ArrayForEach(node, cases) {
+        const int status = parse_previous_case(node, require_fingerprint, &out->results[out->result_count]);
+        if (status < 0) {
+            free_previous_run(out);
+            set_error(error, "report contains a malformed case");
+            return -1;
+        }
+        out->result_count += (size_t)status;
+    }
+
+    qsort(out->results, out->result_count, sizeof(ComparisonResult), compare_result_ids);
+    return 0;
+}
+
+const ComparisonResult *find_reusable_result(const PreviousRun *run, const char *case_id, const char *fingerprint) {
+    if (!run || !case_id || !fingerprint || fingerprint[0] == '\0' || run->result_count == 0) {
+        return NULL;
+    }
+    ComparisonResult key;
+    memset(&key, 0, sizeof(key));
+    strncpy(key.input_case_id, case_id, sizeof(key.input_case_id) - 1);
+    const ComparisonResult *match = (const ComparisonResult *)bsearch(&key, run->results, run->result_count,
+                                                                      sizeof(ComparisonResult), compare_result_ids);
+    return match && strcmp(match->fingerprint, fingerprint) == 0 ? match : NULL;
+}
+
+int carry_over_result(const ComparisonResult *previous,
+                      const ToleranceConfig *tolerance,
+                      ComparisonResult *out,
+                      ValidationError *error) {
+    if (!previous || !tolerance || !out) {
+        set_error(error, "invalid carry-over arguments");
+        return -1;
+    }
+    memset(out, 0, sizeof(ComparisonResult));
+    out->samples = (SampleDelta *)malloc(previous->sample_count * sizeof(SampleDelta));
+    if (!out->samples) {
+        set_error(error, "failed to allocate carried-over samples");
+        return -1;
+    }
+    memcpy(out->samples, previous->samples, previous->sample_count * sizeof(SampleDelta));
+    out->sample_count = previous->sample_count;
+    memcpy(out->input_case_id, previous->input_case_id, sizeof(out->input_case_id));
+    memcpy(out->fingerprint, previous->fingerprint, sizeof(out->fingerprint));
+    out->carried_over = true;
+    out->canonical_duration_ms = previous->canonical_duration_ms;
+    out->alternate_duration_ms = previous->alternate_duration_ms;
+    out->nondeterministic = previous->nondeterministic;
+
+    /* Pass/fail follows the current tolerances, not the ones the old report used. */
+    summarize_comparison(out, tolerance);
+    return 0;
+}
+
+void free_previous_run(PreviousRun *run) {
+    if (!run) {
+        return;
+    }
+    for (size_t i = 0; i < run->result_count; ++i) {
+        free_comparison_result(&run->results[i]);
+    }
+    free(run->results);
+    free(run->c_build_flags);
+    free(run->alt_build_flags);
+    memset(run, 0, sizeof(PreviousRun));
+}
@@ -0,0 +1,310 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+
+/*
+ * JSON scanning without a cJSON tree, for the hand-written decoders (engine
+ * output, corpus index). It accepts exactly what cJSON_Parse accepts, including the
+ * nesting limit and cJSON's handling of string escapes, so switching a reader
+ * from cJSON to a scanner never changes which documents are valid.
+ */
+
+#define JSON_SCAN_MAX_DEPTH 1000 /* matches CJSON_NESTING_LIMIT */
+#define JSON_SCAN_KEY_LENGTH 16  /* longer keys never match a member a decoder looks for */
+
+void json_scan_init(JsonScanner *d, const char *data, size_t length) {
+    d->p = data;
+    d->end = data + length;
+    d->depth = 0;
+    d->failure = NULL;
+    if (length >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        d->p += 3;
+    }
+    json_skip_whitespace(d);
+}
+
+void json_skip_whitespace(JsonScanner *d) {
+    while (d->p < d->end && (unsigned char)*d->p <= 32) {
+        d->p++;
+    }
+}
+
+int json_consume(JsonScanner *d, char c) {
+    json_skip_whitespace(d);
+    if (d->p < d->end && *d->p == c) {
+        d->p++;
+        return 1;
+    }
+    return 0;
+}
+
+int json_peek_is_number(const JsonScanner *d) {
+    return d->p < d->end && (*d->p == '-' || (*d->p >= '0' && *d->p <= '9'));
+}
+
+/* Like cJSON, any non-hex digit makes the whole escape decode as U+0000. */
+static unsigned int parse_hex4(const char *p) {
+    unsigned int value = 0;
+    for (int i = 0; i < 4; ++i) {
+        const char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= (unsigned int)(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            value |= (unsigned int)(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            value |= (unsigned int)(c - 'A' + 10);
+        } else {
+            return 0;
+        }
+    }
+    return value;
+}
+
+/* Appends a byte to dst while it has room; `length` counts every byte regardless. */
+static void put_byte(char *dst, size_t cap, size_t *length, unsigned char byte) {
+    if (dst && *length + 1 < cap) {
+        dst[*length] = (char)byte;
+    }
+    (*length)++;
+}
+
+/* Decodes the \uXXXX escape (plus its low surrogate, if any) at p; returns the bytes consumed, 0 if invalid. */
+static size_t decode_unicode_escape(const char *p, const char *end, char *dst, size_t cap, size_t *length) {
+    if (end - p < 6) {
+        return 0;
+    }
+    const unsigned int first = parse_hex4(p + 2);
+    if (first >= 0xDC00 && first <= 0xDFFF) {
+        return 0;
+    }
+    size_t consumed = 6;
+    unsigned long codepoint = first;
+    if (first >= 0xD800 && first <= 0xDBFF) {
+        if (end - p < 12 || p[6] != '\\' || p[7] != 'u') {
+            return 0;
+        }
+        const unsigned int second = parse_hex4(p + 8);
+        if (second < 0xDC00 || second > 0xDFFF) {
+            return 0;
+        }
+        consumed = 12;
+        codepoint = 0x10000 + (((unsigned long)(first & 0x3FF) << 10) | (second & 0x3FF));
+    }
+    if (codepoint < 0x80) {
+        put_byte(dst, cap, length, (unsigned char)codepoint);
+    } else if (codepoint < 0x800) {
+        put_byte(dst, cap, length, (unsigned char)(0xC0 | (codepoint >> 6)));
+        put_byte(dst, cap, length, (unsigned char)(0x80 | (codepoint & 0x3F)));
+    } else if (codepoint < 0x10000) {
+        put_byte(dst, cap, length, (unsigned char)(0xE0 | (codepoint >> 12)));
+        put_byte(dst, cap, length, (unsigned char)(0x80 | ((codepoint >> 6) & 0x3F)));
+        put_byte(dst, cap, length, (unsigned char)(0x80 | (codepoint & 0x3F)));
+    } else {
+        put_byte(dst, cap, length, (unsigned char)(0xF0 | (codepoint >> 18)));
+        put_byte(dst, cap, length, (unsigned char)(0x80 | ((codepoint >> 12) & 0x3F)));
+        put_byte(dst, cap, length, (unsigned char)(0x80 | ((codepoint >> 6) & 0x3F)));
+        put_byte(dst, cap, length, (unsigned char)(0x80 | (codepoint & 0x3F)));
+    }
+    return consumed;
+}
+
+/* Finds the closing quote of the string at d->p, stepping over every escaped character. */
+static const char *string_end(const JsonScanner *d) {
+    const char *q = d->p + 1;
+    while (q < d->end && *q != '"') {
+        if (*q == '\\' && ++q >= d->end) {
+            return NULL;
+        }
+        q++;
+    }
+    return q < d->end ? q : NULL;
+}
+
+int json_scan_string(JsonScanner *d, char *dst, size_t cap) {
+    const char *end = string_end(d);
+    if (!end) {
+        return -1;
+    }
+    const char *p = d->p + 1;
+    size_t written = 0;
+    while (p < end) {
+        if (*p != '\\') {
+            put_byte(dst, cap, &written, (unsigned char)*p++);
+            continue;
+        }
+        switch (p[1]) {
+            case 'b': put_byte(dst, cap, &written, '\b'); break;
+            case 'f': put_byte(dst, cap, &written, '\f'); break;
+            case 'n': put_byte(dst, cap, &written, '\n'); break;
+            case 'r': put_byte(dst, cap, &written, '\r'); break;
+            case 't': put_byte(dst, cap, &written, '\t'); break;
+            case '"':
+            case '\\':
+            case '/':
+                put_byte(dst, cap, &written, (unsigned char)p[1]);
+                break;
+            case 'u': {
+                const size_t consumed = decode_unicode_escape(p, end, dst, cap, &written);
+                if (consumed == 0) {
+                    return -1;
+                }
+                p += consumed;
+                continue;
+            }
+            default:
+                return -1;
+        }
+        p += 2;
+    }
+    d->p = end + 1;
+    if (dst && cap > 0) {
+        dst[written < cap ? written : cap - 1] = '\0';
+    }
+    return 0;
+}
+
+/* The raw text bounds the decoded size, so one allocation always suffices. */
+int json_scan_string_dup(JsonScanner *d, char **out) {
+    const char *end = string_end(d);
+    if (!end) {
+        return -1;
+    }
+    const size_t cap = (size_t)(end - d->p);
+    char *text = (char *)malloc(cap);
+    if (!text) {
+        return -2;
+    }
+    if (json_scan_string(d, text, cap) != 0) {
+        free(text);
+        return -1;
+    }
+    free(*out);
+    *out = text;
+    return 0;
+}
+
+/* Same number syntax as cJSON: the longest run of number characters, converted with strtod. */
+int json_scan_number(JsonScanner *d, double *value) {
+    const char *q = d->p;
+    while (q < d->end && strchr("0123456789+-eE.", *q) != NULL) {
+        q++;
+    }
+    const size_t span = (size_t)(q - d->p);
+    char local[64];
+    char *text = span < sizeof(local) ? local : (char *)malloc(span + 1);
+    if (!text) {
+        return -1;
+    }
+    memcpy(text, d->p, span);
+    text[span] = '\0';
+    char *stop = NULL;
+    *value = strtod(text, &stop);
+    const size_t used = (size_t)(stop - text);
+    if (text != local) {
+        free(text);
+    }
+    if (used == 0) {
+        return -1;
+    }
+    d->p += used;
+    return 0;
+}
+
+static int match_literal(JsonScanner *d, const char *literal) {
+    const size_t len = strlen(literal);
+    if ((size_t)(d->end - d->p) < len || strncmp(d->p, literal, len) != 0) {
+        return -1;
+    }
+    d->p += len;
+    return 0;
+}
+
+/*
+ * Walks the members of the object at d->p (which must be '{'), calling `member`
+ * with the decoded key for each one; `member` must json_consume the value.
+ */
+int json_walk_object(JsonScanner *d, JsonMemberFn member, void *context) {
+    if (++d->depth > JSON_SCAN_MAX_DEPTH) {
+        return -1;
+    }
+    d->p++;
+    if (json_consume(d, '}')) {
+        d->depth--;
+        return 0;
+    }
+    do {
+        json_skip_whitespace(d);
+        if (d->p >= d->end || *d->p != '"') {
+            return -1;
+        }
+        char key[JSON_SCAN_KEY_LENGTH];
+        if (json_scan_string(d, key, sizeof(key)) != 0 || !json_consume(d, ':')) {
+            return -1;
+        }
+        json_skip_whitespace(d);
+        /* Keys compare as C strings, as in cJSON; none of the wanted keys fills the buffer. */
+        const char *matched = strlen(key) < sizeof(key) - 1 ? key : "";
+        if (member ? member(d, matched, context) != 0 : json_skip_value(d) != 0) {
+            return -1;
+        }
+    } while (json_consume(d, ','));
+    if (!json_consume(d, '}')) {
+        return -1;
+    }
+    d->depth--;
+    return 0;
+}
+
+static int skip_element(JsonScanner *d, void *context) {
+    (void)context;
+    return json_skip_value(d);
+}
+
+int json_skip_value(JsonScanner *d) {
+    json_skip_whitespace(d);
+    if (d->p >= d->end) {
+        return -1;
+    }
+    switch (*d->p) {
+        case '"':
+            return json_scan_string(d, NULL, 0);
+        case '{':
+            return json_walk_object(d, NULL, NULL);
+        case '[':
+            return json_walk_array(d, skip_element, NULL);
+        case 't':
+            return match_literal(d, "true");
+        case 'f':
+            return match_literal(d, "false");
+        case 'n':
+            return match_literal(d, "null");
+        default: {
+            double ignored = 0.0;
+            return json_peek_is_number(d) ? json_scan_number(d, &ignored) : -1;
+        }
+    }
+}
+
+int json_walk_array(JsonScanner *d, JsonElementFn element, void *context) {
+    if (++d->depth > JSON_SCAN_MAX_DEPTH) {
+        return -1;
+    }
+    d->p++;
+    if (json_consume(d, ']')) {
+        d->depth--;
+        return 0;
+    }
+    do {
+        json_skip_whitespace(d);
+        if (element(d, context) != 0) {
+            return -1;
+        }
+    } while (json_consume(d, ','));
+    if (!json_consume(d, ']')) {
+        return -1;
+    }
+    d->depth--;
+    return 0;
+}
@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <errno.h>
 #include <math.h>
 #include <stdio.h>
@@ -56,6 +58,15 @@ static char *read_file_into_buffer(const char *path, long *length) {
     return buffer;
 }
 
+/* Case fields come from the corpus arena when there is one, otherwise from the heap. */
+static void *alloc_zeroed(Arena *arena, size_t count, size_t size) {
+    return arena ? arena_calloc(arena, count, size) : calloc(count, size);
+}
+
+static char *copy_string(Arena *arena, const char *text) {
+    return arena ? arena_strdup(arena, text) : strdup(text);
+}
+
 int validate_corpus_version(const char *version) {
     if (!version) {
         return 0;
@@ -138,7 +149,7 @@ static int parse_anchor(const cJSON *node, Anchor *anchor, ValidationError *erro
     return 0;
 }
 
-static int parse_tags(const cJSON *tags_node, InputCase *input_case, ValidationError *error) {
+static int parse_tags(const cJSON *tags_node, Arena *arena, InputCase *input_case, ValidationError *error) {
     if (!tags_node) {
         input_case->tags = NULL;
         input_case->tag_count = 0;
@@ -149,30 +160,29 @@ static int parse_tags(const cJSON *tags_node, InputCase *input_case, ValidationE
         return -1;
     }
     const int tag_count = cJSON_GetArraySize(tags_node);
-    input_case->tags = (char **)calloc((size_t)tag_count, sizeof(char *));
-    if (!input_case->tags) {
+    input_case->tags = (char **)alloc_zeroed(arena, (size_t)tag_count, sizeof(char *));
+    if (!input_case->tags && tag_count > 0) {
         set_error(error, "failed to allocate tags array");
         return -1;
     }
+    /* tag_count only covers copied tags, so a failed case can be freed as it is. */
     for (int i = 0; i < tag_count; ++i) {
         const cJSON *tag = cJSON_GetArrayItem(tags_node, i);
         if (!cJSON_IsString(tag) || !tag->valuestring) {
             set_error(error, "tags must contain strings");
-            for (int j = 0; j < i; ++j) {
-                free(input_case->tags[j]);
-            }
-            free(input_case->tags);
-            input_case->tags = NULL;
-            input_case->tag_count = 0;
             return -1;
         }
-        input_case->tags[i] = strdup(tag->valuestring);
+        input_case->tags[i] = copy_string(arena, tag->valuestring);
+        if (!input_case->tags[i]) {
+            set_error(error, "failed to allocate tags array");
+            return -1;
+        }
+        input_case->tag_count = (size_t)i + 1;
     }
-    input_case->tag_count = (size_t)tag_count;
     return 0;
 }
 
-static int parse_config(const cJSON *config_node, EngineConfig *config, ValidationError *error) {
+static int parse_config(const cJSON *config_node, Arena *arena, EngineConfig *config, ValidationError *error) {
     memset(config, 0, sizeof(EngineConfig));
     if (!cJSON_IsObject(config_node)) {
         set_error(error, "config must be an object");
@@ -187,7 +197,11 @@ static int parse_config(const cJSON *config_node, EngineConfig *config, Validati
 
     const cJSON *loop_mode = cJSON_GetObjectItemCaseSensitive(config_node, "loopMode");
     if (cJSON_IsString(loop_mode) && loop_mode->valuestring) {
-        config->loop_mode = strdup(loop_mode->valuestring);
+        config->loop_mode = copy_string(arena, loop_mode->valuestring);
+        if (!config->loop_mode) {
+            set_error(error, "failed to allocate config.loopMode");
+            return -1;
+        }
     }
 
     const cJSON *variation_seed = cJSON_GetObjectItemCaseSensitive(config_node, "variationSeed");
@@ -211,7 +225,7 @@ static int parse_config(const cJSON *config_node, EngineConfig *config, Validati
     return 0;
 }
 
-static void free_input_case(InputCase *input_case) {
+void free_input_case(InputCase *input_case) {
     if (!input_case) {
         return;
     }
@@ -226,9 +240,11 @@ static void free_input_case(InputCase *input_case) {
     if (input_case->notes) {
         free(input_case->notes);
     }
+    /* Reset so freeing the case twice (e.g. after a failed parse) is harmless. */
+    memset(input_case, 0, sizeof(InputCase));
 }
 
-static int parse_input_case(const cJSON *node, InputCase *input_case, ValidationError *error) {
+static int parse_input_case(const cJSON *node, Arena *arena, InputCase *input_case, ValidationError *error) {
     memset(input_case, 0, sizeof(InputCase));
     const cJSON *id = cJSON_GetObjectItemCaseSensitive(node, "id");
     const cJSON *anchors = cJSON_GetObjectItemCaseSensitive(node, "anchors");
@@ -259,7 +275,7 @@ static int parse_input_case(const cJSON *node, InputCase *input_case, Validation
         goto fail;
     }
     input_case->anchor_count = (size_t)cJSON_GetArraySize(anchors);
-    input_case->anchors = (Anchor *)calloc(input_case->anchor_count, sizeof(Anchor));
+    input_case->anchors = (Anchor *)alloc_zeroed(arena, input_case->anchor_count, sizeof(Anchor));
     if (!input_case->anchors) {
         set_error(error, "failed to allocate anchors");
         goto fail;
@@ -271,7 +287,7 @@ static int parse_input_case(const cJSON *node, InputCase *input_case, Validation
         }
     }
 
-    if (parse_config(config, &input_case->config, error) != 0) {
+    if (parse_config(config, arena, &input_case->config, error) != 0) {
         goto fail;
     }
 
@@ -282,38 +298,127 @@ static int parse_input_case(const cJSON *node, InputCase *input_case, Validation
     input_case->seed = (uint64_t)seed->valuedouble;
 
     if (notes && cJSON_IsString(notes) && notes->valuestring) {
-        input_case->notes = strdup(notes->valuestring);
+        input_case->notes = copy_string(arena, notes->valuestring);
+        if (!input_case->notes) {
+            set_error(error, "failed to allocate notes");
+            goto fail;
+        }
     }
 
-    if (parse_tags(tags, input_case, error) != 0) {
+    if (parse_tags(tags, arena, input_case, error) != 0) {
         goto fail;
     }
 
     return 0;
 
 fail:
-    free_input_case(input_case);
+    /* Arena memory is reclaimed with the arena. */
+    if (arena) {
+        memset(input_case, 0, sizeof(InputCase));
+    } else {
+        free_input_case(input_case);
+    }
     return -1;
 }
 
-int parse_corpus_file(const char *path, Corpus *out, ValidationError *error) {
-    if (!path || !out) {
-        set_error(error, "invalid corpus arguments");
+int parse_input_case_json(const char *json, InputCase *out, ValidationError *error) {
+    if (!json || !out) {
+        set_error(error, "invalid input case arguments");
         return -1;
     }
-    long length = 0;
-    char *buffer = read_file_into_buffer(path, &length);
-    if (!buffer) {
-        set_error(error, "failed to read corpus file");
+    return parse_input_case_json_length(json, strlen(json), NULL, out, error);
+}
+
+int parse_input_case_json_length(const char *json, size_t length, Arena *arena, InputCase *out, ValidationError *error) {
+    if (!json || !out) {
+        set_error(error, "invalid input case arguments");
         return -1;
     }
-    cJSON *root = cJSON_Parse(buffer);
-    free(buffer);
+    Arena json_arena;
+    arena_init(&json_arena, length);
+    json_arena_begin(&json_arena);
+    cJSON *root = cJSON_ParseWithLength(json, length);
+    int status = -1;
     if (!root) {
-        set_error(error, "failed to parse corpus JSON");
-        return -1;
+        set_error(error, "failed to parse input case JSON");
+    } else {
+        status = parse_input_case(root, arena, out, error);
+        cJSON_Delete(root);
     }
+    json_arena_end();
+    arena_release(&json_arena);
+    return status;
+}
+
+/*
+ * Renders an InputCase as single-line JSON using the corpus case schema. Every
+ * field is emitted in a fixed order with its parsed value, so the output is a
+ * canonical form: parse_input_case_json() round-trips it exactly and equal cases
+ * always serialize to identical bytes.
+ */
+char *serialize_input_case(const InputCase *input_case) {
+    if (!input_case) {
+        return NULL;
+    }
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "id", input_case->id);
+    if (input_case->tag_count > 0) {
+        cJSON *tags = cJSON_AddArrayToObject(root, "tags");
+        for (size_t i = 0; i < input_case->tag_count; ++i) {
+            cJSON_AddItemToArray(tags, cJSON_CreateString(input_case->tags[i]));
+        }
+    }
+
+    cJSON *anchors = cJSON_AddArrayToObject(root, "anchors");
+    for (size_t i = 0; i < input_case->anchor_count; ++i) {
+        const Anchor *anchor = &input_case->anchors[i];
+        cJSON *entry = cJSON_CreateObject();
+        if (anchor->has_oklab) {
+            cJSON *oklab = cJSON_AddObjectToObject(entry, "oklab");
+            cJSON_AddNumberToObject(oklab, "l", anchor->oklab.l);
+            cJSON_AddNumberToObject(oklab, "a", anchor->oklab.a);
+            cJSON_AddNumberToObject(oklab, "b", anchor->oklab.b);
+        }
+        if (anchor->has_srgb) {
+            cJSON *rgb = cJSON_AddObjectToObject(entry, "rgb");
+            cJSON_AddNumberToObject(rgb, "r", anchor->srgb.r);
+            cJSON_AddNumberToObject(rgb, "g", anchor->srgb.g);
+            cJSON_AddNumberToObject(rgb, "b", anchor->srgb.b);
+        }
+        cJSON_AddItemToArray(anchors, entry);
+    }
+
+    const EngineConfig *config = &input_case->config;
+    cJSON *config_node = cJSON_AddObjectToObject(root, "config");
+    cJSON_AddNumberToObject(config_node, "count", (double)config->count);
+    cJSON_AddNumberToObject(config_node, "lightness", config->lightness);
+    cJSON_AddNumberToObject(config_node, "chroma", config->chroma);
+    cJSON_AddNumberToObject(config_node, "contrast", config->contrast);
+    cJSON_AddNumberToObject(config_node, "vibrancy", config->vibrancy);
+    cJSON_AddNumberToObject(config_node, "temperature", config->temperature);
+    if (config->loop_mode) {
+        cJSON_AddStringToObject(config_node, "loopMode", config->loop_mode);
+    }
+    if (config->has_variation_seed) {
+        cJSON_AddNumberToObject(config_node, "variationSeed", (double)config->variation_seed);
+    }
+
+    cJSON_AddNumberToObject(root, "seed", (double)input_case->seed);
+    cJSON_AddStringToObject(root, "corpusVersion", input_case->corpus_version);
+    if (input_case->notes) {
+        cJSON_AddStringToObject(root, "notes", input_case->notes);
+    }
+
+    char *rendered = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return rendered;
+}
+
+/* Fills `out` from a parsed corpus document; the caller owns `root`. */
+static int parse_corpus_root(const cJSON *root, size_t length, Corpus *out, ValidationError *error) {
     memset(out, 0, sizeof(Corpus));
+    /* The parsed cases take up roughly as much memory as their JSON text. */
+    arena_init(&out->arena, length);
 
     const cJSON *corpus_version = cJSON_GetObjectItemCaseSensitive(root, "corpusVersion");
     const cJSON *description = cJSON_GetObjectItemCaseSensitive(root, "description");
@@ -321,42 +426,69 @@ int parse_corpus_file(const char *path, Corpus *out, ValidationError *error) {
 
     if (!validate_corpus_version(corpus_version ? corpus_version->valuestring : NULL)) {
         set_error(error, "corpusVersion must match vYYYYMMDD.n");
-        cJSON_Delete(root);
         return -1;
     }
     strncpy(out->corpus_version, corpus_version->valuestring, MAX_VERSION_LENGTH - 1);
 
     if (description && cJSON_IsString(description) && description->valuestring) {
-        out->description = strdup(description->valuestring);
+        out->description = arena_strdup(&out->arena, description->valuestring);
     }
 
     if (!cJSON_IsArray(cases) || cJSON_GetArraySize(cases) == 0) {
         set_error(error, "cases must be a non-empty array");
-        cJSON_Delete(root);
+        free_corpus(out);
         return -1;
     }
 
     out->case_count = (size_t)cJSON_GetArraySize(cases);
-    out->cases = (InputCase *)calloc(out->case_count, sizeof(InputCase));
+    out->cases = (InputCase *)arena_calloc(&out->arena, out->case_count, sizeof(InputCase));
     if (!out->cases) {
         set_error(error, "failed to allocate cases");
-        cJSON_Delete(root);
+        free_corpus(out);
         return -1;
     }
-    for (size_t i = 0; i < out->case_count; ++i) {
-        const cJSON *case_node = cJSON_GetArrayItem(cases, (int)i);
-        if (parse_input_case(case_node, &out->cases[i], error) != 0) {
-            out->case_count = i + 1;
+    const cJSON *case_node = cases->child;
+    for (size_t i = 0; i < out->case_count; ++i, case_node = case_node->next) {
+        if (parse_input_case(case_node, &out->arena, &out->cases[i], error) != 0) {
             free_corpus(out);
-            cJSON_Delete(root);
             return -1;
         }
     }
-
-    cJSON_Delete(root);
     return 0;
 }
 
+int parse_corpus_file(const char *path, Corpus *out, ValidationError *error) {
+    if (!path || !out) {
+        set_error(error, "invalid corpus arguments");
+        return -1;
+    }
+    if (is_packed_corpus_file(path)) {
+        return parse_packed_corpus_file(path, out, error);
+    }
+    long length = 0;
+    char *buffer = read_file_into_buffer(path, &length);
+    if (!buffer) {
+        set_error(error, "failed to read corpus file");
+        return -1;
+    }
+    /* The document tree is only needed while the cases are copied out of it. */
+    Arena json_arena;
+    arena_init(&json_arena, (size_t)length);
+    json_arena_begin(&json_arena);
+    cJSON *root = cJSON_Parse(buffer);
+    free(buffer);
+    int status = -1;
+    if (!root) {
+        set_error(error, "failed to parse corpus JSON");
+    } else {
+        status = parse_corpus_root(root, (size_t)length, out, error);
+        cJSON_Delete(root);
+    }
+    json_arena_end();
+    arena_release(&json_arena);
+    return status;
+}
+
 static double parse_number_or_default(const cJSON *node, double default_value) {
     if (node && cJSON_IsNumber(node)) {
         return node->valuedouble;
@@ -382,6 +514,7 @@ int parse_tolerances_file(const char *path, ToleranceConfig *out, ValidationErro
         return -1;
     }
     memset(out, 0, sizeof(ToleranceConfig));
+    arena_init(&out->arena, 0);
 
     const cJSON *version = cJSON_GetObjectItemCaseSensitive(root, "toleranceVersion");
     const cJSON *description = cJSON_GetObjectItemCaseSensitive(root, "description");
@@ -397,11 +530,12 @@ int parse_tolerances_file(const char *path, ToleranceConfig *out, ValidationErro
     }
     strncpy(out->version, version->valuestring, MAX_VERSION_LENGTH - 1);
     if (description && cJSON_IsString(description) && description->valuestring) {
-        out->description = strdup(description->valuestring);
+        out->description = arena_strdup(&out->arena, description->valuestring);
     }
 
     if (!cJSON_IsObject(abs) || !cJSON_IsObject(rel)) {
         set_error(error, "abs and rel tolerance objects are required");
+        free_tolerances(out);
         cJSON_Delete(root);
         return -1;
     }
@@ -421,18 +555,18 @@ int parse_tolerances_file(const char *path, ToleranceConfig *out, ValidationErro
         }
         const cJSON *notes = cJSON_GetObjectItemCaseSensitive(policy, "notes");
         if (cJSON_IsString(notes) && notes->valuestring) {
-            out->policy_notes = strdup(notes->valuestring);
+            out->policy_notes = arena_strdup(&out->arena, notes->valuestring);
         }
     }
 
     if (provenance && cJSON_IsObject(provenance)) {
         const cJSON *source = cJSON_GetObjectItemCaseSensitive(provenance, "source");
         if (cJSON_IsString(source) && source->valuestring) {
-            out->provenance_source = strdup(source->valuestring);
+            out->provenance_source = arena_strdup(&out->arena, source->valuestring);
         }
         const cJSON *updated = cJSON_GetObjectItemCaseSensitive(provenance, "updated");
         if (cJSON_IsString(updated) && updated->valuestring) {
-            out->provenance_updated = strdup(updated->valuestring);
+            out->provenance_updated = arena_strdup(&out->arena, updated->valuestring);
         }
     }
 
@@ -444,13 +578,7 @@ void free_corpus(Corpus *corpus) {
     if (!corpus) {
         return;
     }
-    for (size_t i = 0; i < corpus->case_count; ++i) {
-        free_input_case(&corpus->cases[i]);
-    }
-    free(corpus->cases);
-    if (corpus->description) {
-        free(corpus->description);
-    }
+    arena_release(&corpus->arena);
     corpus->cases = NULL;
     corpus->description = NULL;
     corpus->case_count = 0;
@@ -460,10 +588,7 @@ void free_tolerances(ToleranceConfig *config) {
     if (!config) {
         return;
     }
-    free(config->description);
-    free(config->policy_notes);
-    free(config->provenance_source);
-    free(config->provenance_updated);
+    arena_release(&config->arena);
     config->description = NULL;
     config->policy_notes = NULL;
     config->provenance_source = NULL;
@@ -0,0 +1,159 @@
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "types.h"
+
+/*
+ * JSON writing without a cJSON tree, for documents that grow with the run
+ * (report.json, per-case artifacts). Values go straight to a stdio stream in
+ * exactly the bytes cJSON would print: cJSON_PrintUnformatted() when the
+ * writer has no indent, cJSON_Print() with the indent character in place of
+ * each tab otherwise. Readers and tests therefore cannot tell the two apart.
+ */
+
+void json_writer_init(JsonWriter *w, FILE *file, char indent) {
+    memset(w, 0, sizeof(JsonWriter));
+    w->file = file;
+    w->indent = indent;
+}
+
+static void write_indent(JsonWriter *w, size_t depth) {
+    for (size_t i = 0; i < depth; ++i) {
+        putc(w->indent, w->file);
+    }
+}
+
+/* cJSON's print_string_ptr: short escapes where JSON has them, \u00XX for other control bytes. */
+static void write_quoted(JsonWriter *w, const char *text) {
+    FILE *file = w->file;
+    putc('"', file);
+    for (const unsigned char *p = (const unsigned char *)(text ? text : ""); *p; ++p) {
+        switch (*p) {
+            case '"': fputs("\\\"", file); break;
+            case '\\': fputs("\\\\", file); break;
+            case '\b': fputs("\\b", file); break;
+            case '\f': fputs("\\f", file); break;
+            case '\n': fputs("\\n", file); break;
+            case '\r': fputs("\\r", file); break;
+            case '\t': fputs("\\t", file); break;
+            default:
+                if (*p < 32) {
+                    fprintf(file, "\\u%04x", *p);
+                } else {
+                    putc(*p, file);
+                }
+        }
+    }
+    putc('"', file);
+}
+
+/* Separator, indentation and key before a value; key is NULL inside arrays and at the top level. */
+static void begin_value(JsonWriter *w, const char *key) {
+    if (w->depth == 0) {
+        return;
+    }
+    const size_t top = w->depth - 1;
+    if (w->is_array[top]) {
+        if (!w->empty[top]) {
+            fputs(w->indent ? ", " : ",", w->file);
+        }
+    } else {
+        if (w->indent) {
+            fputs(w->empty[top] ? "\n" : ",\n", w->file);
+            write_indent(w, w->depth);
+        } else if (!w->empty[top]) {
+            putc(',', w->file);
+        }
+        write_quoted(w, key);
+        putc(':', w->file);
+        if (w->indent) {
+            putc(w->indent, w->file);
+        }
+    }
+    w->empty[top] = false;
+}
+
+static void begin_container(JsonWriter *w, const char *key, bool is_array) {
+    begin_value(w, key);
+    if (w->depth == JSON_WRITER_MAX_DEPTH) {
+        w->failed = true;
+        return;
+    }
+    putc(is_array ? '[' : '{', w->file);
+    w->is_array[w->depth] = is_array;
+    w->empty[w->depth] = true;
+    w->depth++;
+}
+
+void json_begin_object(JsonWriter *w, const char *key) {
+    begin_container(w, key, false);
+}
+
+void json_end_object(JsonWriter *w) {
+    if (w->depth == 0 || w->is_array[w->depth - 1]) {
+        w->failed = true;
+        return;
+    }
+    if (w->indent) {
+        putc('\n', w->file);
+        write_indent(w, w->depth - 1);
+    }
+    putc('}', w->file);
+    w->depth--;
+}
+
+void json_begin_array(JsonWriter *w, const char *key) {
+    begin_container(w, key, true);
+}
+
+void json_end_array(JsonWriter *w) {
+    if (w->depth == 0 || !w->is_array[w->depth - 1]) {
+        w->failed = true;
+        return;
+    }
+    putc(']', w->file);
+    w->depth--;
+}
+
+/* cJSON's print_number: integers as %d, else the shortest of %1.15g and %1.17g that reads back. */
+void json_write_number(JsonWriter *w, const char *key, double value) {
+    begin_value(w, key);
+    if (isnan(value) || isinf(value)) {
+        fputs("null", w->file);
+        return;
+    }
+    const int as_int = value >= INT_MAX ? INT_MAX : value <= (double)INT_MIN ? INT_MIN : (int)value;
+    if (value == (double)as_int) {
+        fprintf(w->file, "%d", as_int);
+        return;
+    }
+    char text[32];
+    double parsed = 0.0;
+    snprintf(text, sizeof(text), "%1.15g", value);
+    const double scale = fabs(value);
+    if (sscanf(text, "%lg", &parsed) != 1 || !(fabs(parsed - value) <= fmax(fabs(parsed), scale) * DBL_EPSILON)) {
+        snprintf(text, sizeof(text), "%1.17g", value);
+    }
+    fputs(text, w->file);
+}
+
+void json_write_string(JsonWriter *w, const char *key, const char *value) {
+    begin_value(w, key);
+    write_quoted(w, value);
+}
+
+void json_write_bool(JsonWriter *w, const char *key, bool value) {
+    begin_value(w, key);
+    fputs(value ? "true" : "false", w->file);
+}
+
+/* 0 once every container is closed and the stream took every byte so far. */
+int json_writer_finish(JsonWriter *w) {
+    if (fflush(w->file) != 0 || ferror(w->file)) {
+        w->failed = true;
+    }
+    return w->failed || w->depth != 0 ? -1 : 0;
+}
@@ -0,0 +1,415 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "types.h"
+
+/*
+ * Engine process launcher. Runners are started directly from an argv vector
+ * (no /bin/sh), their stdout is read in large chunks into a buffer presized by
+ * the caller, and every wait is bounded by an optional deadline so a hung
+ * engine is killed instead of consuming the run's whole duration budget.
+ */
+
+extern char **environ;
+
+#define MAX_DRAINED_PROCESSES 2
+#define MIN_READ_SPACE 1024
+#define DEFAULT_OUTPUT_CAPACITY 4096
+
+/* Serializes pipe creation and spawning so concurrent workers never inherit each other's pipe ends. */
+static pthread_mutex_t spawn_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void set_error(ValidationError *error, const char *message) {
+    if (!error || !message) {
+        return;
+    }
+    free(error->message);
+    size_t len = strlen(message);
+    error->message = (char *)malloc(len + 1);
+    if (error->message) {
+        memcpy(error->message, message, len + 1);
+    }
+}
+
+double launcher_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1.0e6;
+}
+
+static int set_cloexec(int fd) {
+    const int flags = fcntl(fd, F_GETFD);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
+}
+
+static int open_pipe(int fds[2]) {
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    set_cloexec(fds[0]);
+    set_cloexec(fds[1]);
+    return 0;
+}
+
+static void close_pipe(int fds[2]) {
+    if (fds[0] >= 0) {
+        close(fds[0]);
+    }
+    if (fds[1] >= 0) {
+        close(fds[1]);
+    }
+}
+
+static int has_limits(const LaunchLimits *limits) {
+    return limits && (limits->memory_limit_mb > 0 || limits->cpu_limit_s > 0);
+}
+
+/* Lowers one resource limit for the calling (child) process, never above the inherited hard limit. */
+static int lower_limit(int resource, rlim_t soft, rlim_t hard) {
+    struct rlimit current;
+    if (getrlimit(resource, &current) != 0) {
+        return -1;
+    }
+    struct rlimit next;
+    next.rlim_max = (current.rlim_max != RLIM_INFINITY && current.rlim_max < hard) ? current.rlim_max : hard;
+    next.rlim_cur = soft < next.rlim_max ? soft : next.rlim_max;
+    return setrlimit(resource, &next);
+}
+
+/*
+ * posix_spawn has no portable attribute for resource limits, so limited launches
+ * fork, apply RLIMIT_AS / RLIMIT_CPU in the child and exec the same argv.
+ * RLIMIT_CPU gets one second of grace between SIGXCPU and SIGKILL.
+ */
+static pid_t fork_with_limits(char *const argv[], int stdin_fd, int stdout_fd, const LaunchLimits *limits) {
+    const pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+
+    if ((stdin_fd >= 0 && dup2(stdin_fd, STDIN_FILENO) < 0) || dup2(stdout_fd, STDOUT_FILENO) < 0) {
+        _exit(126);
+    }
+    if (limits->memory_limit_mb > 0) {
+        const rlim_t bytes = (rlim_t)limits->memory_limit_mb * 1024u * 1024u;
+        if (lower_limit(RLIMIT_AS, bytes, bytes) != 0) {
+            _exit(126);
+        }
+    }
+    if (limits->cpu_limit_s > 0) {
+        const rlim_t seconds = (rlim_t)limits->cpu_limit_s;
+        if (lower_limit(RLIMIT_CPU, seconds, seconds + 1) != 0) {
+            _exit(126);
+        }
+    }
+    execvp(argv[0], argv);
+    _exit(127);
+}
+
+static int spawn_direct(char *const argv[], int stdin_fd, int stdout_fd, pid_t *pid) {
+    posix_spawn_file_actions_t actions;
+    int status = posix_spawn_file_actions_init(&actions);
+    if (status != 0) {
+        return status;
+    }
+    if (stdin_fd >= 0) {
+        status = posix_spawn_file_actions_adddup2(&actions, stdin_fd, STDIN_FILENO);
+    }
+    if (status == 0) {
+        status = posix_spawn_file_actions_adddup2(&actions, stdout_fd, STDOUT_FILENO);
+    }
+    if (status == 0) {
+        status = posix_spawnp(pid, argv[0], &actions, NULL, argv, environ);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    return status;
+}
+
+int launch_process(char *const argv[],
+                   int pipe_stdin,
+                   const LaunchLimits *limits,
+                   size_t output_hint,
+                   LaunchedProcess *process,
+                   ValidationError *error) {
+    if (!argv || !argv[0] || !process) {
+        set_error(error, "invalid launch arguments");
+        return -1;
+    }
+    memset(process, 0, sizeof(LaunchedProcess));
+    process->pid = -1;
+    process->stdin_fd = -1;
+    process->stdout_fd = -1;
+
+    process->output_capacity = output_hint > DEFAULT_OUTPUT_CAPACITY ? output_hint : DEFAULT_OUTPUT_CAPACITY;
+    process->output = (char *)malloc(process->output_capacity);
+    if (!process->output) {
+        set_error(error, "failed to allocate output buffer");
+        return -1;
+    }
+    process->output[0] = '\0';
+
+    if (pipe_stdin) {
+        /* A runner that dies mid-request must surface as a write error, not kill the harness. */
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    int input_pipe[2] = {-1, -1};
+    int output_pipe[2] = {-1, -1};
+    pthread_mutex_lock(&spawn_lock);
+    if ((pipe_stdin && open_pipe(input_pipe) != 0) || open_pipe(output_pipe) != 0) {
+        pthread_mutex_unlock(&spawn_lock);
+        close_pipe(input_pipe);
+        free(process->output);
+        process->output = NULL;
+        set_error(error, "failed to create runner pipes");
+        return -1;
+    }
+
+    pid_t pid = -1;
+    int spawn_status = 0;
+    if (has_limits(limits)) {
+        pid = fork_with_limits(argv, input_pipe[0], output_pipe[1], limits);
+        spawn_status = pid < 0 ? errno : 0;
+    } else {
+        spawn_status = spawn_direct(argv, input_pipe[0], output_pipe[1], &pid);
+    }
+    pthread_mutex_unlock(&spawn_lock);
+
+    if (input_pipe[0] >= 0) {
+        close(input_pipe[0]);
+    }
+    close(output_pipe[1]);
+    if (spawn_status != 0) {
+        if (input_pipe[1] >= 0) {
+            close(input_pipe[1]);
+        }
+        close(output_pipe[0]);
+        free(process->output);
+        process->output = NULL;
+        char message[MAX_ERROR_MESSAGE];
+        snprintf(message, sizeof(message), "failed to start %s: %s", argv[0], strerror(spawn_status));
+        set_error(error, message);
+        return -1;
+    }
+
+    process->pid = pid;
+    process->stdin_fd = input_pipe[1];
+    process->stdout_fd = output_pipe[0];
+    process->started_ms = launcher_now_ms();
+    return 0;
+}
+
+static int reserve_output(LaunchedProcess *process) {
+    if (process->output_capacity - process->output_length > MIN_READ_SPACE) {
+        return 0;
+    }
+    size_t capacity = process->output_capacity;
+    while (capacity - process->output_length <= MIN_READ_SPACE) {
+        capacity *= 2;
+    }
+    char *tmp = (char *)realloc(process->output, capacity);
+    if (!tmp) {
+        return -1;
+    }
+    process->output = tmp;
+    process->output_capacity = capacity;
+    return 0;
+}
+
+static int has_response(LaunchedProcess *process) {
+    if (process->binary_frames) {
+        const size_t frame_size = engine_frame_size(process->output, process->output_length);
+        return frame_size > 0 && process->output_length >= frame_size;
+    }
+    if (process->output_length > process->scanned &&
+        memchr(process->output + process->scanned, '\n', process->output_length - process->scanned)) {
+        return 1;
+    }
+    process->scanned = process->output_length;
+    return 0;
+}
+
+static void mark_complete(LaunchedProcess *process) {
+    process->complete = 1;
+    process->finished_ms = launcher_now_ms();
+}
+
+int drain_processes(LaunchedProcess *processes,
+                    size_t count,
+                    int until_response,
+                    double deadline_ms,
+                    size_t *failed,
+                    ValidationError *error) {
+    struct pollfd fds[MAX_DRAINED_PROCESSES];
+    size_t owners[MAX_DRAINED_PROCESSES];
+
+    if (count > MAX_DRAINED_PROCESSES) {
+        set_error(error, "too many processes to drain");
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (until_response && !processes[i].complete && has_response(&processes[i])) {
+            mark_complete(&processes[i]);
+        }
+    }
+
+    for (;;) {
+        nfds_t active = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (!processes[i].complete) {
+                fds[active].fd = processes[i].stdout_fd;
+                fds[active].events = POLLIN;
+                fds[active].revents = 0;
+                owners[active++] = i;
+            }
+        }
+        if (active == 0) {
+            return 0;
+        }
+
+        int wait_ms = -1;
+        if (deadline_ms > 0.0) {
+            const double remaining = deadline_ms - launcher_now_ms();
+            if (remaining <= 0.0) {
+                *failed = owners[0];
+                set_error(error, "engine exceeded the case timeout");
+                return -1;
+            }
+            wait_ms = (int)remaining + 1;
+        }
+
+        const int ready = poll(fds, active, wait_ms);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            *failed = owners[0];
+            set_error(error, "failed to poll runner output");
+            return -1;
+        }
+
+        for (nfds_t p = 0; p < active; ++p) {
+            if (fds[p].revents == 0) {
+                continue;
+            }
+            LaunchedProcess *process = &processes[owners[p]];
+            if (reserve_output(process) != 0) {
+                *failed = owners[p];
+                set_error(error, "failed to grow output buffer");
+                return -1;
+            }
+            const ssize_t received = read(process->stdout_fd,
+                                          process->output + process->output_length,
+                                          process->output_capacity - process->output_length - 1);
+            if (received < 0) {
+                if (errno == EINTR || errno == EAGAIN) {
+                    continue;
+                }
+                *failed = owners[p];
+                set_error(error, "failed to read runner output");
+                return -1;
+            }
+            if (received == 0) {
+                process->eof = 1;
+            }
+            process->output_length += (size_t)received;
+            process->output[process->output_length] = '\0';
+
+            if (until_response ? has_response(process) : process->eof) {
+                mark_complete(process);
+            } else if (process->eof) {
+                *failed = owners[p];
+                set_error(error, "engine server closed its output");
+                return -1;
+            }
+        }
+    }
+}
+
+char *take_process_response(LaunchedProcess *process, size_t *length, ValidationError *error) {
+    size_t response_length = 0;
+    size_t consumed = 0;
+    if (process->binary_frames) {
+        response_length = engine_frame_size(process->output, process->output_length);
+        consumed = response_length;
+        if (response_length == 0 || response_length > process->output_length) {
+            set_error(error, "engine server response is incomplete");
+            return NULL;
+        }
+    } else {
+        const char *newline = (const char *)memchr(process->output, '\n', process->output_length);
+        if (!newline) {
+            set_error(error, "engine server response is incomplete");
+            return NULL;
+        }
+        response_length = (size_t)(newline - process->output);
+        consumed = response_length + 1;
+    }
+    char *response = (char *)malloc(response_length + 1);
+    if (!response) {
+        set_error(error, "failed to allocate engine response");
+        return NULL;
+    }
+    memcpy(response, process->output, response_length);
+    response[response_length] = '\0';
+    *length = response_length;
+    process->output_length -= consumed;
+    memmove(process->output, process->output + consumed, process->output_length);
+    process->output[process->output_length] = '\0';
+    process->scanned = 0;
+    process->complete = 0;
+    return response;
+}
+
+int reap_process(LaunchedProcess *process, int terminate, ValidationError *error) {
+    if (!process || process->pid < 0) {
+        return 0;
+    }
+    if (process->stdin_fd >= 0) {
+        close(process->stdin_fd);
+        process->stdin_fd = -1;
+    }
+    if (terminate) {
+        kill(process->pid, SIGKILL);
+    }
+    close(process->stdout_fd);
+    process->stdout_fd = -1;
+
+    int status = 0;
+    while (waitpid(process->pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            process->pid = -1;
+            set_error(error, "failed to wait for runner process");
+            return -1;
+        }
+    }
+    process->pid = -1;
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        return 0;
+    }
+    char message[MAX_ERROR_MESSAGE];
+    if (WIFSIGNALED(status)) {
+        snprintf(message, sizeof(message), "runner process terminated by signal %d", WTERMSIG(status));
+    } else if (WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+        snprintf(message, sizeof(message), "runner process could not be executed");
+    } else {
+        snprintf(message, sizeof(message), "runner process exited with failure");
+    }
+    set_error(error, message);
+    return -1;
+}
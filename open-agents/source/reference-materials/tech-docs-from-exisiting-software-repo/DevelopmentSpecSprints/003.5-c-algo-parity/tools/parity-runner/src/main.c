@@ -1,8 +1,11 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "types.h"
 #include "../stats/stats.h"
@@ -13,6 +16,61 @@ typedef enum {
     ARTIFACT_POLICY_NONE
 } ArtifactPolicy;
 
+typedef struct {
+    char *c_build_flags;
+    char *alt_build_flags;
+    const char *failed_stage;
+    char fingerprint[FINGERPRINT_LENGTH + 1];
+    bool carried_over; /* result reused from the --since report; nothing to execute */
+} CaseSlot;
+
+/* How one side of the comparison produces its EngineOutput. */
+typedef struct {
+    const char *label;
+    const char *runner_path;
+    int is_canonical;
+    EnginePlugin *plugin;       /* --c-engine-so / --alt-engine-so */
+    EngineServer **servers;     /* --engine-server: one persistent session per worker */
+} EngineBackend;
+
+typedef struct {
+    const Corpus *corpus;
+    const size_t *case_indices;
+    const ToleranceConfig *tolerance;
+    const char *corpus_path;
+    const char *artifacts_root;
+    ArtifactPolicy artifact_policy;
+    ComparisonResult *results;
+    CaseSlot *slots;
+    EngineBackend canonical;
+    EngineBackend alternate;
+    LaunchLimits limits;        /* --case-timeout-ms, --engine-memory-mb, --engine-cpu-seconds */
+    EngineFormat engine_format; /* --engine-format */
+    OutputCache *cache;         /* --cache-dir: canonical outputs from earlier runs */
+    size_t repeat;              /* --repeat: timed trials per case */
+    size_t warmup;              /* --warmup: untimed trials per case */
+    double outlier_mad;         /* --outlier-mad */
+    RunAccumulator *accumulators; /* one per worker, filled by the fused compare pass */
+} CaseRunContext;
+
+typedef struct {
+    TrialStats canonical;
+    TrialStats alternate;
+    unsigned nondeterministic;
+} CaseTrials;
+
+static void set_error(ValidationError *error, const char *message) {
+    if (!error || !message) {
+        return;
+    }
+    free(error->message);
+    size_t len = strlen(message);
+    error->message = (char *)malloc(len + 1);
+    if (error->message) {
+        memcpy(error->message, message, len + 1);
+    }
+}
+
 static const char *artifact_policy_to_string(ArtifactPolicy policy) {
     switch (policy) {
         case ARTIFACT_POLICY_ALL: return "all";
@@ -22,27 +80,19 @@ static const char *artifact_policy_to_string(ArtifactPolicy policy) {
     }
 }
 
-static int case_has_tag(const InputCase *input_case, const char **tags, size_t tag_count) {
-    if (!input_case || !tags || tag_count == 0) {
-        return 1;
-    }
-    for (size_t i = 0; i < input_case->tag_count; ++i) {
-        for (size_t j = 0; j < tag_count; ++j) {
-            if (strcmp(input_case->tags[i], tags[j]) == 0) {
-                return 1;
-            }
-        }
-    }
-    return 0;
-}
-
 static void print_usage(void) {
     printf("Usage: parity-runner --corpus <file> --tolerances <file> [--artifacts <dir>]\\n");
     printf("       [--cases <id1,id2>] [--tags <tag1,tag2>] [--c-runner <path>] [--alt-runner <path>]\\n");
     printf("       [--run-id <id>] [--c-commit <hash>] [--wasm-commit <hash>]\\n");
-    printf("       [--pass-gate <0-1>] [--max-duration-ms <ms>] [--platform <name>]\\n");
+    printf("       [--pass-gate <0-1>] [--max-duration-ms <ms>] [--max-slowdown <ratio>]\\n");
+    printf("       [--platform <name>]\\n");
     printf("       [--tolerance-deltaE <val>] [--tolerance-l <val>] [--tolerance-a <val>] [--tolerance-b <val>]\\n");
-    printf("       [--artifact-policy all|failures|none]\\n");
+    printf("       [--artifact-policy all|failures|none] [--jobs <n>] [--engine-server]\\n");
+    printf("       [--c-engine-so <plugin>] [--alt-engine-so <plugin>]\\n");
+    printf("       [--case-timeout-ms <ms>] [--engine-memory-mb <mb>] [--engine-cpu-seconds <s>]\\n");
+    printf("       [--cache-dir <dir>] [--since <report.json>] [--engine-format json|bin]\\n");
+    printf("       [--repeat <n>] [--warmup <k>] [--outlier-mad <k>] [--shard <i>/<n>]\\n");
+    printf("       [--select <expr>] [--stats exact|streaming] [--percentiles <p1,p2,...>]\\n");
 }
 
 static const char *detect_platform(void) {
@@ -57,6 +107,21 @@ static const char *detect_platform(void) {
 #endif
 }
 
+static double monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1.0e6;
+}
+
+static size_t resolve_job_count(long requested) {
+    if (requested > 0) {
+        return (size_t)requested;
+    }
+    /* --jobs 0 selects one worker per online CPU */
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return online > 0 ? (size_t)online : 1;
+}
+
 static int is_selected_case(const char *id, char **filters, size_t filter_count) {
     if (filter_count == 0 || !filters) {
         return 1;
@@ -108,24 +173,378 @@ static void free_case_filters(char **filters, size_t count) {
     free(filters);
 }
 
-static InputCase *find_input_case(const Corpus *corpus, const char *id) {
-    if (!corpus || !id) {
-        return NULL;
+static int entry_has_tag(const CorpusIndex *index, const CorpusIndexEntry *entry, const char **tags, size_t tag_count) {
+    if (!tags || tag_count == 0) {
+        return 1;
+    }
+    for (size_t j = 0; j < tag_count; ++j) {
+        if (corpus_entry_has_tag(index, entry, tags[j])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int compare_case_positions(const void *a, const void *b) {
+    const size_t left = *(const size_t *)a;
+    const size_t right = *(const size_t *)b;
+    return left < right ? -1 : (left > right ? 1 : 0);
+}
+
+/* Same selection from a packed corpus: --cases ids resolve through its hash index instead of a scan. */
+static int load_selected_packed_corpus(const char *path, char **filters, size_t filter_count, const char **tags,
+                                       size_t tag_count, Corpus *out, ValidationError *error) {
+    PackedCorpus packed;
+    if (open_packed_corpus(path, &packed, error) != 0) {
+        return -1;
+    }
+    size_t *cases = (size_t *)calloc(filter_count > 0 ? filter_count : packed.case_count, sizeof(size_t));
+    if (!cases) {
+        close_packed_corpus(&packed);
+        set_error(error, "failed to allocate cases");
+        return -1;
+    }
+    size_t selected = 0;
+    if (filter_count > 0) {
+        for (size_t i = 0; i < filter_count; ++i) {
+            size_t found = 0;
+            if (packed_corpus_find(&packed, filters[i], &found) == 0) {
+                cases[selected++] = found;
+            }
+        }
+        /* Run in corpus order, once per case, as a scan would. */
+        qsort(cases, selected, sizeof(size_t), compare_case_positions);
+        size_t unique = 0;
+        for (size_t i = 0; i < selected; ++i) {
+            if (unique == 0 || cases[unique - 1] != cases[i]) {
+                cases[unique++] = cases[i];
+            }
+        }
+        selected = unique;
+    } else {
+        for (size_t i = 0; i < packed.case_count; ++i) {
+            cases[selected++] = i;
+        }
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < selected; ++i) {
+        int tagged = !tags || tag_count == 0;
+        for (size_t j = 0; !tagged && j < tag_count; ++j) {
+            tagged = packed_case_has_tag(&packed, cases[i], tags[j]);
+        }
+        if (tagged) {
+            cases[kept++] = cases[i];
+        }
+    }
+    const int status = load_packed_cases(&packed, cases, kept, out, error);
+    free(cases);
+    close_packed_corpus(&packed);
+    return status;
+}
+
+/* Indexes the corpus and parses only the cases that pass --cases/--tags, in corpus order. */
+static int load_selected_corpus(const char *path, char **filters, size_t filter_count, const char **tags,
+                                size_t tag_count, Corpus *out, ValidationError *error) {
+    if (is_packed_corpus_file(path)) {
+        return load_selected_packed_corpus(path, filters, filter_count, tags, tag_count, out, error);
+    }
+    CorpusIndex index;
+    if (open_corpus_index(path, &index, error) != 0) {
+        return -1;
+    }
+    size_t *entries = (size_t *)calloc(index.entry_count, sizeof(size_t));
+    if (!entries) {
+        close_corpus_index(&index);
+        set_error(error, "failed to allocate cases");
+        return -1;
     }
-    for (size_t i = 0; i < corpus->case_count; ++i) {
-        if (strcmp(corpus->cases[i].id, id) == 0) {
-            return &corpus->cases[i];
+    size_t selected = 0;
+    for (size_t i = 0; i < index.entry_count; ++i) {
+        if (is_selected_case(index.entries[i].id, filters, filter_count) &&
+            entry_has_tag(&index, &index.entries[i], tags, tag_count)) {
+            entries[selected++] = i;
         }
     }
-    return NULL;
+    const int status = load_indexed_cases(&index, entries, selected, out, error);
+    free(entries);
+    close_corpus_index(&index);
+    return status;
+}
+
+/* Combines both engine files into one hash so fingerprints change when either engine is rebuilt. */
+static int hash_engines(const char *canonical_path, const char *alternate_path, uint64_t *out) {
+    uint64_t canonical_hash = 0;
+    uint64_t alternate_hash = 0;
+    if (fnv1a64_file(canonical_path, &canonical_hash) != 0 || fnv1a64_file(alternate_path, &alternate_hash) != 0) {
+        return -1;
+    }
+    *out = fnv1a64(fnv1a64(FNV1A64_OFFSET_BASIS, &canonical_hash, sizeof(canonical_hash)),
+                   &alternate_hash, sizeof(alternate_hash));
+    return 0;
+}
+
+/*
+ * Starting a session counts towards the spawn phase of the case that needed it.
+ * A session that failed or timed out is out of step with its requests, so it is
+ * replaced rather than reused.
+ */
+static int ensure_engine_server(const CaseRunContext *ctx,
+                                const EngineBackend *backend,
+                                size_t worker,
+                                CaseTiming *timing,
+                                ValidationError *error) {
+    if (backend->servers[worker] && !engine_server_failed(backend->servers[worker])) {
+        return 0;
+    }
+    stop_engine_server(backend->servers[worker]);
+    backend->servers[worker] = NULL;
+    const double start_ms = monotonic_ms();
+    backend->servers[worker] = start_engine_server(backend->runner_path, &ctx->limits, ctx->engine_format, error);
+    timing->spawn_ms += monotonic_ms() - start_ms;
+    return backend->servers[worker] ? 0 : -1;
+}
+
+static int run_engine_backend(const CaseRunContext *ctx,
+                              const EngineBackend *backend,
+                              size_t worker,
+                              const InputCase *input_case,
+                              EngineOutput *out,
+                              CaseTiming *timing,
+                              ValidationError *error) {
+    if (backend->plugin) {
+        /* In-process engines have no spawn or decode step; the whole call is engine time. */
+        const double start_ms = monotonic_ms();
+        const int status = run_engine_plugin(backend->plugin, input_case, out, error);
+        timing->wait_ms += monotonic_ms() - start_ms;
+        return status;
+    }
+    if (backend->servers) {
+        if (ensure_engine_server(ctx, backend, worker, timing, error) != 0) {
+            return -1;
+        }
+        return engine_server_run_case(backend->servers[worker], input_case, out, timing, error);
+    }
+    return backend->is_canonical
+               ? run_c_engine(backend->runner_path, ctx->corpus_path, input_case, &ctx->limits, ctx->engine_format,
+                              out, timing, error)
+               : run_alt_engine(backend->runner_path, ctx->corpus_path, input_case, &ctx->limits, ctx->engine_format,
+                                out, timing, error);
+}
+
+/*
+ * Runs the canonical and alternate engines for a case. When both are external
+ * processes (one-shot runners or server sessions) they run concurrently and the
+ * comparison only starts once both have finished; in-process plugins run in turn.
+ */
+static int run_case_engines(const CaseRunContext *ctx,
+                            size_t worker,
+                            const InputCase *input_case,
+                            EngineOutput *canonical,
+                            EngineOutput *alternate,
+                            CaseSlot *slot,
+                            CaseTiming *timing,
+                            ValidationError *error) {
+    const EngineBackend *backends[2] = {&ctx->canonical, &ctx->alternate};
+    size_t failed = 0;
+    int status;
+
+    const double lookup_ms = monotonic_ms();
+    const int cached = ctx->cache && output_cache_load(ctx->cache, input_case, canonical);
+    timing->parse_ms += monotonic_ms() - lookup_ms;
+    if (cached) {
+        /* A cache hit leaves only the alternate engine to run. */
+        failed = 1;
+        status = run_engine_backend(ctx, &ctx->alternate, worker, input_case, alternate, timing, error);
+        if (status != 0) {
+            slot->failed_stage = backends[failed]->label;
+        }
+        return status;
+    }
+
+    if (!ctx->canonical.plugin && !ctx->alternate.plugin && ctx->canonical.servers && ctx->alternate.servers) {
+        if (ensure_engine_server(ctx, &ctx->canonical, worker, timing, error) != 0) {
+            status = -1;
+        } else if (ensure_engine_server(ctx, &ctx->alternate, worker, timing, error) != 0) {
+            failed = 1;
+            status = -1;
+        } else {
+            status = engine_server_run_pair(ctx->canonical.servers[worker], ctx->alternate.servers[worker],
+                                            input_case, canonical, alternate, &failed, timing, error);
+        }
+    } else if (!ctx->canonical.plugin && !ctx->alternate.plugin && !ctx->canonical.servers && !ctx->alternate.servers) {
+        status = run_engine_pair(ctx->canonical.runner_path, ctx->alternate.runner_path, ctx->corpus_path,
+                                 input_case, &ctx->limits, ctx->engine_format, canonical, alternate, &failed, timing,
+                                 error);
+    } else {
+        status = run_engine_backend(ctx, &ctx->canonical, worker, input_case, canonical, timing, error);
+        if (status == 0) {
+            failed = 1;
+            status = run_engine_backend(ctx, &ctx->alternate, worker, input_case, alternate, timing, error);
+        }
+    }
+
+    if (status != 0) {
+        slot->failed_stage = backends[failed]->label;
+        return status;
+    }
+
+    if (ctx->cache && output_cache_store(ctx->cache, input_case, canonical, error) != 0) {
+        fprintf(stderr, "Failed to cache canonical output for case %s: %s\n",
+                input_case->id, error->message ? error->message : "unknown error");
+    }
+    return 0;
+}
+
+static void release_engine_backend(EngineBackend *backend, size_t worker_count) {
+    for (size_t i = 0; backend->servers && i < worker_count; ++i) {
+        if (stop_engine_server(backend->servers[i]) != 0) {
+            fprintf(stderr, "%s server exited with failure\n", backend->label);
+        }
+    }
+    free(backend->servers);
+    backend->servers = NULL;
+    unload_engine_plugin(backend->plugin);
+    backend->plugin = NULL;
+}
+
+/*
+ * Runs the warmup and timed trials of a case. The first trial's outputs are
+ * kept for comparison; every later trial must reproduce them bit for bit.
+ * Only a single trial leaves *trials zeroed.
+ */
+static int run_case_trials(const CaseRunContext *ctx,
+                           size_t worker,
+                           const InputCase *input_case,
+                           EngineOutput *canonical,
+                           EngineOutput *alternate,
+                           CaseSlot *slot,
+                           CaseTiming *timing,
+                           CaseTrials *trials,
+                           ValidationError *error) {
+    memset(trials, 0, sizeof(CaseTrials));
+    if (run_case_engines(ctx, worker, input_case, canonical, alternate, slot, timing, error) != 0) {
+        return -1;
+    }
+    const size_t total = ctx->warmup + ctx->repeat;
+    if (total <= 1) {
+        return 0;
+    }
+
+    double *durations = (double *)malloc(2 * ctx->repeat * sizeof(double));
+    if (!durations) {
+        set_error(error, "failed to allocate trial durations");
+        return -1;
+    }
+    double *canonical_ms = durations;
+    double *alternate_ms = durations + ctx->repeat;
+    if (ctx->warmup == 0) {
+        canonical_ms[0] = canonical->duration_ms;
+        alternate_ms[0] = alternate->duration_ms;
+    }
+
+    for (size_t trial = 1; trial < total; ++trial) {
+        EngineOutput canonical_trial = {0};
+        EngineOutput alternate_trial = {0};
+        if (run_case_engines(ctx, worker, input_case, &canonical_trial, &alternate_trial, slot, timing, error) != 0) {
+            free_engine_output(&canonical_trial);
+            free_engine_output(&alternate_trial);
+            free(durations);
+            return -1;
+        }
+        if (!engine_outputs_identical(canonical, &canonical_trial)) {
+            trials->nondeterministic |= NONDETERMINISTIC_CANONICAL;
+        }
+        if (!engine_outputs_identical(alternate, &alternate_trial)) {
+            trials->nondeterministic |= NONDETERMINISTIC_ALTERNATE;
+        }
+        if (trial >= ctx->warmup) {
+            canonical_ms[trial - ctx->warmup] = canonical_trial.duration_ms;
+            alternate_ms[trial - ctx->warmup] = alternate_trial.duration_ms;
+        }
+        free_engine_output(&canonical_trial);
+        free_engine_output(&alternate_trial);
+    }
+
+    summarize_trials(canonical_ms, ctx->repeat, ctx->outlier_mad, &trials->canonical);
+    summarize_trials(alternate_ms, ctx->repeat, ctx->outlier_mad, &trials->alternate);
+    free(durations);
+    return 0;
+}
+
+/* Runs both engines for one selected case; executed on a pool worker. */
+static int execute_case(size_t index, size_t worker, void *context, ValidationError *error) {
+    CaseRunContext *ctx = (CaseRunContext *)context;
+    const InputCase *input_case = &ctx->corpus->cases[ctx->case_indices[index]];
+    ComparisonResult *result = &ctx->results[index];
+    CaseSlot *slot = &ctx->slots[index];
+
+    if (slot->carried_over) {
+        return 0;
+    }
+
+    const double start_ms = monotonic_ms();
+    CaseTiming timing = {0};
+    CaseTrials trials;
+    EngineOutput canonical = {0};
+    EngineOutput alternate = {0};
+
+    if (run_case_trials(ctx, worker, input_case, &canonical, &alternate, slot, &timing, &trials, error) != 0) {
+        free_engine_output(&canonical);
+        free_engine_output(&alternate);
+        return -1;
+    }
+
+    if (canonical.build_flags) {
+        slot->c_build_flags = strdup(canonical.build_flags);
+    }
+    if (alternate.build_flags) {
+        slot->alt_build_flags = strdup(alternate.build_flags);
+    }
+
+    double mark_ms = monotonic_ms();
+    if (compare_engine_outputs(&canonical, &alternate, ctx->tolerance, input_case, result, &ctx->accumulators[worker]) != 0) {
+        fprintf(stderr, "Comparison failed for case %s\n", input_case->id);
+    }
+    timing.compare_ms = monotonic_ms() - mark_ms;
+    result->canonical_duration_ms = canonical.duration_ms;
+    result->alternate_duration_ms = alternate.duration_ms;
+    if (trials.canonical.trials > 0) {
+        result->canonical_trials = trials.canonical;
+        result->alternate_trials = trials.alternate;
+        result->canonical_duration_ms = trials.canonical.median_ms;
+        result->alternate_duration_ms = trials.alternate.median_ms;
+    }
+    if (trials.nondeterministic) {
+        result->nondeterministic = trials.nondeterministic;
+        result->passed = 0;
+    }
+    memcpy(result->fingerprint, slot->fingerprint, sizeof(result->fingerprint));
+
+    /* Write artifacts based on retention policy */
+    int should_write = (ctx->artifact_policy == ARTIFACT_POLICY_ALL) ||
+                       (ctx->artifact_policy == ARTIFACT_POLICY_FAILURES && !result->passed);
+    mark_ms = monotonic_ms();
+    if (should_write && write_case_artifacts(ctx->artifacts_root, input_case, &canonical, &alternate, result, error) != 0) {
+        fprintf(stderr, "Failed to write artifacts for case %s: %s\n", input_case->id, error->message ? error->message : "unknown error");
+    }
+    timing.write_ms = monotonic_ms() - mark_ms;
+
+    retain_compared_colors(result, &canonical, &alternate);
+    free_engine_output(&canonical);
+    free_engine_output(&alternate);
+    timing.total_ms = monotonic_ms() - start_ms;
+    result->timing = timing;
+    return 0;
 }
 
 int main(int argc, char **argv) {
+    install_json_arena_hooks();
     const char *corpus_path = NULL;
     const char *tolerances_path = NULL;
     const char *artifacts_path = NULL;
     const char *cases_filter = NULL;
     const char *tags_filter = NULL;
+    const char *select_arg = NULL;
     const char *c_runner = "./parity_c_runner";
     const char *alt_runner = "./parity_wasm_as_c_runner";
     const char *run_id = NULL;
@@ -134,11 +553,26 @@ int main(int argc, char **argv) {
     const char *platform_arg = NULL;
     double pass_gate = 0.95;
     double max_duration_ms = 600000.0; /* 10 minutes */
+    double max_slowdown = 0.0;
+    long repeat = 1;
+    long warmup = 0;
+    double outlier_mad = 3.0;
+    const char *shard_arg = NULL;
     double tolerance_deltaE_override = -1.0;
     double tolerance_l_override = -1.0;
     double tolerance_a_override = -1.0;
     double tolerance_b_override = -1.0;
     ArtifactPolicy artifact_policy = ARTIFACT_POLICY_ALL;
+    long jobs_requested = 1;
+    int use_engine_server = 0;
+    const char *c_engine_so = NULL;
+    const char *alt_engine_so = NULL;
+    LaunchLimits launch_limits = {0};
+    const char *engine_format_arg = "json";
+    const char *cache_dir = NULL;
+    const char *since_report = NULL;
+    const char *stats_arg = "exact";
+    const char *percentiles_arg = NULL;
 
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) {
@@ -151,6 +585,8 @@ int main(int argc, char **argv) {
             cases_filter = argv[++i];
         } else if (strcmp(argv[i], "--tags") == 0 && i + 1 < argc) {
             tags_filter = argv[++i];
+        } else if (strcmp(argv[i], "--select") == 0 && i + 1 < argc) {
+            select_arg = argv[++i];
         } else if (strcmp(argv[i], "--tolerance-deltaE") == 0 && i + 1 < argc) {
             tolerance_deltaE_override = atof(argv[++i]);
         } else if (strcmp(argv[i], "--tolerance-l") == 0 && i + 1 < argc) {
@@ -168,6 +604,30 @@ int main(int argc, char **argv) {
             } else if (strcmp(policy, "none") == 0) {
                 artifact_policy = ARTIFACT_POLICY_NONE;
             }
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobs_requested = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--engine-server") == 0) {
+            use_engine_server = 1;
+        } else if (strcmp(argv[i], "--c-engine-so") == 0 && i + 1 < argc) {
+            c_engine_so = argv[++i];
+        } else if (strcmp(argv[i], "--alt-engine-so") == 0 && i + 1 < argc) {
+            alt_engine_so = argv[++i];
+        } else if (strcmp(argv[i], "--case-timeout-ms") == 0 && i + 1 < argc) {
+            launch_limits.timeout_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--engine-memory-mb") == 0 && i + 1 < argc) {
+            launch_limits.memory_limit_mb = (size_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "--engine-cpu-seconds") == 0 && i + 1 < argc) {
+            launch_limits.cpu_limit_s = (size_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "--engine-format") == 0 && i + 1 < argc) {
+            engine_format_arg = argv[++i];
+        } else if (strcmp(argv[i], "--percentiles") == 0 && i + 1 < argc) {
+            percentiles_arg = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            stats_arg = argv[++i];
+        } else if (strcmp(argv[i], "--since") == 0 && i + 1 < argc) {
+            since_report = argv[++i];
+        } else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+            cache_dir = argv[++i];
         } else if (strcmp(argv[i], "--c-runner") == 0 && i + 1 < argc) {
             c_runner = argv[++i];
         } else if (strcmp(argv[i], "--alt-runner") == 0 && i + 1 < argc) {
@@ -182,6 +642,16 @@ int main(int argc, char **argv) {
             pass_gate = atof(argv[++i]);
         } else if (strcmp(argv[i], "--max-duration-ms") == 0 && i + 1 < argc) {
             max_duration_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-slowdown") == 0 && i + 1 < argc) {
+            max_slowdown = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--outlier-mad") == 0 && i + 1 < argc) {
+            outlier_mad = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--shard") == 0 && i + 1 < argc) {
+            shard_arg = argv[++i];
         } else if (strcmp(argv[i], "--platform") == 0 && i + 1 < argc) {
             platform_arg = argv[++i];
         } else if (strcmp(argv[i], "--version") == 0) {
@@ -204,11 +674,62 @@ int main(int argc, char **argv) {
         print_usage();
         return 1;
     }
+    size_t shard_index = 0;
+    size_t shard_count = 0;
+    if (shard_arg && (sscanf(shard_arg, "%zu/%zu", &shard_index, &shard_count) != 2 ||
+                      shard_count == 0 || shard_index >= shard_count)) {
+        fprintf(stderr, "--shard expects <i>/<n> with 0 <= i < n.\n");
+        return 1;
+    }
+    if (strcmp(engine_format_arg, "json") != 0 && strcmp(engine_format_arg, "bin") != 0) {
+        fprintf(stderr, "--engine-format expects json or bin.\n");
+        return 1;
+    }
+    if (strcmp(stats_arg, "exact") != 0 && strcmp(stats_arg, "streaming") != 0) {
+        fprintf(stderr, "--stats expects exact or streaming.\n");
+        return 1;
+    }
+    if (repeat < 1 || warmup < 0) {
+        fprintf(stderr, "--repeat must be at least 1 and --warmup at least 0.\n");
+        return 1;
+    }
+    if (cache_dir && repeat + warmup > 1) {
+        /* Every trial has to run the canonical engine to be timed and checked. */
+        fprintf(stderr, "--cache-dir is ignored with --repeat/--warmup.\n");
+        cache_dir = NULL;
+    }
 
     ValidationError error = {.message = NULL};
+    PercentileList percentiles = {0};
+    if (percentiles_arg && parse_percentile_list(percentiles_arg, &percentiles, &error) != 0) {
+        fprintf(stderr, "Invalid --percentiles: %s\n", error.message ? error.message : "unknown error");
+        free(error.message);
+        return 1;
+    }
+    SelectExpr *select_expr = NULL;
+    if (select_arg && !(select_expr = parse_select_expression(select_arg, &error))) {
+        fprintf(stderr, "Invalid --select expression: %s\n", error.message ? error.message : "unknown error");
+        free(error.message);
+        return 1;
+    }
+
+    size_t filter_count = 0;
+    char **filters = split_cases(cases_filter, &filter_count);
+
+    size_t tag_filter_count = 0;
+    char **tag_filters = split_cases(tags_filter, &tag_filter_count);
+
     Corpus corpus;
-    if (parse_corpus_file(corpus_path, &corpus, &error) != 0) {
+    /* A filtered run only parses the cases it selects; the rest of the corpus is just indexed. */
+    const int corpus_status = filter_count > 0 || tag_filter_count > 0
+                                  ? load_selected_corpus(corpus_path, filters, filter_count, (const char **)tag_filters,
+                                                         tag_filter_count, &corpus, &error)
+                                  : parse_corpus_file(corpus_path, &corpus, &error);
+    if (corpus_status != 0) {
         fprintf(stderr, "Corpus validation failed: %s\n", error.message ? error.message : "unknown error");
+        free_case_filters(filters, filter_count);
+        free_case_filters(tag_filters, tag_filter_count);
+        free_select_expression(select_expr);
         free(error.message);
         return 1;
     }
@@ -216,6 +737,9 @@ int main(int argc, char **argv) {
     ToleranceConfig tolerance;
     if (parse_tolerances_file(tolerances_path, &tolerance, &error) != 0) {
         fprintf(stderr, "Tolerance validation failed: %s\n", error.message ? error.message : "unknown error");
+        free_case_filters(filters, filter_count);
+        free_case_filters(tag_filters, tag_filter_count);
+        free_select_expression(select_expr);
         free_corpus(&corpus);
         free(error.message);
         return 1;
@@ -235,65 +759,74 @@ int main(int argc, char **argv) {
         tolerance.abs.b = tolerance_b_override;
     }
 
-    size_t filter_count = 0;
-    char **filters = split_cases(cases_filter, &filter_count);
-
-    size_t tag_filter_count = 0;
-    char **tag_filters = split_cases(tags_filter, &tag_filter_count);
-
     size_t selected_cases = 0;
-    for (size_t i = 0; i < corpus.case_count; ++i) {
-        if (is_selected_case(corpus.cases[i].id, filters, filter_count) &&
-            case_has_tag(&corpus.cases[i], (const char **)tag_filters, tag_filter_count)) {
-            selected_cases++;
-        }
+    size_t *case_indices = (size_t *)calloc(corpus.case_count ? corpus.case_count : 1, sizeof(size_t));
+    if (!case_indices) {
+        fprintf(stderr, "Failed to allocate case selection.\n");
+        free_case_filters(filters, filter_count);
+        free_case_filters(tag_filters, tag_filter_count);
+        free_select_expression(select_expr);
+        free_tolerances(&tolerance);
+        free_corpus(&corpus);
+        free(error.message);
+        return 1;
     }
-
-    if (selected_cases == 0) {
-        fprintf(stderr, "No cases selected for execution.\n");
+    /* Evaluated once; every later phase works from case_indices and the catalog's id index. */
+    CaseCatalog catalog;
+    if (build_case_catalog(&corpus, &catalog, &error) != 0 ||
+        select_cases(&catalog, select_expr, filters, filter_count, tag_filters, tag_filter_count, case_indices,
+                     &selected_cases, &error) != 0) {
+        fprintf(stderr, "Case selection failed: %s\n", error.message ? error.message : "unknown error");
+        free_case_catalog(&catalog);
+        free(case_indices);
         free_case_filters(filters, filter_count);
+        free_case_filters(tag_filters, tag_filter_count);
+        free_select_expression(select_expr);
         free_tolerances(&tolerance);
         free_corpus(&corpus);
         free(error.message);
         return 1;
     }
 
-    RunResults results = {0};
-    results.result_count = selected_cases;
-    results.results = (ComparisonResult *)calloc(selected_cases, sizeof(ComparisonResult));
-    if (!results.results) {
-        fprintf(stderr, "Failed to allocate comparison results.\n");
+    if (selected_cases == 0) {
+        fprintf(stderr, "No cases selected for execution.\n");
+        free(case_indices);
         free_case_filters(filters, filter_count);
+        free_case_filters(tag_filters, tag_filter_count);
+        free_select_expression(select_expr);
+        free_case_catalog(&catalog);
         free_tolerances(&tolerance);
         free_corpus(&corpus);
         free(error.message);
         return 1;
     }
 
-    size_t delta_capacity = 128;
-    size_t delta_count = 0;
-    double *delta_e_values = (double *)malloc(delta_capacity * sizeof(double));
-    double *delta_l_values = (double *)malloc(delta_capacity * sizeof(double));
-    double *delta_a_values = (double *)malloc(delta_capacity * sizeof(double));
-    double *delta_b_values = (double *)malloc(delta_capacity * sizeof(double));
-    double *delta_r_values = (double *)malloc(delta_capacity * sizeof(double));
-    double *delta_g_values = (double *)malloc(delta_capacity * sizeof(double));
-    double *delta_b_rgb_values = (double *)malloc(delta_capacity * sizeof(double));
-
-    if (!delta_e_values || !delta_l_values || !delta_a_values || !delta_b_values ||
-        !delta_r_values || !delta_g_values || !delta_b_rgb_values) {
-        fprintf(stderr, "Failed to allocate delta buffers.\n");
-        free(delta_e_values);
-        free(delta_l_values);
-        free(delta_a_values);
-        free(delta_b_values);
-        free(delta_r_values);
-        free(delta_g_values);
-        free(delta_b_rgb_values);
+    /* A shard keeps its share of the selection; an empty shard still writes a (mergeable) report. */
+    if (shard_count > 0) {
+        size_t kept = 0;
+        for (size_t i = 0; i < selected_cases; ++i) {
+            if (shard_of_case(corpus.cases[case_indices[i]].id, shard_count) == shard_index) {
+                case_indices[kept++] = case_indices[i];
+            }
+        }
+        selected_cases = kept;
+    }
+
+    RunResults results = {0};
+    results.result_count = selected_cases;
+    results.results = (ComparisonResult *)calloc(selected_cases ? selected_cases : 1, sizeof(ComparisonResult));
+    CaseSlot *slots = (CaseSlot *)calloc(selected_cases ? selected_cases : 1, sizeof(CaseSlot));
+    if (!results.results || !slots) {
+        fprintf(stderr, "Failed to allocate comparison results.\n");
+        free(results.results);
+        free(slots);
+        free(case_indices);
         free_case_filters(filters, filter_count);
+        free_case_filters(tag_filters, tag_filter_count);
+        free_select_expression(select_expr);
+        free_case_catalog(&catalog);
         free_tolerances(&tolerance);
         free_corpus(&corpus);
-        free(results.results);
         free(error.message);
         return 1;
     }
@@ -314,152 +847,168 @@ int main(int argc, char **argv) {
         .artifacts_root = (char *)resolved_root,
         .max_duration_ms = max_duration_ms,
         .pass_gate = pass_gate,
+        .max_slowdown = max_slowdown,
+        .repeat = (size_t)repeat,
+        .warmup = (size_t)warmup,
+        .outlier_mad = outlier_mad,
+        .shard_index = shard_index,
+        .shard_count = shard_count,
         .c_build_flags = NULL,
         .alt_build_flags = NULL
     };
 
     int exit_code = 0;
-    const clock_t start = clock();
+    const double start_ms = monotonic_ms();
 
-    size_t output_index = 0;
-    for (size_t i = 0; i < corpus.case_count; ++i) {
-        InputCase *input_case = &corpus.cases[i];
-        if (!is_selected_case(input_case->id, filters, filter_count) ||
-            !case_has_tag(input_case, (const char **)tag_filters, tag_filter_count)) {
-            continue;
-        }
+    const size_t job_count = resolve_job_count(jobs_requested);
 
-        EngineOutput canonical = {0};
-        EngineOutput alternate = {0};
+    CaseRunContext run_context = {
+        .corpus = &corpus,
+        .case_indices = case_indices,
+        .tolerance = &tolerance,
+        .corpus_path = corpus_path,
+        .artifacts_root = resolved_root,
+        .artifact_policy = artifact_policy,
+        .results = results.results,
+        .slots = slots,
+        .canonical = {.label = "Canonical runner", .runner_path = c_runner, .is_canonical = 1},
+        .alternate = {.label = "Alternate runner", .runner_path = alt_runner, .is_canonical = 0},
+        .limits = launch_limits,
+        .engine_format = strcmp(engine_format_arg, "bin") == 0 ? ENGINE_FORMAT_BIN : ENGINE_FORMAT_JSON,
+        .repeat = (size_t)repeat,
+        .warmup = (size_t)warmup,
+        .outlier_mad = outlier_mad
+    };
 
-        if (run_c_engine(c_runner, corpus_path, input_case->id, &canonical, &error) != 0) {
-            fprintf(stderr, "Canonical runner failed for case %s: %s\n", input_case->id, error.message ? error.message : "unknown error");
-            free_engine_output(&canonical);
-            free_engine_output(&alternate);
+    if (c_engine_so && !(run_context.canonical.plugin = load_engine_plugin(c_engine_so, &error))) {
+        fprintf(stderr, "Canonical engine plugin failed: %s\n", error.message ? error.message : "unknown error");
+        exit_code = 1;
+    }
+    if (alt_engine_so && !(run_context.alternate.plugin = load_engine_plugin(alt_engine_so, &error))) {
+        fprintf(stderr, "Alternate engine plugin failed: %s\n", error.message ? error.message : "unknown error");
+        exit_code = 1;
+    }
+    if (cache_dir && exit_code == 0 &&
+        !(run_context.cache = open_output_cache(cache_dir, c_engine_so ? c_engine_so : c_runner,
+                                                run_context.engine_format, &error))) {
+        fprintf(stderr, "Output cache failed: %s\n", error.message ? error.message : "unknown error");
+        exit_code = 1;
+    }
+    const StatsMode stats_mode = strcmp(stats_arg, "streaming") == 0 ? STATS_MODE_STREAMING : STATS_MODE_EXACT;
+    run_context.accumulators = (RunAccumulator *)calloc(job_count, sizeof(RunAccumulator));
+    for (size_t i = 0; run_context.accumulators && exit_code == 0 && i < job_count; ++i) {
+        if (init_run_accumulator(&run_context.accumulators[i], stats_mode) != 0) {
             exit_code = 1;
-            break;
         }
-        if (run_alt_engine(alt_runner, corpus_path, input_case->id, &alternate, &error) != 0) {
-            fprintf(stderr, "Alternate runner failed for case %s: %s\n", input_case->id, error.message ? error.message : "unknown error");
-            free_engine_output(&canonical);
-            free_engine_output(&alternate);
+    }
+    if (!run_context.accumulators || exit_code != 0) {
+        fprintf(stderr, "Failed to allocate run statistics.\n");
+        exit_code = 1;
+    }
+    if (use_engine_server) {
+        run_context.canonical.servers = (EngineServer **)calloc(job_count, sizeof(EngineServer *));
+        run_context.alternate.servers = (EngineServer **)calloc(job_count, sizeof(EngineServer *));
+        if (!run_context.canonical.servers || !run_context.alternate.servers) {
+            fprintf(stderr, "Failed to allocate engine server sessions.\n");
             exit_code = 1;
-            break;
         }
+    }
 
-        if (!provenance.c_build_flags && canonical.build_flags) {
-            provenance.c_build_flags = strdup(canonical.build_flags);
-        }
-        if (!provenance.alt_build_flags && alternate.build_flags) {
-            provenance.alt_build_flags = strdup(alternate.build_flags);
+    /* Fingerprints let a later --since run reuse these results; they need both engine files to be readable. */
+    uint64_t engine_hash = 0;
+    const int have_engine_hash = hash_engines(c_engine_so ? c_engine_so : c_runner,
+                                              alt_engine_so ? alt_engine_so : alt_runner,
+                                              &engine_hash) == 0;
+    PreviousRun previous = {0};
+    if (since_report && exit_code == 0 && load_previous_run(since_report, &previous, &error) != 0) {
+        fprintf(stderr, "Previous report failed: %s\n", error.message ? error.message : "unknown error");
+        exit_code = 1;
+    }
+    if (since_report && !have_engine_hash) {
+        fprintf(stderr, "Cannot fingerprint engine binaries; every case will run.\n");
+    }
+    for (size_t i = 0; exit_code == 0 && have_engine_hash && i < selected_cases; ++i) {
+        const InputCase *input_case = &corpus.cases[case_indices[i]];
+        if (fingerprint_input_case(input_case, engine_hash, slots[i].fingerprint, sizeof(slots[i].fingerprint)) != 0) {
+            continue;
         }
-
-        if (compare_engine_outputs(&canonical, &alternate, &tolerance, input_case, &results.results[output_index]) != 0) {
-            fprintf(stderr, "Comparison failed for case %s\n", input_case->id);
+        const ComparisonResult *previous_result = find_reusable_result(&previous, input_case->id, slots[i].fingerprint);
+        if (previous_result && carry_over_result(previous_result, &tolerance, &results.results[i], &error) == 0) {
+            slots[i].carried_over = true;
+            provenance.carried_over++;
         }
+    }
+    if (provenance.carried_over > 0) {
+        /* Carried results came from the same engine binaries, so their build flags still apply. */
+        provenance.c_build_flags = previous.c_build_flags;
+        provenance.alt_build_flags = previous.alt_build_flags;
+        previous.c_build_flags = NULL;
+        previous.alt_build_flags = NULL;
+    }
+    free_previous_run(&previous);
+    provenance.since_report = since_report;
 
-        /* Accumulate delta metrics */
-        for (size_t s = 0; s < results.results[output_index].sample_count; ++s) {
-            const ComparisonDelta *delta = &results.results[output_index].samples[s].delta;
-            if (delta_count + 1 >= delta_capacity) {
-                delta_capacity *= 2;
-                double *tmp_e = (double *)realloc(delta_e_values, delta_capacity * sizeof(double));
-                double *tmp_l = (double *)realloc(delta_l_values, delta_capacity * sizeof(double));
-                double *tmp_a = (double *)realloc(delta_a_values, delta_capacity * sizeof(double));
-                double *tmp_b = (double *)realloc(delta_b_values, delta_capacity * sizeof(double));
-                double *tmp_r = (double *)realloc(delta_r_values, delta_capacity * sizeof(double));
-                double *tmp_g = (double *)realloc(delta_g_values, delta_capacity * sizeof(double));
-                double *tmp_b_rgb = (double *)realloc(delta_b_rgb_values, delta_capacity * sizeof(double));
-                if (!tmp_e || !tmp_l || !tmp_a || !tmp_b || !tmp_r || !tmp_g || !tmp_b_rgb) {
-                    fprintf(stderr, "Failed to grow delta buffers.\n");
-                    free(tmp_e);
-                    free(tmp_l);
-                    free(tmp_a);
-                    free(tmp_b);
-                    free(tmp_r);
-                    free(tmp_g);
-                    free(tmp_b_rgb);
-                    exit_code = 1;
-                    break;
-                }
-                delta_e_values = tmp_e;
-                delta_l_values = tmp_l;
-                delta_a_values = tmp_a;
-                delta_b_values = tmp_b;
-                delta_r_values = tmp_r;
-                delta_g_values = tmp_g;
-                delta_b_rgb_values = tmp_b_rgb;
-            }
-            delta_e_values[delta_count] = fabs(delta->deltaE);
-            delta_l_values[delta_count] = fabs(delta->l);
-            delta_a_values[delta_count] = fabs(delta->a);
-            delta_b_values[delta_count] = fabs(delta->b);
-            delta_r_values[delta_count] = fabs(results.results[output_index].samples[s].rgb_delta.r);
-            delta_g_values[delta_count] = fabs(results.results[output_index].samples[s].rgb_delta.g);
-            delta_b_rgb_values[delta_count] = fabs(results.results[output_index].samples[s].rgb_delta.b);
-            delta_count++;
-        }
+    WorkerPool *pool = NULL;
+    if (exit_code == 0 && !(pool = worker_pool_start(job_count, selected_cases, execute_case, &run_context, &error))) {
+        fprintf(stderr, "Failed to start case workers: %s\n", error.message ? error.message : "unknown error");
+        exit_code = 1;
+    }
 
-        if (exit_code != 0) {
-            free_engine_output(&canonical);
-            free_engine_output(&alternate);
+    /* Consume completed cases in corpus order so accumulated metrics match a serial run. */
+    size_t output_index = 0;
+    for (size_t i = 0; pool && i < selected_cases; ++i) {
+        const InputCase *input_case = &corpus.cases[case_indices[i]];
+        char *message = NULL;
+        if (worker_pool_wait(pool, i, &message) != 0) {
+            fprintf(stderr, "%s failed for case %s: %s\n",
+                    slots[i].failed_stage ? slots[i].failed_stage : "Case execution",
+                    input_case->id,
+                    message ? message : "unknown error");
+            free(message);
+            worker_pool_cancel(pool);
+            exit_code = 1;
             break;
         }
 
-        /* Write artifacts based on retention policy */
-        int should_write = (artifact_policy == ARTIFACT_POLICY_ALL) ||
-                          (artifact_policy == ARTIFACT_POLICY_FAILURES && !results.results[output_index].passed);
-        if (should_write && write_case_artifacts(resolved_root, input_case, &canonical, &alternate, &results.results[output_index], &error) != 0) {
-            fprintf(stderr, "Failed to write artifacts for case %s: %s\n", input_case->id, error.message ? error.message : "unknown error");
+        if (!provenance.c_build_flags && slots[i].c_build_flags) {
+            provenance.c_build_flags = slots[i].c_build_flags;
+            slots[i].c_build_flags = NULL;
+        }
+        if (!provenance.alt_build_flags && slots[i].alt_build_flags) {
+            provenance.alt_build_flags = slots[i].alt_build_flags;
+            slots[i].alt_build_flags = NULL;
         }
 
-        free_engine_output(&canonical);
-        free_engine_output(&alternate);
         output_index++;
     }
+    worker_pool_finish(pool);
 
-    const clock_t end = clock();
-    results.result_count = output_index;
-    results.summary.total_cases = output_index;
-    results.summary.passed = 0;
-    results.summary.failed = 0;
-    for (size_t i = 0; i < results.result_count; ++i) {
-        if (results.results[i].passed) {
-            results.summary.passed++;
-        } else {
-            results.summary.failed++;
-        }
+    release_engine_backend(&run_context.canonical, job_count);
+    release_engine_backend(&run_context.alternate, job_count);
+    if (run_context.cache) {
+        provenance.cache_enabled = true;
+        output_cache_counts(run_context.cache, &provenance.cache_hits, &provenance.cache_misses);
+        close_output_cache(run_context.cache);
+        run_context.cache = NULL;
     }
-    results.summary.duration_ms = ((double)(end - start) / CLOCKS_PER_SEC) * 1000.0;
-    results.summary.pass_rate = results.summary.total_cases > 0 ? ((double)results.summary.passed / (double)results.summary.total_cases) : 0.0;
-
-    compute_metric_stats(delta_e_values, delta_count, &results.summary.stats.delta_e);
-    compute_metric_stats(delta_l_values, delta_count, &results.summary.stats.l);
-    compute_metric_stats(delta_a_values, delta_count, &results.summary.stats.a);
-    compute_metric_stats(delta_b_values, delta_count, &results.summary.stats.b);
-    compute_metric_stats(delta_r_values, delta_count, &results.summary.stats.rgb_r);
-    compute_metric_stats(delta_g_values, delta_count, &results.summary.stats.rgb_g);
-    compute_metric_stats(delta_b_rgb_values, delta_count, &results.summary.stats.rgb_b);
 
-    const double hist_max = results.summary.stats.delta_e.max > 0.0 ? results.summary.stats.delta_e.max : 1.0;
-    init_histogram(&results.summary.stats.delta_e_hist, 0.0, hist_max, 20);
-    for (size_t i = 0; i < delta_count; ++i) {
-        record_histogram(&results.summary.stats.delta_e_hist, delta_e_values[i]);
+    const double end_ms = monotonic_ms();
+    results.result_count = output_index;
+    results.summary.duration_ms = end_ms - start_ms;
+    results.summary.stats_mode = stats_mode;
+    results.summary.percentiles = percentiles;
+    results.accumulators = run_context.accumulators;
+    results.accumulator_count = run_context.accumulators ? job_count : 0;
+    if (summarize_run_results(&results, &error) != 0) {
+        fprintf(stderr, "Failed to summarize run: %s\n", error.message ? error.message : "unknown error");
+        exit_code = 1;
+    }
+    if (compute_run_contributors(&results, 3, &error) != 0) {
+        fprintf(stderr, "Contributor analysis failed: %s\n", error.message ? error.message : "unknown error");
     }
 
     for (size_t i = 0; i < results.result_count; ++i) {
-        Contributor *contributors = NULL;
-        size_t contributor_count = 0;
-        if (compute_contributors(&results.results[i], &results.summary, 3, &contributors, &contributor_count, &error) != 0) {
-            fprintf(stderr, "Failed to compute contributors for case %s: %s\n",
-                    results.results[i].input_case_id,
-                    error.message ? error.message : "unknown error");
-        } else {
-            results.results[i].contributors = contributors;
-            results.results[i].contributor_count = contributor_count;
-        }
-
-        InputCase *matching_case = find_input_case(&corpus, results.results[i].input_case_id);
+        const InputCase *matching_case = catalog_find_case(&catalog, results.results[i].input_case_id);
         if (matching_case) {
             int should_write_metadata = (artifact_policy == ARTIFACT_POLICY_ALL) ||
                                        (artifact_policy == ARTIFACT_POLICY_FAILURES && !results.results[i].passed);
@@ -471,7 +1020,9 @@ int main(int argc, char **argv) {
         }
     }
 
+    results.summary.peak_rss_bytes = process_peak_rss_bytes();
     provenance.artifact_policy = artifact_policy_to_string(artifact_policy);
+    provenance.engine_format = engine_format_arg;
     if (write_run_report(resolved_root, &provenance, &results, &tolerance, &error) != 0) {
         fprintf(stderr, "Failed to write run report: %s\n", error.message ? error.message : "unknown error");
     } else {
@@ -485,28 +1036,51 @@ int main(int argc, char **argv) {
            results.summary.pass_rate * 100.0,
            results.summary.duration_ms);
 
+    if (results.summary.peak_rss_bytes > 0 && results.summary.sample_count > 0) {
+        printf("Memory: peak RSS %.1f MiB over %zu samples\n",
+               (double)results.summary.peak_rss_bytes / (1024.0 * 1024.0),
+               results.summary.sample_count);
+    }
+
+    const EnginePerformance *performance = &results.summary.performance;
+    if (performance->measured_cases > 0) {
+        printf("Engines: alternate/canonical %.3fx over %zu cases (canonical %.1fms, alternate %.1fms)\n",
+               performance->slowdown,
+               performance->measured_cases,
+               performance->canonical_total_ms,
+               performance->alternate_total_ms);
+    }
+
     if (results.summary.pass_rate < pass_gate || results.summary.duration_ms > max_duration_ms) {
         exit_code = 1;
     }
+    if (max_slowdown > 0.0 && performance->slowdown > max_slowdown) {
+        fprintf(stderr, "Alternate engine slowdown %.3fx exceeds --max-slowdown %.3fx\n",
+                performance->slowdown, max_slowdown);
+        exit_code = 1;
+    }
 
-    /* Cleanup */
-    for (size_t i = 0; i < results.result_count; ++i) {
+    /* Cleanup: workers may have completed cases past an aborting failure */
+    for (size_t i = 0; i < selected_cases; ++i) {
         free_comparison_result(&results.results[i]);
+        free(slots[i].c_build_flags);
+        free(slots[i].alt_build_flags);
+    }
+    for (size_t i = 0; run_context.accumulators && i < job_count; ++i) {
+        free_run_accumulator(&run_context.accumulators[i]);
     }
+    free(run_context.accumulators);
     free(results.results);
+    free(slots);
+    free(case_indices);
     free_case_filters(filters, filter_count);
     free_case_filters(tag_filters, tag_filter_count);
+    free_select_expression(select_expr);
+    free_case_catalog(&catalog);
     free_tolerances(&tolerance);
     free_corpus(&corpus);
     free(error.message);
-    free(delta_e_values);
-    free(delta_l_values);
-    free(delta_a_values);
-    free(delta_b_values);
-    free(delta_r_values);
-    free(delta_g_values);
-    free(delta_b_rgb_values);
-    free_histogram(&results.summary.stats.delta_e_hist);
+    free_run_stats(&results.summary.stats);
     free(provenance.c_build_flags);
     free(provenance.alt_build_flags);
 
@@ -0,0 +1,389 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "stats.h"
+#include "types.h"
+
+/*
+ * parity-merge: combines the report.json files of a --shard i/N run into one
+ * report. Shard reports keep every per-sample delta and per-case timing, so
+ * the merged summary is recomputed from the union of cases with the same code
+ * parity-runner uses; nothing is derived from the shards' reduced percentiles.
+ */
+
+typedef struct {
+    cJSON *root;
+    const cJSON *provenance;
+    size_t shard_index;
+    size_t shard_count;
+    PreviousRun cases;
+} ShardReport;
+
+static void set_error(ValidationError *error, const char *message) {
+    if (!error || !message) {
+        return;
+    }
+    free(error->message);
+    size_t len = strlen(message);
+    error->message = (char *)malloc(len + 1);
+    if (error->message) {
+        memcpy(error->message, message, len + 1);
+    }
+}
+
+static void print_usage(void) {
+    printf("Usage: parity-merge --output <dir> [--run-id <id>] [--pass-gate <0-1>]\n");
+    printf("       [--max-duration-ms <ms>] [--max-slowdown <ratio>] [--stats exact|streaming]\n");
+    printf("       [--percentiles <p1,p2,...>]\n");
+    printf("       <shard-report.json>...\n");
+}
+
+static char *read_text_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    if (fseek(file, 0, SEEK_END) != 0) {
+        fclose(file);
+        return NULL;
+    }
+    const long size = ftell(file);
+    rewind(file);
+    if (size < 0) {
+        fclose(file);
+        return NULL;
+    }
+    char *buffer = (char *)malloc((size_t)size + 1);
+    if (buffer && fread(buffer, 1, (size_t)size, file) != (size_t)size) {
+        free(buffer);
+        buffer = NULL;
+    }
+    fclose(file);
+    if (buffer) {
+        buffer[size] = '\0';
+    }
+    return buffer;
+}
+
+static const char *string_field(const cJSON *object, const char *name) {
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(object, name);
+    return cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+static double number_field(const cJSON *object, const char *name, double fallback) {
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(object, name);
+    return cJSON_IsNumber(item) ? item->valuedouble : fallback;
+}
+
+static int load_shard_report(const char *path, ShardReport *shard, ValidationError *error) {
+    memset(shard, 0, sizeof(ShardReport));
+    char *text = read_text_file(path);
+    if (!text) {
+        set_error(error, "failed to read shard report");
+        return -1;
+    }
+    shard->root = cJSON_Parse(text);
+    free(text);
+    if (!shard->root) {
+        set_error(error, "failed to parse shard report JSON");
+        return -1;
+    }
+    shard->provenance = cJSON_GetObjectItemCaseSensitive(shard->root, "provenance");
+    const cJSON *info = cJSON_GetObjectItemCaseSensitive(shard->provenance, "shard");
+    const double index = number_field(info, "index", -1.0);
+    const double count = number_field(info, "count", 0.0);
+    if (index < 0.0 || count < 1.0 || index >= count) {
+        set_error(error, "report was not produced by a --shard run");
+        return -1;
+    }
+    shard->shard_index = (size_t)index;
+    shard->shard_count = (size_t)count;
+    return parse_report_cases(cJSON_GetObjectItemCaseSensitive(shard->root, "cases"), 0, &shard->cases, error);
+}
+
+static void free_shard_report(ShardReport *shard) {
+    cJSON_Delete(shard->root);
+    free_previous_run(&shard->cases);
+    memset(shard, 0, sizeof(ShardReport));
+}
+
+/* Strings that identify what was compared must agree; a field missing from one shard (e.g. an empty one) is not a conflict. */
+static int same_optional_string(const char *a, const char *b) {
+    return !a || !b || strcmp(a, b) == 0;
+}
+
+static int read_applied_tolerances(const cJSON *provenance, ToleranceConfig *out) {
+    const cJSON *applied = cJSON_GetObjectItemCaseSensitive(provenance, "appliedTolerances");
+    const cJSON *abs = cJSON_GetObjectItemCaseSensitive(applied, "abs");
+    const cJSON *rel = cJSON_GetObjectItemCaseSensitive(applied, "rel");
+    if (!cJSON_IsObject(abs) || !cJSON_IsObject(rel)) {
+        return -1;
+    }
+    memset(out, 0, sizeof(ToleranceConfig));
+    out->abs.l = number_field(abs, "l", 0.0);
+    out->abs.a = number_field(abs, "a", 0.0);
+    out->abs.b = number_field(abs, "b", 0.0);
+    out->abs.deltaE = number_field(abs, "deltaE", 0.0);
+    out->rel.l = number_field(rel, "l", 0.0);
+    out->rel.a = number_field(rel, "a", 0.0);
+    out->rel.b = number_field(rel, "b", 0.0);
+    return 0;
+}
+
+static int check_shard_compatible(const ShardReport *first,
+                                  const ShardReport *shard,
+                                  const ToleranceConfig *tolerance,
+                                  ValidationError *error) {
+    static const char *const provenance_fields[] = {"cCommit", "wasmCommit", "platform", "cBuildFlags", "altBuildFlags",
+                                                    "engineFormat"};
+    if (!same_optional_string(string_field(first->root, "corpusVersion"), string_field(shard->root, "corpusVersion"))) {
+        set_error(error, "shards were run against different corpus versions");
+        return -1;
+    }
+    for (size_t i = 0; i < sizeof(provenance_fields) / sizeof(provenance_fields[0]); ++i) {
+        if (!same_optional_string(string_field(first->provenance, provenance_fields[i]),
+                                  string_field(shard->provenance, provenance_fields[i]))) {
+            char message[128];
+            snprintf(message, sizeof(message), "shards disagree on provenance.%s", provenance_fields[i]);
+            set_error(error, message);
+            return -1;
+        }
+    }
+    ToleranceConfig shard_tolerance;
+    if (read_applied_tolerances(shard->provenance, &shard_tolerance) != 0 ||
+        memcmp(&shard_tolerance.abs, &tolerance->abs, sizeof(ToleranceAbs)) != 0 ||
+        memcmp(&shard_tolerance.rel, &tolerance->rel, sizeof(ToleranceRel)) != 0) {
+        set_error(error, "shards were run with different tolerances");
+        return -1;
+    }
+    if (number_field(first->provenance, "repeat", 1.0) != number_field(shard->provenance, "repeat", 1.0) ||
+        number_field(first->provenance, "warmup", 0.0) != number_field(shard->provenance, "warmup", 0.0)) {
+        set_error(error, "shards were run with different --repeat/--warmup settings");
+        return -1;
+    }
+    for (size_t i = 0; i < shard->cases.result_count; ++i) {
+        if (shard_of_case(shard->cases.results[i].input_case_id, shard->shard_count) != shard->shard_index) {
+            char message[MAX_ID_LENGTH + 64];
+            snprintf(message, sizeof(message), "case %s does not belong to its shard",
+                     shard->cases.results[i].input_case_id);
+            set_error(error, message);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int compare_result_ids(const void *lhs, const void *rhs) {
+    const ComparisonResult *a = (const ComparisonResult *)lhs;
+    const ComparisonResult *b = (const ComparisonResult *)rhs;
+    return strcmp(a->input_case_id, b->input_case_id);
+}
+
+int main(int argc, char **argv) {
+    install_json_arena_hooks();
+    const char *output_dir = NULL;
+    const char *run_id = NULL;
+    double pass_gate = 0.95;
+    double max_duration_ms = 600000.0; /* 10 minutes */
+    double max_slowdown = 0.0;
+    const char *stats_arg = "exact";
+    const char *percentiles_arg = NULL;
+    const char **paths = (const char **)calloc((size_t)argc, sizeof(char *));
+    size_t path_count = 0;
+    if (!paths) {
+        fprintf(stderr, "Failed to allocate shard list.\n");
+        return 1;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_dir = argv[++i];
+        } else if (strcmp(argv[i], "--run-id") == 0 && i + 1 < argc) {
+            run_id = argv[++i];
+        } else if (strcmp(argv[i], "--pass-gate") == 0 && i + 1 < argc) {
+            pass_gate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-duration-ms") == 0 && i + 1 < argc) {
+            max_duration_ms = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-slowdown") == 0 && i + 1 < argc) {
+            max_slowdown = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--percentiles") == 0 && i + 1 < argc) {
+            percentiles_arg = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            stats_arg = argv[++i];
+        } else if (strcmp(argv[i], "--help") == 0) {
+            print_usage();
+            free(paths);
+            return 0;
+        } else {
+            paths[path_count++] = argv[i];
+        }
+    }
+    if (!output_dir || path_count == 0) {
+        print_usage();
+        free(paths);
+        return 1;
+    }
+    if (strcmp(stats_arg, "exact") != 0 && strcmp(stats_arg, "streaming") != 0) {
+        fprintf(stderr, "--stats expects exact or streaming.\n");
+        free(paths);
+        return 1;
+    }
+    const StatsMode stats_mode = strcmp(stats_arg, "streaming") == 0 ? STATS_MODE_STREAMING : STATS_MODE_EXACT;
+
+    ValidationError error = {.message = NULL};
+    PercentileList percentiles = {0};
+    if (percentiles_arg && parse_percentile_list(percentiles_arg, &percentiles, &error) != 0) {
+        fprintf(stderr, "Invalid --percentiles: %s\n", error.message ? error.message : "unknown error");
+        free(error.message);
+        free(paths);
+        return 1;
+    }
+    ShardReport *shards = (ShardReport *)calloc(path_count, sizeof(ShardReport));
+    ToleranceConfig tolerance;
+    int exit_code = shards ? 0 : 1;
+    size_t case_total = 0;
+
+    for (size_t i = 0; exit_code == 0 && i < path_count; ++i) {
+        if (load_shard_report(paths[i], &shards[i], &error) != 0) {
+            fprintf(stderr, "%s: %s\n", paths[i], error.message ? error.message : "unknown error");
+            exit_code = 1;
+            break;
+        }
+        if (i == 0 && read_applied_tolerances(shards[0].provenance, &tolerance) != 0) {
+            fprintf(stderr, "%s: report is missing provenance.appliedTolerances\n", paths[i]);
+            exit_code = 1;
+            break;
+        }
+        if (shards[i].shard_count != path_count) {
+            fprintf(stderr, "%s: shard %zu/%zu, but %zu reports were given\n",
+                    paths[i], shards[i].shard_index, shards[i].shard_count, path_count);
+            exit_code = 1;
+            break;
+        }
+        for (size_t j = 0; j < i; ++j) {
+            if (shards[j].shard_index == shards[i].shard_index) {
+                fprintf(stderr, "%s: shard %zu is given twice\n", paths[i], shards[i].shard_index);
+                exit_code = 1;
+            }
+        }
+        if (exit_code == 0 && check_shard_compatible(&shards[0], &shards[i], &tolerance, &error) != 0) {
+            fprintf(stderr, "%s: %s\n", paths[i], error.message ? error.message : "unknown error");
+            exit_code = 1;
+        }
+        case_total += shards[i].cases.result_count;
+    }
+
+    RunResults results = {0};
+    if (exit_code == 0) {
+        results.results = (ComparisonResult *)calloc(case_total ? case_total : 1, sizeof(ComparisonResult));
+        if (!results.results) {
+            fprintf(stderr, "Failed to allocate merged results.\n");
+            exit_code = 1;
+        }
+    }
+
+    RunProvenance provenance = {0};
+    if (exit_code == 0) {
+        const ShardReport *first = &shards[0];
+        provenance.run_id = (char *)(run_id ? run_id : string_field(first->root, "runId"));
+        provenance.corpus_version = (char *)string_field(first->root, "corpusVersion");
+        provenance.c_commit = (char *)string_field(first->provenance, "cCommit");
+        provenance.wasm_commit = (char *)string_field(first->provenance, "wasmCommit");
+        provenance.platform = (char *)string_field(first->provenance, "platform");
+        provenance.artifacts_root = (char *)output_dir;
+        provenance.artifact_policy = string_field(first->root, "artifactPolicy");
+        /* The shards agree on engineFormat where they record it; take it from any that does. */
+        for (size_t i = 0; i < path_count && !provenance.engine_format; ++i) {
+            provenance.engine_format = string_field(shards[i].provenance, "engineFormat");
+        }
+        provenance.pass_gate = pass_gate;
+        provenance.max_duration_ms = max_duration_ms;
+        provenance.max_slowdown = max_slowdown;
+        provenance.repeat = (size_t)number_field(first->provenance, "repeat", 1.0);
+        provenance.warmup = (size_t)number_field(first->provenance, "warmup", 0.0);
+        provenance.outlier_mad = number_field(first->provenance, "outlierMad", 0.0);
+        provenance.merged_shards = path_count;
+
+        /* Shards run side by side, so the merged run takes as long as the slowest one. */
+        for (size_t i = 0; i < path_count; ++i) {
+            const ShardReport *shard = &shards[i];
+            const double duration_ms = number_field(shard->root, "durationMs", 0.0);
+            if (duration_ms > results.summary.duration_ms) {
+                results.summary.duration_ms = duration_ms;
+            }
+            if (!provenance.c_build_flags) {
+                provenance.c_build_flags = (char *)string_field(shard->provenance, "cBuildFlags");
+            }
+            if (!provenance.alt_build_flags) {
+                provenance.alt_build_flags = (char *)string_field(shard->provenance, "altBuildFlags");
+            }
+            if (cJSON_GetObjectItemCaseSensitive(shard->provenance, "cacheHits")) {
+                provenance.cache_enabled = true;
+                provenance.cache_hits += (size_t)number_field(shard->provenance, "cacheHits", 0.0);
+                provenance.cache_misses += (size_t)number_field(shard->provenance, "cacheMisses", 0.0);
+            }
+            if (!provenance.since_report) {
+                provenance.since_report = string_field(shard->provenance, "sinceReport");
+            }
+            provenance.carried_over += (size_t)number_field(shard->provenance, "carriedOverCases", 0.0);
+
+            memcpy(results.results + results.result_count, shard->cases.results,
+                   shard->cases.result_count * sizeof(ComparisonResult));
+            results.result_count += shard->cases.result_count;
+            /* The merged array owns the samples now. */
+            free(shard->cases.results);
+            shards[i].cases.results = NULL;
+            shards[i].cases.result_count = 0;
+        }
+
+        qsort(results.results, results.result_count, sizeof(ComparisonResult), compare_result_ids);
+        for (size_t i = 0; i < results.result_count; ++i) {
+            summarize_comparison(&results.results[i], &tolerance);
+        }
+
+        results.summary.stats_mode = stats_mode;
+        results.summary.percentiles = percentiles;
+        if (summarize_run_results(&results, &error) != 0) {
+            fprintf(stderr, "Failed to summarize merged run: %s\n", error.message ? error.message : "unknown error");
+            exit_code = 1;
+        } else if (compute_run_contributors(&results, 3, &error) != 0) {
+            fprintf(stderr, "Contributor analysis failed: %s\n", error.message ? error.message : "unknown error");
+        }
+    }
+
+    if (exit_code == 0) {
+        if (write_run_report(output_dir, &provenance, &results, &tolerance, &error) != 0) {
+            fprintf(stderr, "Failed to write merged report: %s\n", error.message ? error.message : "unknown error");
+            exit_code = 1;
+        } else {
+            printf("Merged %zu shards into %s/report.json\n", path_count, output_dir);
+            printf("Cases: %zu total, %zu passed, %zu failed | pass rate %.2f%% | duration %.1fms\n",
+                   results.summary.total_cases,
+                   results.summary.passed,
+                   results.summary.failed,
+                   results.summary.pass_rate * 100.0,
+                   results.summary.duration_ms);
+            if (results.summary.pass_rate < pass_gate || results.summary.duration_ms > max_duration_ms ||
+                (max_slowdown > 0.0 && results.summary.performance.slowdown > max_slowdown)) {
+                exit_code = 1;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < results.result_count; ++i) {
+        free_comparison_result(&results.results[i]);
+    }
+    free(results.results);
+    free_run_stats(&results.summary.stats);
+    for (size_t i = 0; shards && i < path_count; ++i) {
+        free_shard_report(&shards[i]);
+    }
+    free(shards);
+    free(paths);
+    free(error.message);
+    return exit_code;
+}
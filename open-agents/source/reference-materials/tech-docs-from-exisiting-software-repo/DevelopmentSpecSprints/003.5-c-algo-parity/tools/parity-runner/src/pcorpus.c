@@ -0,0 +1,659 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "types.h"
+
+/*
+ * Packed corpora (.pcorpus), written by `parity-corpus compile` from a corpus
+ * that already passed validation. Opening one maps the file and checks the
+ * header; cases are decoded from fixed-layout records when they are loaded, so
+ * there is no parse step. All integers and doubles are little-endian:
+ *
+ *   0   magic "PCOR"
+ *   4   u32 version
+ *   8   u64 file length
+ *   16  u64 case count
+ *   24  u64 anchor count
+ *   32  u64 tag reference count
+ *   40  u64 hash slot count (a power of two)
+ *   48  u64 string table length
+ *   56  u32 corpusVersion string, u32 description string
+ *   64  case records, anchor records, u32 tag references, u32 hash slots, strings
+ *
+ * Each section starts on an 8-byte boundary. Strings are NUL-terminated, interned
+ * (ids, tags, loop modes and versions are stored once) and referenced by their
+ * offset in the string table; PCORPUS_NO_STRING marks an absent one. Hash slots
+ * hold a case index + 1 (0 = empty), placed by linear probing on the FNV-1a hash
+ * of the id.
+ */
+
+#define PCORPUS_MAGIC "PCOR"
+#define PCORPUS_VERSION 1u
+#define PCORPUS_HEADER_SIZE 64u
+#define PCORPUS_NO_STRING 0xFFFFFFFFu
+#define CASE_RECORD_SIZE 96u
+#define ANCHOR_RECORD_SIZE 56u
+#define ANCHOR_HAS_OKLAB 1u
+#define ANCHOR_HAS_SRGB 2u
+#define CASE_HAS_VARIATION_SEED 1u
+
+static void set_error(ValidationError *error, const char *message) {
+    if (!error || !message) {
+        return;
+    }
+    free(error->message);
+    size_t len = strlen(message);
+    error->message = (char *)malloc(len + 1);
+    if (error->message) {
+        memcpy(error->message, message, len + 1);
+    }
+}
+
+static uint64_t read_u64(const unsigned char *p, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = bytes; i > 0; --i) {
+        value = (value << 8) | p[i - 1];
+    }
+    return value;
+}
+
+static void write_u64(unsigned char *p, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static double read_f64(const unsigned char *p) {
+    const uint64_t bits = read_u64(p, 8);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void write_f64(unsigned char *p, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    write_u64(p, bits, 8);
+}
+
+static uint32_t hash_id(const char *id) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)id; *c; ++c) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+static size_t align8(size_t offset) {
+    return (offset + 7u) & ~(size_t)7u;
+}
+
+static size_t hash_slot_count(size_t case_count) {
+    size_t slots = 8;
+    while (slots < case_count * 2) {
+        slots *= 2;
+    }
+    return slots;
+}
+
+/* Places the sections after the header from the counts in `packed`; fails if they do not fit in `length` bytes. */
+static int layout_sections(PackedCorpus *packed, size_t length) {
+    const size_t counts[4] = {packed->case_count, packed->anchor_count, packed->tag_ref_count, packed->slot_count};
+    const size_t sizes[4] = {CASE_RECORD_SIZE, ANCHOR_RECORD_SIZE, 4, 4};
+    size_t *offsets[4] = {&packed->cases_offset, &packed->anchors_offset, &packed->tags_offset, &packed->slots_offset};
+    size_t offset = PCORPUS_HEADER_SIZE;
+    for (size_t i = 0; i < 4; ++i) {
+        if (offset > length || counts[i] > (length - offset) / sizes[i]) {
+            return -1;
+        }
+        *offsets[i] = offset;
+        offset = align8(offset + counts[i] * sizes[i]);
+    }
+    packed->strings_offset = offset;
+    return offset <= length ? 0 : -1;
+}
+
+/* The NUL-terminated string at `ref`, or NULL when the reference is absent or out of bounds. */
+static const char *packed_string(const PackedCorpus *packed, uint32_t ref) {
+    if (ref == PCORPUS_NO_STRING || ref >= packed->strings_length) {
+        return NULL;
+    }
+    const char *strings = (const char *)packed->data + packed->strings_offset;
+    return memchr(strings + ref, '\0', packed->strings_length - ref) ? strings + ref : NULL;
+}
+
+static const unsigned char *case_record(const PackedCorpus *packed, size_t index) {
+    return packed->data + packed->cases_offset + index * CASE_RECORD_SIZE;
+}
+
+int is_packed_corpus_file(const char *path) {
+    FILE *file = path ? fopen(path, "rb") : NULL;
+    if (!file) {
+        return 0;
+    }
+    char magic[4];
+    const int packed = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, PCORPUS_MAGIC, 4) == 0;
+    fclose(file);
+    return packed;
+}
+
+int open_packed_corpus(const char *path, PackedCorpus *out, ValidationError *error) {
+    if (!path || !out) {
+        set_error(error, "invalid corpus arguments");
+        return -1;
+    }
+    memset(out, 0, sizeof(PackedCorpus));
+    const int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size < (off_t)PCORPUS_HEADER_SIZE) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        set_error(error, "failed to read corpus file");
+        return -1;
+    }
+    const size_t length = (size_t)info.st_size;
+    void *mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        set_error(error, "failed to read corpus file");
+        return -1;
+    }
+    out->data = (const unsigned char *)mapped;
+    out->length = length;
+
+    const unsigned char *header = out->data;
+    const char *failure = NULL;
+    if (memcmp(header, PCORPUS_MAGIC, 4) != 0) {
+        failure = "corpus is not a packed corpus";
+    } else if (read_u64(header + 4, 4) != PCORPUS_VERSION) {
+        failure = "unsupported packed corpus version";
+    } else {
+        const uint64_t counts[4] = {read_u64(header + 16, 8), read_u64(header + 24, 8), read_u64(header + 32, 8),
+                                    read_u64(header + 40, 8)};
+        const int counts_fit = counts[0] <= length && counts[1] <= length && counts[2] <= length && counts[3] <= length;
+        out->case_count = counts_fit ? (size_t)counts[0] : 0;
+        out->anchor_count = counts_fit ? (size_t)counts[1] : 0;
+        out->tag_ref_count = counts_fit ? (size_t)counts[2] : 0;
+        out->slot_count = counts_fit ? (size_t)counts[3] : 0;
+        out->strings_length = (size_t)read_u64(header + 48, 8);
+        if (!counts_fit || read_u64(header + 8, 8) != (uint64_t)length || out->case_count == 0 ||
+            out->slot_count < out->case_count || (out->slot_count & (out->slot_count - 1)) != 0 ||
+            layout_sections(out, length) != 0 || out->strings_length != length - out->strings_offset) {
+            failure = "packed corpus is corrupt";
+        }
+    }
+    const char *version = failure ? NULL : packed_string(out, (uint32_t)read_u64(header + 56, 4));
+    if (!failure && !validate_corpus_version(version)) {
+        failure = "corpusVersion must match vYYYYMMDD.n";
+    }
+    if (failure) {
+        close_packed_corpus(out);
+        set_error(error, failure);
+        return -1;
+    }
+    strncpy(out->corpus_version, version, MAX_VERSION_LENGTH - 1);
+    out->description = packed_string(out, (uint32_t)read_u64(header + 60, 4));
+    return 0;
+}
+
+const char *packed_case_id(const PackedCorpus *packed, size_t index) {
+    if (!packed || index >= packed->case_count) {
+        return NULL;
+    }
+    return packed_string(packed, (uint32_t)read_u64(case_record(packed, index), 4));
+}
+
+int packed_corpus_find(const PackedCorpus *packed, const char *id, size_t *index) {
+    if (!packed || !id || !index) {
+        return -1;
+    }
+    const unsigned char *slots = packed->data + packed->slots_offset;
+    const size_t mask = packed->slot_count - 1;
+    for (size_t probe = 0, slot = hash_id(id) & mask; probe < packed->slot_count; ++probe, slot = (slot + 1) & mask) {
+        const uint64_t entry = read_u64(slots + 4 * slot, 4);
+        if (entry == 0) {
+            return -1;
+        }
+        const char *candidate = packed_case_id(packed, (size_t)(entry - 1));
+        if (candidate && strcmp(candidate, id) == 0) {
+            *index = (size_t)(entry - 1);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int packed_case_has_tag(const PackedCorpus *packed, size_t index, const char *tag) {
+    if (!packed || !tag || index >= packed->case_count) {
+        return 0;
+    }
+    const unsigned char *record = case_record(packed, index);
+    const uint64_t first = read_u64(record + 24, 4);
+    const uint64_t count = read_u64(record + 28, 4);
+    if (first > packed->tag_ref_count || count > packed->tag_ref_count - first) {
+        return 0;
+    }
+    const unsigned char *refs = packed->data + packed->tags_offset + 4 * first;
+    for (uint64_t i = 0; i < count; ++i) {
+        const char *candidate = packed_string(packed, (uint32_t)read_u64(refs + 4 * i, 4));
+        if (candidate && strcmp(candidate, tag) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static char *dup_string(Arena *arena, const char *text, int *ok) {
+    if (!text) {
+        return NULL;
+    }
+    char *copy = arena ? arena_strdup(arena, text) : strdup(text);
+    *ok = *ok && copy != NULL;
+    return copy;
+}
+
+/*
+ * Decodes one case record into the arena, or onto the heap without one; every
+ * reference is bounds-checked since the file is not re-validated on open.
+ */
+static int decode_case(const PackedCorpus *packed, size_t index, Arena *arena, InputCase *out, ValidationError *error) {
+    memset(out, 0, sizeof(InputCase));
+    const unsigned char *record = case_record(packed, index);
+    const char *id = packed_string(packed, (uint32_t)read_u64(record, 4));
+    const char *version = packed_string(packed, (uint32_t)read_u64(record + 4, 4));
+    const uint32_t loop_mode_ref = (uint32_t)read_u64(record + 8, 4);
+    const uint32_t notes_ref = (uint32_t)read_u64(record + 12, 4);
+    const uint64_t first_anchor = read_u64(record + 16, 4);
+    const uint64_t anchor_count = read_u64(record + 20, 4);
+    const uint64_t first_tag = read_u64(record + 24, 4);
+    const uint64_t tag_count = read_u64(record + 28, 4);
+    if (!id || strlen(id) >= MAX_ID_LENGTH || !version || strlen(version) >= MAX_VERSION_LENGTH ||
+        (loop_mode_ref != PCORPUS_NO_STRING && !packed_string(packed, loop_mode_ref)) ||
+        (notes_ref != PCORPUS_NO_STRING && !packed_string(packed, notes_ref)) || anchor_count == 0 ||
+        first_anchor > packed->anchor_count || anchor_count > packed->anchor_count - first_anchor ||
+        first_tag > packed->tag_ref_count || tag_count > packed->tag_ref_count - first_tag) {
+        set_error(error, "packed corpus is corrupt");
+        return -1;
+    }
+    const unsigned char *refs = packed->data + packed->tags_offset + 4 * first_tag;
+    for (uint64_t i = 0; i < tag_count; ++i) {
+        if (!packed_string(packed, (uint32_t)read_u64(refs + 4 * i, 4))) {
+            set_error(error, "packed corpus is corrupt");
+            return -1;
+        }
+    }
+
+    strncpy(out->id, id, MAX_ID_LENGTH - 1);
+    strncpy(out->corpus_version, version, MAX_VERSION_LENGTH - 1);
+    out->seed = read_u64(record + 32, 8);
+    out->config.variation_seed = read_u64(record + 40, 8);
+    out->config.lightness = read_f64(record + 48);
+    out->config.chroma = read_f64(record + 56);
+    out->config.contrast = read_f64(record + 64);
+    out->config.vibrancy = read_f64(record + 72);
+    out->config.temperature = read_f64(record + 80);
+    out->config.count = (uint32_t)read_u64(record + 88, 4);
+    out->config.has_variation_seed = (read_u64(record + 92, 4) & CASE_HAS_VARIATION_SEED) != 0;
+
+    int ok = 1;
+    out->config.loop_mode = dup_string(arena, packed_string(packed, loop_mode_ref), &ok);
+    out->notes = dup_string(arena, packed_string(packed, notes_ref), &ok);
+    if (arena) {
+        out->anchors = (Anchor *)arena_calloc(arena, (size_t)anchor_count, sizeof(Anchor));
+        out->tags = tag_count > 0 ? (char **)arena_calloc(arena, (size_t)tag_count, sizeof(char *)) : NULL;
+    } else {
+        out->anchors = (Anchor *)calloc((size_t)anchor_count, sizeof(Anchor));
+        out->tags = tag_count > 0 ? (char **)calloc((size_t)tag_count, sizeof(char *)) : NULL;
+    }
+    ok = ok && out->anchors && (tag_count == 0 || out->tags);
+    if (!ok) {
+        goto fail;
+    }
+    out->anchor_count = (size_t)anchor_count;
+    const unsigned char *anchor = packed->data + packed->anchors_offset + first_anchor * ANCHOR_RECORD_SIZE;
+    for (size_t i = 0; i < out->anchor_count; ++i, anchor += ANCHOR_RECORD_SIZE) {
+        const uint64_t flags = read_u64(anchor, 4);
+        out->anchors[i].has_oklab = (flags & ANCHOR_HAS_OKLAB) != 0;
+        out->anchors[i].has_srgb = (flags & ANCHOR_HAS_SRGB) != 0;
+        out->anchors[i].oklab.l = read_f64(anchor + 8);
+        out->anchors[i].oklab.a = read_f64(anchor + 16);
+        out->anchors[i].oklab.b = read_f64(anchor + 24);
+        out->anchors[i].srgb.r = read_f64(anchor + 32);
+        out->anchors[i].srgb.g = read_f64(anchor + 40);
+        out->anchors[i].srgb.b = read_f64(anchor + 48);
+    }
+    out->tag_count = (size_t)tag_count;
+    for (size_t i = 0; i < out->tag_count; ++i) {
+        out->tags[i] = dup_string(arena, packed_string(packed, (uint32_t)read_u64(refs + 4 * i, 4)), &ok);
+    }
+    if (!ok) {
+        goto fail;
+    }
+    return 0;
+
+fail:
+    if (arena) {
+        memset(out, 0, sizeof(InputCase));
+    } else {
+        free_input_case(out);
+    }
+    set_error(error, "failed to allocate cases");
+    return -1;
+}
+
+int load_packed_case(const PackedCorpus *packed, size_t index, InputCase *out, ValidationError *error) {
+    if (!packed || !out || index >= packed->case_count) {
+        set_error(error, "invalid corpus arguments");
+        return -1;
+    }
+    return decode_case(packed, index, NULL, out, error);
+}
+
+int load_packed_cases(const PackedCorpus *packed, const size_t *cases, size_t count, Corpus *out, ValidationError *error) {
+    if (!packed || !out || (count > 0 && !cases)) {
+        set_error(error, "invalid corpus arguments");
+        return -1;
+    }
+    memset(out, 0, sizeof(Corpus));
+    memcpy(out->corpus_version, packed->corpus_version, sizeof(out->corpus_version));
+    if (packed->description) {
+        out->description = arena_strdup(&out->arena, packed->description);
+    }
+    if (count == 0) {
+        return 0;
+    }
+    out->cases = (InputCase *)arena_calloc(&out->arena, count, sizeof(InputCase));
+    if (!out->cases) {
+        free_corpus(out);
+        set_error(error, "failed to allocate cases");
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        out->case_count = i + 1;
+        if (cases[i] >= packed->case_count) {
+            set_error(error, "invalid corpus arguments");
+            free_corpus(out);
+            return -1;
+        }
+        if (decode_case(packed, cases[i], &out->arena, &out->cases[i], error) != 0) {
+            free_corpus(out);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int parse_packed_corpus_file(const char *path, Corpus *out, ValidationError *error) {
+    PackedCorpus packed;
+    if (open_packed_corpus(path, &packed, error) != 0) {
+        return -1;
+    }
+    size_t *all = (size_t *)malloc(packed.case_count * sizeof(size_t));
+    if (!all) {
+        close_packed_corpus(&packed);
+        set_error(error, "failed to allocate cases");
+        return -1;
+    }
+    for (size_t i = 0; i < packed.case_count; ++i) {
+        all[i] = i;
+    }
+    const int status = load_packed_cases(&packed, all, packed.case_count, out, error);
+    free(all);
+    close_packed_corpus(&packed);
+    return status;
+}
+
+void close_packed_corpus(PackedCorpus *packed) {
+    if (!packed) {
+        return;
+    }
+    if (packed->data) {
+        munmap((void *)packed->data, packed->length);
+    }
+    memset(packed, 0, sizeof(PackedCorpus));
+}
+
+/* Interned string table used while writing: open addressing over string offsets. */
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    uint32_t *slots; /* offset + 1, 0 = empty */
+    size_t slot_count;
+    size_t string_count;
+} StringTable;
+
+static int string_table_grow_slots(StringTable *table) {
+    const size_t slot_count = table->slot_count ? table->slot_count * 2 : 256;
+    uint32_t *slots = (uint32_t *)calloc(slot_count, sizeof(uint32_t));
+    if (!slots) {
+        return -1;
+    }
+    for (size_t i = 0; i < table->slot_count; ++i) {
+        if (table->slots[i] == 0) {
+            continue;
+        }
+        size_t slot = hash_id(table->data + table->slots[i] - 1) & (slot_count - 1);
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = table->slots[i];
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->slot_count = slot_count;
+    return 0;
+}
+
+/* Returns the offset of `text` in the table, adding it on first use; PCORPUS_NO_STRING for NULL. */
+static int intern_string(StringTable *table, const char *text, uint32_t *ref) {
+    if (!text) {
+        *ref = PCORPUS_NO_STRING;
+        return 0;
+    }
+    if ((table->string_count + 1) * 2 > table->slot_count && string_table_grow_slots(table) != 0) {
+        return -1;
+    }
+    size_t slot = hash_id(text) & (table->slot_count - 1);
+    while (table->slots[slot] != 0) {
+        if (strcmp(table->data + table->slots[slot] - 1, text) == 0) {
+            *ref = table->slots[slot] - 1;
+            return 0;
+        }
+        slot = (slot + 1) & (table->slot_count - 1);
+    }
+    const size_t length = strlen(text) + 1;
+    if (table->length + length >= PCORPUS_NO_STRING) {
+        return -1;
+    }
+    if (table->length + length > table->capacity) {
+        size_t capacity = table->capacity ? table->capacity : 4096;
+        while (capacity < table->length + length) {
+            capacity *= 2;
+        }
+        char *grown = (char *)realloc(table->data, capacity);
+        if (!grown) {
+            return -1;
+        }
+        table->data = grown;
+        table->capacity = capacity;
+    }
+    memcpy(table->data + table->length, text, length);
+    *ref = (uint32_t)table->length;
+    table->slots[slot] = (uint32_t)table->length + 1;
+    table->length += length;
+    table->string_count++;
+    return 0;
+}
+
+static int write_all(FILE *file, const void *data, size_t length) {
+    return length == 0 || fwrite(data, 1, length, file) == length ? 0 : -1;
+}
+
+int write_packed_corpus(const Corpus *corpus, const char *path, ValidationError *error) {
+    if (!corpus || !path || corpus->case_count == 0) {
+        set_error(error, "invalid corpus arguments");
+        return -1;
+    }
+    size_t anchor_count = 0;
+    size_t tag_ref_count = 0;
+    for (size_t i = 0; i < corpus->case_count; ++i) {
+        anchor_count += corpus->cases[i].anchor_count;
+        tag_ref_count += corpus->cases[i].tag_count;
+    }
+    if (corpus->case_count >= UINT32_MAX || anchor_count >= UINT32_MAX || tag_ref_count >= UINT32_MAX) {
+        set_error(error, "corpus is too large for the packed format");
+        return -1;
+    }
+
+    PackedCorpus layout = {.case_count = corpus->case_count, .anchor_count = anchor_count,
+                           .tag_ref_count = tag_ref_count, .slot_count = hash_slot_count(corpus->case_count)};
+    StringTable strings = {0};
+    unsigned char *cases = (unsigned char *)calloc(corpus->case_count, CASE_RECORD_SIZE);
+    unsigned char *anchors = (unsigned char *)calloc(anchor_count ? anchor_count : 1, ANCHOR_RECORD_SIZE);
+    unsigned char *tag_refs = (unsigned char *)calloc(tag_ref_count ? tag_ref_count : 1, 4);
+    uint32_t *slots = (uint32_t *)calloc(layout.slot_count, sizeof(uint32_t));
+    const char *failure = !cases || !anchors || !tag_refs || !slots ? "failed to allocate packed corpus" : NULL;
+
+    uint32_t version_ref = 0;
+    uint32_t description_ref = 0;
+    if (!failure && (intern_string(&strings, corpus->corpus_version, &version_ref) != 0 ||
+                     intern_string(&strings, corpus->description, &description_ref) != 0)) {
+        failure = "failed to allocate packed corpus";
+    }
+    size_t next_anchor = 0;
+    size_t next_tag = 0;
+    for (size_t i = 0; !failure && i < corpus->case_count; ++i) {
+        const InputCase *input_case = &corpus->cases[i];
+        unsigned char *record = cases + i * CASE_RECORD_SIZE;
+        uint32_t refs[4];
+        if (intern_string(&strings, input_case->id, &refs[0]) != 0 ||
+            intern_string(&strings, input_case->corpus_version, &refs[1]) != 0 ||
+            intern_string(&strings, input_case->config.loop_mode, &refs[2]) != 0 ||
+            intern_string(&strings, input_case->notes, &refs[3]) != 0) {
+            failure = "failed to allocate packed corpus";
+            break;
+        }
+        /* The hash index needs unique ids; the first case with an id is the one lookups find anyway. */
+        size_t slot = hash_id(input_case->id) & (layout.slot_count - 1);
+        while (slots[slot] != 0) {
+            if (strcmp(corpus->cases[slots[slot] - 1].id, input_case->id) == 0) {
+                failure = "corpus contains duplicate case ids";
+                break;
+            }
+            slot = (slot + 1) & (layout.slot_count - 1);
+        }
+        if (failure) {
+            break;
+        }
+        slots[slot] = (uint32_t)i + 1;
+
+        for (size_t r = 0; r < 4; ++r) {
+            write_u64(record + 4 * r, refs[r], 4);
+        }
+        write_u64(record + 16, next_anchor, 4);
+        write_u64(record + 20, input_case->anchor_count, 4);
+        write_u64(record + 24, next_tag, 4);
+        write_u64(record + 28, input_case->tag_count, 4);
+        write_u64(record + 32, input_case->seed, 8);
+        write_u64(record + 40, input_case->config.variation_seed, 8);
+        write_f64(record + 48, input_case->config.lightness);
+        write_f64(record + 56, input_case->config.chroma);
+        write_f64(record + 64, input_case->config.contrast);
+        write_f64(record + 72, input_case->config.vibrancy);
+        write_f64(record + 80, input_case->config.temperature);
+        write_u64(record + 88, input_case->config.count, 4);
+        write_u64(record + 92, input_case->config.has_variation_seed ? CASE_HAS_VARIATION_SEED : 0u, 4);
+
+        for (size_t a = 0; a < input_case->anchor_count; ++a, ++next_anchor) {
+            const Anchor *source = &input_case->anchors[a];
+            unsigned char *anchor = anchors + next_anchor * ANCHOR_RECORD_SIZE;
+            write_u64(anchor, (source->has_oklab ? ANCHOR_HAS_OKLAB : 0u) | (source->has_srgb ? ANCHOR_HAS_SRGB : 0u), 4);
+            write_f64(anchor + 8, source->oklab.l);
+            write_f64(anchor + 16, source->oklab.a);
+            write_f64(anchor + 24, source->oklab.b);
+            write_f64(anchor + 32, source->srgb.r);
+            write_f64(anchor + 40, source->srgb.g);
+            write_f64(anchor + 48, source->srgb.b);
+        }
+        for (size_t t = 0; t < input_case->tag_count; ++t, ++next_tag) {
+            uint32_t tag_ref;
+            if (intern_string(&strings, input_case->tags[t], &tag_ref) != 0) {
+                failure = "failed to allocate packed corpus";
+                break;
+            }
+            write_u64(tag_refs + 4 * next_tag, tag_ref, 4);
+        }
+    }
+
+    FILE *file = NULL;
+    if (!failure) {
+        layout_sections(&layout, SIZE_MAX);
+        const size_t total = layout.strings_offset + strings.length;
+        unsigned char header[PCORPUS_HEADER_SIZE] = {0};
+        memcpy(header, PCORPUS_MAGIC, 4);
+        write_u64(header + 4, PCORPUS_VERSION, 4);
+        write_u64(header + 8, total, 8);
+        write_u64(header + 16, corpus->case_count, 8);
+        write_u64(header + 24, anchor_count, 8);
+        write_u64(header + 32, tag_ref_count, 8);
+        write_u64(header + 40, layout.slot_count, 8);
+        write_u64(header + 48, strings.length, 8);
+        write_u64(header + 56, version_ref, 4);
+        write_u64(header + 60, description_ref, 4);
+
+        /* Rewrite the slots in place as little-endian bytes. */
+        unsigned char *slot_bytes = (unsigned char *)slots;
+        for (size_t s = 0; s < layout.slot_count; ++s) {
+            const uint32_t value = slots[s];
+            write_u64(slot_bytes + 4 * s, value, 4);
+        }
+        static const unsigned char padding[8] = {0};
+        const struct {
+            const void *data;
+            size_t length;
+            size_t next_offset;
+        } sections[] = {
+            {header, PCORPUS_HEADER_SIZE, layout.cases_offset},
+            {cases, corpus->case_count * CASE_RECORD_SIZE, layout.anchors_offset},
+            {anchors, anchor_count * ANCHOR_RECORD_SIZE, layout.tags_offset},
+            {tag_refs, tag_ref_count * 4, layout.slots_offset},
+            {slot_bytes, layout.slot_count * 4, layout.strings_offset},
+            {strings.data, strings.length, total},
+        };
+        file = fopen(path, "wb");
+        size_t written = 0;
+        for (size_t s = 0; file && !failure && s < sizeof(sections) / sizeof(sections[0]); ++s) {
+            written += sections[s].length;
+            if (write_all(file, sections[s].data, sections[s].length) != 0 ||
+                write_all(file, padding, sections[s].next_offset - written) != 0) {
+                failure = "failed to write packed corpus";
+            }
+            written = sections[s].next_offset;
+        }
+        if (!file || fclose(file) != 0 || failure) {
+            failure = "failed to write packed corpus";
+            remove(path);
+        }
+    }
+
+    free(cases);
+    free(anchors);
+    free(tag_refs);
+    free(slots);
+    free(strings.data);
+    free(strings.slots);
+    if (failure) {
+        set_error(error, failure);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,137 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "parity_plugin.h"
+#include "types.h"
+
+struct EnginePlugin {
+    void *handle;
+    const ParityEnginePlugin *descriptor;
+};
+
+static void set_error(ValidationError *error, const char *message) {
+    if (!error || !message) {
+        return;
+    }
+    free(error->message);
+    size_t len = strlen(message);
+    error->message = (char *)malloc(len + 1);
+    if (error->message) {
+        memcpy(error->message, message, len + 1);
+    }
+}
+
+static double monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1.0e6;
+}
+
+static char *dup_optional(const char *value) {
+    return value ? strdup(value) : NULL;
+}
+
+EnginePlugin *load_engine_plugin(const char *path, ValidationError *error) {
+    if (!path) {
+        set_error(error, "invalid engine plugin path");
+        return NULL;
+    }
+
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        char message[MAX_ERROR_MESSAGE];
+        snprintf(message, sizeof(message), "failed to load engine plugin: %s", dlerror());
+        set_error(error, message);
+        return NULL;
+    }
+
+    /* dlsym returns void *; copying through memcpy keeps the function-pointer conversion portable under -pedantic. */
+    void *symbol = dlsym(handle, PARITY_PLUGIN_ENTRY_SYMBOL);
+    if (!symbol) {
+        dlclose(handle);
+        set_error(error, "engine plugin does not export " PARITY_PLUGIN_ENTRY_SYMBOL);
+        return NULL;
+    }
+    ParityEnginePluginEntry entry;
+    memcpy(&entry, &symbol, sizeof(entry));
+
+    const ParityEnginePlugin *descriptor = entry();
+    if (!descriptor || !descriptor->generate || !descriptor->engine) {
+        dlclose(handle);
+        set_error(error, "engine plugin returned an incomplete descriptor");
+        return NULL;
+    }
+    if (descriptor->abi_version != PARITY_PLUGIN_ABI_VERSION ||
+        descriptor->input_case_size != sizeof(InputCase) ||
+        descriptor->engine_color_size != sizeof(EngineColor)) {
+        dlclose(handle);
+        set_error(error, "engine plugin ABI version mismatch");
+        return NULL;
+    }
+
+    EnginePlugin *plugin = (EnginePlugin *)calloc(1, sizeof(EnginePlugin));
+    if (!plugin) {
+        dlclose(handle);
+        set_error(error, "failed to allocate engine plugin");
+        return NULL;
+    }
+    plugin->handle = handle;
+    plugin->descriptor = descriptor;
+    return plugin;
+}
+
+int run_engine_plugin(const EnginePlugin *plugin,
+                      const InputCase *input_case,
+                      EngineOutput *out,
+                      ValidationError *error) {
+    if (!plugin || !input_case || !out) {
+        set_error(error, "invalid engine plugin request");
+        return -1;
+    }
+    memset(out, 0, sizeof(EngineOutput));
+
+    const size_t capacity = input_case->config.count;
+    out->colors = (EngineColor *)calloc(capacity ? capacity : 1, sizeof(EngineColor));
+    if (!out->colors) {
+        set_error(error, "failed to allocate engine colors");
+        return -1;
+    }
+
+    const ParityEnginePlugin *descriptor = plugin->descriptor;
+    char message[MAX_ERROR_MESSAGE] = {0};
+    size_t produced = 0;
+    const double start_ms = monotonic_ms();
+    const int status = descriptor->generate(input_case, out->colors, capacity, &produced, message, sizeof(message));
+    out->duration_ms = monotonic_ms() - start_ms;
+
+    if (status != 0) {
+        free_engine_output(out);
+        set_error(error, message[0] ? message : "engine plugin failed to generate colors");
+        return -1;
+    }
+    if (produced == 0 || produced > capacity) {
+        free_engine_output(out);
+        set_error(error, "engine output contains no colors");
+        return -1;
+    }
+
+    out->color_count = produced;
+    strncpy(out->engine, descriptor->engine, sizeof(out->engine) - 1);
+    out->commit = dup_optional(descriptor->commit);
+    out->build_flags = dup_optional(descriptor->build_flags);
+    out->platform = dup_optional(descriptor->platform);
+    return 0;
+}
+
+void unload_engine_plugin(EnginePlugin *plugin) {
+    if (!plugin) {
+        return;
+    }
+    dlclose(plugin->handle);
+    free(plugin);
+}
@@ -2,9 +2,10 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "cJSON.h"
 #include "types.h"
 
+#define JSON_FILE_BUFFER (1 << 16)
+
 static void set_error(ValidationError *error, const char *message) {
     if (!error || !message) {
         return;
@@ -17,111 +18,319 @@ static void set_error(ValidationError *error, const char *message) {
     }
 }
 
-static cJSON *oklab_to_json(const OklabColor *c) {
-    cJSON *node = cJSON_CreateObject();
-    cJSON_AddNumberToObject(node, "l", c->l);
-    cJSON_AddNumberToObject(node, "a", c->a);
-    cJSON_AddNumberToObject(node, "b", c->b);
-    return node;
+static void write_oklab(JsonWriter *w, const char *key, const OklabColor *c) {
+    json_begin_object(w, key);
+    json_write_number(w, "l", c->l);
+    json_write_number(w, "a", c->a);
+    json_write_number(w, "b", c->b);
+    json_end_object(w);
 }
 
-static cJSON *srgb_to_json(const SrgbColor *c) {
-    cJSON *node = cJSON_CreateObject();
-    cJSON_AddNumberToObject(node, "r", c->r);
-    cJSON_AddNumberToObject(node, "g", c->g);
-    cJSON_AddNumberToObject(node, "b", c->b);
-    return node;
+static void write_srgb(JsonWriter *w, const char *key, const SrgbColor *c) {
+    json_begin_object(w, key);
+    json_write_number(w, "r", c->r);
+    json_write_number(w, "g", c->g);
+    json_write_number(w, "b", c->b);
+    json_end_object(w);
 }
 
-static cJSON *engine_output_json(const EngineOutput *output) {
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "engine", output->engine);
-    cJSON_AddNumberToObject(root, "durationMs", output->duration_ms);
-    cJSON_AddNumberToObject(root, "count", (double)output->color_count);
-    if (output->commit) cJSON_AddStringToObject(root, "commit", output->commit);
-    if (output->build_flags) cJSON_AddStringToObject(root, "buildFlags", output->build_flags);
-    if (output->platform) cJSON_AddStringToObject(root, "platform", output->platform);
+static void write_engine_output(JsonWriter *w, const EngineOutput *output) {
+    json_begin_object(w, NULL);
+    json_write_string(w, "engine", output->engine);
+    json_write_number(w, "durationMs", output->duration_ms);
+    if (output->wall_ms > 0.0) {
+        json_write_number(w, "wallMs", output->wall_ms);
+    }
+    json_write_number(w, "count", (double)output->color_count);
+    if (output->commit) json_write_string(w, "commit", output->commit);
+    if (output->build_flags) json_write_string(w, "buildFlags", output->build_flags);
+    if (output->platform) json_write_string(w, "platform", output->platform);
 
-    cJSON *colors = cJSON_AddArrayToObject(root, "colors");
+    json_begin_array(w, "colors");
     for (size_t i = 0; i < output->color_count; ++i) {
-        cJSON *entry = cJSON_CreateObject();
-        cJSON_AddItemToObject(entry, "oklab", oklab_to_json(&output->colors[i].oklab));
-        cJSON_AddItemToObject(entry, "rgb", srgb_to_json(&output->colors[i].srgb));
-        cJSON_AddItemToArray(colors, entry);
+        json_begin_object(w, NULL);
+        write_oklab(w, "oklab", &output->colors[i].oklab);
+        write_srgb(w, "rgb", &output->colors[i].srgb);
+        json_end_object(w);
     }
-    return root;
+    json_end_array(w);
+    json_end_object(w);
 }
 
-static cJSON *comparison_json(const ComparisonResult *result) {
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "inputCaseId", result->input_case_id);
-    cJSON_AddBoolToObject(root, "passed", result->passed ? 1 : 0);
-    cJSON_AddNumberToObject(root, "maxDeltaE", result->max_delta_e);
+static void write_case_timing(JsonWriter *w, const CaseTiming *timing) {
+    json_begin_object(w, "timing");
+    json_write_number(w, "spawnMs", timing->spawn_ms);
+    json_write_number(w, "waitMs", timing->wait_ms);
+    json_write_number(w, "parseMs", timing->parse_ms);
+    json_write_number(w, "compareMs", timing->compare_ms);
+    json_write_number(w, "writeMs", timing->write_ms);
+    json_write_number(w, "totalMs", timing->total_ms);
+    json_end_object(w);
+}
 
-    cJSON *samples = cJSON_AddArrayToObject(root, "samples");
-    for (size_t i = 0; i < result->sample_count; ++i) {
-        const SampleDelta *sample = &result->samples[i];
-        cJSON *entry = cJSON_CreateObject();
-        cJSON_AddNumberToObject(entry, "index", (double)sample->index);
-        cJSON_AddItemToObject(entry, "delta", oklab_to_json(&(OklabColor){
-            .l = sample->delta.l,
-            .a = sample->delta.a,
-            .b = sample->delta.b
-        }));
-        cJSON_AddNumberToObject(entry, "deltaE", sample->delta.deltaE);
-        cJSON_AddItemToObject(entry, "rgbDelta", srgb_to_json(&(SrgbColor){
-            .r = sample->rgb_delta.r,
-            .g = sample->rgb_delta.g,
-            .b = sample->rgb_delta.b
-        }));
-        cJSON_AddItemToObject(entry, "canonical", oklab_to_json(&sample->canonical.oklab));
-        cJSON_AddItemToObject(entry, "alternate", oklab_to_json(&sample->alternate.oklab));
-        cJSON_AddItemToArray(samples, entry);
-    }
-
-    if (result->contributors && result->contributor_count > 0) {
-        cJSON *contributors = cJSON_AddArrayToObject(root, "topContributors");
-        for (size_t i = 0; i < result->contributor_count; ++i) {
-            const Contributor *hint = &result->contributors[i];
-            cJSON *entry = cJSON_CreateObject();
-            cJSON_AddStringToObject(entry, "metric", hint->metric);
-            cJSON_AddNumberToObject(entry, "magnitude", hint->magnitude);
-            cJSON_AddStringToObject(entry, "direction", hint->direction);
-            if (hint->stage) cJSON_AddStringToObject(entry, "stage", hint->stage);
-            if (hint->parameter) cJSON_AddStringToObject(entry, "parameter", hint->parameter);
-            cJSON_AddNumberToObject(entry, "zScore", hint->z_score);
-            cJSON_AddBoolToObject(entry, "significant", hint->significant ? 1 : 0);
-            cJSON_AddItemToArray(contributors, entry);
+static void write_trial_stats(JsonWriter *w, const char *key, const TrialStats *trials) {
+    json_begin_object(w, key);
+    json_write_number(w, "trials", (double)trials->trials);
+    json_write_number(w, "rejected", (double)trials->rejected);
+    json_write_number(w, "medianMs", trials->median_ms);
+    json_write_number(w, "madMs", trials->mad_ms);
+    json_write_number(w, "minMs", trials->min_ms);
+    json_end_object(w);
+}
+
+static void write_contributors(JsonWriter *w, const ComparisonResult *result) {
+    if (!result->contributors || result->contributor_count == 0) {
+        return;
+    }
+    json_begin_array(w, "topContributors");
+    for (size_t i = 0; i < result->contributor_count; ++i) {
+        const Contributor *hint = &result->contributors[i];
+        json_begin_object(w, NULL);
+        json_write_string(w, "metric", hint->metric);
+        json_write_number(w, "magnitude", hint->magnitude);
+        json_write_string(w, "direction", hint->direction);
+        if (hint->stage) json_write_string(w, "stage", hint->stage);
+        if (hint->parameter) json_write_string(w, "parameter", hint->parameter);
+        json_write_number(w, "zScore", hint->z_score);
+        json_write_bool(w, "significant", hint->significant);
+        json_end_object(w);
+    }
+    json_end_array(w);
+}
+
+/* One case of report.json and diff.json; samples are derived and written one at a time. */
+static void write_comparison(JsonWriter *w, const ComparisonResult *result) {
+    json_begin_object(w, NULL);
+    json_write_string(w, "inputCaseId", result->input_case_id);
+    json_write_bool(w, "passed", result->passed);
+    json_write_number(w, "maxDeltaE", result->max_delta_e);
+    if (result->fingerprint[0] != '\0') {
+        json_write_string(w, "fingerprint", result->fingerprint);
+    }
+    if (result->carried_over) {
+        json_write_bool(w, "carriedOver", true);
+    }
+    if (case_speed_ratio(result) > 0.0) {
+        json_write_number(w, "canonicalDurationMs", result->canonical_duration_ms);
+        json_write_number(w, "alternateDurationMs", result->alternate_duration_ms);
+        json_write_number(w, "speedRatio", case_speed_ratio(result));
+    }
+    if (result->timing.total_ms > 0.0) {
+        write_case_timing(w, &result->timing);
+    }
+    if (result->canonical_trials.trials > 0) {
+        json_begin_object(w, "durationTrials");
+        write_trial_stats(w, "canonical", &result->canonical_trials);
+        write_trial_stats(w, "alternate", &result->alternate_trials);
+        json_end_object(w);
+    }
+    if (result->nondeterministic) {
+        json_begin_array(w, "nondeterministic");
+        if (result->nondeterministic & NONDETERMINISTIC_CANONICAL) {
+            json_write_string(w, NULL, "canonical");
         }
+        if (result->nondeterministic & NONDETERMINISTIC_ALTERNATE) {
+            json_write_string(w, NULL, "alternate");
+        }
+        json_end_array(w);
     }
-    return root;
+
+    json_begin_array(w, "samples");
+    for (size_t i = 0; i < result->sample_count; ++i) {
+        SampleDelta sample;
+        comparison_sample(result, i, &sample);
+        json_begin_object(w, NULL);
+        json_write_number(w, "index", (double)sample.index);
+        write_oklab(w, "delta", &(OklabColor){.l = sample.delta.l, .a = sample.delta.a, .b = sample.delta.b});
+        json_write_number(w, "deltaE", sample.delta.deltaE);
+        write_srgb(w, "rgbDelta", &(SrgbColor){.r = sample.rgb_delta.r, .g = sample.rgb_delta.g, .b = sample.rgb_delta.b});
+        write_oklab(w, "canonical", &sample.canonical.oklab);
+        write_oklab(w, "alternate", &sample.alternate.oklab);
+        json_end_object(w);
+    }
+    json_end_array(w);
+
+    write_contributors(w, result);
+    json_end_object(w);
 }
 
-static cJSON *histogram_json(const Histogram *hist) {
-    cJSON *root = cJSON_CreateObject();
+/*
+ * Bucket counts run-length encoded: a positive entry is one bucket's count,
+ * a negative entry -n stands for n empty buckets. Trailing empty buckets are
+ * dropped.
+ */
+static void write_log_histogram(JsonWriter *w, const char *key, const LogHistogram *hist) {
+    json_begin_object(w, key);
     if (!hist || !hist->counts) {
-        return root;
+        json_end_object(w);
+        return;
+    }
+    json_write_number(w, "total", (double)hist->total);
+    json_write_number(w, "underflow", (double)hist->underflow);
+    json_write_number(w, "overflow", (double)hist->overflow);
+    if (hist->nan_count > 0) {
+        json_write_number(w, "nan", (double)hist->nan_count);
+    }
+    json_begin_array(w, "counts");
+    size_t empty_run = 0;
+    for (size_t i = 0; i < LOG_HISTOGRAM_BUCKETS; ++i) {
+        if (hist->counts[i] == 0) {
+            empty_run++;
+            continue;
+        }
+        if (empty_run > 0) {
+            json_write_number(w, NULL, -(double)empty_run);
+            empty_run = 0;
+        }
+        json_write_number(w, NULL, (double)hist->counts[i]);
+    }
+    json_end_array(w);
+    json_end_object(w);
+}
+
+static void write_run_histograms(JsonWriter *w, const RunStats *stats) {
+    json_begin_object(w, "histograms");
+    json_write_number(w, "minExponent", LOG_HISTOGRAM_MIN_EXPONENT);
+    json_write_number(w, "maxExponent", LOG_HISTOGRAM_MAX_EXPONENT);
+    json_write_number(w, "subBuckets", LOG_HISTOGRAM_SUB_BUCKETS);
+    write_log_histogram(w, "deltaE", &stats->delta_e_hist);
+    write_log_histogram(w, "l", &stats->l_hist);
+    write_log_histogram(w, "a", &stats->a_hist);
+    write_log_histogram(w, "b", &stats->b_hist);
+    write_log_histogram(w, "rgbR", &stats->rgb_r_hist);
+    write_log_histogram(w, "rgbG", &stats->rgb_g_hist);
+    write_log_histogram(w, "rgbB", &stats->rgb_b_hist);
+    json_end_object(w);
+}
+
+/* The members of a MetricStats object; callers open it so they can append their own. */
+static void write_metric_fields(JsonWriter *w, const MetricStats *stats) {
+    json_write_number(w, "mean", stats->mean);
+    json_write_number(w, "stddev", stats->stddev);
+    json_write_number(w, "p50", stats->p50);
+    json_write_number(w, "p95", stats->p95);
+    json_write_number(w, "p99", stats->p99);
+    json_write_number(w, "min", stats->min);
+    json_write_number(w, "max", stats->max);
+    if (stats->percentile_count > 0) {
+        /* --percentiles, keyed like the fixed fields: "p99.9" */
+        json_begin_object(w, "percentiles");
+        for (size_t i = 0; i < stats->percentile_count; ++i) {
+            char key[32];
+            snprintf(key, sizeof(key), "p%g", stats->percentiles[i].percent);
+            json_write_number(w, key, stats->percentiles[i].value);
+        }
+        json_end_object(w);
+    }
+}
+
+static void write_metric_stats(JsonWriter *w, const char *key, const MetricStats *stats) {
+    json_begin_object(w, key);
+    write_metric_fields(w, stats);
+    json_end_object(w);
+}
+
+static void write_phase_timing(JsonWriter *w, const char *key, const PhaseTiming *phase) {
+    json_begin_object(w, key);
+    json_write_number(w, "totalMs", phase->total_ms);
+    json_write_number(w, "p50Ms", phase->stats.p50);
+    json_write_number(w, "p95Ms", phase->stats.p95);
+    json_write_number(w, "maxMs", phase->stats.max);
+    json_end_object(w);
+}
+
+static void write_run_timing(JsonWriter *w, const RunSummary *summary) {
+    const RunTiming *timing = &summary->timing;
+    json_begin_object(w, "timing");
+    json_write_number(w, "wallMs", summary->duration_ms);
+    json_write_number(w, "measuredCases", (double)timing->measured_cases);
+    json_begin_object(w, "phases");
+    write_phase_timing(w, "spawn", &timing->spawn);
+    write_phase_timing(w, "wait", &timing->wait);
+    write_phase_timing(w, "parse", &timing->parse);
+    write_phase_timing(w, "compare", &timing->compare);
+    write_phase_timing(w, "write", &timing->write);
+    write_phase_timing(w, "total", &timing->total);
+    json_end_object(w);
+    json_end_object(w);
+}
+
+static void write_engine_performance(JsonWriter *w, const RunResults *results, double max_slowdown) {
+    const EnginePerformance *performance = &results->summary.performance;
+    json_begin_object(w, "performance");
+    json_write_number(w, "measuredCases", (double)performance->measured_cases);
+    json_write_number(w, "slowdown", performance->slowdown);
+    if (max_slowdown > 0.0) {
+        json_write_number(w, "maxSlowdown", max_slowdown);
+    }
+
+    json_begin_object(w, "canonicalDurationMs");
+    write_metric_fields(w, &performance->canonical_duration);
+    json_write_number(w, "totalMs", performance->canonical_total_ms);
+    json_end_object(w);
+    json_begin_object(w, "alternateDurationMs");
+    write_metric_fields(w, &performance->alternate_duration);
+    json_write_number(w, "totalMs", performance->alternate_total_ms);
+    json_end_object(w);
+    write_metric_stats(w, "speedRatio", &performance->speed_ratio);
+
+    json_begin_array(w, "slowestCases");
+    for (size_t i = 0; i < performance->slowest_count; ++i) {
+        const ComparisonResult *result = &results->results[performance->slowest[i]];
+        json_begin_object(w, NULL);
+        json_write_string(w, "inputCaseId", result->input_case_id);
+        json_write_number(w, "canonicalDurationMs", result->canonical_duration_ms);
+        json_write_number(w, "alternateDurationMs", result->alternate_duration_ms);
+        json_write_number(w, "speedRatio", case_speed_ratio(result));
+        json_end_object(w);
     }
-    cJSON_AddNumberToObject(root, "min", hist->min_value);
-    cJSON_AddNumberToObject(root, "max", hist->max_value);
-    cJSON_AddNumberToObject(root, "bucketSize", hist->bucket_size);
-    cJSON *counts = cJSON_AddArrayToObject(root, "counts");
-    for (size_t i = 0; i < hist->bucket_count; ++i) {
-        cJSON_AddItemToArray(counts, cJSON_CreateNumber((double)hist->counts[i]));
+    json_end_array(w);
+    json_end_object(w);
+}
+
+/* dir/name into a fixed path buffer; -1 instead of a truncated path. */
+static int format_path(char *path, size_t path_size, const char *dir, const char *name, ValidationError *error) {
+    const int length = snprintf(path, path_size, "%s/%s", dir, name);
+    if (length < 0 || (size_t)length >= path_size) {
+        set_error(error, "artifact path is too long");
+        return -1;
+    }
+    return 0;
+}
+
+/* Creates <artifacts_root>/cases/<case_id> and leaves its path in case_dir. */
+static int prepare_case_directory(const char *artifacts_root,
+                                  const char *case_id,
+                                  char *case_dir,
+                                  size_t case_dir_size,
+                                  ValidationError *error) {
+    char cases_dir[MAX_PATH_LENGTH];
+    if (format_path(cases_dir, sizeof(cases_dir), artifacts_root, "cases", error) != 0 ||
+        format_path(case_dir, case_dir_size, cases_dir, case_id, error) != 0) {
+        return -1;
     }
-    return root;
+    return ensure_directory(artifacts_root, error) != 0 || ensure_directory(case_dir, error) != 0 ? -1 : 0;
 }
 
-static cJSON *metric_stats_json(const MetricStats *stats) {
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "mean", stats->mean);
-    cJSON_AddNumberToObject(root, "stddev", stats->stddev);
-    cJSON_AddNumberToObject(root, "p50", stats->p50);
-    cJSON_AddNumberToObject(root, "p95", stats->p95);
-    cJSON_AddNumberToObject(root, "p99", stats->p99);
-    cJSON_AddNumberToObject(root, "min", stats->min);
-    cJSON_AddNumberToObject(root, "max", stats->max);
-    return root;
+/* Opens path behind a JSON_FILE_BUFFER stdio buffer; close_json_file() reports any failed write. */
+static FILE *open_json_file(const char *path, JsonWriter *w, char indent, const char *message, ValidationError *error) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        set_error(error, message);
+        return NULL;
+    }
+    setvbuf(file, NULL, _IOFBF, JSON_FILE_BUFFER);
+    json_writer_init(w, file, indent);
+    return file;
+}
+
+static int close_json_file(FILE *file, JsonWriter *w, const char *message, ValidationError *error) {
+    const int status = json_writer_finish(w);
+    if (fclose(file) != 0 || status != 0) {
+        set_error(error, message);
+        return -1;
+    }
+    return 0;
 }
 
 int write_case_artifacts(const char *artifacts_root,
@@ -136,53 +345,46 @@ int write_case_artifacts(const char *artifacts_root,
     }
 
     char case_dir[MAX_PATH_LENGTH];
-    snprintf(case_dir, sizeof(case_dir), "%s/cases/%s", artifacts_root, input_case->id);
-    if (ensure_directory(artifacts_root, error) != 0 || ensure_directory(case_dir, error) != 0) {
+    if (prepare_case_directory(artifacts_root, input_case->id, case_dir, sizeof(case_dir), error) != 0) {
         return -1;
     }
 
     char path[MAX_PATH_LENGTH];
+    JsonWriter w;
 
-    snprintf(path, sizeof(path), "%s/canonical.json", case_dir);
-    FILE *file = fopen(path, "w");
+    if (format_path(path, sizeof(path), case_dir, "canonical.json", error) != 0) {
+        return -1;
+    }
+    FILE *file = open_json_file(path, &w, '\0', "failed to write canonical artifact", error);
     if (!file) {
-        set_error(error, "failed to write canonical artifact");
         return -1;
     }
-    cJSON *canonical_json = engine_output_json(canonical);
-    char *canonical_str = cJSON_PrintUnformatted(canonical_json);
-    fprintf(file, "%s", canonical_str);
-    fclose(file);
-    cJSON_Delete(canonical_json);
-    free(canonical_str);
+    write_engine_output(&w, canonical);
+    if (close_json_file(file, &w, "failed to write canonical artifact", error) != 0) {
+        return -1;
+    }
 
-    snprintf(path, sizeof(path), "%s/alternate.json", case_dir);
-    file = fopen(path, "w");
+    if (format_path(path, sizeof(path), case_dir, "alternate.json", error) != 0) {
+        return -1;
+    }
+    file = open_json_file(path, &w, '\0', "failed to write alternate artifact", error);
     if (!file) {
-        set_error(error, "failed to write alternate artifact");
         return -1;
     }
-    cJSON *alternate_json = engine_output_json(alternate);
-    char *alternate_str = cJSON_PrintUnformatted(alternate_json);
-    fprintf(file, "%s", alternate_str);
-    fclose(file);
-    cJSON_Delete(alternate_json);
-    free(alternate_str);
+    write_engine_output(&w, alternate);
+    if (close_json_file(file, &w, "failed to write alternate artifact", error) != 0) {
+        return -1;
+    }
 
-    snprintf(path, sizeof(path), "%s/diff.json", case_dir);
-    file = fopen(path, "w");
+    if (format_path(path, sizeof(path), case_dir, "diff.json", error) != 0) {
+        return -1;
+    }
+    file = open_json_file(path, &w, '\0', "failed to write diff artifact", error);
     if (!file) {
-        set_error(error, "failed to write diff artifact");
         return -1;
     }
-    cJSON *diff_json = comparison_json(result);
-    char *diff_str = cJSON_PrintUnformatted(diff_json);
-    fprintf(file, "%s", diff_str);
-    fclose(file);
-    cJSON_Delete(diff_json);
-    free(diff_str);
-
-    return 0;
+    write_comparison(&w, result);
+    return close_json_file(file, &w, "failed to write diff artifact", error);
 }
 
 int write_case_metadata(const char *artifacts_root,
@@ -195,67 +397,58 @@ int write_case_metadata(const char *artifacts_root,
     }
 
     char case_dir[MAX_PATH_LENGTH];
-    snprintf(case_dir, sizeof(case_dir), "%s/cases/%s", artifacts_root, input_case->id);
-    if (ensure_directory(artifacts_root, error) != 0 || ensure_directory(case_dir, error) != 0) {
+    if (prepare_case_directory(artifacts_root, input_case->id, case_dir, sizeof(case_dir), error) != 0) {
+        return -1;
+    }
+
+    char path[MAX_PATH_LENGTH];
+    if (format_path(path, sizeof(path), case_dir, "metadata.json", error) != 0) {
+        return -1;
+    }
+    JsonWriter w;
+    FILE *file = open_json_file(path, &w, '\t', "failed to write case metadata", error);
+    if (!file) {
         return -1;
     }
 
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "inputCaseId", input_case->id);
-    cJSON_AddBoolToObject(root, "passed", result->passed ? 1 : 0);
-    cJSON_AddNumberToObject(root, "maxDeltaE", result->max_delta_e);
+    json_begin_object(&w, NULL);
+    json_write_string(&w, "inputCaseId", input_case->id);
+    json_write_bool(&w, "passed", result->passed);
+    json_write_number(&w, "maxDeltaE", result->max_delta_e);
 
-    cJSON *input = cJSON_CreateObject();
-    cJSON_AddStringToObject(input, "corpusVersion", input_case->corpus_version);
-    cJSON_AddNumberToObject(input, "seed", (double)input_case->seed);
-    cJSON_AddNumberToObject(input, "count", (double)input_case->config.count);
+    json_begin_object(&w, "input");
+    json_write_string(&w, "corpusVersion", input_case->corpus_version);
+    json_write_number(&w, "seed", (double)input_case->seed);
+    json_write_number(&w, "count", (double)input_case->config.count);
     if (input_case->tag_count > 0) {
-        cJSON *tags = cJSON_AddArrayToObject(input, "tags");
+        json_begin_array(&w, "tags");
         for (size_t i = 0; i < input_case->tag_count; ++i) {
-            cJSON_AddItemToArray(tags, cJSON_CreateString(input_case->tags[i]));
-        }
-    }
-    cJSON_AddItemToObject(root, "input", input);
-
-    cJSON *artifacts = cJSON_CreateObject();
-    cJSON_AddStringToObject(artifacts, "canonical", "canonical.json");
-    cJSON_AddStringToObject(artifacts, "alternate", "alternate.json");
-    cJSON_AddStringToObject(artifacts, "diff", "diff.json");
-    cJSON_AddItemToObject(root, "artifacts", artifacts);
-
-    if (result->contributors && result->contributor_count > 0) {
-        cJSON *contributors = cJSON_AddArrayToObject(root, "topContributors");
-        for (size_t i = 0; i < result->contributor_count; ++i) {
-            const Contributor *hint = &result->contributors[i];
-            cJSON *entry = cJSON_CreateObject();
-            cJSON_AddStringToObject(entry, "metric", hint->metric);
-            cJSON_AddNumberToObject(entry, "magnitude", hint->magnitude);
-            cJSON_AddStringToObject(entry, "direction", hint->direction);
-            if (hint->stage) cJSON_AddStringToObject(entry, "stage", hint->stage);
-            if (hint->parameter) cJSON_AddStringToObject(entry, "parameter", hint->parameter);
-            cJSON_AddNumberToObject(entry, "zScore", hint->z_score);
-            cJSON_AddBoolToObject(entry, "significant", hint->significant ? 1 : 0);
-            cJSON_AddItemToArray(contributors, entry);
+            json_write_string(&w, NULL, input_case->tags[i]);
         }
+        json_end_array(&w);
     }
+    json_end_object(&w);
 
-    char path[MAX_PATH_LENGTH];
-    snprintf(path, sizeof(path), "%s/metadata.json", case_dir);
-    FILE *file = fopen(path, "w");
-    if (!file) {
-        cJSON_Delete(root);
-        set_error(error, "failed to write case metadata");
-        return -1;
-    }
+    json_begin_object(&w, "artifacts");
+    json_write_string(&w, "canonical", "canonical.json");
+    json_write_string(&w, "alternate", "alternate.json");
+    json_write_string(&w, "diff", "diff.json");
+    json_end_object(&w);
 
-    char *rendered = cJSON_Print(root);
-    fprintf(file, "%s", rendered);
-    fclose(file);
-    free(rendered);
-    cJSON_Delete(root);
-    return 0;
+    if (result->timing.total_ms > 0.0) {
+        write_case_timing(&w, &result->timing);
+    }
+    write_contributors(&w, result);
+    json_end_object(&w);
+    return close_json_file(file, &w, "failed to write case metadata", error);
 }
 
+/*
+ * report.json is written as it is produced: the header and summary first,
+ * then one case at a time, each sample derived and written in turn. Only the
+ * serialization is bounded (the stdio buffer); the retained palettes, the
+ * results array and summarize_exact()'s scratch arrays still grow with the run.
+ */
 int write_run_report(const char *artifacts_root,
                      const RunProvenance *provenance,
                      const RunResults *results,
@@ -269,86 +462,118 @@ int write_run_report(const char *artifacts_root,
         return -1;
     }
 
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "runId", provenance->run_id ? provenance->run_id : "local-run");
-    cJSON_AddStringToObject(root, "corpusVersion", provenance->corpus_version ? provenance->corpus_version : "unknown");
-    cJSON_AddNumberToObject(root, "durationMs", results->summary.duration_ms);
-    cJSON_AddNumberToObject(root, "passRate", results->summary.pass_rate);
-    cJSON_AddBoolToObject(root, "withinPassGate", results->summary.pass_rate >= provenance->pass_gate ? 1 : 0);
-    cJSON_AddBoolToObject(root, "withinDuration", results->summary.duration_ms <= provenance->max_duration_ms ? 1 : 0);
+    char path[MAX_PATH_LENGTH];
+    if (format_path(path, sizeof(path), artifacts_root, "report.json", error) != 0) {
+        return -1;
+    }
+    JsonWriter writer;
+    JsonWriter *w = &writer;
+    /* cJSON_Print's layout with spaces for tabs, so line-oriented test readers can match "key": value. */
+    FILE *file = open_json_file(path, w, ' ', "failed to write run report", error);
+    if (!file) {
+        return -1;
+    }
+
+    const RunSummary *summary = &results->summary;
+    json_begin_object(w, NULL);
+    json_write_string(w, "runId", provenance->run_id ? provenance->run_id : "local-run");
+    json_write_string(w, "corpusVersion", provenance->corpus_version ? provenance->corpus_version : "unknown");
+    json_write_number(w, "durationMs", summary->duration_ms);
+    json_write_number(w, "passRate", summary->pass_rate);
+    json_write_bool(w, "withinPassGate", summary->pass_rate >= provenance->pass_gate);
+    json_write_bool(w, "withinDuration", summary->duration_ms <= provenance->max_duration_ms);
+    json_write_bool(w, "withinSlowdown",
+                    provenance->max_slowdown <= 0.0 || summary->performance.slowdown <= provenance->max_slowdown);
     if (provenance->artifact_policy) {
-        cJSON_AddStringToObject(root, "artifactPolicy", provenance->artifact_policy);
+        json_write_string(w, "artifactPolicy", provenance->artifact_policy);
     }
 
-    cJSON *prov = cJSON_CreateObject();
-    cJSON_AddStringToObject(prov, "cCommit", provenance->c_commit ? provenance->c_commit : "unknown");
-    cJSON_AddStringToObject(prov, "wasmCommit", provenance->wasm_commit ? provenance->wasm_commit : "unknown");
-    cJSON_AddStringToObject(prov, "platform", provenance->platform ? provenance->platform : "unknown");
-    cJSON_AddStringToObject(prov, "artifactsRoot", provenance->artifacts_root ? provenance->artifacts_root : artifacts_root);
+    json_begin_object(w, "provenance");
+    json_write_string(w, "cCommit", provenance->c_commit ? provenance->c_commit : "unknown");
+    json_write_string(w, "wasmCommit", provenance->wasm_commit ? provenance->wasm_commit : "unknown");
+    json_write_string(w, "platform", provenance->platform ? provenance->platform : "unknown");
+    json_write_string(w, "artifactsRoot", provenance->artifacts_root ? provenance->artifacts_root : artifacts_root);
     if (provenance->c_build_flags) {
-        cJSON_AddStringToObject(prov, "cBuildFlags", provenance->c_build_flags);
+        json_write_string(w, "cBuildFlags", provenance->c_build_flags);
     }
     if (provenance->alt_build_flags) {
-        cJSON_AddStringToObject(prov, "altBuildFlags", provenance->alt_build_flags);
+        json_write_string(w, "altBuildFlags", provenance->alt_build_flags);
+    }
+    if (provenance->engine_format) {
+        json_write_string(w, "engineFormat", provenance->engine_format);
+    }
+    if (provenance->since_report) {
+        json_write_string(w, "sinceReport", provenance->since_report);
+        json_write_number(w, "carriedOverCases", (double)provenance->carried_over);
+    }
+    if (provenance->cache_enabled) {
+        json_write_number(w, "cacheHits", (double)provenance->cache_hits);
+        json_write_number(w, "cacheMisses", (double)provenance->cache_misses);
+    }
+    if (provenance->shard_count > 0) {
+        json_begin_object(w, "shard");
+        json_write_number(w, "index", (double)provenance->shard_index);
+        json_write_number(w, "count", (double)provenance->shard_count);
+        json_end_object(w);
+    }
+    if (provenance->merged_shards > 0) {
+        json_write_number(w, "mergedShards", (double)provenance->merged_shards);
+    }
+    if (provenance->repeat > 1 || provenance->warmup > 0) {
+        json_write_number(w, "repeat", (double)provenance->repeat);
+        json_write_number(w, "warmup", (double)provenance->warmup);
+        json_write_number(w, "outlierMad", provenance->outlier_mad);
     }
     if (tolerance) {
-        cJSON *tol = cJSON_CreateObject();
-        cJSON *abs = cJSON_CreateObject();
-        cJSON_AddNumberToObject(abs, "l", tolerance->abs.l);
-        cJSON_AddNumberToObject(abs, "a", tolerance->abs.a);
-        cJSON_AddNumberToObject(abs, "b", tolerance->abs.b);
-        cJSON_AddNumberToObject(abs, "deltaE", tolerance->abs.deltaE);
-        cJSON_AddItemToObject(tol, "abs", abs);
-        cJSON *rel = cJSON_CreateObject();
-        cJSON_AddNumberToObject(rel, "l", tolerance->rel.l);
-        cJSON_AddNumberToObject(rel, "a", tolerance->rel.a);
-        cJSON_AddNumberToObject(rel, "b", tolerance->rel.b);
-        cJSON_AddItemToObject(tol, "rel", rel);
-        cJSON_AddItemToObject(prov, "appliedTolerances", tol);
-    }
-    cJSON_AddItemToObject(root, "provenance", prov);
-
-    cJSON *summary = cJSON_CreateObject();
-    cJSON_AddNumberToObject(summary, "totalCases", (double)results->summary.total_cases);
-    cJSON_AddNumberToObject(summary, "passed", (double)results->summary.passed);
-    cJSON_AddNumberToObject(summary, "failed", (double)results->summary.failed);
-    cJSON_AddItemToObject(summary, "deltaE", metric_stats_json(&results->summary.stats.delta_e));
-    cJSON_AddItemToObject(summary, "l", metric_stats_json(&results->summary.stats.l));
-    cJSON_AddItemToObject(summary, "a", metric_stats_json(&results->summary.stats.a));
-    cJSON_AddItemToObject(summary, "b", metric_stats_json(&results->summary.stats.b));
-    cJSON_AddItemToObject(summary, "rgbR", metric_stats_json(&results->summary.stats.rgb_r));
-    cJSON_AddItemToObject(summary, "rgbG", metric_stats_json(&results->summary.stats.rgb_g));
-    cJSON_AddItemToObject(summary, "rgbB", metric_stats_json(&results->summary.stats.rgb_b));
-    cJSON_AddItemToObject(summary, "deltaEHistogram", histogram_json(&results->summary.stats.delta_e_hist));
-    cJSON_AddItemToObject(root, "summary", summary);
-
-    cJSON *cases = cJSON_AddArrayToObject(root, "cases");
-    for (size_t i = 0; i < results->result_count; ++i) {
-        cJSON_AddItemToArray(cases, comparison_json(&results->results[i]));
+        json_begin_object(w, "appliedTolerances");
+        json_begin_object(w, "abs");
+        json_write_number(w, "l", tolerance->abs.l);
+        json_write_number(w, "a", tolerance->abs.a);
+        json_write_number(w, "b", tolerance->abs.b);
+        json_write_number(w, "deltaE", tolerance->abs.deltaE);
+        json_end_object(w);
+        json_begin_object(w, "rel");
+        json_write_number(w, "l", tolerance->rel.l);
+        json_write_number(w, "a", tolerance->rel.a);
+        json_write_number(w, "b", tolerance->rel.b);
+        json_end_object(w);
+        json_end_object(w);
     }
-
-    char path[MAX_PATH_LENGTH];
-    snprintf(path, sizeof(path), "%s/report.json", artifacts_root);
-    FILE *file = fopen(path, "w");
-    if (!file) {
-        cJSON_Delete(root);
-        set_error(error, "failed to write run report");
-        return -1;
+    json_end_object(w);
+
+    json_begin_object(w, "summary");
+    json_write_number(w, "totalCases", (double)summary->total_cases);
+    json_write_number(w, "passed", (double)summary->passed);
+    json_write_number(w, "failed", (double)summary->failed);
+    json_write_number(w, "nondeterministicCases", (double)summary->nondeterministic_cases);
+    if (summary->stats_mode == STATS_MODE_STREAMING) {
+        /* Percentiles come from quantile sketches; mean and stddev are streamed (Welford), min and max exact. */
+        json_write_string(w, "statsMode", "streaming");
+        json_write_number(w, "quantileRelativeError", QUANTILE_SKETCH_ALPHA);
+    }
+    write_metric_stats(w, "deltaE", &summary->stats.delta_e);
+    write_metric_stats(w, "l", &summary->stats.l);
+    write_metric_stats(w, "a", &summary->stats.a);
+    write_metric_stats(w, "b", &summary->stats.b);
+    write_metric_stats(w, "rgbR", &summary->stats.rgb_r);
+    write_metric_stats(w, "rgbG", &summary->stats.rgb_g);
+    write_metric_stats(w, "rgbB", &summary->stats.rgb_b);
+    write_run_histograms(w, &summary->stats);
+    json_end_object(w);
+    write_run_timing(w, summary);
+    if (summary->peak_rss_bytes > 0) {
+        json_begin_object(w, "memory");
+        json_write_number(w, "peakRssBytes", (double)summary->peak_rss_bytes);
+        json_write_number(w, "samples", (double)summary->sample_count);
+        json_end_object(w);
     }
+    write_engine_performance(w, results, provenance->max_slowdown);
 
-    /* Pretty-print to keep summary fields visible to line-oriented test readers. */
-    char *rendered = cJSON_Print(root);
-    if (rendered) {
-        /* Normalize indentation so substring searches with spaces succeed. */
-        for (char *p = rendered; *p; ++p) {
-            if (*p == '\t') {
-                *p = ' ';
-            }
-        }
+    json_begin_array(w, "cases");
+    for (size_t i = 0; i < results->result_count; ++i) {
+        write_comparison(w, &results->results[i]);
     }
-    fprintf(file, "%s", rendered);
-    fclose(file);
-    free(rendered);
-    cJSON_Delete(root);
-    return 0;
+    json_end_array(w);
+    json_end_object(w);
+    return close_json_file(file, w, "failed to write run report", error);
 }
@@ -0,0 +1,472 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+
+/*
+ * Case selection. A CaseCatalog interns every tag of the loaded corpus to a bit
+ * position, stores each case's tags as a bitset and hashes case ids to their
+ * index. Selections are evaluated once, a whole column at a time: every term of
+ * a --select expression becomes a bit vector over all cases and the boolean
+ * operators combine those vectors word by word.
+ *
+ * --select grammar (NOT binds tighter than AND, AND tighter than OR; keywords
+ * are case-insensitive):
+ *
+ *   expr := term | NOT expr | expr AND expr | expr OR expr | ( expr )
+ *   term := tag:<name> | id:<pattern>     (pattern may use * ? [...] globs)
+ */
+
+typedef enum {
+    SELECT_TAG,
+    SELECT_ID,
+    SELECT_NOT,
+    SELECT_AND,
+    SELECT_OR
+} SelectOp;
+
+struct SelectExpr {
+    SelectOp op;
+    char *value;               /* SELECT_TAG / SELECT_ID */
+    struct SelectExpr *left;   /* operand of SELECT_NOT; left side of AND/OR */
+    struct SelectExpr *right;
+};
+
+static void set_error(ValidationError *error, const char *message) {
+    if (!error || !message) {
+        return;
+    }
+    free(error->message);
+    size_t len = strlen(message);
+    error->message = (char *)malloc(len + 1);
+    if (error->message) {
+        memcpy(error->message, message, len + 1);
+    }
+}
+
+static size_t hash_string(const char *text) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)text; *c; ++c) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+typedef struct {
+    const char *p;
+    const char *failure;
+} SelectParser;
+
+static SelectExpr *new_node(SelectOp op, SelectExpr *left, SelectExpr *right) {
+    SelectExpr *node = (SelectExpr *)calloc(1, sizeof(SelectExpr));
+    if (node) {
+        node->op = op;
+        node->left = left;
+        node->right = right;
+    }
+    return node;
+}
+
+void free_select_expression(SelectExpr *expr) {
+    if (!expr) {
+        return;
+    }
+    free_select_expression(expr->left);
+    free_select_expression(expr->right);
+    free(expr->value);
+    free(expr);
+}
+
+static void skip_spaces(SelectParser *parser) {
+    while (isspace((unsigned char)*parser->p)) {
+        parser->p++;
+    }
+}
+
+/* Consumes `keyword` if it is the next whole word. */
+static int accept_keyword(SelectParser *parser, const char *keyword) {
+    skip_spaces(parser);
+    const size_t length = strlen(keyword);
+    for (size_t i = 0; i < length; ++i) {
+        if (toupper((unsigned char)parser->p[i]) != keyword[i]) {
+            return 0;
+        }
+    }
+    const char next = parser->p[length];
+    if (next != '\0' && next != '(' && next != ')' && !isspace((unsigned char)next)) {
+        return 0;
+    }
+    parser->p += length;
+    return 1;
+}
+
+static SelectExpr *parse_or(SelectParser *parser);
+
+static SelectExpr *parse_term(SelectParser *parser) {
+    skip_spaces(parser);
+    SelectOp op;
+    if (strncmp(parser->p, "tag:", 4) == 0) {
+        op = SELECT_TAG;
+        parser->p += 4;
+    } else if (strncmp(parser->p, "id:", 3) == 0) {
+        op = SELECT_ID;
+        parser->p += 3;
+    } else {
+        parser->failure = *parser->p ? "expected tag:<name> or id:<pattern>" : "expression is incomplete";
+        return NULL;
+    }
+    const char *start = parser->p;
+    while (*parser->p && *parser->p != '(' && *parser->p != ')' && !isspace((unsigned char)*parser->p)) {
+        parser->p++;
+    }
+    if (parser->p == start) {
+        parser->failure = "tag: and id: need a value";
+        return NULL;
+    }
+    SelectExpr *node = new_node(op, NULL, NULL);
+    if (!node || !(node->value = strndup(start, (size_t)(parser->p - start)))) {
+        free(node);
+        parser->failure = "failed to allocate selection";
+        return NULL;
+    }
+    return node;
+}
+
+static SelectExpr *parse_unary(SelectParser *parser) {
+    if (accept_keyword(parser, "NOT")) {
+        SelectExpr *operand = parse_unary(parser);
+        SelectExpr *node = operand ? new_node(SELECT_NOT, operand, NULL) : NULL;
+        if (operand && !node) {
+            free_select_expression(operand);
+            parser->failure = "failed to allocate selection";
+        }
+        return node;
+    }
+    skip_spaces(parser);
+    if (*parser->p == '(') {
+        parser->p++;
+        SelectExpr *inner = parse_or(parser);
+        skip_spaces(parser);
+        if (inner && *parser->p != ')') {
+            free_select_expression(inner);
+            parser->failure = "unbalanced parentheses";
+            return NULL;
+        }
+        parser->p += inner ? 1 : 0;
+        return inner;
+    }
+    return parse_term(parser);
+}
+
+static SelectExpr *parse_binary(SelectParser *parser, SelectOp op) {
+    const char *keyword = op == SELECT_AND ? "AND" : "OR";
+    SelectExpr *left = op == SELECT_AND ? parse_unary(parser) : parse_binary(parser, SELECT_AND);
+    while (left && accept_keyword(parser, keyword)) {
+        SelectExpr *right = op == SELECT_AND ? parse_unary(parser) : parse_binary(parser, SELECT_AND);
+        SelectExpr *node = right ? new_node(op, left, right) : NULL;
+        if (!node) {
+            if (right) {
+                parser->failure = "failed to allocate selection";
+            }
+            free_select_expression(left);
+            free_select_expression(right);
+            return NULL;
+        }
+        left = node;
+    }
+    return left;
+}
+
+static SelectExpr *parse_or(SelectParser *parser) {
+    return parse_binary(parser, SELECT_OR);
+}
+
+SelectExpr *parse_select_expression(const char *text, ValidationError *error) {
+    if (!text) {
+        set_error(error, "expression is incomplete");
+        return NULL;
+    }
+    SelectParser parser = {.p = text};
+    SelectExpr *expr = parse_or(&parser);
+    skip_spaces(&parser);
+    if (expr && *parser.p != '\0') {
+        parser.failure = *parser.p == ')' ? "unbalanced parentheses" : "expected AND, OR or the end of the expression";
+        free_select_expression(expr);
+        expr = NULL;
+    }
+    if (!expr) {
+        set_error(error, parser.failure ? parser.failure : "failed to allocate selection");
+    }
+    return expr;
+}
+
+static size_t table_size(size_t entries) {
+    size_t slots = 8;
+    while (slots < entries * 2) {
+        slots *= 2;
+    }
+    return slots;
+}
+
+/* Bit position of `tag` in the case bitsets, or -1 with `*free_slot` set to where it would be interned. */
+static long find_tag_bit(const CaseCatalog *catalog, const char *tag, size_t *free_slot) {
+    const size_t mask = catalog->tag_slot_count - 1;
+    size_t slot = hash_string(tag) & mask;
+    while (catalog->tag_slots[slot] != 0) {
+        if (strcmp(catalog->tag_names[catalog->tag_slots[slot] - 1], tag) == 0) {
+            return (long)(catalog->tag_slots[slot] - 1);
+        }
+        slot = (slot + 1) & mask;
+    }
+    if (free_slot) {
+        *free_slot = slot;
+    }
+    return -1;
+}
+
+static long intern_tag(CaseCatalog *catalog, const char *tag) {
+    size_t slot = 0;
+    const long bit = find_tag_bit(catalog, tag, &slot);
+    if (bit >= 0) {
+        return bit;
+    }
+    catalog->tag_names[catalog->tag_count] = tag;
+    catalog->tag_slots[slot] = ++catalog->tag_count;
+    return (long)(catalog->tag_count - 1);
+}
+
+int build_case_catalog(const Corpus *corpus, CaseCatalog *out, ValidationError *error) {
+    if (!corpus || !out) {
+        set_error(error, "invalid selection arguments");
+        return -1;
+    }
+    memset(out, 0, sizeof(CaseCatalog));
+    out->corpus = corpus;
+    size_t tag_total = 0;
+    for (size_t i = 0; i < corpus->case_count; ++i) {
+        tag_total += corpus->cases[i].tag_count;
+    }
+
+    /* Tag names and ids are borrowed from the corpus, which must outlive the catalog. */
+    out->tag_slot_count = table_size(tag_total);
+    out->tag_slots = (size_t *)calloc(out->tag_slot_count, sizeof(size_t));
+    out->tag_names = (const char **)calloc(tag_total ? tag_total : 1, sizeof(char *));
+    out->id_slot_count = table_size(corpus->case_count);
+    out->id_slots = (size_t *)calloc(out->id_slot_count, sizeof(size_t));
+    long *case_bits = (long *)calloc(tag_total ? tag_total : 1, sizeof(long));
+    if (!out->tag_slots || !out->tag_names || !out->id_slots || !case_bits) {
+        free(case_bits);
+        free_case_catalog(out);
+        set_error(error, "failed to allocate selection");
+        return -1;
+    }
+
+    size_t next = 0;
+    for (size_t i = 0; i < corpus->case_count; ++i) {
+        for (size_t t = 0; t < corpus->cases[i].tag_count; ++t) {
+            case_bits[next++] = intern_tag(out, corpus->cases[i].tags[t]);
+        }
+        /* The index keeps the first case with an id; later duplicates make id lookups fall back to a scan. */
+        const size_t mask = out->id_slot_count - 1;
+        size_t slot = hash_string(corpus->cases[i].id) & mask;
+        while (out->id_slots[slot] != 0 && strcmp(corpus->cases[out->id_slots[slot] - 1].id, corpus->cases[i].id) != 0) {
+            slot = (slot + 1) & mask;
+        }
+        if (out->id_slots[slot] == 0) {
+            out->id_slots[slot] = i + 1;
+        } else {
+            out->duplicate_ids = true;
+        }
+    }
+
+    out->tag_words = (out->tag_count + 63) / 64;
+    out->tag_bits = (uint64_t *)calloc(corpus->case_count * out->tag_words + 1, sizeof(uint64_t));
+    if (!out->tag_bits) {
+        free(case_bits);
+        free_case_catalog(out);
+        set_error(error, "failed to allocate selection");
+        return -1;
+    }
+    next = 0;
+    for (size_t i = 0; i < corpus->case_count; ++i) {
+        uint64_t *bits = out->tag_bits + i * out->tag_words;
+        for (size_t t = 0; t < corpus->cases[i].tag_count; ++t, ++next) {
+            bits[case_bits[next] / 64] |= (uint64_t)1 << (case_bits[next] % 64);
+        }
+    }
+    free(case_bits);
+    return 0;
+}
+
+const InputCase *catalog_find_case(const CaseCatalog *catalog, const char *id) {
+    if (!catalog || !id || !catalog->id_slots) {
+        return NULL;
+    }
+    const size_t mask = catalog->id_slot_count - 1;
+    for (size_t slot = hash_string(id) & mask; catalog->id_slots[slot] != 0; slot = (slot + 1) & mask) {
+        const InputCase *input_case = &catalog->corpus->cases[catalog->id_slots[slot] - 1];
+        if (strcmp(input_case->id, id) == 0) {
+            return input_case;
+        }
+    }
+    return NULL;
+}
+
+typedef struct {
+    const CaseCatalog *catalog;
+    size_t words; /* uint64_t words per selection vector */
+} SelectionPass;
+
+static void set_case(uint64_t *vector, size_t index) {
+    vector[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+static void mark_tag(const SelectionPass *pass, const char *tag, uint64_t *vector) {
+    const CaseCatalog *catalog = pass->catalog;
+    const long bit = find_tag_bit(catalog, tag, NULL);
+    if (bit < 0) {
+        return;
+    }
+    const uint64_t mask = (uint64_t)1 << (bit % 64);
+    const uint64_t *word = catalog->tag_bits + bit / 64;
+    for (size_t i = 0; i < catalog->corpus->case_count; ++i, word += catalog->tag_words) {
+        if (*word & mask) {
+            set_case(vector, i);
+        }
+    }
+}
+
+/* Marks the cases whose id is exactly `id`: one hash lookup unless the corpus repeats ids. */
+static void mark_exact_id(const SelectionPass *pass, const char *id, uint64_t *vector) {
+    const CaseCatalog *catalog = pass->catalog;
+    if (!catalog->duplicate_ids) {
+        const InputCase *input_case = catalog_find_case(catalog, id);
+        if (input_case) {
+            set_case(vector, (size_t)(input_case - catalog->corpus->cases));
+        }
+        return;
+    }
+    for (size_t i = 0; i < catalog->corpus->case_count; ++i) {
+        if (strcmp(catalog->corpus->cases[i].id, id) == 0) {
+            set_case(vector, i);
+        }
+    }
+}
+
+static void mark_id(const SelectionPass *pass, const char *pattern, uint64_t *vector) {
+    if (strpbrk(pattern, "*?[") == NULL) {
+        mark_exact_id(pass, pattern, vector);
+        return;
+    }
+    const CaseCatalog *catalog = pass->catalog;
+    for (size_t i = 0; i < catalog->corpus->case_count; ++i) {
+        if (fnmatch(pattern, catalog->corpus->cases[i].id, 0) == 0) {
+            set_case(vector, i);
+        }
+    }
+}
+
+/* Evaluates `expr` into `vector` (zeroed by the caller); -1 if a scratch vector cannot be allocated. */
+static int evaluate(const SelectionPass *pass, const SelectExpr *expr, uint64_t *vector) {
+    switch (expr->op) {
+        case SELECT_TAG:
+            mark_tag(pass, expr->value, vector);
+            return 0;
+        case SELECT_ID:
+            mark_id(pass, expr->value, vector);
+            return 0;
+        case SELECT_NOT:
+            if (evaluate(pass, expr->left, vector) != 0) {
+                return -1;
+            }
+            for (size_t w = 0; w < pass->words; ++w) {
+                vector[w] = ~vector[w];
+            }
+            if (pass->catalog->corpus->case_count % 64 != 0) {
+                vector[pass->words - 1] &= ((uint64_t)1 << (pass->catalog->corpus->case_count % 64)) - 1;
+            }
+            return 0;
+        default: {
+            uint64_t *right = (uint64_t *)calloc(pass->words, sizeof(uint64_t));
+            if (!right || evaluate(pass, expr->left, vector) != 0 || evaluate(pass, expr->right, right) != 0) {
+                free(right);
+                return -1;
+            }
+            for (size_t w = 0; w < pass->words; ++w) {
+                vector[w] = expr->op == SELECT_AND ? vector[w] & right[w] : vector[w] | right[w];
+            }
+            free(right);
+            return 0;
+        }
+    }
+}
+
+static void intersect(uint64_t *vector, const uint64_t *filter, size_t words) {
+    for (size_t w = 0; w < words; ++w) {
+        vector[w] &= filter[w];
+    }
+}
+
+int select_cases(const CaseCatalog *catalog, const SelectExpr *expr, char **ids, size_t id_count, char **tags,
+                 size_t tag_count, size_t *selected, size_t *selected_count, ValidationError *error) {
+    if (!catalog || !selected || !selected_count) {
+        set_error(error, "invalid selection arguments");
+        return -1;
+    }
+    const size_t case_count = catalog->corpus->case_count;
+    SelectionPass pass = {.catalog = catalog, .words = (case_count + 63) / 64};
+    uint64_t *vector = (uint64_t *)calloc(pass.words + 1, sizeof(uint64_t));
+    uint64_t *filter = (uint64_t *)calloc(pass.words + 1, sizeof(uint64_t));
+    int status = vector && filter ? 0 : -1;
+    if (status == 0 && expr) {
+        status = evaluate(&pass, expr, vector);
+    } else if (status == 0) {
+        memset(vector, 0xFF, pass.words * sizeof(uint64_t));
+    }
+    /* --cases (literal ids) and --tags (any of) each narrow the selection further. */
+    if (status == 0 && id_count > 0) {
+        for (size_t i = 0; i < id_count; ++i) {
+            mark_exact_id(&pass, ids[i], filter);
+        }
+        intersect(vector, filter, pass.words);
+    }
+    if (status == 0 && tag_count > 0) {
+        memset(filter, 0, pass.words * sizeof(uint64_t));
+        for (size_t i = 0; i < tag_count; ++i) {
+            mark_tag(&pass, tags[i], filter);
+        }
+        intersect(vector, filter, pass.words);
+    }
+    if (status != 0) {
+        free(vector);
+        free(filter);
+        set_error(error, "failed to allocate selection");
+        return -1;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < case_count; ++i) {
+        if (vector[i / 64] & ((uint64_t)1 << (i % 64))) {
+            selected[count++] = i;
+        }
+    }
+    *selected_count = count;
+    free(vector);
+    free(filter);
+    return 0;
+}
+
+void free_case_catalog(CaseCatalog *catalog) {
+    if (!catalog) {
+        return;
+    }
+    free(catalog->tag_names);
+    free(catalog->tag_slots);
+    free(catalog->tag_bits);
+    free(catalog->id_slots);
+    memset(catalog, 0, sizeof(CaseCatalog));
+}
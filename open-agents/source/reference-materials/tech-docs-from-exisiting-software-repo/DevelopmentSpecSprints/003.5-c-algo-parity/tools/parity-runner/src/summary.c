@@ -0,0 +1,383 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "stats.h"
+#include "types.h"
+
+/*
+ * Run-level summaries computed from per-case results. parity-runner calls
+ * these once every case has finished; parity-merge calls them on the union
+ * of shard results, so a merged report is summarized exactly like a single run.
+ */
+
+static void set_error(ValidationError *error, const char *message) {
+    if (!error || !message) {
+        return;
+    }
+    free(error->message);
+    size_t len = strlen(message);
+    error->message = (char *)malloc(len + 1);
+    if (error->message) {
+        memcpy(error->message, message, len + 1);
+    }
+}
+
+static void summarize_phase(const double *values, size_t count, PhaseTiming *phase) {
+    phase->total_ms = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        phase->total_ms += values[i];
+    }
+    compute_metric_stats(values, count, &phase->stats);
+}
+
+/* Aggregates per-phase timings over the cases executed in this run; carried-over cases are left out. */
+static int summarize_run_timing(const ComparisonResult *results, size_t count, RunTiming *out) {
+    memset(out, 0, sizeof(RunTiming));
+    double *values = (double *)malloc((count > 0 ? count : 1) * 6 * sizeof(double));
+    if (!values) {
+        return -1;
+    }
+    double *phases[6];
+    for (size_t p = 0; p < 6; ++p) {
+        phases[p] = values + p * (count > 0 ? count : 1);
+    }
+    size_t measured = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const CaseTiming *timing = &results[i].timing;
+        if (timing->total_ms <= 0.0) {
+            continue;
+        }
+        phases[0][measured] = timing->spawn_ms;
+        phases[1][measured] = timing->wait_ms;
+        phases[2][measured] = timing->parse_ms;
+        phases[3][measured] = timing->compare_ms;
+        phases[4][measured] = timing->write_ms;
+        phases[5][measured] = timing->total_ms;
+        measured++;
+    }
+    out->measured_cases = measured;
+    summarize_phase(phases[0], measured, &out->spawn);
+    summarize_phase(phases[1], measured, &out->wait);
+    summarize_phase(phases[2], measured, &out->parse);
+    summarize_phase(phases[3], measured, &out->compare);
+    summarize_phase(phases[4], measured, &out->write);
+    summarize_phase(phases[5], measured, &out->total);
+    free(values);
+    return 0;
+}
+
+int init_run_accumulator(RunAccumulator *acc, StatsMode mode) {
+    if (!acc) {
+        return -1;
+    }
+    memset(acc, 0, sizeof(RunAccumulator));
+    acc->mode = mode;
+    for (int metric = 0; metric < RUN_METRIC_COUNT; ++metric) {
+        if (init_log_histogram(&acc->hist[metric]) != 0) {
+            free_run_accumulator(acc);
+            return -1;
+        }
+        init_quantile_sketch(&acc->sketch[metric]);
+    }
+    return 0;
+}
+
+/* magnitudes holds |delta| in RunMetric order; moments, when not NULL, collects the case's streaming moments. */
+void accumulate_sample(RunAccumulator *acc, RunningMoments *moments, const double *magnitudes) {
+    acc->samples++;
+    for (int metric = 0; metric < RUN_METRIC_COUNT; ++metric) {
+        record_log_histogram(&acc->hist[metric], magnitudes[metric]);
+    }
+    if (acc->mode != STATS_MODE_STREAMING) {
+        return;
+    }
+    for (int metric = 0; metric < RUN_METRIC_COUNT; ++metric) {
+        add_quantile_sketch(&acc->sketch[metric], magnitudes[metric]);
+        if (moments) {
+            add_running_moments(&moments[metric], magnitudes[metric]);
+        }
+    }
+}
+
+void merge_run_accumulator(RunAccumulator *into, const RunAccumulator *from) {
+    if (!into || !from) {
+        return;
+    }
+    into->samples += from->samples;
+    for (int metric = 0; metric < RUN_METRIC_COUNT; ++metric) {
+        merge_log_histogram(&into->hist[metric], &from->hist[metric]);
+        if (into->mode == STATS_MODE_STREAMING) {
+            merge_quantile_sketch(&into->sketch[metric], &from->sketch[metric]);
+        }
+    }
+}
+
+void free_run_accumulator(RunAccumulator *acc) {
+    if (!acc) {
+        return;
+    }
+    for (int metric = 0; metric < RUN_METRIC_COUNT; ++metric) {
+        free_log_histogram(&acc->hist[metric]);
+    }
+    acc->samples = 0;
+}
+
+static void sample_magnitudes(const SampleDelta *sample, double *magnitudes) {
+    magnitudes[RUN_METRIC_DELTA_E] = fabs(sample->delta.deltaE);
+    magnitudes[RUN_METRIC_L] = fabs(sample->delta.l);
+    magnitudes[RUN_METRIC_A] = fabs(sample->delta.a);
+    magnitudes[RUN_METRIC_B] = fabs(sample->delta.b);
+    magnitudes[RUN_METRIC_RGB_R] = fabs(sample->rgb_delta.r);
+    magnitudes[RUN_METRIC_RGB_G] = fabs(sample->rgb_delta.g);
+    magnitudes[RUN_METRIC_RGB_B] = fabs(sample->rgb_delta.b);
+}
+
+/* The compare pass, redone from comparison_sample() for results it did not accumulate. */
+static void accumulate_comparison(RunAccumulator *acc, const ComparisonResult *result, RunningMoments *moments) {
+    for (size_t s = 0; s < result->sample_count; ++s) {
+        SampleDelta sample;
+        double magnitudes[RUN_METRIC_COUNT];
+        comparison_sample(result, s, &sample);
+        sample_magnitudes(&sample, magnitudes);
+        accumulate_sample(acc, moments, magnitudes);
+    }
+}
+
+/*
+ * Exact statistics: one walk over the samples fills every metric's value array,
+ * deriving each sample's deltas (ΔE included) once, then each array is sorted
+ * in place for its percentiles.
+ */
+static int summarize_exact(const RunResults *results, MetricStats *const *targets) {
+    size_t sample_total = 0;
+    for (size_t i = 0; i < results->result_count; ++i) {
+        sample_total += results->results[i].sample_count;
+    }
+    const size_t stride = sample_total > 0 ? sample_total : 1;
+    if (stride > SIZE_MAX / (RUN_METRIC_COUNT * sizeof(double))) {
+        return -1;
+    }
+    double *values = (double *)malloc(stride * RUN_METRIC_COUNT * sizeof(double));
+    if (!values) {
+        return -1;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < results->result_count; ++i) {
+        const ComparisonResult *result = &results->results[i];
+        for (size_t s = 0; s < result->sample_count; ++s, ++count) {
+            SampleDelta sample;
+            double magnitudes[RUN_METRIC_COUNT];
+            comparison_sample(result, s, &sample);
+            sample_magnitudes(&sample, magnitudes);
+            for (int metric = 0; metric < RUN_METRIC_COUNT; ++metric) {
+                values[(size_t)metric * stride + count] = magnitudes[metric];
+            }
+        }
+    }
+    for (int metric = 0; metric < RUN_METRIC_COUNT; ++metric) {
+        compute_metric_stats_in_place(&values[(size_t)metric * stride], count, &results->summary.percentiles,
+                                      targets[metric]);
+    }
+    free(values);
+    return 0;
+}
+
+/*
+ * Histograms, and under --stats streaming the sketches and moments, come from
+ * the workers' accumulators, which the fused compare pass already filled;
+ * only results it did not see (carried over, merged from reports) are walked
+ * here. Should the accumulators disagree with the results, say after a run
+ * was cut short, everything is walked instead. Per-case moments are folded in
+ * result order so the streaming mean and stddev do not depend on scheduling.
+ */
+static int summarize_deltas(const RunResults *results, RunStats *stats) {
+    const StatsMode mode = results->summary.stats_mode;
+    RunAccumulator *run = (RunAccumulator *)malloc(sizeof(RunAccumulator));
+    if (!run || init_run_accumulator(run, mode) != 0) {
+        free(run);
+        return -1;
+    }
+    size_t accumulated_samples = 0;
+    bool rebuild = false;
+    for (size_t i = 0; i < results->result_count; ++i) {
+        const ComparisonResult *result = &results->results[i];
+        if (result->accumulated) {
+            accumulated_samples += result->sample_count;
+            rebuild = rebuild || (mode == STATS_MODE_STREAMING && !result->moments);
+        }
+    }
+    for (size_t i = 0; i < results->accumulator_count; ++i) {
+        rebuild = rebuild || results->accumulators[i].mode != mode;
+        merge_run_accumulator(run, &results->accumulators[i]);
+    }
+    if (rebuild || run->samples != accumulated_samples) {
+        rebuild = true;
+        free_run_accumulator(run);
+        if (init_run_accumulator(run, mode) != 0) {
+            free(run);
+            return -1;
+        }
+    }
+
+    RunningMoments totals[RUN_METRIC_COUNT];
+    memset(totals, 0, sizeof(totals));
+    for (size_t i = 0; i < results->result_count; ++i) {
+        const ComparisonResult *result = &results->results[i];
+        RunningMoments walked[RUN_METRIC_COUNT];
+        const RunningMoments *moments = result->moments;
+        if (rebuild || !result->accumulated) {
+            memset(walked, 0, sizeof(walked));
+            accumulate_comparison(run, result, walked);
+            moments = walked;
+        }
+        for (int metric = 0; mode == STATS_MODE_STREAMING && metric < RUN_METRIC_COUNT; ++metric) {
+            merge_running_moments(&totals[metric], &moments[metric]);
+        }
+    }
+
+    MetricStats *const targets[RUN_METRIC_COUNT] = {
+        &stats->delta_e, &stats->l, &stats->a, &stats->b, &stats->rgb_r, &stats->rgb_g, &stats->rgb_b,
+    };
+    int status = 0;
+    if (mode == STATS_MODE_STREAMING) {
+        for (int metric = 0; metric < RUN_METRIC_COUNT; ++metric) {
+            finish_sketched_stats(&totals[metric], &run->sketch[metric], &results->summary.percentiles, targets[metric]);
+        }
+    } else {
+        status = summarize_exact(results, targets);
+    }
+    LogHistogram *const histograms[RUN_METRIC_COUNT] = {
+        &stats->delta_e_hist, &stats->l_hist, &stats->a_hist, &stats->b_hist,
+        &stats->rgb_r_hist, &stats->rgb_g_hist, &stats->rgb_b_hist,
+    };
+    for (int metric = 0; status == 0 && metric < RUN_METRIC_COUNT; ++metric) {
+        *histograms[metric] = run->hist[metric];
+        run->hist[metric].counts = NULL;
+    }
+    free_run_accumulator(run);
+    free(run);
+    return status;
+}
+
+int summarize_run_results(RunResults *results, ValidationError *error) {
+    if (!results || (!results->results && results->result_count > 0)) {
+        set_error(error, "invalid run summary arguments");
+        return -1;
+    }
+    RunSummary *summary = &results->summary;
+    summary->total_cases = results->result_count;
+    summary->passed = 0;
+    summary->failed = 0;
+    summary->nondeterministic_cases = 0;
+    summary->sample_count = 0;
+    for (size_t i = 0; i < results->result_count; ++i) {
+        summary->sample_count += results->results[i].sample_count;
+        if (results->results[i].passed) {
+            summary->passed++;
+        } else {
+            summary->failed++;
+        }
+        if (results->results[i].nondeterministic) {
+            summary->nondeterministic_cases++;
+        }
+    }
+    summary->pass_rate = summary->total_cases > 0 ? ((double)summary->passed / (double)summary->total_cases) : 0.0;
+
+    if (summarize_deltas(results, &summary->stats) != 0) {
+        set_error(error, "failed to allocate delta buffers");
+        return -1;
+    }
+    if (summarize_run_timing(results->results, results->result_count, &summary->timing) != 0) {
+        set_error(error, "failed to summarize case timings");
+        return -1;
+    }
+    return compute_engine_performance(results->results, results->result_count, &summary->performance, error);
+}
+
+int compute_run_contributors(RunResults *results, size_t top_n, ValidationError *error) {
+    if (!results) {
+        set_error(error, "invalid contributor arguments");
+        return -1;
+    }
+    int status = 0;
+    for (size_t i = 0; i < results->result_count; ++i) {
+        ComparisonResult *result = &results->results[i];
+        Contributor *contributors = NULL;
+        size_t contributor_count = 0;
+        if (compute_contributors(result, &results->summary, top_n, &contributors, &contributor_count, error) != 0) {
+            char message[MAX_ID_LENGTH + 64];
+            snprintf(message, sizeof(message), "failed to compute contributors for case %s", result->input_case_id);
+            set_error(error, message);
+            status = -1;
+            continue;
+        }
+        free(result->contributors);
+        result->contributors = contributors;
+        result->contributor_count = contributor_count;
+    }
+    return status;
+}
+
+/* "50,90,99.9": ascending percents in [0, 100], at most MAX_PERCENTILES of them. */
+int parse_percentile_list(const char *text, PercentileList *out, ValidationError *error) {
+    if (!text || !out) {
+        set_error(error, "invalid percentile list arguments");
+        return -1;
+    }
+    memset(out, 0, sizeof(PercentileList));
+    const char *cursor = text;
+    while (*cursor) {
+        char *end = NULL;
+        const double percent = strtod(cursor, &end);
+        if (end == cursor || (*end != ',' && *end != '\0') || !(percent >= 0.0 && percent <= 100.0)) {
+            set_error(error, "percentiles must be numbers between 0 and 100");
+            return -1;
+        }
+        if (out->count == MAX_PERCENTILES) {
+            set_error(error, "too many percentiles");
+            return -1;
+        }
+        if (out->count > 0 && percent <= out->percents[out->count - 1]) {
+            set_error(error, "percentiles must be in ascending order");
+            return -1;
+        }
+        out->percents[out->count++] = percent;
+        cursor = *end == ',' ? end + 1 : end;
+    }
+    if (out->count == 0) {
+        set_error(error, "percentile list is empty");
+        return -1;
+    }
+    return 0;
+}
+
+void free_run_stats(RunStats *stats) {
+    if (!stats) {
+        return;
+    }
+    free_log_histogram(&stats->delta_e_hist);
+    free_log_histogram(&stats->l_hist);
+    free_log_histogram(&stats->a_hist);
+    free_log_histogram(&stats->b_hist);
+    free_log_histogram(&stats->rgb_r_hist);
+    free_log_histogram(&stats->rgb_g_hist);
+    free_log_histogram(&stats->rgb_b_hist);
+}
+
+size_t process_peak_rss_bytes(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0 || usage.ru_maxrss <= 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024; /* kilobytes */
+#endif
+}
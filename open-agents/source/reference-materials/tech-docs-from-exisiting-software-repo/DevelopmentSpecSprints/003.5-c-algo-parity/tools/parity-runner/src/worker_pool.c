@@ -0,0 +1,225 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+
+/*
+ * Fixed-size pool of worker threads that execute indexed tasks. Workers claim
+ * task indices in ascending order; the caller consumes completions in that same
+ * order via worker_pool_wait(), so anything accumulated on the consumer side
+ * stays deterministic regardless of the job count.
+ *
+ * Tasks receive the index of the worker running them (0..jobs-1) so callers can
+ * keep per-worker state such as persistent engine sessions.
+ *
+ * With jobs <= 1 no threads are created and worker_pool_wait() runs each task
+ * inline as worker 0, which keeps the default run strictly serial.
+ */
+
+typedef enum {
+    TASK_PENDING = 0,
+    TASK_RUNNING,
+    TASK_DONE
+} TaskState;
+
+typedef struct {
+    WorkerPool *pool;
+    size_t id;
+    pthread_t thread;
+    ValidationError error;
+} Worker;
+
+struct WorkerPool {
+    WorkerTaskFn task;
+    void *context;
+    size_t task_count;
+    size_t next_task;
+    int cancelled;
+
+    TaskState *states;
+    int *statuses;
+    char **messages;
+
+    Worker *workers;
+    size_t worker_count;
+    ValidationError inline_error;
+
+    pthread_mutex_t lock;
+    pthread_cond_t task_done;
+};
+
+static void set_error(ValidationError *error, const char *message) {
+    if (!error || !message) {
+        return;
+    }
+    free(error->message);
+    size_t len = strlen(message);
+    error->message = (char *)malloc(len + 1);
+    if (error->message) {
+        memcpy(error->message, message, len + 1);
+    }
+}
+
+/* Moves the worker's error message into the per-task slot so the consumer can report it. */
+static char *take_message(ValidationError *error) {
+    char *message = error->message;
+    error->message = NULL;
+    return message;
+}
+
+static void *worker_main(void *arg) {
+    Worker *worker = (Worker *)arg;
+    WorkerPool *pool = worker->pool;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        if (pool->cancelled || pool->next_task >= pool->task_count) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        const size_t index = pool->next_task++;
+        pool->states[index] = TASK_RUNNING;
+        pthread_mutex_unlock(&pool->lock);
+
+        const int status = pool->task(index, worker->id, pool->context, &worker->error);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->statuses[index] = status;
+        if (status != 0) {
+            pool->messages[index] = take_message(&worker->error);
+        }
+        pool->states[index] = TASK_DONE;
+        pthread_cond_broadcast(&pool->task_done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+WorkerPool *worker_pool_start(size_t jobs,
+                              size_t task_count,
+                              WorkerTaskFn task,
+                              void *context,
+                              ValidationError *error) {
+    if (!task) {
+        set_error(error, "invalid worker pool arguments");
+        return NULL;
+    }
+
+    WorkerPool *pool = (WorkerPool *)calloc(1, sizeof(WorkerPool));
+    if (!pool) {
+        set_error(error, "failed to allocate worker pool");
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->task_done, NULL);
+    pool->task = task;
+    pool->context = context;
+    pool->task_count = task_count;
+    pool->states = (TaskState *)calloc(task_count ? task_count : 1, sizeof(TaskState));
+    pool->statuses = (int *)calloc(task_count ? task_count : 1, sizeof(int));
+    pool->messages = (char **)calloc(task_count ? task_count : 1, sizeof(char *));
+    if (!pool->states || !pool->statuses || !pool->messages) {
+        worker_pool_finish(pool);
+        set_error(error, "failed to allocate worker pool state");
+        return NULL;
+    }
+
+    if (jobs <= 1 || task_count <= 1) {
+        return pool;
+    }
+    if (jobs > task_count) {
+        jobs = task_count;
+    }
+
+    pool->workers = (Worker *)calloc(jobs, sizeof(Worker));
+    if (!pool->workers) {
+        worker_pool_finish(pool);
+        set_error(error, "failed to allocate workers");
+        return NULL;
+    }
+    for (size_t i = 0; i < jobs; ++i) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        if (pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i]) != 0) {
+            break;
+        }
+        pool->worker_count++;
+    }
+    if (pool->worker_count == 0) {
+        worker_pool_finish(pool);
+        set_error(error, "failed to start worker threads");
+        return NULL;
+    }
+    return pool;
+}
+
+int worker_pool_wait(WorkerPool *pool, size_t index, char **message) {
+    if (message) {
+        *message = NULL;
+    }
+    if (!pool || index >= pool->task_count) {
+        return -1;
+    }
+
+    if (pool->worker_count == 0) {
+        if (pool->states[index] != TASK_DONE) {
+            pool->statuses[index] = pool->task(index, 0, pool->context, &pool->inline_error);
+            if (pool->statuses[index] != 0) {
+                pool->messages[index] = take_message(&pool->inline_error);
+            }
+            pool->states[index] = TASK_DONE;
+        }
+    } else {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->states[index] != TASK_DONE) {
+            if (pool->cancelled && pool->states[index] == TASK_PENDING) {
+                pthread_mutex_unlock(&pool->lock);
+                return -1;
+            }
+            pthread_cond_wait(&pool->task_done, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    if (message) {
+        *message = pool->messages[index];
+        pool->messages[index] = NULL;
+    }
+    return pool->statuses[index];
+}
+
+void worker_pool_cancel(WorkerPool *pool) {
+    if (!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->cancelled = 1;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void worker_pool_finish(WorkerPool *pool) {
+    if (!pool) {
+        return;
+    }
+    worker_pool_cancel(pool);
+    for (size_t i = 0; i < pool->worker_count; ++i) {
+        pthread_join(pool->workers[i].thread, NULL);
+        free(pool->workers[i].error.message);
+    }
+    if (pool->messages) {
+        for (size_t i = 0; i < pool->task_count; ++i) {
+            free(pool->messages[i]);
+        }
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->task_done);
+    free(pool->inline_error.message);
+    free(pool->workers);
+    free(pool->states);
+    free(pool->statuses);
+    free(pool->messages);
+    free(pool);
+}
@@ -0,0 +1,216 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "parity_plugin.h"
+
+/*
+ * Stand-in engine for the integration tests, so they do not need the real
+ * engines. Colors are a cheap deterministic function of the case's seed and
+ * sample index; built with -DSTUB_ALTERNATE they are nudged by at most 2e-7 in
+ * l, which stays inside the test tolerances but keeps the deltas non-zero.
+ *
+ * Built as a runner it speaks the runner protocol: `--corpus <path> --case-id
+ * <id>` answers one case, `--server` answers one serialized InputCase per
+ * stdin line, and `--format bin` switches either to binary frames. JSON
+ * numbers get 17 significant digits, so both formats carry the same doubles
+ * (cJSON's printer may drop the last bit). Built with -DSTUB_PLUGIN it is an
+ * engine plugin instead.
+ *
+ * PARITY_STUB_SLEEP_MS makes each case take that long, for timeout tests;
+ * with PARITY_STUB_SLOW_CASE set, only the case with that id is slowed.
+ */
+
+#ifdef STUB_ALTERNATE
+#define STUB_ENGINE "stub-alternate"
+#else
+#define STUB_ENGINE "stub"
+#endif
+#define STUB_COMMIT "0000000"
+#define STUB_BUILD_FLAGS "-O0"
+#define STUB_DURATION_MS 1.0
+
+static void stub_sleep(const InputCase *input_case) {
+    const char *slow_case = getenv("PARITY_STUB_SLOW_CASE");
+    if (slow_case && strcmp(slow_case, input_case->id) != 0) {
+        return;
+    }
+    const char *sleep_ms = getenv("PARITY_STUB_SLEEP_MS");
+    const long ms = sleep_ms ? atol(sleep_ms) : 0;
+    if (ms > 0) {
+        const struct timespec delay = {ms / 1000, (ms % 1000) * 1000000L};
+        nanosleep(&delay, NULL);
+    }
+}
+
+static void stub_colors(const InputCase *input_case, EngineColor *colors, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const double phase = (double)(input_case->seed % 997) + (double)i / 3.0;
+        EngineColor *color = &colors[i];
+        color->oklab.l = 0.2 + 0.6 * (double)(i + 1) / (double)(count + 1);
+        color->oklab.a = 0.1 * sin(phase);
+        color->oklab.b = 0.1 * cos(phase);
+#ifdef STUB_ALTERNATE
+        color->oklab.l += 1e-7 * (double)(i % 3);
+#endif
+        color->srgb.r = color->oklab.l;
+        color->srgb.g = fabs(color->oklab.a) * 3.0;
+        color->srgb.b = fabs(color->oklab.b) * 3.0;
+    }
+}
+
+#ifdef STUB_PLUGIN
+
+static int stub_generate(const InputCase *input_case,
+                         EngineColor *colors,
+                         size_t capacity,
+                         size_t *out_count,
+                         char *error_message,
+                         size_t error_capacity) {
+    (void)error_message;
+    (void)error_capacity;
+    stub_sleep(input_case);
+    stub_colors(input_case, colors, capacity);
+    *out_count = capacity;
+    return 0;
+}
+
+const ParityEnginePlugin *parity_engine_plugin(void) {
+    static const ParityEnginePlugin plugin = {
+        PARITY_PLUGIN_ABI_VERSION,
+        (uint32_t)sizeof(InputCase),
+        (uint32_t)sizeof(EngineColor),
+        STUB_ENGINE,
+        STUB_COMMIT,
+        STUB_BUILD_FLAGS,
+        NULL,
+        stub_generate
+    };
+    return &plugin;
+}
+
+#else
+
+/* Writes one EngineOutput for the case, as a JSON line or a binary frame. */
+static int answer_case(const InputCase *input_case, int binary) {
+    stub_sleep(input_case);
+    const size_t count = input_case->config.count;
+    EngineOutput output;
+    memset(&output, 0, sizeof(output));
+    strncpy(output.engine, STUB_ENGINE, sizeof(output.engine) - 1);
+    output.commit = STUB_COMMIT;
+    output.build_flags = STUB_BUILD_FLAGS;
+    output.duration_ms = STUB_DURATION_MS;
+    output.color_count = count;
+    output.colors = (EngineColor *)calloc(count > 0 ? count : 1, sizeof(EngineColor));
+    if (!output.colors) {
+        return -1;
+    }
+    stub_colors(input_case, output.colors, count);
+
+    int status = 0;
+    if (binary) {
+        size_t length = 0;
+        char *frame = encode_engine_frame(&output, &length);
+        status = frame && fwrite(frame, 1, length, stdout) == length ? 0 : -1;
+        free(frame);
+    } else {
+        status = printf("{\"engine\":\"%s\",\"commit\":\"%s\",\"buildFlags\":\"%s\",\"durationMs\":%.17g,\"count\":%zu,"
+                        "\"colors\":[",
+                        output.engine, output.commit, output.build_flags, output.duration_ms, count) > 0 ? 0 : -1;
+        for (size_t i = 0; status == 0 && i < count; ++i) {
+            const EngineColor *color = &output.colors[i];
+            if (printf("%s{\"oklab\":{\"l\":%.17g,\"a\":%.17g,\"b\":%.17g},\"rgb\":{\"r\":%.17g,\"g\":%.17g,\"b\":%.17g}}",
+                       i == 0 ? "" : ",", color->oklab.l, color->oklab.a, color->oklab.b,
+                       color->srgb.r, color->srgb.g, color->srgb.b) < 0) {
+                status = -1;
+            }
+        }
+        if (status == 0 && printf("]}\n") < 0) {
+            status = -1;
+        }
+    }
+    free(output.colors);
+    return fflush(stdout) == 0 ? status : -1;
+}
+
+static int serve(int binary) {
+    size_t capacity = 4096;
+    char *line = (char *)malloc(capacity);
+    size_t length = 0;
+    int c;
+    while (line && (c = getchar()) != EOF) {
+        if (c != '\n') {
+            if (length + 1 == capacity) {
+                char *grown = (char *)realloc(line, capacity * 2);
+                if (!grown) {
+                    break;
+                }
+                line = grown;
+                capacity *= 2;
+            }
+            line[length++] = (char)c;
+            continue;
+        }
+        line[length] = '\0';
+        length = 0;
+        InputCase input_case;
+        ValidationError error = {0};
+        if (parse_input_case_json(line, &input_case, &error) != 0) {
+            fprintf(stderr, "stub engine: %s\n", error.message ? error.message : "bad request");
+            free(error.message);
+            free(line);
+            return 1;
+        }
+        const int status = answer_case(&input_case, binary);
+        free_input_case(&input_case);
+        if (status != 0) {
+            free(line);
+            return 1;
+        }
+    }
+    free(line);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *corpus_path = NULL;
+    const char *case_id = NULL;
+    int server = 0;
+    int binary = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) {
+            corpus_path = argv[++i];
+        } else if (strcmp(argv[i], "--case-id") == 0 && i + 1 < argc) {
+            case_id = argv[++i];
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            binary = strcmp(argv[++i], "bin") == 0;
+        } else if (strcmp(argv[i], "--server") == 0) {
+            server = 1;
+        }
+    }
+    if (server) {
+        return serve(binary);
+    }
+    if (!corpus_path || !case_id) {
+        fprintf(stderr, "usage: stub_engine --corpus <path> --case-id <id> [--format bin] | --server [--format bin]\n");
+        return 2;
+    }
+
+    InputCase input_case;
+    ValidationError error = {0};
+    if (load_corpus_case(corpus_path, case_id, &input_case, &error) != 0) {
+        fprintf(stderr, "stub engine: %s\n", error.message ? error.message : "failed to load case");
+        free(error.message);
+        return 1;
+    }
+    const int status = answer_case(&input_case, binary);
+    free_input_case(&input_case);
+    return status == 0 ? 0 : 1;
+}
+
+#endif
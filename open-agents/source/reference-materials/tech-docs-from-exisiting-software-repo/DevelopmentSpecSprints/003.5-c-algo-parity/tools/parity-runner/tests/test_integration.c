@@ -1,8 +1,11 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <time.h>
 
 static int file_exists(const char *path) {
     struct stat st;
@@ -40,6 +43,116 @@ static int file_contains(const char *path, const char *needle) {
     return found;
 }
 
+/* Every run uses the in-tree stub engines (tests/stub_engine.c), so the suite needs no real engine build. */
+#define PARITY_RUNNER "./parity-runner --c-runner tests/stub_engine --alt-runner tests/stub_engine_alt"
+#define STUB_CORPUS "tests/output/stub-corpus.json"
+#define STUB_CASES 12
+
+/* A corpus big enough that --jobs has work to interleave. */
+static int write_stub_corpus(void) {
+    FILE *file = fopen(STUB_CORPUS, "w");
+    if (!file) {
+        return 0;
+    }
+    fprintf(file, "{\"corpusVersion\": \"v20251212.1\", \"cases\": [");
+    for (int i = 0; i < STUB_CASES; ++i) {
+        fprintf(file, "%s{\"id\": \"stub-%02d\", \"anchors\": [{\"oklab\": {\"l\": 0.5, \"a\": 0.1, \"b\": 0.05}}], "
+                      "\"config\": {\"count\": %d, \"loopMode\": \"once\"}, \"seed\": %d, \"corpusVersion\": \"v20251212.1\"}",
+                i == 0 ? "" : ", ", i, 3 + i % 5, 100 + i);
+    }
+    fprintf(file, "]}\n");
+    return fclose(file) == 0;
+}
+
+/* Runs parity-runner over the stub corpus with the in-tree stub engines; returns its exit status or -1. */
+static int run_stub(const char *artifacts, const char *options) {
+    char command[1024];
+    remove_path(artifacts);
+    snprintf(command, sizeof(command),
+             PARITY_RUNNER " --corpus %s --tolerances tests/fixtures/test-tolerances.json --artifacts %s "
+             "--run-id stub --pass-gate 0 %s > /dev/null",
+             STUB_CORPUS, artifacts, options);
+    const int result = system(command);
+    return result == -1 ? -1 : WEXITSTATUS(result);
+}
+
+/* The key of a report line, up to and including the colon; the whole line when it has none. */
+static size_t key_length(const char *line) {
+    const char *colon = strstr(line, "\": ");
+    return colon ? (size_t)(colon - line) + 2 : strlen(line);
+}
+
+/* Reads lines until one contains `needle`, which is left in `line`. */
+static int skip_to_line(FILE *file, char *line, size_t size, const char *needle) {
+    while (fgets(line, (int)size, file)) {
+        if (strstr(line, needle)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Whether the key part of `line` contains any of the NULL-terminated `keys`. */
+static int key_is_one_of(const char *line, const char *const *keys) {
+    const size_t key = key_length(line);
+    for (size_t i = 0; keys && keys[i]; ++i) {
+        const char *found = strstr(line, keys[i]);
+        if (found && (size_t)(found - line) < key) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Compares two report.json files line by line, from the first line containing
+ * `from` when it is not NULL. Harness-measured timings, the artifacts path and
+ * the `also_ignored` keys only need to match by key; everything else must be
+ * byte-identical.
+ */
+static int reports_match(const char *path_a, const char *path_b, const char *const *also_ignored, const char *from) {
+    static const char *const volatile_keys[] = {
+        "\"durationMs\"", "\"artifactsRoot\"", "\"wallMs\"", "\"spawnMs\"", "\"waitMs\"", "\"parseMs\"",
+        "\"compareMs\"", "\"writeMs\"", "\"totalMs\"", "\"p50Ms\"", "\"p95Ms\"", "\"maxMs\"", "\"peakRssBytes",
+        NULL,
+    };
+    FILE *a = fopen(path_a, "r");
+    FILE *b = fopen(path_b, "r");
+    char line_a[1024];
+    char line_b[1024];
+    int match = a && b;
+    int pending = 0; /* line_a and line_b already hold the `from` lines */
+    if (match && from) {
+        match = skip_to_line(a, line_a, sizeof(line_a), from) && skip_to_line(b, line_b, sizeof(line_b), from);
+        pending = 1;
+    }
+    while (match) {
+        const int more_a = pending || fgets(line_a, sizeof(line_a), a) != NULL;
+        const int more_b = pending || fgets(line_b, sizeof(line_b), b) != NULL;
+        pending = 0;
+        if (!more_a || !more_b) {
+            match = !more_a && !more_b;
+            break;
+        }
+        const size_t key = key_length(line_a);
+        if (key_is_one_of(line_a, volatile_keys) || key_is_one_of(line_a, also_ignored)) {
+            match = key == key_length(line_b) && strncmp(line_a, line_b, key) == 0;
+        } else {
+            match = strcmp(line_a, line_b) == 0;
+        }
+        if (!match) {
+            fprintf(stderr, "%s: %s%s: %s", path_a, line_a, path_b, line_b);
+        }
+    }
+    if (a) {
+        fclose(a);
+    }
+    if (b) {
+        fclose(b);
+    }
+    return match;
+}
+
 int main(void) {
     const char *artifacts = "tests/output/integration";
     const char *report_path = "tests/output/integration/report.json";
@@ -47,8 +160,8 @@ int main(void) {
 
     remove_path(artifacts);
 
-    char command[512];
-    snprintf(command, sizeof(command), "./parity-runner --corpus %s --tolerances %s --artifacts %s",
+    char command[1024];
+    snprintf(command, sizeof(command), PARITY_RUNNER " --corpus %s --tolerances %s --artifacts %s",
              "tests/fixtures/test-corpus.json",
              "tests/fixtures/test-tolerances.json",
              artifacts);
@@ -69,13 +182,20 @@ int main(void) {
     failures += assert_true(file_contains(report_path, "topContributors"), "report should include top contributors");
     failures += assert_true(file_exists(metadata_path), "metadata.json should exist for at least one case");
     failures += assert_true(file_contains(metadata_path, "topContributors"), "metadata should include contributors");
+    failures += assert_true(file_contains(report_path, "measuredCases\": 2"), "report should include run timing");
+    failures += assert_true(file_contains(report_path, "\"samples\": 3") && file_contains(report_path, "\"peakRssBytes\""),
+                             "report should include peak memory and the sample count");
+    failures += assert_true(file_contains(report_path, "\"histograms\"") && file_contains(report_path, "subBuckets\": 128"),
+                            "report should include log histograms");
+    failures += assert_true(file_contains(metadata_path, "waitMs"), "metadata should include case timing");
+    failures += assert_true(file_contains(report_path, "slowestCases"), "report should include engine performance");
 
     /* Test tag-based filtering */
     const char *tagged_artifacts = "tests/output/integration-tags";
     const char *tagged_report = "tests/output/integration-tags/report.json";
     remove_path(tagged_artifacts);
 
-    snprintf(command, sizeof(command), "./parity-runner --corpus %s --tolerances %s --artifacts %s --tags baseline",
+    snprintf(command, sizeof(command), PARITY_RUNNER " --corpus %s --tolerances %s --artifacts %s --tags baseline",
              "tests/fixtures/test-corpus.json",
              "tests/fixtures/test-tolerances.json",
              tagged_artifacts);
@@ -91,12 +211,62 @@ int main(void) {
     failures += assert_true(file_exists(tagged_report), "tag-filtered report should be created");
     failures += assert_true(file_contains(tagged_report, "totalCases\": 1"), "tag-filtered report should include filtered totals");
 
+    remove_path(tagged_artifacts);
+    snprintf(command, sizeof(command), PARITY_RUNNER " --corpus %s --tolerances %s --artifacts %s --select '%s'",
+             "tests/fixtures/test-corpus.json",
+             "tests/fixtures/test-tolerances.json",
+             tagged_artifacts,
+             "id:case-* AND NOT tag:baseline");
+    strncat(command, " --pass-gate 0 --percentiles 50,99.9", sizeof(command) - strlen(command) - 1);
+
+    result = system(command);
+    if (result == -1) {
+        fprintf(stderr, "Failed to spawn parity-runner for --select\n");
+        return 1;
+    }
+    failures += assert_true(WEXITSTATUS(result) == 0, "--select run should exit successfully");
+    failures += assert_true(file_contains(tagged_report, "case-edge") && !file_contains(tagged_report, "case-baseline"),
+                            "--select should run only the matching cases");
+    failures += assert_true(file_contains(tagged_report, "\"p99.9\""), "report should include the requested percentiles");
+
+    /* Test a packed corpus compiled from the fixture */
+    const char *packed_artifacts = "tests/output/integration-packed";
+    const char *packed_report = "tests/output/integration-packed/report.json";
+    remove_path(packed_artifacts);
+
+    result = system("./parity-corpus compile tests/fixtures/test-corpus.json tests/output/integration.pcorpus > /dev/null");
+    if (result == -1) {
+        fprintf(stderr, "Failed to spawn parity-corpus\n");
+        return 1;
+    }
+    failures += assert_true(WEXITSTATUS(result) == 0, "parity-corpus compile should exit successfully");
+    result = system("./parity-corpus stats tests/output/integration.pcorpus > tests/output/corpus-stats.txt");
+    failures += assert_true(result != -1 && WEXITSTATUS(result) == 0 &&
+                                file_contains("tests/output/corpus-stats.txt", "Loaded 2 cases"),
+                            "parity-corpus stats should report the loaded cases");
+
+    snprintf(command, sizeof(command), PARITY_RUNNER " --corpus %s --tolerances %s --artifacts %s --cases case-edge",
+             "tests/output/integration.pcorpus",
+             "tests/fixtures/test-tolerances.json",
+             packed_artifacts);
+    strncat(command, " --pass-gate 0", sizeof(command) - strlen(command) - 1);
+
+    result = system(command);
+    if (result == -1) {
+        fprintf(stderr, "Failed to spawn parity-runner for packed corpus\n");
+        return 1;
+    }
+    exit_code = WEXITSTATUS(result);
+    failures += assert_true(exit_code == 0, "packed corpus run should exit successfully");
+    failures += assert_true(file_contains(packed_report, "totalCases\": 1"), "packed corpus run should select by id");
+    failures += assert_true(file_contains(packed_report, "v20251212.1"), "packed corpus run should keep the corpus version");
+
     /* Test tolerance override */
     const char *override_artifacts = "tests/output/integration-tolerance";
     const char *override_report = "tests/output/integration-tolerance/report.json";
     remove_path(override_artifacts);
 
-    snprintf(command, sizeof(command), "./parity-runner --corpus %s --tolerances %s --artifacts %s",
+    snprintf(command, sizeof(command), PARITY_RUNNER " --corpus %s --tolerances %s --artifacts %s",
              "tests/fixtures/test-corpus.json",
              "tests/fixtures/test-tolerances.json",
              override_artifacts);
@@ -113,5 +283,181 @@ int main(void) {
     failures += assert_true(file_exists(override_report), "tolerance override report should be created");
     failures += assert_true(file_contains(override_report, "\"deltaE\": 0.123"), "report should include overridden deltaE");
 
+    /* Test incremental run against the first report */
+    const char *since_artifacts = "tests/output/integration-since";
+    const char *since_report = "tests/output/integration-since/report.json";
+    remove_path(since_artifacts);
+
+    snprintf(command, sizeof(command), PARITY_RUNNER " --corpus %s --tolerances %s --artifacts %s --since %s",
+             "tests/fixtures/test-corpus.json",
+             "tests/fixtures/test-tolerances.json",
+             since_artifacts,
+             report_path);
+    strncat(command, " --pass-gate 0", sizeof(command) - strlen(command) - 1);
+
+    result = system(command);
+    if (result == -1) {
+        fprintf(stderr, "Failed to spawn parity-runner for incremental run\n");
+        return 1;
+    }
+    exit_code = WEXITSTATUS(result);
+    failures += assert_true(exit_code == 0, "incremental run should exit successfully");
+    failures += assert_true(file_contains(since_report, "carriedOverCases\": 2"), "unchanged cases should be carried over");
+    failures += assert_true(file_contains(since_report, "totalCases\": 2"), "carried cases should count in summary totals");
+
+    /* Test sharded runs merged back into one report */
+    const char *merged_artifacts = "tests/output/integration-merged";
+    const char *merged_report = "tests/output/integration-merged/report.json";
+    remove_path("tests/output/integration-shard-0");
+    remove_path("tests/output/integration-shard-1");
+    remove_path(merged_artifacts);
+
+    for (int shard = 0; shard < 2; ++shard) {
+        snprintf(command, sizeof(command), PARITY_RUNNER " --corpus %s --tolerances %s --artifacts tests/output/integration-shard-%d --shard %d/2",
+                 "tests/fixtures/test-corpus.json",
+                 "tests/fixtures/test-tolerances.json",
+                 shard,
+                 shard);
+        strncat(command, " --pass-gate 0", sizeof(command) - strlen(command) - 1);
+        result = system(command);
+        if (result == -1) {
+            fprintf(stderr, "Failed to spawn parity-runner for shard %d\n", shard);
+            return 1;
+        }
+        failures += assert_true(WEXITSTATUS(result) == 0, "shard run should exit successfully");
+    }
+
+    snprintf(command, sizeof(command), "./parity-merge --output %s --pass-gate 0 --stats streaming %s %s",
+             merged_artifacts,
+             "tests/output/integration-shard-1/report.json",
+             "tests/output/integration-shard-0/report.json");
+    result = system(command);
+    if (result == -1) {
+        fprintf(stderr, "Failed to spawn parity-merge\n");
+        return 1;
+    }
+    exit_code = WEXITSTATUS(result);
+    failures += assert_true(exit_code == 0, "parity-merge should exit successfully");
+    failures += assert_true(file_contains(merged_report, "totalCases\": 2"), "merged report should include every shard's cases");
+    failures += assert_true(file_contains(merged_report, "mergedShards\": 2"), "merged report should record the shard count");
+
+    snprintf(command, sizeof(command), "./parity-merge --output %s --stats sketch %s %s",
+             "tests/output/integration-merged-bad-stats",
+             "tests/output/integration-shard-0/report.json",
+             "tests/output/integration-shard-1/report.json");
+    result = system(command);
+    failures += assert_true(result != -1 && WEXITSTATUS(result) == 1 &&
+                                !file_exists("tests/output/integration-merged-bad-stats/report.json"),
+                            "parity-merge should reject an unknown --stats mode");
+
+    /* NaN/Inf deltas are printed as null; a shard carrying one must still merge */
+    const char *null_shard = "tests/output/integration-shard-null/report.json";
+    remove_path("tests/output/integration-shard-null");
+    remove_path("tests/output/integration-merged-null");
+    system("mkdir -p tests/output/integration-shard-null");
+    snprintf(command, sizeof(command), "sed 's/^     \"deltaE\": .*,$/     \"deltaE\": null,/' %s > %s",
+             "tests/output/integration-shard-0/report.json",
+             null_shard);
+    result = system(command);
+    failures += assert_true(result != -1 && WEXITSTATUS(result) == 0 && file_contains(null_shard, "\"deltaE\": null"),
+                            "shard report with null deltas should be prepared");
+    snprintf(command, sizeof(command), "./parity-merge --output %s --pass-gate 0 %s %s",
+             "tests/output/integration-merged-null",
+             null_shard,
+             "tests/output/integration-shard-1/report.json");
+    result = system(command);
+    if (result == -1) {
+        fprintf(stderr, "Failed to spawn parity-merge for null deltas\n");
+        return 1;
+    }
+    failures += assert_true(WEXITSTATUS(result) == 0, "parity-merge should accept a shard with null deltas");
+    failures += assert_true(file_contains("tests/output/integration-merged-null/report.json", "totalCases\": 2"),
+                            "merged report should keep the case with null deltas");
+
+    /* Shards must agree on the engine wire format */
+    const char *bin_shard = "tests/output/integration-shard-bin/report.json";
+    remove_path("tests/output/integration-shard-bin");
+    remove_path("tests/output/integration-merged-bin");
+    system("mkdir -p tests/output/integration-shard-bin");
+    snprintf(command, sizeof(command), "sed 's/\"engineFormat\": \"json\"/\"engineFormat\": \"bin\"/' %s > %s",
+             "tests/output/integration-shard-0/report.json",
+             bin_shard);
+    result = system(command);
+    failures += assert_true(result != -1 && WEXITSTATUS(result) == 0 && file_contains(bin_shard, "\"engineFormat\": \"bin\""),
+                            "shard report with another engine format should be prepared");
+    snprintf(command, sizeof(command), "./parity-merge --output %s --pass-gate 0 %s %s",
+             "tests/output/integration-merged-bin",
+             bin_shard,
+             "tests/output/integration-shard-1/report.json");
+    result = system(command);
+    failures += assert_true(result != -1 && WEXITSTATUS(result) == 1 &&
+                                !file_exists("tests/output/integration-merged-bin/report.json"),
+                            "parity-merge should reject shards run with different engine formats");
+    failures += assert_true(file_contains(merged_report, "\"engineFormat\": \"json\""),
+                            "merged report should keep the shards' engine format");
+
+
+    /* End-to-end modes, over a corpus big enough to spread across workers */
+    const char *stub_report = "tests/output/integration-stub/report.json";
+    failures += assert_true(write_stub_corpus(), "stub corpus should be written");
+    failures += assert_true(run_stub("tests/output/integration-stub", "--jobs 1") == 0, "stub run should exit successfully");
+    failures += assert_true(file_contains(stub_report, "totalCases\": 12") && file_contains(stub_report, "passed\": 12"),
+                            "stub run should pass every case");
+
+    failures += assert_true(run_stub("tests/output/integration-stub-jobs", "--jobs 4") == 0 &&
+                                reports_match(stub_report, "tests/output/integration-stub-jobs/report.json", NULL, NULL),
+                            "--jobs 4 should report exactly what --jobs 1 does, timings aside");
+
+    failures += assert_true(run_stub("tests/output/integration-stub-server", "--jobs 2 --engine-server") == 0 &&
+                                reports_match(stub_report, "tests/output/integration-stub-server/report.json", NULL, NULL),
+                            "--engine-server should report exactly what one process per case does");
+
+    failures += assert_true(run_stub("tests/output/integration-stub-bin", "--jobs 2 --engine-format bin") == 0 &&
+                                reports_match(stub_report, "tests/output/integration-stub-bin/report.json",
+                                              (const char *const[]){"\"engineFormat\"", NULL}, NULL),
+                            "--engine-format bin should report exactly what JSON output does");
+
+    /*
+     * Plugins are other files than the runners, so the engine hashes in the fingerprints differ, and their
+     * durations are measured rather than reported; compare the cases' samples and verdicts.
+     */
+    failures += assert_true(run_stub("tests/output/integration-stub-plugin",
+                                     "--jobs 2 --c-engine-so tests/stub_engine.so --alt-engine-so tests/stub_engine_alt.so") == 0 &&
+                                reports_match(stub_report, "tests/output/integration-stub-plugin/report.json",
+                                              (const char *const[]){"\"fingerprint\"", "DurationMs\"", "\"speedRatio\"", NULL},
+                                              "\"cases\""),
+                            "engine plugins should report exactly what the runners do");
+
+    remove_path("tests/output/integration-stub-cache");
+    failures += assert_true(run_stub("tests/output/integration-stub-cold", "--jobs 2 --cache-dir tests/output/integration-stub-cache") == 0 &&
+                                file_contains("tests/output/integration-stub-cold/report.json", "cacheHits\": 0") &&
+                                file_contains("tests/output/integration-stub-cold/report.json", "cacheMisses\": 12"),
+                            "a cold cache should miss every case");
+    failures += assert_true(run_stub("tests/output/integration-stub-warm", "--jobs 2 --cache-dir tests/output/integration-stub-cache") == 0 &&
+                                file_contains("tests/output/integration-stub-warm/report.json", "cacheHits\": 12") &&
+                                reports_match("tests/output/integration-stub-cold/report.json",
+                                              "tests/output/integration-stub-warm/report.json",
+                                              (const char *const[]){"\"cache", NULL}, NULL),
+                            "a warm cache should hit every case and report the same results");
+    failures += assert_true(run_stub("tests/output/integration-stub-cache-bin",
+                                     "--jobs 2 --engine-format bin --cache-dir tests/output/integration-stub-cache") == 0 &&
+                                file_contains("tests/output/integration-stub-cache-bin/report.json", "cacheMisses\": 12"),
+                            "entries cached from JSON output should miss for --engine-format bin");
+
+    const char *repeat_report = "tests/output/integration-stub-repeat/report.json";
+    failures += assert_true(run_stub("tests/output/integration-stub-repeat", "--jobs 2 --repeat 3 --warmup 1") == 0 &&
+                                file_contains(repeat_report, "durationTrials") && file_contains(repeat_report, "trials\": 3") &&
+                                file_contains(repeat_report, "nondeterministicCases\": 0"),
+                            "--repeat/--warmup should record three timed trials per engine");
+
+    setenv("PARITY_STUB_SLEEP_MS", "10000", 1);
+    const time_t timeout_start = time(NULL);
+    failures += assert_true(run_stub("tests/output/integration-stub-timeout",
+                                     "--case-timeout-ms 200 2> tests/output/integration-stub-timeout.log") == 1 &&
+                                file_contains("tests/output/integration-stub-timeout.log", "exceeded the case timeout"),
+                            "a case past --case-timeout-ms should fail the run");
+    failures += assert_true(time(NULL) - timeout_start < 5, "a timed-out engine should be killed, not waited for");
+    unsetenv("PARITY_STUB_SLEEP_MS");
+
     return failures == 0 ? 0 : 1;
 }
@@ -1,8 +1,11 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "cJSON.h"
 #include "types.h"
 
 static int assert_true(int condition, const char *message) {
@@ -13,9 +16,282 @@ static int assert_true(int condition, const char *message) {
     return 0;
 }
 
+static int compare_doubles(const void *a, const void *b) {
+    const double da = *(const double *)a;
+    const double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/*
+ * Every compare kernel the CPU supports must match a per-sample comparison bit
+ * for bit, and its fused pass must accumulate exactly what a walk over the
+ * samples would.
+ */
+static int check_compare_kernels(const ToleranceConfig *tolerance, int with_specials, int *any_passed, int *any_failed) {
+    enum { COUNT = 603 }; /* a few fused tiles and a ragged tail */
+    static EngineColor canonical[COUNT];
+    static EngineColor alternate[COUNT];
+    static SampleDelta expected_samples[COUNT];
+    uint64_t state = with_specials ? 0x9e3779b97f4a7c15ULL : 0x2545f4914f6cdd1dULL;
+    for (size_t i = 0; i < COUNT; ++i) {
+        double *c = &canonical[i].oklab.l;
+        double *a = &alternate[i].oklab.l;
+        for (size_t k = 0; k < 6; ++k) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            c[k] = (double)(state >> 11) / 9007199254740992.0;
+            a[k] = c[k] + ((double)((state >> 20) & 0xffff) - 32768.0) * 1e-9;
+        }
+    }
+    if (with_specials) {
+        canonical[3].oklab.l = NAN;
+        alternate[70].oklab.b = INFINITY;
+        canonical[71].srgb.g = -0.0;
+        alternate[71].srgb.g = 0.0;
+        canonical[130].oklab.a = 1e300;
+        alternate[202].srgb.r = -NAN;
+    }
+    ComparisonResult expected = {.passed = 1};
+    double *expected_max[7] = {&expected.max_l, &expected.max_a, &expected.max_b, &expected.max_delta_e,
+                               &expected.max_rgb_r, &expected.max_rgb_g, &expected.max_rgb_b};
+    const RunMetric metric_of[7] = {RUN_METRIC_L, RUN_METRIC_A, RUN_METRIC_B, RUN_METRIC_DELTA_E,
+                                    RUN_METRIC_RGB_R, RUN_METRIC_RGB_G, RUN_METRIC_RGB_B};
+    RunAccumulator walked;
+    RunningMoments walked_moments[RUN_METRIC_COUNT] = {{0}};
+    init_run_accumulator(&walked, STATS_MODE_STREAMING);
+    for (size_t i = 0; i < COUNT; ++i) {
+        SampleDelta *sample = &expected_samples[i];
+        sample->index = i;
+        sample->canonical = canonical[i];
+        sample->alternate = alternate[i];
+        sample->delta.l = canonical[i].oklab.l - alternate[i].oklab.l;
+        sample->delta.a = canonical[i].oklab.a - alternate[i].oklab.a;
+        sample->delta.b = canonical[i].oklab.b - alternate[i].oklab.b;
+        sample->delta.deltaE = delta_e_oklab(&canonical[i].oklab, &alternate[i].oklab);
+        sample->rgb_delta.r = canonical[i].srgb.r - alternate[i].srgb.r;
+        sample->rgb_delta.g = canonical[i].srgb.g - alternate[i].srgb.g;
+        sample->rgb_delta.b = canonical[i].srgb.b - alternate[i].srgb.b;
+        if (!comparison_within_tolerance(&sample->delta, tolerance)) {
+            expected.passed = 0;
+        }
+        const double magnitude[7] = {fabs(sample->delta.l), fabs(sample->delta.a), fabs(sample->delta.b),
+                                     sample->delta.deltaE, fabs(sample->rgb_delta.r),
+                                     fabs(sample->rgb_delta.g), fabs(sample->rgb_delta.b)};
+        const double signed_delta[7] = {sample->delta.l, sample->delta.a, sample->delta.b, sample->delta.deltaE,
+                                        sample->rgb_delta.r, sample->rgb_delta.g, sample->rgb_delta.b};
+        double magnitudes[RUN_METRIC_COUNT];
+        for (size_t m = 0; m < 7; ++m) {
+            if (magnitude[m] > *expected_max[m]) {
+                *expected_max[m] = magnitude[m];
+                expected.max_signed[metric_of[m]] = signed_delta[m];
+            }
+            magnitudes[metric_of[m]] = magnitude[m];
+        }
+        accumulate_sample(&walked, walked_moments, magnitudes);
+    }
+    *any_passed |= expected.passed;
+    *any_failed |= !expected.passed;
+
+    ComparisonResult result = {.canonical_colors = canonical, .alternate_colors = alternate, .sample_count = COUNT};
+    SampleDelta sample;
+    int samples_match = 1;
+    for (size_t i = 0; i < COUNT; ++i) {
+        memset(&sample, 0xa5, sizeof(sample));
+        comparison_sample(&result, i, &sample);
+        samples_match &= memcmp(&sample, &expected_samples[i], sizeof(sample)) == 0;
+    }
+    int failures = assert_true(samples_match, "comparison samples are derived from the palettes");
+
+    const char *kernels[] = {"scalar", "sse2", "avx2", "avx512"};
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+        if (select_compare_kernel(kernels[k]) != 0) {
+            continue;
+        }
+        compare_palettes(canonical, alternate, COUNT, tolerance, &result, NULL);
+        failures += assert_true(result.passed == expected.passed &&
+                                    memcmp(&result.max_delta_e, &expected.max_delta_e, 7 * sizeof(double)) == 0 &&
+                                    memcmp(result.max_signed, expected.max_signed, sizeof(result.max_signed)) == 0,
+                                kernels[k]);
+
+        RunAccumulator fused;
+        init_run_accumulator(&fused, STATS_MODE_STREAMING);
+        compare_palettes(canonical, alternate, COUNT, tolerance, &result, &fused);
+        int same = result.accumulated && result.moments && fused.samples == COUNT &&
+                   memcmp(result.moments, walked_moments, sizeof(walked_moments)) == 0;
+        for (size_t m = 0; m < RUN_METRIC_COUNT; ++m) {
+            same &= fused.hist[m].nan_count == walked.hist[m].nan_count &&
+                    memcmp(fused.hist[m].counts, walked.hist[m].counts, LOG_HISTOGRAM_BUCKETS * sizeof(size_t)) == 0 &&
+                    memcmp(fused.sketch[m].bins, walked.sketch[m].bins, sizeof(walked.sketch[m].bins)) == 0;
+        }
+        failures += assert_true(same, "the fused compare pass should accumulate every sample once");
+        free_run_accumulator(&fused);
+        free(result.moments);
+        result.moments = NULL;
+        result.accumulated = false;
+    }
+    select_compare_kernel("auto");
+    free_run_accumulator(&walked);
+    return failures;
+}
+
+/* JsonWriter must print the bytes cJSON would for the same document, in each of its layouts. */
+static int check_json_writer(char indent) {
+    static const double numbers[] = {0.0, -0.0, 1.0, -3.0, 0.1, 1.0 / 3.0, 1e300, 3e9, -2147483648.0, 2147483647.5,
+                                     5e-324, 123456789.123, NAN, INFINITY};
+    const size_t number_count = sizeof(numbers) / sizeof(numbers[0]);
+    const char *text = "q\"\\\b\f\n\r\t\x01\xc3\xa9";
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "s", text);
+    cJSON *values = cJSON_AddArrayToObject(root, "n");
+    for (size_t i = 0; i < number_count; ++i) {
+        cJSON_AddItemToArray(values, cJSON_CreateNumber(numbers[i]));
+    }
+    cJSON_AddObjectToObject(root, "e");
+    cJSON_AddArrayToObject(root, "a");
+    cJSON *nested = cJSON_AddObjectToObject(root, "o");
+    cJSON_AddBoolToObject(nested, "t", 1);
+    cJSON *list = cJSON_AddArrayToObject(nested, "list");
+    cJSON *item = cJSON_CreateObject();
+    cJSON_AddNumberToObject(item, "x", 1);
+    cJSON_AddItemToArray(list, item);
+    cJSON_AddItemToArray(list, cJSON_CreateArray());
+    char *expected = indent ? cJSON_Print(root) : cJSON_PrintUnformatted(root);
+    for (char *p = expected; p && *p; ++p) {
+        if (*p == '\t') {
+            *p = indent;
+        }
+    }
+
+    FILE *file = tmpfile();
+    JsonWriter w;
+    json_writer_init(&w, file, indent);
+    json_begin_object(&w, NULL);
+    json_write_string(&w, "s", text);
+    json_begin_array(&w, "n");
+    for (size_t i = 0; i < number_count; ++i) {
+        json_write_number(&w, NULL, numbers[i]);
+    }
+    json_end_array(&w);
+    json_begin_object(&w, "e");
+    json_end_object(&w);
+    json_begin_array(&w, "a");
+    json_end_array(&w);
+    json_begin_object(&w, "o");
+    json_write_bool(&w, "t", true);
+    json_begin_array(&w, "list");
+    json_begin_object(&w, NULL);
+    json_write_number(&w, "x", 1);
+    json_end_object(&w);
+    json_begin_array(&w, NULL);
+    json_end_array(&w);
+    json_end_array(&w);
+    json_end_object(&w);
+    json_end_object(&w);
+    const int finished = json_writer_finish(&w) == 0;
+
+    char written[1024] = {0};
+    rewind(file);
+    const size_t length = fread(written, 1, sizeof(written) - 1, file);
+    fclose(file);
+    const int same = finished && expected && length == strlen(expected) && memcmp(written, expected, length) == 0;
+    cJSON_free(expected);
+    cJSON_Delete(root);
+    return assert_true(same, indent == '\0' ? "compact JsonWriter should match cJSON_PrintUnformatted"
+                                            : "formatted JsonWriter should match cJSON_Print");
+}
+
+/* NaN and Inf deltas are printed as null; reading them back must not reject the report. */
+static int check_null_sample_report(void) {
+    static const char report[] =
+        "{\"cases\":[{\"inputCaseId\":\"case-null\",\"fingerprint\":\"0123456789abcdef\",\"samples\":["
+        "{\"index\":0,\"deltaE\":0.5,\"delta\":{\"l\":0.5,\"a\":0,\"b\":0},\"rgbDelta\":{\"r\":0.1,\"g\":0,\"b\":0},"
+        "\"canonical\":{\"l\":0.5,\"a\":0,\"b\":0},\"alternate\":{\"l\":0,\"a\":0,\"b\":0}},"
+        "{\"index\":1,\"deltaE\":null,\"delta\":{\"l\":null,\"a\":0,\"b\":0},\"rgbDelta\":{\"r\":0,\"g\":0,\"b\":0},"
+        "\"canonical\":{\"l\":null,\"a\":0,\"b\":0},\"alternate\":{\"l\":0,\"a\":0,\"b\":0}}]}]}";
+    const char *path = "tests/output/null-sample-report.json";
+    int failures = 0;
+    ValidationError error = {0};
+
+    FILE *file = fopen(path, "wb");
+    failures += assert_true(file && fputs(report, file) >= 0 && fclose(file) == 0, "null-sample report written");
+    PreviousRun previous;
+    failures += assert_true(load_previous_run(path, &previous, &error) == 0 && previous.result_count == 0,
+                             "--since should re-run, not reject, a case with null samples");
+    free_previous_run(&previous);
+    remove(path);
+
+    cJSON *root = cJSON_Parse(report);
+    PreviousRun shard;
+    const int parsed = parse_report_cases(cJSON_GetObjectItemCaseSensitive(root, "cases"), 0, &shard, &error);
+    failures += assert_true(parsed == 0 && shard.result_count == 1 && shard.results[0].sample_count == 2 &&
+                                shard.results[0].samples[0].delta.deltaE == 0.5 &&
+                                isnan(shard.results[0].samples[1].delta.deltaE) &&
+                                isnan(shard.results[0].samples[1].delta.l) &&
+                                isnan(shard.results[0].samples[1].canonical.oklab.l),
+                             "null sample fields should read back as NaN");
+    free_previous_run(&shard);
+    cJSON_Delete(root);
+    free(error.message);
+    return failures;
+}
+
+/*
+ * A timed-out request leaves the server session out of step: it must refuse the
+ * next case rather than hand it the late response, and a replacement session
+ * must answer that case exactly as a one-shot runner does.
+ */
+static int check_engine_server_restart(const Corpus *corpus) {
+    const char *stub = "tests/stub_engine";
+    const LaunchLimits limits = {.timeout_ms = 200};
+    const InputCase *slow = &corpus->cases[1];
+    const InputCase *next = &corpus->cases[0];
+    int failures = 0;
+    ValidationError error = {0};
+
+    setenv("PARITY_STUB_SLEEP_MS", "2000", 1);
+    setenv("PARITY_STUB_SLOW_CASE", slow->id, 1);
+    EngineServer *server = start_engine_server(stub, &limits, ENGINE_FORMAT_JSON, &error);
+    EngineOutput served;
+    EngineOutput expected;
+    memset(&served, 0, sizeof(served));
+    memset(&expected, 0, sizeof(expected));
+    failures += assert_true(server && engine_server_run_case(server, slow, &served, NULL, &error) != 0 &&
+                                engine_server_failed(server),
+                             "a timed-out request should mark the server session failed");
+    failures += assert_true(server && engine_server_run_case(server, next, &served, NULL, &error) != 0,
+                             "a failed server session should refuse further cases");
+    failures += assert_true(stop_engine_server(server) != 0, "stopping a failed server session should report it");
+
+    server = start_engine_server(stub, &limits, ENGINE_FORMAT_JSON, &error);
+    const int restarted = server ? engine_server_run_case(server, next, &served, NULL, &error) : -1;
+    const int one_shot = run_c_engine(stub, "tests/fixtures/test-corpus.json", next, &limits, ENGINE_FORMAT_JSON,
+                                      &expected, NULL, &error);
+    failures += assert_true(restarted == 0 && one_shot == 0 && engine_outputs_identical(&served, &expected),
+                             "a restarted server session should answer the next case correctly");
+    failures += assert_true(stop_engine_server(server) == 0, "a healthy server session should stop cleanly");
+    unsetenv("PARITY_STUB_SLEEP_MS");
+    unsetenv("PARITY_STUB_SLOW_CASE");
+    free_engine_output(&served);
+    free_engine_output(&expected);
+    free(error.message);
+    return failures;
+}
+
 int main(void) {
     int failures = 0;
     ValidationError error = {.message = NULL};
+    install_json_arena_hooks();
+
+    Arena arena;
+    arena_init(&arena, 0);
+    char *small = arena_strdup(&arena, "tag");
+    double *large = (double *)arena_calloc(&arena, 100000, sizeof(double));
+    char *after = arena_strdup(&arena, "after");
+    failures += assert_true(small && large && after && strcmp(small, "tag") == 0 && large[99999] == 0.0 &&
+                                (uintptr_t)large % 16 == 0 && after == small + 16 && arena.allocations == 3 &&
+                                arena.block_count == 2,
+                             "an oversized arena allocation should get its own block");
+    arena_release(&arena);
 
     Corpus corpus;
     failures += assert_true(parse_corpus_file("tests/fixtures/test-corpus.json", &corpus, &error) == 0,
@@ -27,7 +303,141 @@ int main(void) {
         failures += assert_true(strcmp(corpus.corpus_version, "v20251212.1") == 0,
                                  "corpus version should match fixture");
         failures += assert_true(corpus.case_count == 2, "expected two cases in fixture");
+        failures += assert_true(corpus.arena.block_count == 1 && corpus.arena.allocations > corpus.case_count,
+                                 "corpus cases should be allocated from its arena");
+
+        char *serialized = serialize_input_case(&corpus.cases[0]);
+        InputCase round_trip;
+        failures += assert_true(serialized && parse_input_case_json(serialized, &round_trip, &error) == 0,
+                                 "serialized input case should parse");
+        if (serialized && failures == 0) {
+            char *reserialized = serialize_input_case(&round_trip);
+            failures += assert_true(reserialized && strcmp(serialized, reserialized) == 0,
+                                     "input case serialization should round-trip");
+            failures += assert_true(strchr(serialized, '\n') == NULL, "serialized input case should be one line");
+            free(reserialized);
+            free_input_case(&round_trip);
+        }
+        free(serialized);
+
+        Arena json_arena;
+        arena_init(&json_arena, 0);
+        json_arena_begin(&json_arena);
+        char *pooled = serialize_input_case(&corpus.cases[1]);
+        json_arena_end();
+        failures += assert_true(pooled && strstr(pooled, "case-edge") && json_arena.allocations > 1,
+                                 "cJSON should allocate from the open JSON arena");
+        arena_release(&json_arena);
+
+        CorpusIndex index;
+        failures += assert_true(open_corpus_index("tests/fixtures/test-corpus.json", &index, &error) == 0,
+                                 error.message ? error.message : "corpus indexed");
+        if (index.entries) {
+            failures += assert_true(index.entry_count == 2 && strcmp(index.entries[1].id, "case-edge") == 0 &&
+                                        corpus_entry_has_tag(&index, &index.entries[0], "oklab") &&
+                                        !corpus_entry_has_tag(&index, &index.entries[1], "oklab"),
+                                     "corpus index should record ids and tags");
+            const size_t second = 1;
+            Corpus lazy;
+            failures += assert_true(load_indexed_cases(&index, &second, 1, &lazy, &error) == 0 && lazy.case_count == 1,
+                                     "indexed case should load");
+            if (lazy.cases) {
+                char *eager_json = serialize_input_case(&corpus.cases[1]);
+                char *lazy_json = serialize_input_case(&lazy.cases[0]);
+                failures += assert_true(eager_json && lazy_json && strcmp(eager_json, lazy_json) == 0,
+                                         "lazily loaded case should match the eager parse");
+                free(eager_json);
+                free(lazy_json);
+                free_corpus(&lazy);
+            }
+            close_corpus_index(&index);
+        }
+
+        Corpus packed_corpus;
+        failures += assert_true(write_packed_corpus(&corpus, "tests/output/test-corpus.pcorpus", &error) == 0 &&
+                                    parse_corpus_file("tests/output/test-corpus.pcorpus", &packed_corpus, &error) == 0,
+                                 error.message ? error.message : "packed corpus written and loaded");
+        if (failures == 0) {
+            failures += assert_true(packed_corpus.case_count == corpus.case_count &&
+                                        strcmp(packed_corpus.corpus_version, corpus.corpus_version) == 0,
+                                     "packed corpus should keep every case");
+            for (size_t i = 0; i < packed_corpus.case_count && i < corpus.case_count; ++i) {
+                char *json_case = serialize_input_case(&corpus.cases[i]);
+                char *packed_case = serialize_input_case(&packed_corpus.cases[i]);
+                failures += assert_true(json_case && packed_case && strcmp(json_case, packed_case) == 0,
+                                         "packed case should match the JSON case");
+                free(json_case);
+                free(packed_case);
+            }
+            free_corpus(&packed_corpus);
+            PackedCorpus packed;
+            size_t found = 0;
+            failures += assert_true(open_packed_corpus("tests/output/test-corpus.pcorpus", &packed, &error) == 0 &&
+                                        packed_corpus_find(&packed, "case-edge", &found) == 0 && found == 1 &&
+                                        packed_corpus_find(&packed, "case-missing", &found) != 0 &&
+                                        packed_case_has_tag(&packed, 0, "baseline"),
+                                     "packed corpus should find cases by id");
+            close_packed_corpus(&packed);
+        }
+
+        CaseCatalog catalog;
+        failures += assert_true(build_case_catalog(&corpus, &catalog, &error) == 0 &&
+                                    catalog_find_case(&catalog, "case-edge") == &corpus.cases[1] &&
+                                    !catalog_find_case(&catalog, "case-missing"),
+                                 "case catalog should index ids");
+        size_t picked[2] = {0, 0};
+        size_t picked_count = 0;
+        SelectExpr *expr = parse_select_expression("tag:oklab AND NOT tag:baseline OR id:case-e*", &error);
+        failures += assert_true(expr && select_cases(&catalog, expr, NULL, 0, NULL, 0, picked, &picked_count, &error) == 0 &&
+                                    picked_count == 1 && picked[0] == 1,
+                                 "NOT should bind tighter than AND, and AND tighter than OR");
+        free_select_expression(expr);
+        expr = parse_select_expression("(tag:baseline OR id:case-edge) and not (tag:slow)", &error);
+        char *only_edge[] = {"case-edge"};
+        failures += assert_true(expr && select_cases(&catalog, expr, only_edge, 1, NULL, 0, picked, &picked_count, &error) == 0 &&
+                                    picked_count == 1 && picked[0] == 1,
+                                 "--cases should narrow a --select expression");
+        free_select_expression(expr);
+        failures += assert_true(!parse_select_expression("tag:baseline AND", &error) &&
+                                    !parse_select_expression("(tag:baseline", &error) &&
+                                    !parse_select_expression("label:x", &error),
+                                 "malformed --select expressions should be rejected");
+        free_case_catalog(&catalog);
+
+        EngineColor cached_colors[2] = {{{0.5, 0.1, -0.2}, {0.7, 0.3, 0.1}}, {{0.6, 0.0, 0.1}, {0.2, 0.4, 0.9}}};
+        EngineOutput stored = {.engine = "c", .colors = cached_colors, .color_count = 2, .duration_ms = 1.5,
+                               .build_flags = "-O2"};
+        EngineOutput loaded;
+        OutputCache *cache = open_output_cache("tests/output/cache", "tests/fixtures/test-corpus.json",
+                                               ENGINE_FORMAT_JSON, &error);
+        failures += assert_true(cache != NULL, error.message ? error.message : "output cache opened");
+        if (cache) {
+            failures += assert_true(output_cache_store(cache, &corpus.cases[1], &stored, &error) == 0,
+                                     "canonical output stored in cache");
+            failures += assert_true(output_cache_load(cache, &corpus.cases[1], &loaded) == 1 &&
+                                        loaded.color_count == 2 &&
+                                        memcmp(loaded.colors, cached_colors, sizeof(cached_colors)) == 0 &&
+                                        strcmp(loaded.build_flags, "-O2") == 0 && !loaded.commit,
+                                     "cached output should round-trip bit for bit");
+            free_engine_output(&loaded);
+        }
+        /* Same engine and identity, other wire format: JSON colors are rounded, so entries must not cross. */
+        OutputCache *bin_cache = open_output_cache("tests/output/cache", "tests/fixtures/test-corpus.json",
+                                                   ENGINE_FORMAT_BIN, &error);
+        if (cache && bin_cache) {
+            failures += assert_true(output_cache_load(bin_cache, &corpus.cases[1], &loaded) == 0,
+                                     "json-format cache entries should miss for bin-format runs");
+            failures += assert_true(output_cache_store(bin_cache, &corpus.cases[0], &stored, &error) == 0 &&
+                                        output_cache_load(cache, &corpus.cases[0], &loaded) == 0,
+                                     "bin-format cache entries should miss for json-format runs");
+            failures += assert_true(output_cache_load(bin_cache, &corpus.cases[0], &loaded) == 1,
+                                     "bin-format cache entries should hit for bin-format runs");
+            free_engine_output(&loaded);
+        }
+        close_output_cache(cache);
+        close_output_cache(bin_cache);
     }
+        failures += check_engine_server_restart(&corpus);
 
     ToleranceConfig tolerance;
     failures += assert_true(parse_tolerances_file("tests/fixtures/test-tolerances.json", &tolerance, &error) == 0,
@@ -55,6 +465,219 @@ int main(void) {
     double delta = delta_e_oklab(&color_a, &color_b);
     failures += assert_true(delta > 0.0, "delta_e_oklab should compute positive distance");
 
+    int any_passed = 0;
+    int any_failed = 0;
+    ToleranceConfig tight = tolerance;
+    tight.abs.deltaE = 2e-5;
+    tight.rel.l = 1e-5;
+    failures += check_compare_kernels(&tolerance, 0, &any_passed, &any_failed);
+    failures += check_compare_kernels(&tight, 0, &any_passed, &any_failed);
+    failures += check_compare_kernels(&tolerance, 1, &any_passed, &any_failed);
+    failures += check_json_writer('\0');
+    failures += check_json_writer('\t');
+    failures += check_json_writer(' ');
+    failures += check_null_sample_report();
+    failures += assert_true(any_passed && any_failed, "compare kernels should be checked on passing and failing palettes");
+
+    EngineOutput decoded;
+    const char *engine_json =
+        "{\"count\":2,\"engine\":\"c\\u00e9\",\"meta\":{\"nested\":[1,\"x\",null]},\"durationMs\":1.5,"
+        "\"colors\":[{\"oklab\":{\"l\":0.5,\"a\":0.1,\"b\":-0.2},\"rgb\":{\"r\":0.7,\"g\":0.3,\"b\":0.1}},"
+        "{\"rgb\":{\"b\":0.9,\"g\":0.4,\"r\":0.2},\"oklab\":{\"l\":0.6,\"a\":0,\"b\":1e-3}}],\"commit\":\"a\\\"b\"}";
+    failures += assert_true(parse_engine_output(engine_json, &decoded, &error) == 0, "engine output should decode");
+    failures += assert_true(strcmp(decoded.engine, "c\xc3\xa9") == 0 && decoded.color_count == 2 &&
+                                decoded.colors[1].srgb.r == 0.2 && decoded.colors[1].oklab.b == 1e-3 &&
+                                decoded.duration_ms == 1.5 && strcmp(decoded.commit, "a\"b") == 0 && !decoded.platform,
+                             "decoded engine output should match the document");
+    EngineOutput decoded_copy;
+    InputCase compared_case = {.id = "retained"};
+    compared_case.config.count = 2;
+    ComparisonResult retained;
+    failures += assert_true(parse_engine_output(engine_json, &decoded_copy, &error) == 0 &&
+                                compare_engine_outputs(&decoded, &decoded_copy, &tolerance, &compared_case, &retained, NULL) == 0,
+                             "engine outputs should compare");
+    retain_compared_colors(&retained, &decoded, &decoded_copy);
+    SampleDelta retained_sample;
+    comparison_sample(&retained, 1, &retained_sample);
+    failures += assert_true(!decoded.colors && !decoded_copy.colors && retained.passed && retained_sample.index == 1 &&
+                                retained_sample.delta.deltaE == 0.0 && retained_sample.alternate.srgb.b == 0.9,
+                             "retained comparison should take over the engine palettes");
+    free_engine_output(&decoded_copy);
+    free_comparison_result(&retained);
+    free_engine_output(&decoded);
+    failures += assert_true(parse_engine_output("{\"engine\":\"c\",\"durationMs\":1,\"colors\":[]}", &decoded, &error) != 0 &&
+                                strcmp(error.message, "engine output missing required fields") == 0,
+                             "engine output without count should be rejected");
+    failures += assert_true(parse_engine_output("{\"engine\":\"c\",\"durationMs\":1,\"count\":1,\"colors\":"
+                                                "[{\"oklab\":{\"l\":0,\"a\":0,\"b\":\"0\"},\"rgb\":{\"r\":0,\"g\":0,\"b\":0}}]}",
+                                                &decoded, &error) != 0 &&
+                                strcmp(error.message, "engine color components must be numeric") == 0,
+                             "non-numeric color component should be rejected");
+    failures += assert_true(parse_engine_output("{\"engine\":\"c\",\"durationMs\":1,\"count\":1,\"colors\":[{\"rgb\":[]}]",
+                                                &decoded, &error) != 0 &&
+                                strcmp(error.message, "failed to parse engine JSON output") == 0,
+                             "truncated engine output should be a parse failure");
+
+    EngineColor frame_colors[2] = {{{0.1 + 0.2, -0.0, 1e-310}, {0.7, 0.3, 0.1}}, {{0.6, 0.0, 0.1}, {0.2, 0.4, 0.9}}};
+    EngineOutput framed = {.engine = "wasm", .colors = frame_colors, .color_count = 2, .duration_ms = 2.25,
+                           .platform = "linux"};
+    size_t frame_length = 0;
+    char *frame = encode_engine_frame(&framed, &frame_length);
+    failures += assert_true(frame && decode_engine_frame(frame, frame_length, &decoded, &error) == 0,
+                             "engine frame should decode");
+    if (frame && decoded.colors) {
+        failures += assert_true(strcmp(decoded.engine, "wasm") == 0 && decoded.color_count == 2 &&
+                                    memcmp(decoded.colors, frame_colors, sizeof(frame_colors)) == 0 &&
+                                    decoded.duration_ms == 2.25 && strcmp(decoded.platform, "linux") == 0 &&
+                                    !decoded.commit,
+                                 "engine frame should round-trip bit for bit");
+        free_engine_output(&decoded);
+        failures += assert_true(decode_engine_frame(frame, frame_length - 1, &decoded, &error) != 0,
+                                 "truncated engine frame should be rejected");
+        failures += assert_true(engine_frame_size(frame, 47) == 0 && engine_frame_size(frame, frame_length) == frame_length,
+                                 "frame size should be known once the header is complete");
+    }
+    free(frame);
+
+    const double trial_ms[7] = {10.0, 11.0, 9.0, 10.0, 10.5, 9.5, 40.0};
+    TrialStats trials;
+    summarize_trials(trial_ms, 7, 3.0, &trials);
+    failures += assert_true(trials.trials == 7 && trials.rejected == 1, "outlier trial should be rejected");
+    failures += assert_true(fabs(trials.median_ms - 10.0) < 1e-9 && fabs(trials.min_ms - 9.0) < 1e-9,
+                             "trial median and min should ignore the outlier");
+
+    /* Multi-quantile selection must agree with a full sort, including duplicates and presorted input. */
+    enum { SELECT_VALUES = 5003 };
+    double *select_values = (double *)malloc(SELECT_VALUES * sizeof(double));
+    double *sorted_values = (double *)malloc(SELECT_VALUES * sizeof(double));
+    const double select_q[] = {0.0, 0.5, 0.9, 0.99, 0.999, 0.9999, 1.0};
+    double selected_q[sizeof(select_q) / sizeof(select_q[0])];
+    int selection_matches = select_values && sorted_values;
+    for (int layout = 0; selection_matches && layout < 3; ++layout) {
+        unsigned long long select_state = 99;
+        for (size_t i = 0; i < SELECT_VALUES; ++i) {
+            select_state = select_state * 6364136223846793005ULL + 1442695040888963407ULL;
+            select_values[i] = layout == 0 ? (double)(select_state >> 54) : (layout == 1 ? (double)i : 7.0);
+        }
+        memcpy(sorted_values, select_values, SELECT_VALUES * sizeof(double));
+        qsort(sorted_values, SELECT_VALUES, sizeof(double), compare_doubles);
+        select_quantiles(select_values, SELECT_VALUES, select_q, 7, selected_q);
+        for (size_t q = 0; q < 7; ++q) {
+            selection_matches &= selected_q[q] == sorted_values[(size_t)floor(select_q[q] * (SELECT_VALUES - 1) + 0.5)];
+        }
+    }
+    failures += assert_true(selection_matches, "selected quantiles should match a full sort");
+    PercentileList percentile_list;
+    MetricStats with_percentiles;
+    failures += assert_true(parse_percentile_list("50,90,99.9,99.99", &percentile_list, &error) == 0 &&
+                                percentile_list.count == 4 && percentile_list.percents[2] == 99.9,
+                             "percentile list should parse");
+    if (select_values && sorted_values) {
+        compute_metric_stats_in_place(select_values, SELECT_VALUES, &percentile_list, &with_percentiles);
+        failures += assert_true(with_percentiles.percentile_count == 4 && with_percentiles.percentiles[3].percent == 99.99 &&
+                                    with_percentiles.percentiles[0].value == with_percentiles.p50,
+                                 "metric stats should carry the requested percentiles");
+    }
+    failures += assert_true(parse_percentile_list("99,50", &percentile_list, &error) != 0 &&
+                                parse_percentile_list("101", &percentile_list, &error) != 0,
+                             "unordered or out-of-range percentiles should be rejected");
+    free(error.message);
+    error.message = NULL;
+    free(select_values);
+    free(sorted_values);
+
+    /* Streaming stats: exact moments and extremes, quantiles within the sketch's relative error. */
+    enum { STREAM_VALUES = 10000 };
+    double *stream_values = (double *)malloc(STREAM_VALUES * sizeof(double));
+    StreamingStats whole;
+    StreamingStats halves[2];
+    init_streaming_stats(&whole);
+    init_streaming_stats(&halves[0]);
+    init_streaming_stats(&halves[1]);
+    unsigned long long lcg = 12345;
+    for (size_t i = 0; stream_values && i < STREAM_VALUES; ++i) {
+        lcg = lcg * 6364136223846793005ULL + 1442695040888963407ULL;
+        const double u = (double)(lcg >> 11) / 9007199254740992.0;
+        stream_values[i] = i % 10 == 0 ? 0.0 : pow(10.0, -9.0 * u);
+        add_streaming_stats(&whole, stream_values[i]);
+        add_streaming_stats(&halves[i < STREAM_VALUES / 3 ? 0 : 1], stream_values[i]);
+    }
+    merge_streaming_stats(&halves[0], &halves[1]);
+    MetricStats exact_stats;
+    MetricStats streamed_stats;
+    MetricStats merged_stats;
+    compute_metric_stats(stream_values, stream_values ? STREAM_VALUES : 0, &exact_stats);
+    finish_streaming_stats(&whole, NULL, &streamed_stats);
+    finish_streaming_stats(&halves[0], NULL, &merged_stats);
+    failures += assert_true(stream_values && streamed_stats.min == exact_stats.min &&
+                                streamed_stats.max == exact_stats.max &&
+                                fabs(streamed_stats.mean - exact_stats.mean) <= 1e-12 * exact_stats.mean &&
+                                fabs(streamed_stats.stddev - exact_stats.stddev) <= 1e-9 * exact_stats.stddev,
+                             "streaming moments should match the exact ones");
+    const double exact_q[3] = {exact_stats.p50, exact_stats.p95, exact_stats.p99};
+    const double streamed_q[3] = {streamed_stats.p50, streamed_stats.p95, streamed_stats.p99};
+    const double merged_q[3] = {merged_stats.p50, merged_stats.p95, merged_stats.p99};
+    for (int q = 0; q < 3; ++q) {
+        failures += assert_true(fabs(streamed_q[q] - exact_q[q]) <= QUANTILE_SKETCH_ALPHA * exact_q[q] * (1.0 + 1e-12),
+                                 "streaming quantiles should stay within the sketch's relative error");
+        failures += assert_true(merged_q[q] == streamed_q[q], "merged sketches should match a single sketch");
+    }
+    failures += assert_true(halves[0].moments.count == STREAM_VALUES && merged_stats.min == streamed_stats.min &&
+                                fabs(merged_stats.mean - streamed_stats.mean) <= 1e-12 * streamed_stats.mean &&
+                                fabs(merged_stats.stddev - streamed_stats.stddev) <= 1e-9 * streamed_stats.stddev,
+                             "merged moments should match a single pass");
+    free(stream_values);
+
+    /* Far more decades than the sketch has buckets: the lowest collapse, the upper quantiles hold. */
+    StreamingStats wide;
+    init_streaming_stats(&wide);
+    for (int e = -300; e <= 300; ++e) {
+        add_streaming_stats(&wide, pow(10.0, (double)e));
+    }
+    const double wide_p99 = streaming_stats_quantile(&wide, 0.99);
+    failures += assert_true(fabs(wide_p99 - 1e294) <= QUANTILE_SKETCH_ALPHA * 1e294 && wide.moments.min == 1e-300,
+                             "collapsed sketch should keep its upper quantiles");
+
+    /* Log histograms: every value lands in a bucket no wider than 1/SUB_BUCKETS of its floor; merging adds counts. */
+    LogHistogram hist_whole;
+    LogHistogram hist_parts[2];
+    int hist_ready = init_log_histogram(&hist_whole) == 0;
+    hist_ready &= init_log_histogram(&hist_parts[0]) == 0;
+    hist_ready &= init_log_histogram(&hist_parts[1]) == 0;
+    const double hist_values[] = {0.0, 1e-300, 1e-12, 3.3e-7, 0.25, 1.0, 1.0 - 1e-16, 4095.0, 4096.0, INFINITY, NAN};
+    const size_t hist_value_count = sizeof(hist_values) / sizeof(hist_values[0]);
+    for (size_t i = 0; hist_ready && i < hist_value_count; ++i) {
+        record_log_histogram(&hist_whole, hist_values[i]);
+        record_log_histogram(&hist_parts[i % 2], hist_values[i]);
+    }
+    merge_log_histogram(&hist_parts[0], &hist_parts[1]);
+    size_t binned = 0;
+    int buckets_hold_values = 1;
+    for (size_t i = 0; hist_ready && i < LOG_HISTOGRAM_BUCKETS; ++i) {
+        if (hist_whole.counts[i] == 0) {
+            continue;
+        }
+        binned += hist_whole.counts[i];
+        const double floor_value = log_histogram_bucket_floor(i);
+        const double ceiling = log_histogram_bucket_floor(i + 1);
+        size_t inside = 0;
+        for (size_t k = 0; k < hist_value_count; ++k) {
+            inside += hist_values[k] >= floor_value && hist_values[k] < ceiling;
+        }
+        buckets_hold_values &= inside == hist_whole.counts[i] &&
+                               ceiling - floor_value <= floor_value / LOG_HISTOGRAM_SUB_BUCKETS;
+    }
+    failures += assert_true(hist_ready && hist_whole.total == hist_value_count && hist_whole.underflow == 2 &&
+                                hist_whole.overflow == 2 && hist_whole.nan_count == 1 && binned == 6 && buckets_hold_values,
+                             "log histogram should bucket values by octave and slice");
+    failures += assert_true(hist_ready && hist_parts[0].total == hist_whole.total &&
+                                hist_parts[0].underflow == hist_whole.underflow &&
+                                memcmp(hist_parts[0].counts, hist_whole.counts, LOG_HISTOGRAM_BUCKETS * sizeof(size_t)) == 0,
+                             "merged log histograms should match a single one");
+    free_log_histogram(&hist_whole);
+    free_log_histogram(&hist_parts[0]);
+    free_log_histogram(&hist_parts[1]);
+
     free_tolerances(&tolerance);
     free_corpus(&corpus);
     free(error.message);
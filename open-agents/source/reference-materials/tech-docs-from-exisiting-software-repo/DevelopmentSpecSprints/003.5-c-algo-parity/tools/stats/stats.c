@@ -12,49 +12,174 @@ static int compare_double(const void *a, const void *b) {
     return 0;
 }
 
-int init_histogram(Histogram *hist, double min_value, double max_value, size_t bucket_count) {
-    if (!hist || bucket_count == 0 || max_value <= min_value) {
+int init_log_histogram(LogHistogram *hist) {
+    if (!hist) {
         return -1;
     }
-    memset(hist, 0, sizeof(Histogram));
-    hist->min_value = min_value;
-    hist->max_value = max_value;
-    hist->bucket_count = bucket_count;
-    hist->bucket_size = (max_value - min_value) / (double)bucket_count;
-    hist->counts = (size_t *)calloc(bucket_count, sizeof(size_t));
+    memset(hist, 0, sizeof(LogHistogram));
+    hist->counts = (size_t *)calloc(LOG_HISTOGRAM_BUCKETS, sizeof(size_t));
     return hist->counts ? 0 : -1;
 }
 
-void record_histogram(Histogram *hist, double value) {
-    if (!hist || !hist->counts || hist->bucket_size <= 0) {
+/* A value in [2^k, 2^(k+1)) lands in one of LOG_HISTOGRAM_SUB_BUCKETS equal slices of that octave. */
+void record_log_histogram(LogHistogram *hist, double value) {
+    if (!hist || !hist->counts) {
+        return;
+    }
+    hist->total++;
+    if (isnan(value)) {
+        hist->nan_count++;
         return;
     }
-    if (value < hist->min_value) {
-        value = hist->min_value;
+    int exponent = 0;
+    const double mantissa = frexp(value, &exponent); /* value = mantissa * 2^exponent, mantissa in [0.5, 1) */
+    const int octave = exponent - 1 - LOG_HISTOGRAM_MIN_EXPONENT;
+    if (value <= 0.0 || octave < 0) {
+        hist->underflow++;
+    } else if (isinf(value) || octave >= LOG_HISTOGRAM_MAX_EXPONENT - LOG_HISTOGRAM_MIN_EXPONENT) {
+        hist->overflow++;
+    } else {
+        const size_t slice = (size_t)((2.0 * mantissa - 1.0) * LOG_HISTOGRAM_SUB_BUCKETS);
+        hist->counts[(size_t)octave * LOG_HISTOGRAM_SUB_BUCKETS + slice]++;
     }
-    if (value > hist->max_value) {
-        value = hist->max_value;
+}
+
+void merge_log_histogram(LogHistogram *into, const LogHistogram *from) {
+    if (!into || !into->counts || !from || !from->counts) {
+        return;
     }
-    size_t index = (size_t)((value - hist->min_value) / hist->bucket_size);
-    if (index >= hist->bucket_count) {
-        index = hist->bucket_count - 1;
+    into->total += from->total;
+    into->underflow += from->underflow;
+    into->overflow += from->overflow;
+    into->nan_count += from->nan_count;
+    for (size_t i = 0; i < LOG_HISTOGRAM_BUCKETS; ++i) {
+        into->counts[i] += from->counts[i];
     }
-    hist->counts[index] += 1;
 }
 
-void free_histogram(Histogram *hist) {
+/* Smallest value recorded in bucket index; the bucket ends where index + 1 begins. */
+double log_histogram_bucket_floor(size_t index) {
+    const int octave = (int)(index / LOG_HISTOGRAM_SUB_BUCKETS);
+    const double slice = (double)(index % LOG_HISTOGRAM_SUB_BUCKETS);
+    return ldexp(1.0 + slice / LOG_HISTOGRAM_SUB_BUCKETS, octave + LOG_HISTOGRAM_MIN_EXPONENT);
+}
+
+void free_log_histogram(LogHistogram *hist) {
     if (!hist) {
         return;
     }
     free(hist->counts);
-    memset(hist, 0, sizeof(Histogram));
+    memset(hist, 0, sizeof(LogHistogram));
 }
 
-void compute_metric_stats(const double *values, size_t count, MetricStats *out) {
+static void swap_values(double *values, size_t i, size_t j) {
+    const double tmp = values[i];
+    values[i] = values[j];
+    values[j] = tmp;
+}
+
+static double median_of_three(double a, double b, double c) {
+    if (a < b) {
+        return b < c ? b : (a < c ? c : a);
+    }
+    return a < c ? a : (b < c ? c : b);
+}
+
+/*
+ * Introselect for several ranks at once: after the call values[r] holds the
+ * r-th smallest value of [lo, hi) for every r in ranks (ascending, inside
+ * the range). Each three-way partition settles the ranks that land on the
+ * pivot and recurses only into the sides that still hold ranks; once depth
+ * runs out the range is sorted instead, which bounds the worst case.
+ */
+static void multi_select(double *values, size_t lo, size_t hi, const size_t *ranks, size_t rank_count, int depth) {
+    while (rank_count > 0 && hi - lo > 1) {
+        if (hi - lo <= 16 || depth-- == 0) {
+            qsort(values + lo, hi - lo, sizeof(double), compare_double);
+            return;
+        }
+        const double pivot = median_of_three(values[lo], values[lo + (hi - lo) / 2], values[hi - 1]);
+        /* [lo, lt) < pivot, [lt, gt) neither (the pivot's equals, and NaN), [gt, hi) > pivot */
+        size_t lt = lo;
+        size_t gt = hi;
+        for (size_t i = lo; i < gt;) {
+            if (values[i] < pivot) {
+                swap_values(values, lt++, i++);
+            } else if (values[i] > pivot) {
+                swap_values(values, i, --gt);
+            } else {
+                i++;
+            }
+        }
+        size_t below = 0;
+        while (below < rank_count && ranks[below] < lt) {
+            below++;
+        }
+        size_t above = below;
+        while (above < rank_count && ranks[above] < gt) {
+            above++;
+        }
+        multi_select(values, lo, lt, ranks, below, depth);
+        ranks += above;
+        rank_count -= above;
+        lo = gt;
+    }
+}
+
+static int compare_size(const void *a, const void *b) {
+    const size_t sa = *(const size_t *)a;
+    const size_t sb = *(const size_t *)b;
+    return (sa > sb) - (sa < sb);
+}
+
+static size_t quantile_rank(double q, size_t count) {
+    q = q < 0.0 ? 0.0 : (q > 1.0 ? 1.0 : q);
+    return (size_t)floor(q * (double)(count - 1) + 0.5);
+}
+
+/*
+ * Nearest-rank quantiles (rank floor(q * (n - 1) + 0.5)) of values, which
+ * are reordered in place. Expected O(n) for a handful of quantiles, given
+ * in any order; out[i] answers quantiles[i].
+ */
+void select_quantiles(double *values, size_t count, const double *quantiles, size_t quantile_count, double *out) {
+    if (!out || !quantiles) {
+        return;
+    }
+    size_t *ranks = (size_t *)malloc((quantile_count > 0 ? quantile_count : 1) * sizeof(size_t));
+    if (!values || count == 0 || !ranks) {
+        for (size_t i = 0; i < quantile_count; ++i) {
+            out[i] = 0.0;
+        }
+        free(ranks);
+        return;
+    }
+    for (size_t i = 0; i < quantile_count; ++i) {
+        ranks[i] = quantile_rank(quantiles[i], count);
+    }
+    qsort(ranks, quantile_count, sizeof(size_t), compare_size);
+    int depth = 0;
+    for (size_t n = count; n > 1; n >>= 1) {
+        depth += 2;
+    }
+    multi_select(values, 0, count, ranks, quantile_count, depth);
+    for (size_t i = 0; i < quantile_count; ++i) {
+        out[i] = values[quantile_rank(quantiles[i], count)];
+    }
+    free(ranks);
+}
+
+/* Reorders values; fills p50/p95/p99 and, when percentiles is given, its list too. */
+void compute_metric_stats_in_place(double *values, size_t count, const PercentileList *percentiles, MetricStats *out) {
     if (!out) {
         return;
     }
     memset(out, 0, sizeof(MetricStats));
+    const size_t extra = percentiles ? percentiles->count : 0;
+    for (size_t i = 0; i < extra; ++i) {
+        out->percentiles[i].percent = percentiles->percents[i];
+    }
+    out->percentile_count = extra;
     if (!values || count == 0) {
         return;
     }
@@ -77,17 +202,292 @@ void compute_metric_stats(const double *values, size_t count, MetricStats *out)
     }
     out->stddev = count > 1 ? sqrt(variance / (double)(count - 1)) : 0.0;
 
-    double *sorted = (double *)malloc(count * sizeof(double));
-    if (!sorted) {
+    double quantiles[3 + MAX_PERCENTILES] = {0.50, 0.95, 0.99};
+    double selected[3 + MAX_PERCENTILES];
+    for (size_t i = 0; i < extra; ++i) {
+        quantiles[3 + i] = percentiles->percents[i] / 100.0;
+    }
+    select_quantiles(values, count, quantiles, 3 + extra, selected);
+    out->p50 = selected[0];
+    out->p95 = selected[1];
+    out->p99 = selected[2];
+    for (size_t i = 0; i < extra; ++i) {
+        out->percentiles[i].value = selected[3 + i];
+    }
+}
+
+void compute_metric_stats(const double *values, size_t count, MetricStats *out) {
+    if (!out) {
+        return;
+    }
+    double *scratch = values && count > 0 ? (double *)malloc(count * sizeof(double)) : NULL;
+    if (scratch) {
+        memcpy(scratch, values, count * sizeof(double));
+    }
+    compute_metric_stats_in_place(scratch, scratch ? count : 0, NULL, out);
+    free(scratch);
+}
+
+/*
+ * Median, MAD and min of repeated measurements. Values further than
+ * outlier_mad * MAD from the median are rejected first (outlier_mad <= 0
+ * keeps everything); with a MAD of 0 nothing can be judged an outlier.
+ */
+void summarize_trials(const double *values, size_t count, double outlier_mad, TrialStats *out) {
+    if (!out) {
+        return;
+    }
+    memset(out, 0, sizeof(TrialStats));
+    if (!values || count == 0) {
+        return;
+    }
+
+    double *scratch = (double *)malloc(2 * count * sizeof(double));
+    if (!scratch) {
+        return;
+    }
+    double *kept = scratch;
+    double *deviations = scratch + count;
+
+    MetricStats stats;
+    MetricStats spread;
+    compute_metric_stats(values, count, &stats);
+    for (size_t i = 0; i < count; ++i) {
+        deviations[i] = fabs(values[i] - stats.p50);
+    }
+    compute_metric_stats(deviations, count, &spread);
+
+    size_t kept_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (outlier_mad <= 0.0 || spread.p50 <= 0.0 || deviations[i] <= outlier_mad * spread.p50) {
+            kept[kept_count++] = values[i];
+        }
+    }
+    if (kept_count < count) {
+        compute_metric_stats(kept, kept_count, &stats);
+        for (size_t i = 0; i < kept_count; ++i) {
+            deviations[i] = fabs(kept[i] - stats.p50);
+        }
+        compute_metric_stats(deviations, kept_count, &spread);
+    }
+
+    out->trials = count;
+    out->rejected = count - kept_count;
+    out->median_ms = stats.p50;
+    out->mad_ms = spread.p50;
+    out->min_ms = stats.min;
+    free(scratch);
+}
+
+static int sketch_index(const QuantileSketch *sketch, double value) {
+    return (int)ceil(log(value) / sketch->log_gamma);
+}
+
+/* Moves the bucket window to start at offset; occupied buckets below it collapse into the first one. */
+static void move_sketch_window(QuantileSketch *sketch, int offset) {
+    size_t moved[QUANTILE_SKETCH_BINS] = {0};
+    for (int index = sketch->min_index; index <= sketch->max_index; ++index) {
+        const size_t n = sketch->bins[index - sketch->offset];
+        if (n > 0) {
+            moved[(index < offset ? offset : index) - offset] += n;
+        }
+    }
+    memcpy(sketch->bins, moved, sizeof(moved));
+    sketch->offset = offset;
+    if (sketch->min_index < offset) {
+        sketch->min_index = offset;
+    }
+}
+
+static void add_sketch_bucket(QuantileSketch *sketch, int index, size_t n) {
+    if (sketch->binned == 0) {
+        sketch->offset = index - QUANTILE_SKETCH_BINS / 2;
+        sketch->min_index = index;
+        sketch->max_index = index;
+    } else if (index < sketch->offset || index >= sketch->offset + QUANTILE_SKETCH_BINS) {
+        const int low = index < sketch->min_index ? index : sketch->min_index;
+        const int high = index > sketch->max_index ? index : sketch->max_index;
+        const int span = high - low + 1;
+        /* Re-center when everything fits, otherwise keep the highest buckets. */
+        const int offset = span <= QUANTILE_SKETCH_BINS ? low - (QUANTILE_SKETCH_BINS - span) / 2
+                                                        : high - QUANTILE_SKETCH_BINS + 1;
+        if (offset != sketch->offset) {
+            move_sketch_window(sketch, offset);
+        }
+        if (index < sketch->offset) {
+            index = sketch->offset;
+        }
+    }
+    if (index < sketch->min_index) sketch->min_index = index;
+    if (index > sketch->max_index) sketch->max_index = index;
+    sketch->bins[index - sketch->offset] += n;
+    sketch->binned += n;
+}
+
+void init_quantile_sketch(QuantileSketch *sketch) {
+    if (!sketch) {
+        return;
+    }
+    memset(sketch, 0, sizeof(QuantileSketch));
+    sketch->log_gamma = log((1.0 + QUANTILE_SKETCH_ALPHA) / (1.0 - QUANTILE_SKETCH_ALPHA));
+}
+
+void add_quantile_sketch(QuantileSketch *sketch, double value) {
+    if (!sketch || isnan(value)) {
         return;
     }
-    memcpy(sorted, values, count * sizeof(double));
-    qsort(sorted, count, sizeof(double), compare_double);
+    if (value <= 0.0) {
+        sketch->zero_count++;
+    } else if (isinf(value)) {
+        sketch->infinite_count++;
+    } else {
+        add_sketch_bucket(sketch, sketch_index(sketch, value), 1);
+    }
+}
+
+/* Bucket counts add, so merging is exact and order does not matter. */
+void merge_quantile_sketch(QuantileSketch *into, const QuantileSketch *from) {
+    if (!into || !from) {
+        return;
+    }
+    into->zero_count += from->zero_count;
+    into->infinite_count += from->infinite_count;
+    for (int index = from->min_index; from->binned > 0 && index <= from->max_index; ++index) {
+        const size_t n = from->bins[index - from->offset];
+        if (n > 0) {
+            add_sketch_bucket(into, index, n);
+        }
+    }
+}
+
+/*
+ * Same rank as compute_metric_stats (floor(q * (n - 1) + 0.5)); the value
+ * returned is within QUANTILE_SKETCH_ALPHA of the exact one, relatively,
+ * unless that rank fell into collapsed buckets. Infinities answer INFINITY.
+ */
+double quantile_sketch_value(const QuantileSketch *sketch, double q) {
+    if (!sketch) {
+        return 0.0;
+    }
+    const size_t total = sketch->zero_count + sketch->binned + sketch->infinite_count;
+    if (total == 0) {
+        return 0.0;
+    }
+    const size_t rank = quantile_rank(q, total);
+    size_t seen = sketch->zero_count;
+    if (rank < seen) {
+        return 0.0;
+    }
+    for (int index = sketch->min_index; sketch->binned > 0 && index <= sketch->max_index; ++index) {
+        seen += sketch->bins[index - sketch->offset];
+        if (rank < seen) {
+            /* Midpoint of (gamma^(i-1), gamma^i] in relative terms. */
+            const double gamma = exp(sketch->log_gamma);
+            return 2.0 * exp((double)index * sketch->log_gamma) / (gamma + 1.0);
+        }
+    }
+    return INFINITY;
+}
+
+void add_running_moments(RunningMoments *moments, double value) {
+    if (!moments) {
+        return;
+    }
+    if (moments->count == 0) {
+        moments->min = value;
+        moments->max = value;
+    } else {
+        if (value < moments->min) moments->min = value;
+        if (value > moments->max) moments->max = value;
+    }
+    moments->count++;
+    const double delta = value - moments->mean;
+    moments->mean += delta / (double)moments->count;
+    moments->m2 += delta * (value - moments->mean);
+}
 
-    const double mid = (double)(count - 1);
-    out->p50 = sorted[(size_t)floor(0.50 * mid + 0.5)];
-    out->p95 = sorted[(size_t)floor(0.95 * mid + 0.5)];
-    out->p99 = sorted[(size_t)floor(0.99 * mid + 0.5)];
+/* Chan et al.'s pairwise update; the result depends on merge order only through rounding. */
+void merge_running_moments(RunningMoments *into, const RunningMoments *from) {
+    if (!into || !from || from->count == 0) {
+        return;
+    }
+    if (into->count == 0) {
+        *into = *from;
+        return;
+    }
+    const double total = (double)(into->count + from->count);
+    const double delta = from->mean - into->mean;
+    into->mean += delta * (double)from->count / total;
+    into->m2 += from->m2 + delta * delta * (double)into->count * (double)from->count / total;
+    into->count += from->count;
+    if (from->min < into->min) into->min = from->min;
+    if (from->max > into->max) into->max = from->max;
+}
+
+/* Moments as they are; sketched quantiles clamped to the exact [min, max]. */
+void finish_sketched_stats(const RunningMoments *moments,
+                           const QuantileSketch *sketch,
+                           const PercentileList *percentiles,
+                           MetricStats *out) {
+    if (!out) {
+        return;
+    }
+    memset(out, 0, sizeof(MetricStats));
+    out->percentile_count = percentiles ? percentiles->count : 0;
+    for (size_t i = 0; i < out->percentile_count; ++i) {
+        out->percentiles[i].percent = percentiles->percents[i];
+    }
+    if (!moments || moments->count == 0) {
+        return;
+    }
+    out->mean = moments->mean;
+    out->stddev = moments->count > 1 && moments->m2 > 0.0 ? sqrt(moments->m2 / (double)(moments->count - 1)) : 0.0;
+    out->min = moments->min;
+    out->max = moments->max;
+    double *const targets[3] = {&out->p50, &out->p95, &out->p99};
+    const double fixed[3] = {0.50, 0.95, 0.99};
+    for (size_t i = 0; i < 3 + out->percentile_count; ++i) {
+        double value = quantile_sketch_value(sketch, i < 3 ? fixed[i] : out->percentiles[i - 3].percent / 100.0);
+        if (value < moments->min) value = moments->min;
+        if (value > moments->max) value = moments->max;
+        *(i < 3 ? targets[i] : &out->percentiles[i - 3].value) = value;
+    }
+}
+
+void init_streaming_stats(StreamingStats *stats) {
+    if (!stats) {
+        return;
+    }
+    memset(&stats->moments, 0, sizeof(RunningMoments));
+    init_quantile_sketch(&stats->sketch);
+}
+
+void add_streaming_stats(StreamingStats *stats, double value) {
+    if (!stats) {
+        return;
+    }
+    add_running_moments(&stats->moments, value);
+    add_quantile_sketch(&stats->sketch, value);
+}
+
+void merge_streaming_stats(StreamingStats *into, const StreamingStats *from) {
+    if (!into || !from) {
+        return;
+    }
+    merge_running_moments(&into->moments, &from->moments);
+    merge_quantile_sketch(&into->sketch, &from->sketch);
+}
+
+double streaming_stats_quantile(const StreamingStats *stats, double q) {
+    if (!stats || stats->moments.count == 0) {
+        return 0.0;
+    }
+    double value = quantile_sketch_value(&stats->sketch, q);
+    if (value < stats->moments.min) value = stats->moments.min;
+    if (value > stats->moments.max) value = stats->moments.max;
+    return value;
+}
 
-    free(sorted);
+void finish_streaming_stats(const StreamingStats *stats, const PercentileList *percentiles, MetricStats *out) {
+    finish_sketched_stats(stats ? &stats->moments : NULL, stats ? &stats->sketch : NULL, percentiles, out);
 }
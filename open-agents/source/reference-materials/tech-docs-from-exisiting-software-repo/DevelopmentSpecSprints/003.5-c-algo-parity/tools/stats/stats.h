@@ -3,9 +3,29 @@
 
 #include "types.h"
 
-int init_histogram(Histogram *hist, double min_value, double max_value, size_t bucket_count);
-void record_histogram(Histogram *hist, double value);
-void free_histogram(Histogram *hist);
+int init_log_histogram(LogHistogram *hist);
+void record_log_histogram(LogHistogram *hist, double value);
+void merge_log_histogram(LogHistogram *into, const LogHistogram *from);
+double log_histogram_bucket_floor(size_t index);
+void free_log_histogram(LogHistogram *hist);
+void select_quantiles(double *values, size_t count, const double *quantiles, size_t quantile_count, double *out);
+void compute_metric_stats_in_place(double *values, size_t count, const PercentileList *percentiles, MetricStats *out);
 void compute_metric_stats(const double *values, size_t count, MetricStats *out);
+void summarize_trials(const double *values, size_t count, double outlier_mad, TrialStats *out);
+void init_quantile_sketch(QuantileSketch *sketch);
+void add_quantile_sketch(QuantileSketch *sketch, double value);
+void merge_quantile_sketch(QuantileSketch *into, const QuantileSketch *from);
+double quantile_sketch_value(const QuantileSketch *sketch, double q);
+void add_running_moments(RunningMoments *moments, double value);
+void merge_running_moments(RunningMoments *into, const RunningMoments *from);
+void finish_sketched_stats(const RunningMoments *moments,
+                           const QuantileSketch *sketch,
+                           const PercentileList *percentiles,
+                           MetricStats *out);
+void init_streaming_stats(StreamingStats *stats);
+void add_streaming_stats(StreamingStats *stats, double value);
+void merge_streaming_stats(StreamingStats *into, const StreamingStats *from);
+double streaming_stats_quantile(const StreamingStats *stats, double q);
+void finish_streaming_stats(const StreamingStats *stats, const PercentileList *percentiles, MetricStats *out);
 
 #endif